@@ -117,10 +117,12 @@ if(MSVC)
 endif()
 
 # sokol-shdc library (without main.cc)
+# input.cc is built through src/shdc_input.cc, which lets it parse sources
+# held in memory instead of requiring a file
 add_library(sokol_shdc_lib STATIC
     ${SHDC_SRC}/args.cc
     ${SHDC_SRC}/bytecode.cc
-    ${SHDC_SRC}/input.cc
+    ${CMAKE_CURRENT_SOURCE_DIR}/src/shdc_input.cc
     ${SHDC_SRC}/reflection.cc
     ${SHDC_SRC}/spirv.cc
     ${SHDC_SRC}/spirvcross.cc
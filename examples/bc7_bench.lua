@@ -0,0 +1,122 @@
+-- bc7_bench.lua - BC7 encoder thread scaling benchmark
+-- Encodes the examples/rendering texture set (assets/mill-scene/tex) once per
+-- thread count (1, 2, 4, ... up to bc7enc.max_threads()) and reports encode
+-- time and speedup over a single thread. Falls back to synthetic images when
+-- the assets are missing. Not part of run_tests.sh: encoding a full texture
+-- set takes seconds.
+-- Runs headless: lub3d-test examples.bc7_bench 1
+
+local gfx = require("sokol.gfx")
+local app = require("sokol.app")
+local glue = require("sokol.glue")
+local stm = require("sokol.time")
+local fs = require("lub3d.fs")
+local log = require("lib.log")
+local texture = require("lib.texture")
+
+local bc7enc_ok, bc7enc = pcall(require, "bc7enc")
+
+local TEXTURE_DIR <const> = "assets/mill-scene/tex/"
+local SYNTHETIC_COUNT <const> = 8
+local SYNTHETIC_SIZE <const> = 512
+
+local M = {}
+M.width = 320
+M.height = 240
+M.window_title = "Lub3d - BC7 Benchmark"
+
+---@return texture.ImageData[]
+local function load_images()
+    local images = {}
+    local iter = fs.dir(TEXTURE_DIR)
+    if iter then
+        for name in iter do
+            if name:match("%.png$") or name:match("%.jpg$") or name:match("%.tga$") then
+                local data = texture.load_image_data(TEXTURE_DIR .. name)
+                if data then
+                    images[#images + 1] = data
+                end
+            end
+        end
+    end
+    if #images > 0 then
+        return images
+    end
+
+    -- Noisy gradients: cheap to build, not trivially compressible
+    log.info("bc7_bench: " .. TEXTURE_DIR .. " not found, using synthetic images")
+    local seed = 1
+    for i = 1, SYNTHETIC_COUNT do
+        local rows = {}
+        for y = 0, SYNTHETIC_SIZE - 1 do
+            local row = {}
+            for x = 0, SYNTHETIC_SIZE - 1 do
+                seed = (seed * 1103515245 + 12345) & 0x7fffffff
+                local n = (seed >> 16) & 31
+                row[x + 1] = string.char((x + n) & 255, (y + n) & 255, (x * i + y) & 255, 255)
+            end
+            rows[y + 1] = table.concat(row)
+        end
+        images[i] = { w = SYNTHETIC_SIZE, h = SYNTHETIC_SIZE, ch = 4, pixels = table.concat(rows) }
+    end
+    return images
+end
+
+function M:init()
+    gfx.setup(gfx.Desc({
+        environment = glue.environment(),
+    }))
+    stm.setup()
+
+    if not bc7enc_ok then
+        log.info("bc7_bench: bc7enc not available, skipping")
+        return
+    end
+
+    local images = load_images()
+    local pixels = 0
+    for _, img in ipairs(images) do
+        pixels = pixels + img.w * img.h
+    end
+
+    local counts = {}
+    local n = 1
+    local max_threads = bc7enc.max_threads()
+    while n < max_threads do
+        counts[#counts + 1] = n
+        n = n * 2
+    end
+    counts[#counts + 1] = max_threads
+
+    local base_ms
+    for _, threads in ipairs(counts) do
+        local t0 = stm.now()
+        for _, img in ipairs(images) do
+            assert(bc7enc.encode(img.pixels, img.w, img.h, { quality = 5, threads = threads }))
+        end
+        local ms = stm.ms(stm.since(t0))
+        base_ms = base_ms or ms
+        log.info(string.format("bc7_bench: %d images (%.1f Mpixel), %2d threads: %8.1f ms, %.2fx",
+            #images, pixels / 1e6, threads, ms, base_ms / ms))
+    end
+end
+
+function M:frame()
+    gfx.begin_pass(gfx.Pass({ swapchain = glue.swapchain() }))
+    gfx.end_pass()
+    gfx.commit()
+end
+
+function M:cleanup()
+    gfx.shutdown()
+end
+
+function M:event(ev)
+    if ev.type == app.EventType.KEY_DOWN then
+        if ev.key_code == app.Keycode.ESCAPE or ev.key_code == app.Keycode.Q then
+            app.quit()
+        end
+    end
+end
+
+return M
@@ -164,7 +164,7 @@ function M.render(proj, view)
     end
 
     -- Render particles
-    particle.render()
+    particle.render(proj, view)
 end
 
 -- Render UI
@@ -197,14 +197,14 @@ function M:frame()
         gfx.apply_scissor_rect(0, 0, math.floor(app.widthf()), math.floor(app.heightf()), true)
 
         -- Rasterize cube depth for particle occlusion
+        local proj = camera:get_proj(aspect)
+        local view = camera:get_view()
         if current_state == const.GAME_STATE_GAME and #cubes > 0 then
-            local proj = camera:get_proj(aspect)
-            local view = camera:get_view()
             renderer.draw_cubes_depth_only(cubes, proj, view)
         end
 
         if current_state == const.GAME_STATE_GAME then
-            particle.render()
+            particle.render(proj, view)
         end
 
         -- Setup UI projection for overlay on top of path traced image
@@ -268,6 +268,7 @@ end
 
 function M:cleanup()
     audio.cleanup()
+    particle.shutdown()
     renderer.cleanup() -- gl.shutdown() is called inside
     gfx.shutdown()
     log.info("hakonotaiatari cleanup complete")
@@ -1,45 +1,41 @@
 -- hakonotaiatari particle system
+-- Thin wrapper over lib.particles: simulation runs in the native pool and
+-- particles are drawn as instanced 3-axis crosses
 
-local glm = require("lib.glm")
-local gl = require("sokol.gl")
+local particles = require("lib.particles")
 local const = require("examples.hakonotaiatari.const")
 
 local M = {}
 
--- Particle pool
-local particles = {}
 local MAX_PARTICLES <const> = 2000
+local SIZE <const> = 2.0
 
--- Particle structure
-local function new_particle()
-    return {
-        pos = glm.vec3(0, 0, 0),
-        velo = glm.vec3(0, 0, 0),
-        acc = glm.vec3(0, 0, 0),
-        color = 0xffffffff,
-        tick = 0,
-        max_tick = 60,
-        size = 2,
-        alive = false,
-    }
-end
+---@type particles.System?
+local system = nil
+
+-- Reused emitter config (avoids a table per emit call)
+local emitter = {
+    pos = { 0, 0, 0 },
+    acc = { 0, 0, 0 },
+    acc_range = { 0, 0, 0 },
+    color = { 1, 1, 1, 1 },
+    size = SIZE,
+}
 
--- Initialize particle pool
+-- Initialize particle pool (created once, cleared on re-init)
 function M.init()
-    particles = {}
-    for i = 1, MAX_PARTICLES do
-        particles[i] = new_particle()
+    if not system then
+        -- Opaque lines with depth write, like the sokol.gl wireframe pipeline
+        system = particles.new_system({
+            max_particles = MAX_PARTICLES,
+            shape = "cross",
+            blend = "none",
+            depth_write = true,
+        })
     end
-end
-
--- Get a free particle from pool
-local function get_particle()
-    for i = 1, MAX_PARTICLES do
-        if not particles[i].alive then
-            return particles[i]
-        end
+    if system then
+        particles.clear(system)
     end
-    return nil
 end
 
 -- Emit particles in a cone pattern
@@ -56,81 +52,51 @@ function M.emit_cone(amount, center, y_angle_center, y_angle_range,
                      velo_center, velo_range,
                      tick_center, tick_range,
                      acc_center, acc_range, color)
-    for i = 1, amount do
-        local p = get_particle()
-        if not p then break end
-
-        local y_angle = y_angle_center + (math.random() * 2 - 1) * y_angle_range
-        local xz_angle = xz_angle_center + (math.random() * 2 - 1) * xz_angle_range
-        local velo_len = velo_center + (math.random() * 2 - 1) * velo_range
-
-        local velo_xz = math.cos(xz_angle) * velo_len
-        local velo_y = math.sin(xz_angle) * velo_len
+    if not system then return end
 
-        p.pos = glm.vec3(center.x, center.y, center.z)
-        p.velo = glm.vec3(
-            math.cos(y_angle) * velo_xz,
-            velo_y,
-            math.sin(y_angle) * velo_xz
-        )
-        p.acc = acc_center + glm.vec3(
-            (math.random() * 2 - 1) * acc_range.x,
-            (math.random() * 2 - 1) * acc_range.y,
-            (math.random() * 2 - 1) * acc_range.z
-        )
-        p.color = color
-        p.tick = 0
-        p.max_tick = tick_center + math.floor((math.random() * 2 - 1) * tick_range)
-        p.size = 2
-        p.alive = true
-    end
+    local e = emitter
+    e.pos[1], e.pos[2], e.pos[3] = center.x, center.y, center.z
+    e.yaw, e.yaw_range = y_angle_center, y_angle_range
+    e.pitch, e.pitch_range = xz_angle_center, xz_angle_range
+    e.speed, e.speed_range = velo_center, velo_range
+    -- Lifetimes are in fixed 60 FPS ticks
+    e.life, e.life_range = tick_center * const.DELTA_T, tick_range * const.DELTA_T
+    e.acc[1], e.acc[2], e.acc[3] = acc_center.x, acc_center.y, acc_center.z
+    e.acc_range[1], e.acc_range[2], e.acc_range[3] = acc_range.x, acc_range.y, acc_range.z
+    e.color[1], e.color[2], e.color[3] = const.argb_to_rgb(color)
+    particles.emit(system, amount, e)
 end
 
 -- Update all particles
 function M.update(dt)
-    for i = 1, MAX_PARTICLES do
-        local p = particles[i]
-        if p.alive then
-            p.tick = p.tick + 1
-            p.velo = p.velo + p.acc * dt
-            p.pos = p.pos + p.velo * dt
-
-            if p.tick >= p.max_tick then
-                p.alive = false
-            end
-        end
+    if system then
+        particles.update(system, dt)
     end
 end
 
 -- Render all particles as small crosses
-function M.render()
-    local SIZE <const> = 2.0
-    gl.begin_lines()
-    for i = 1, MAX_PARTICLES do
-        local p = particles[i]
-        if p.alive then
-            local r, g, b = const.argb_to_rgb(p.color)
-            -- Fade out near end of life
-            local alpha = 1.0 - (p.tick / p.max_tick)
-            local cr, cg, cb = r * alpha, g * alpha, b * alpha
-            local x, y, z = p.pos.x, p.pos.y, p.pos.z
-            -- Draw cross
-            gl.v3f_c3f(x - SIZE, y, z, cr, cg, cb)
-            gl.v3f_c3f(x + SIZE, y, z, cr, cg, cb)
-            gl.v3f_c3f(x, y - SIZE, z, cr, cg, cb)
-            gl.v3f_c3f(x, y + SIZE, z, cr, cg, cb)
-            gl.v3f_c3f(x, y, z - SIZE, cr, cg, cb)
-            gl.v3f_c3f(x, y, z + SIZE, cr, cg, cb)
-        end
+---@param proj mat4
+---@param view mat4
+function M.render(proj, view)
+    if system then
+        particles.draw(system, proj, view)
     end
-    gl["end"]()
 end
 
 -- Clear all particles
 function M.clear()
-    for i = 1, MAX_PARTICLES do
-        particles[i].alive = false
+    if system then
+        particles.clear(system)
+    end
+end
+
+-- Release GPU resources (call before gfx.shutdown)
+function M.shutdown()
+    if system then
+        particles.destroy(system)
+        system = nil
     end
+    particles.shutdown()
 end
 
 return M
@@ -11,6 +11,7 @@ local rt_mod = require("lib.render_target")
 local shader_mod = require("lib.shader")
 local util = require("lib.util")
 local log = require("lib.log")
+local pipeline_cache = require("lub3d.pipeline_cache")
 local const = require("examples.hakonotaiatari.const")
 
 local M = {}
@@ -549,8 +550,8 @@ function M.init()
         return false
     end
 
-    -- Pipelines
-    pt_pipeline = gfx.make_pipeline(gfx.PipelineDesc({
+    -- Pipelines (from the shared cache, released in M.cleanup)
+    pt_pipeline = pipeline_cache.get(gfx.PipelineDesc({
         shader = pt_shader,
         layout = { attrs = { { format = gfx.VertexFormat.FLOAT2 } } },
         primitive_type = gfx.PrimitiveType.TRIANGLE_STRIP,
@@ -563,7 +564,7 @@ function M.init()
         return false
     end
 
-    out_pipeline = gfx.make_pipeline(gfx.PipelineDesc({
+    out_pipeline = pipeline_cache.get(gfx.PipelineDesc({
         shader = out_shader,
         layout = { attrs = { { format = gfx.VertexFormat.FLOAT2 } } },
         primitive_type = gfx.PrimitiveType.TRIANGLE_STRIP,
@@ -602,7 +603,9 @@ function M.cleanup()
         if rt[i] then rt[i]:destroy(); rt[i] = nil end
     end
     if tex_sampler then tex_sampler:destroy(); tex_sampler = nil end
-    -- quad_vbuf, pipelines, shaders are raw sokol handles (GC'd or leaked - acceptable)
+    if pt_pipeline then pipeline_cache.release(pt_pipeline); pt_pipeline = nil end
+    if out_pipeline then pipeline_cache.release(out_pipeline); out_pipeline = nil end
+    -- quad_vbuf, shaders are raw sokol handles (GC'd or leaked - acceptable)
 end
 
 -- ============================================================
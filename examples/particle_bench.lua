@@ -0,0 +1,136 @@
+-- particle_bench.lua - Particle system throughput benchmark
+-- Keeps ~PARTICLE_COUNT billboard particles alive through lib.particles and
+-- reports CPU time for emit + update + draw per frame.
+-- Runs headless: lub3d-test examples.particle_bench 60
+
+local gfx = require("sokol.gfx")
+local app = require("sokol.app")
+local glue = require("sokol.glue")
+local stm = require("sokol.time")
+local glm = require("lib.glm")
+local log = require("lib.log")
+local particles = require("lib.particles")
+local test = require("lib.test")
+
+local SCREEN_W <const> = 800
+local SCREEN_H <const> = 600
+local PARTICLE_COUNT <const> = 100000
+local LIFE <const> = 2.0
+local DT <const> = 1.0 / 60.0
+
+local M = {}
+M.width = SCREEN_W
+M.height = SCREEN_H
+M.window_title = "Lub3d - Particle Benchmark"
+
+local function run_tests()
+    local core = require("lub3d.particles")
+    test.run("particles", {
+        emit_clamps_to_capacity = function()
+            local pool = core.new_pool(10)
+            assert(pool:emit(4, {}) == 4)
+            assert(pool:emit(20, {}) == 6)
+            assert(pool:count() == 10)
+            pool:destroy()
+        end,
+        update_retires_expired = function()
+            local pool = core.new_pool(100)
+            pool:emit(30, { life = 0.5 })
+            pool:emit(20, { life = 2.0 })
+            pool:update(1.0)
+            assert(pool:count() == 20, "expected short-lived particles to be retired")
+            pool:update(1.5)
+            assert(pool:count() == 0)
+            pool:clear()
+            pool:destroy()
+        end,
+    })
+end
+
+function M:init()
+    gfx.setup(gfx.Desc({
+        environment = glue.environment(),
+    }))
+    stm.setup()
+    run_tests()
+
+    self.system = assert(particles.new_system({
+        max_particles = PARTICLE_COUNT,
+        shape = "quad",
+        blend = "add",
+    }))
+    self.emitter = {
+        pos = { 0, 0, 0 },
+        pos_range = { 2, 0, 2 },
+        yaw = 0,
+        yaw_range = math.pi,
+        pitch = math.pi * 0.4,
+        pitch_range = 0.3,
+        speed = 8,
+        speed_range = 3,
+        acc = { 0, -9.8, 0 },
+        life = LIFE,
+        life_range = 0.5,
+        size = 0.05,
+        size_range = 0.02,
+        color = { 1.0, 0.6, 0.2, 1.0 },
+    }
+    self.proj = glm.perspective(glm.radians(60), SCREEN_W / SCREEN_H, 0.1, 100.0)
+    self.view = glm.lookat(glm.vec3(0, 6, 14), glm.vec3(0, 3, 0), glm.vec3(0, 1, 0))
+
+    self.frames = 0
+    self.total_ms = 0
+    self.peak = 0
+end
+
+function M:frame()
+    local sys = self.system
+    local t0 = stm.now()
+
+    -- Emit enough per frame to sustain PARTICLE_COUNT at the average lifetime
+    particles.emit(sys, math.ceil(PARTICLE_COUNT * DT / LIFE), self.emitter)
+    particles.update(sys, DT)
+
+    gfx.begin_pass(gfx.Pass({
+        action = gfx.PassAction({
+            colors = {
+                gfx.ColorAttachmentAction({
+                    load_action = gfx.LoadAction.CLEAR,
+                    clear_value = gfx.Color({ r = 0.02, g = 0.02, b = 0.05, a = 1.0 }),
+                }),
+            },
+        }),
+        swapchain = glue.swapchain(),
+    }))
+    particles.draw(sys, self.proj, self.view)
+    gfx.end_pass()
+    gfx.commit()
+
+    self.total_ms = self.total_ms + stm.ms(stm.diff(stm.now(), t0))
+    self.peak = math.max(self.peak, particles.count(sys))
+    self.frames = self.frames + 1
+end
+
+function M:cleanup()
+    if self.frames > 0 then
+        log.info(string.format(
+            "particle_bench: %d frames, peak %d particles, %.3f ms/frame (emit + update + draw)",
+            self.frames, self.peak, self.total_ms / self.frames))
+    end
+    if self.system then
+        particles.destroy(self.system)
+        self.system = nil
+    end
+    particles.shutdown()
+    gfx.shutdown()
+end
+
+function M:event(ev)
+    if ev.type == app.EventType.KEY_DOWN then
+        if ev.key_code == app.Keycode.ESCAPE or ev.key_code == app.Keycode.Q then
+            app.quit()
+        end
+    end
+end
+
+return M
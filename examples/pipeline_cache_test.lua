@@ -0,0 +1,156 @@
+-- pipeline_cache_test.lua - Shared pipeline cache tests
+-- Checks lub3d.pipeline_cache: hit/miss counts in stats(), one pipeline for
+-- descriptors differing only in their label, reference counting through
+-- release(), and refresh() keeping handles across a shader re-init.
+-- Needs the dummy backend, which accepts shaders without code.
+-- Runs headless: lub3d-test examples.pipeline_cache_test 1
+
+local gfx = require("sokol.gfx")
+local app = require("sokol.app")
+local glue = require("sokol.glue")
+local log = require("lib.log")
+local pipeline_cache = require("lub3d.pipeline_cache")
+local test = require("lib.test")
+
+local M = {}
+M.width = 320
+M.height = 240
+M.window_title = "Lub3d - Pipeline Cache Test"
+
+-- Change of every stats() field since before
+---@param before table
+---@return { hits: integer, misses: integer, pipelines: integer, refs: integer }
+local function delta(before)
+    local now = pipeline_cache.stats()
+    return {
+        hits = now.hits - before.hits,
+        misses = now.misses - before.misses,
+        pipelines = now.pipelines - before.pipelines,
+        refs = now.refs - before.refs,
+    }
+end
+
+---@param shd sokol.gfx.Shader
+---@param label string
+---@param primitive_type? integer gfx.PrimitiveType
+---@return sokol.gfx.PipelineDesc
+local function pipeline_desc(shd, label, primitive_type)
+    return gfx.PipelineDesc({
+        shader = shd,
+        primitive_type = primitive_type or gfx.PrimitiveType.TRIANGLES,
+        label = label,
+    })
+end
+
+local function run_tests()
+    test.run("pipeline_cache", {
+        hit_miss_counts = function()
+            local shd = gfx.make_shader(gfx.ShaderDesc({}))
+            local before = pipeline_cache.stats()
+            local a = pipeline_cache.get(pipeline_desc(shd, "a"))
+            local d = delta(before)
+            assert(d.misses == 1 and d.hits == 0 and d.pipelines == 1 and d.refs == 1, "first get")
+            local b = pipeline_cache.get(pipeline_desc(shd, "a"))
+            d = delta(before)
+            assert(d.misses == 1 and d.hits == 1 and d.pipelines == 1 and d.refs == 2, "second get")
+            assert(a == b)
+            local lines = pipeline_cache.get(pipeline_desc(shd, "a", gfx.PrimitiveType.LINES))
+            d = delta(before)
+            assert(d.misses == 2 and d.hits == 1 and d.pipelines == 2 and d.refs == 3, "other desc")
+            assert(lines ~= a)
+            pipeline_cache.release(a)
+            pipeline_cache.release(b)
+            pipeline_cache.release(lines)
+            gfx.destroy_shader(shd)
+        end,
+        label_ignored = function()
+            local shd = gfx.make_shader(gfx.ShaderDesc({}))
+            local before = pipeline_cache.stats()
+            local a = pipeline_cache.get(pipeline_desc(shd, "first label"))
+            local b = pipeline_cache.get(pipeline_desc(shd, "second label"))
+            local d = delta(before)
+            assert(a == b, "labels split the pipeline")
+            assert(d.misses == 1 and d.hits == 1 and d.pipelines == 1)
+            pipeline_cache.release(a)
+            pipeline_cache.release(b)
+            gfx.destroy_shader(shd)
+        end,
+        release_refcount = function()
+            local shd = gfx.make_shader(gfx.ShaderDesc({}))
+            local before = pipeline_cache.stats()
+            local a = pipeline_cache.get(pipeline_desc(shd, "a"))
+            local b = pipeline_cache.get(pipeline_desc(shd, "b"))
+            pipeline_cache.release(a)
+            local d = delta(before)
+            assert(d.pipelines == 1 and d.refs == 1, "destroyed with a reference left")
+            assert(gfx.query_pipeline_state(b) == gfx.ResourceState.VALID)
+            pipeline_cache.release(b)
+            d = delta(before)
+            assert(d.pipelines == 0 and d.refs == 0, "kept after the last release")
+            assert(gfx.query_pipeline_state(b) ~= gfx.ResourceState.VALID)
+            -- Pipelines not from get() are destroyed without touching the cache
+            local own = gfx.make_pipeline(pipeline_desc(shd, "own"))
+            pipeline_cache.release(own)
+            assert(gfx.query_pipeline_state(own) ~= gfx.ResourceState.VALID)
+            d = delta(before)
+            assert(d.pipelines == 0 and d.refs == 0)
+            gfx.destroy_shader(shd)
+        end,
+        refresh_keeps_handles = function()
+            local shd = gfx.make_shader(gfx.ShaderDesc({}))
+            local other = gfx.make_shader(gfx.ShaderDesc({}))
+            local tris = pipeline_cache.get(pipeline_desc(shd, "tris"))
+            local lines = pipeline_cache.get(pipeline_desc(shd, "lines", gfx.PrimitiveType.LINES))
+            local unrelated = pipeline_cache.get(pipeline_desc(other, "other"))
+            local before = pipeline_cache.stats()
+            -- Shader hot reload: same handle, new contents
+            gfx.uninit_shader(shd)
+            gfx.init_shader(shd, gfx.ShaderDesc({}))
+            assert(pipeline_cache.refresh(shd) == 2)
+            local d = delta(before)
+            assert(d.pipelines == 0 and d.refs == 0, "refresh changed references")
+            assert(gfx.query_pipeline_state(tris) == gfx.ResourceState.VALID)
+            assert(gfx.query_pipeline_state(lines) == gfx.ResourceState.VALID)
+            -- Still the cached pipeline: a new get() hits it
+            local again = pipeline_cache.get(pipeline_desc(shd, "again"))
+            assert(again == tris and delta(before).hits == 1)
+            for _, pip in ipairs({ tris, lines, unrelated, again }) do
+                pipeline_cache.release(pip)
+            end
+            assert(delta(before).pipelines == -3)
+            gfx.destroy_shader(shd)
+            gfx.destroy_shader(other)
+        end,
+    })
+end
+
+function M:init()
+    gfx.setup(gfx.Desc({
+        environment = glue.environment(),
+    }))
+    if gfx.query_backend() ~= gfx.Backend.DUMMY then
+        log.info("pipeline_cache_test: needs the dummy backend, skipping")
+        return
+    end
+    run_tests()
+end
+
+function M:frame()
+    gfx.begin_pass(gfx.Pass({ swapchain = glue.swapchain() }))
+    gfx.end_pass()
+    gfx.commit()
+end
+
+function M:cleanup()
+    gfx.shutdown()
+end
+
+function M:event(ev)
+    if ev.type == app.EventType.KEY_DOWN then
+        if ev.key_code == app.Keycode.ESCAPE or ev.key_code == app.Keycode.Q then
+            app.quit()
+        end
+    end
+end
+
+return M
@@ -73,7 +73,9 @@ void main() {
     vec4 specular = texture(sampler2D(specular_tex, specular_smp), v_uv);
 
     // Normal mapping: transform from tangent space to view space
-    vec3 normal_map = texture(sampler2D(normal_tex, normal_smp), v_uv).rgb * 2.0 - 1.0;
+    // (BC5 normal maps store x and y only, z is rebuilt from them)
+    vec2 normal_xy = texture(sampler2D(normal_tex, normal_smp), v_uv).rg * 2.0 - 1.0;
+    vec3 normal_map = vec3(normal_xy, sqrt(max(0.0, 1.0 - dot(normal_xy, normal_xy))));
     mat3 tbn = mat3(v_view_tangent, v_view_bitangent, v_view_normal);
     vec3 view_normal = normalize(tbn * normal_map);
 
@@ -87,72 +89,6 @@ void main() {
 @program geom geom_vs geom_fs
 ]]
 
-M.shader_desc = {
-    uniform_blocks = {
-        { stage = gfx.ShaderStage.VERTEX, size = 192 }, -- 3x mat4
-    },
-    views = {
-        {
-            texture = {
-                stage = gfx.ShaderStage.FRAGMENT,
-                image_type = gfx.ImageType["2D"],
-                sample_type = gfx.ImageSampleType.FLOAT,
-                hlsl_register_t_n = 0,
-                wgsl_group1_binding_n = 0,
-            },
-        },
-        {
-            texture = {
-                stage = gfx.ShaderStage.FRAGMENT,
-                image_type = gfx.ImageType["2D"],
-                sample_type = gfx.ImageSampleType.FLOAT,
-                hlsl_register_t_n = 1,
-                wgsl_group1_binding_n = 1,
-            },
-        },
-        {
-            texture = {
-                stage = gfx.ShaderStage.FRAGMENT,
-                image_type = gfx.ImageType["2D"],
-                sample_type = gfx.ImageSampleType.FLOAT,
-                hlsl_register_t_n = 2,
-                wgsl_group1_binding_n = 2,
-            },
-        },
-    },
-    samplers = {
-        {
-            stage = gfx.ShaderStage.FRAGMENT,
-            sampler_type = gfx.SamplerType.FILTERING,
-            hlsl_register_s_n = 0,
-            wgsl_group1_binding_n = 32,
-        },
-        {
-            stage = gfx.ShaderStage.FRAGMENT,
-            sampler_type = gfx.SamplerType.FILTERING,
-            hlsl_register_s_n = 1,
-            wgsl_group1_binding_n = 33,
-        },
-        {
-            stage = gfx.ShaderStage.FRAGMENT,
-            sampler_type = gfx.SamplerType.FILTERING,
-            hlsl_register_s_n = 2,
-            wgsl_group1_binding_n = 34,
-        },
-    },
-    texture_sampler_pairs = {
-        { stage = gfx.ShaderStage.FRAGMENT, view_slot = 0, sampler_slot = 0, glsl_name = "diffuse_tex_diffuse_smp" },
-        { stage = gfx.ShaderStage.FRAGMENT, view_slot = 1, sampler_slot = 1, glsl_name = "normal_tex_normal_smp" },
-        { stage = gfx.ShaderStage.FRAGMENT, view_slot = 2, sampler_slot = 2, glsl_name = "specular_tex_specular_smp" },
-    },
-    attrs = {
-        { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 0 },
-        { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 1 },
-        { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 2 },
-        { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 3 },
-    },
-}
-
 -- Setup common resource management (on_reload, destroy, ensure_resources)
 render_pass.setup(M, {
     shader_name = "geom",
@@ -3,13 +3,16 @@
 local gfx = require("sokol.gfx")
 local glue = require("sokol.glue")
 local app = require("sokol.app")
+local stm = require("sokol.time")
 local log = require("lib.log")
-local texture = require("lib.texture")
+local texture_manager = require("lib.texture_manager")
 local util = require("lib.util")
 local glm = require("lib.glm")
 local imgui = require("imgui")
 local gpu = require("lib.gpu")
 local pipeline = require("lib.render_pipeline")
+local pipeline_cache = require("lub3d.pipeline_cache")
+local program_cache = require("lub3d.program_cache")
 local notify = require("lib.notify")
 local fs = require("lub3d.fs")
 
@@ -27,10 +30,13 @@ M.window_title = "Lub3d - Rendering Pipeline"
 
 -- Scene data
 local meshes = {}
-local textures_cache = {}
+---@type texture_manager.Manager?
+local textures = nil
 local default_diffuse = nil
 local default_normal = nil
 local default_specular = nil
+-- Start of init, until the first frame drawn by every pass
+local init_time = nil
 
 -- ImGui pass (renders UI overlay)
 local imgui_pass = {
@@ -68,6 +74,14 @@ local function update_ui()
         end
 
         imgui.text_unformatted(string.format("Active Lights: %d / %d", #light.sources, light.NUMBER_OF_LIGHTS))
+        if textures then
+            local ts = textures:stats()
+            imgui.text_unformatted(string.format("Textures: %d / %d loaded (%.0f%%), %d failed, %.1f MiB resident",
+                ts.loaded, ts.requested, ts.progress * 100, ts.failed, ts.resident_bytes / (1024 * 1024)))
+        end
+        local ps = pipeline_cache.stats()
+        imgui.text_unformatted(string.format("Pipelines: %d shared by %d users (%d hits, %d misses)",
+            ps.pipelines, ps.refs, ps.hits, ps.misses))
 
         -- Blinn-Phong toggle
         local bp_changed, bp_new = imgui.checkbox("Blinn-Phong", light.blinn_phong_enabled)
@@ -104,6 +118,23 @@ local function update_ui()
             imgui.tree_pop()
         end
 
+        -- Texture residency
+        if textures and imgui.tree_node_str("Texture Streaming") then
+            local ts = textures:stats()
+            local mib = 1024 * 1024
+            imgui.text_unformatted(string.format("Resident: %.1f / %.0f MiB", ts.resident_bytes / mib,
+                (ts.memory_budget or 0) / mib))
+            imgui.text_unformatted(string.format("Upgrades: %d, evictions: %d", ts.upgrades, ts.evictions))
+            imgui.begin_child_str_vec2_x_x("TextureList", { 0, 200 },
+                imgui.ChildFlags.BORDERS, imgui.WindowFlags.NONE)
+            for _, r in ipairs(textures:residency()) do
+                imgui.text_unformatted(string.format("%-9s %4dx%-4d / %4dx%-4d %7.1f KiB  %s", r.state,
+                    r.width, r.height, r.full_width, r.full_height, r.bytes / 1024, r.path:match("[^/]*$")))
+            end
+            imgui.end_child()
+            imgui.tree_pop()
+        end
+
         -- Animation controls
         if imgui.tree_node_str("Day/Night Cycle") then
             local anim_changed, anim_new = imgui.checkbox("Animate", light.animate_enabled)
@@ -196,6 +227,29 @@ local function update_ui()
     imgui.end_window()
 end
 
+-- Report how many pixels each mesh covers so the texture manager streams in
+-- sharper versions of its textures (bounding sphere projected with the 60
+-- degree fov of camera.projection_matrix; meshes the camera is inside of
+-- ask for full resolution)
+local function report_texture_usage(height)
+    local pixels_per_unit = height / math.tan(math.rad(60) / 2)
+    for _, mesh in ipairs(meshes) do
+        local dist = (mesh.center - camera.pos):length()
+        local size = dist > mesh.radius and mesh.radius / dist * pixels_per_unit or math.huge
+        for _, tex in ipairs(mesh.textures) do
+            textures:use(tex, size)
+        end
+    end
+end
+
+-- Point a mesh's bindings at its current textures (placeholders until loaded)
+local function bind_mesh_textures(mesh)
+    local diffuse, normal, specular = mesh.textures[1], mesh.textures[2], mesh.textures[3]
+    mesh.diffuse_view, mesh.diffuse_smp = diffuse.view.handle, diffuse.smp.handle
+    mesh.normal_view, mesh.normal_smp = normal.view.handle, normal.smp.handle
+    mesh.specular_view, mesh.specular_smp = specular.view.handle, specular.smp.handle
+end
+
 local function load_model()
     local t0 = os.clock()
 
@@ -287,8 +341,13 @@ local function load_model()
         -- Build vertex buffer with tangents
         t1 = os.clock()
         local vparts = {}
+        local minx, miny, minz = math.huge, math.huge, math.huge
+        local maxx, maxy, maxz = -math.huge, -math.huge, -math.huge
         for i = 0, vertex_count - 1 do
             local base = i * in_stride
+            local px, py, pz = vertices[base + 1], vertices[base + 2], vertices[base + 3]
+            minx, miny, minz = math.min(minx, px), math.min(miny, py), math.min(minz, pz)
+            maxx, maxy, maxz = math.max(maxx, px), math.max(maxy, py), math.max(maxz, pz)
             local t = tangents[i]
             local len = math.sqrt(t[1] * t[1] + t[2] * t[2] + t[3] * t[3])
             local tx, ty, tz
@@ -323,43 +382,7 @@ local function load_model()
         }))
         t_vbuf = t_vbuf + (os.clock() - t1)
 
-        -- Load textures (diffuse, normal, specular)
-        t1 = os.clock()
-
-        -- Helper to load or get cached texture
-        local function load_texture_slot(slot_index)
-            if not mesh_data.textures or slot_index > #mesh_data.textures then
-                return nil, nil
-            end
-            local tex_name = mesh_data.textures[slot_index]
-            if not tex_name then
-                return nil, nil
-            end
-
-            local tex_info = model.textures[tex_name]
-            if not tex_info then
-                return nil, nil
-            end
-
-            local path = texture_base .. tex_info.path
-            if not textures_cache[path] then
-                local tex = texture.load_bc7(path)
-                if tex then
-                    textures_cache[path] = tex
-                end
-            end
-            if textures_cache[path] then
-                return textures_cache[path].view.handle, textures_cache[path].smp.handle
-            end
-            return nil, nil
-        end
-
-        local diffuse_view, diffuse_smp = load_texture_slot(1)
-        local normal_view, normal_smp = load_texture_slot(2)
-        local specular_view, specular_smp = load_texture_slot(3)
-        t_texture = t_texture + (os.clock() - t1)
-
-        -- Create default textures if needed
+        -- Create default textures if needed (also shown while textures load)
         if not default_diffuse then
             local white = string.pack("BBBB", 255, 255, 255, 255)
             local img = gpu.image(gfx.ImageDesc({
@@ -408,33 +431,47 @@ local function load_model()
             default_specular = { img = img, view = view, smp = smp }
         end
 
-        -- Use defaults if textures not loaded
-        if not diffuse_view then
-            diffuse_view = default_diffuse.view.handle
-            diffuse_smp = default_diffuse.smp.handle
-        end
-        if not normal_view then
-            normal_view = default_normal.view.handle
-            normal_smp = default_normal.smp.handle
-        end
-        if not specular_view then
-            specular_view = default_specular.view.handle
-            specular_smp = default_specular.smp.handle
+        -- Queue textures (diffuse, normal, specular) for background loading
+        t1 = os.clock()
+
+        -- Helper to get a managed texture, or the default for a missing slot
+        local function load_texture_slot(slot_index, default, usage)
+            if not mesh_data.textures or slot_index > #mesh_data.textures then
+                return default
+            end
+            local tex_name = mesh_data.textures[slot_index]
+            if not tex_name then
+                return default
+            end
+
+            local tex_info = model.textures[tex_name]
+            if not tex_info then
+                return default
+            end
+
+            return textures:get(texture_base .. tex_info.path, { bc7 = true, usage = usage, placeholder = default })
         end
 
+        local mesh_textures = {
+            load_texture_slot(1, default_diffuse),
+            load_texture_slot(2, default_normal, "normal"),
+            load_texture_slot(3, default_specular),
+        }
+        t_texture = t_texture + (os.clock() - t1)
+
         -- Skip water meshes
         if not mat_name:find("water") and not mat_name:find("Water") then
-            table.insert(meshes, {
+            local mesh = {
                 vbuf = vbuf,
                 ibuf = ibuf,
                 num_indices = #indices,
-                diffuse_view = diffuse_view,
-                diffuse_smp = diffuse_smp,
-                normal_view = normal_view,
-                normal_smp = normal_smp,
-                specular_view = specular_view,
-                specular_smp = specular_smp,
-            })
+                textures = mesh_textures,
+                -- Bounding sphere for texture streaming feedback
+                center = glm.vec3((minx + maxx) / 2, (miny + maxy) / 2, (minz + maxz) / 2),
+                radius = glm.vec3(maxx - minx, maxy - miny, maxz - minz):length() / 2,
+            }
+            bind_mesh_textures(mesh)
+            table.insert(meshes, mesh)
         end
     end
 
@@ -443,6 +480,8 @@ local function load_model()
 end
 
 function M:init()
+    init_time = stm.now()
+
     -- Initialize sokol.gfx
     gfx.setup(gfx.Desc({
         environment = glue.environment(),
@@ -462,6 +501,8 @@ function M:init()
     pipeline.register(lighting_pass)
     pipeline.register(imgui_pass)
 
+    -- Start every texture at 64px and keep sharper versions within 256 MiB
+    textures = texture_manager.new({ stream = { min_size = 64, memory_budget = 256 * 1024 * 1024 } })
     load_model()
 end
 
@@ -479,6 +520,16 @@ function M:frame()
     local dt = app.frame_duration()
     light.animate(dt)
 
+    -- Swap in textures finished or resized by the background loader
+    if textures then
+        report_texture_usage(height)
+    end
+    if textures and textures:update() > 0 then
+        for _, mesh in ipairs(meshes) do
+            bind_mesh_textures(mesh)
+        end
+    end
+
     imgui.new_frame()
     update_ui()
 
@@ -496,6 +547,15 @@ function M:frame()
 
     -- Execute all passes
     pipeline.execute(ctx, frame_data)
+
+    -- Time to first frame: on warm starts the shaders come from the shader
+    -- cache and, on GL, the driver's program binaries
+    if init_time and geometry_pass.resources and lighting_pass.resources then
+        local ps = program_cache.stats()
+        log.info(string.format("time to first frame: %.1f ms (GL program binaries: %d loaded, %d compiled, %d rejected)",
+            stm.ms(stm.since(init_time)), ps.loaded, ps.compiled, ps.rejected))
+        init_time = nil
+    end
 end
 
 function M:cleanup()
@@ -513,13 +573,11 @@ function M:cleanup()
     end
     meshes = {}
 
-    -- Destroy cached textures
-    for path, tex in pairs(textures_cache) do
-        tex.smp:destroy()
-        tex.view:destroy()
-        tex.img:destroy()
+    -- Destroy loaded textures
+    if textures then
+        textures:destroy()
+        textures = nil
     end
-    textures_cache = {}
 
     -- Destroy default textures
     for _, tex in ipairs({ default_diffuse, default_normal, default_specular }) do
@@ -3,7 +3,7 @@
 local gfx = require("sokol.gfx")
 local glue = require("sokol.glue")
 local render_pass = require("lib.render_pass")
-local light_module = require("examples.rendering.light")
+local light = require("examples.rendering.light")
 
 local M = {}
 
@@ -24,7 +24,8 @@ void main() {
 @end
 
 @fs light_fs
-#define NUMBER_OF_LIGHTS 4
+// NUMBER_OF_LIGHTS is defined per permutation (light.NUMBER_OF_LIGHTS)
+// @permute NUMBER_OF_LIGHTS 4
 #define MAX_SHININESS 127.75
 
 in vec2 v_uv;
@@ -239,92 +240,10 @@ void main() {
 @program light light_vs light_fs
 ]]
 
-M.shader_desc = {
-    uniform_blocks = {
-        {
-            stage = gfx.ShaderStage.FRAGMENT,
-            size = light_module.uniform_size(), -- 544 bytes
-        },
-    },
-    views = {
-        {
-            texture = {
-                stage = gfx.ShaderStage.FRAGMENT,
-                image_type = gfx.ImageType["2D"],
-                sample_type = gfx.ImageSampleType.FLOAT,
-                hlsl_register_t_n = 0,
-                wgsl_group1_binding_n = 0,
-            },
-        },
-        {
-            texture = {
-                stage = gfx.ShaderStage.FRAGMENT,
-                image_type = gfx.ImageType["2D"],
-                sample_type = gfx.ImageSampleType.FLOAT,
-                hlsl_register_t_n = 1,
-                wgsl_group1_binding_n = 1,
-            },
-        },
-        {
-            texture = {
-                stage = gfx.ShaderStage.FRAGMENT,
-                image_type = gfx.ImageType["2D"],
-                sample_type = gfx.ImageSampleType.FLOAT,
-                hlsl_register_t_n = 2,
-                wgsl_group1_binding_n = 2,
-            },
-        },
-        {
-            texture = {
-                stage = gfx.ShaderStage.FRAGMENT,
-                image_type = gfx.ImageType["2D"],
-                sample_type = gfx.ImageSampleType.FLOAT,
-                hlsl_register_t_n = 3,
-                wgsl_group1_binding_n = 3,
-            },
-        },
-    },
-    samplers = {
-        {
-            stage = gfx.ShaderStage.FRAGMENT,
-            sampler_type = gfx.SamplerType.FILTERING,
-            hlsl_register_s_n = 0,
-            wgsl_group1_binding_n = 32,
-        },
-        {
-            stage = gfx.ShaderStage.FRAGMENT,
-            sampler_type = gfx.SamplerType.FILTERING,
-            hlsl_register_s_n = 1,
-            wgsl_group1_binding_n = 33,
-        },
-        {
-            stage = gfx.ShaderStage.FRAGMENT,
-            sampler_type = gfx.SamplerType.FILTERING,
-            hlsl_register_s_n = 2,
-            wgsl_group1_binding_n = 34,
-        },
-        {
-            stage = gfx.ShaderStage.FRAGMENT,
-            sampler_type = gfx.SamplerType.FILTERING,
-            hlsl_register_s_n = 3,
-            wgsl_group1_binding_n = 35,
-        },
-    },
-    texture_sampler_pairs = {
-        { stage = gfx.ShaderStage.FRAGMENT, view_slot = 0, sampler_slot = 0, glsl_name = "position_tex_position_smp" },
-        { stage = gfx.ShaderStage.FRAGMENT, view_slot = 1, sampler_slot = 1, glsl_name = "normal_tex_normal_smp" },
-        { stage = gfx.ShaderStage.FRAGMENT, view_slot = 2, sampler_slot = 2, glsl_name = "albedo_tex_albedo_smp" },
-        { stage = gfx.ShaderStage.FRAGMENT, view_slot = 3, sampler_slot = 3, glsl_name = "specular_tex_specular_smp" },
-    },
-    attrs = {
-        { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 0 },
-        { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 1 },
-    },
-}
-
 -- Setup common resource management (on_reload, destroy, ensure_resources)
 render_pass.setup(M, {
     shader_name = "light",
+    defines = { NUMBER_OF_LIGHTS = light.NUMBER_OF_LIGHTS },
     pipeline_desc = function(shader_handle)
         return gfx.PipelineDesc({
             shader = shader_handle,
@@ -0,0 +1,186 @@
+-- shader_bench.lua - sokol-shdc compile latency benchmark
+-- Compiles the lib/sprite.lua shaders and the examples/rendering passes for
+-- every target language and permutation, several times each and bypassing
+-- the shader cache, and reports the per-compile latency measured inside shdc
+-- (best and median), then the time shdc.compile_all takes for all programs
+-- and languages at once.
+-- On the GL backends it then compares driver compile times (gfx.make_shader
+-- compiles and links the GLSL) and source sizes across the shdc output
+-- options: plain, optimize (spirv-opt), minify and both. Drivers with an
+-- on-disk shader cache serve repeats from it; for cold numbers disable it
+-- (Mesa: MESA_SHADER_CACHE_DISABLE=true).
+-- Not part of run_tests.sh: a full run takes a few seconds.
+-- Runs headless: lub3d-test examples.shader_bench 1
+
+local gfx = require("sokol.gfx")
+local app = require("sokol.app")
+local glue = require("sokol.glue")
+local stm = require("sokol.time")
+local fs = require("lub3d.fs")
+local log = require("lib.log")
+local shader_lib = require("lib.shader")
+
+local shdc_ok, shdc = pcall(require, "shdc")
+
+local SOURCES <const> = {
+    "lib/sprite.lua",
+    "examples/rendering/geometry.lua",
+    "examples/rendering/lighting.lua",
+}
+local LANGS <const> = { "glsl430", "glsl300es", "hlsl5", "metal_macos", "wgsl" }
+local RUNS <const> = 5
+local OUTPUTS <const> = {
+    { name = "plain", options = {} },
+    { name = "optimize", options = { optimize = true } },
+    { name = "minify", options = { minify = true } },
+    { name = "opt+minify", options = { optimize = true, minify = true } },
+}
+
+local M = {}
+M.width = 320
+M.height = 240
+M.window_title = "Lub3d - Shader Compile Benchmark"
+
+-- Shader sources embedded in a Lua file's long strings, with their programs,
+-- once for every permutation they declare ("// @permute NAME values...")
+---@param path string
+---@return { source: string, programs: string[], defines: string[], variant: string }[]
+local function embedded_shaders(path)
+    local list = {}
+    local src = fs.read(path)
+    if not src then
+        return list
+    end
+    for _, source in ipairs(shader_lib.embedded_sources(src)) do
+        local programs = {}
+        for name in source:gmatch("@program%s+([%w_]+)") do
+            programs[#programs + 1] = name
+        end
+        for _, set in ipairs(shader_lib.permutations(source)) do
+            local defines = shader_lib.define_list(set)
+            list[#list + 1] = {
+                source = source,
+                programs = programs,
+                defines = defines,
+                variant = table.concat(defines, ","),
+            }
+        end
+    end
+    return list
+end
+
+-- Driver compile time of one program for each output option: first
+-- make_shader and median of RUNS, with the size of the sources handed over
+---@param shader { source: string, defines: string[], variant: string }
+---@param name string program name
+---@param lang string
+local function driver_bench(shader, name, lang)
+    for _, output in ipairs(OUTPUTS) do
+        local result = shdc.compile(shader.source, name, lang, shader.defines, output.options)
+        if not result.success then
+            log.error("shader_bench: " .. name .. " (" .. output.name .. "): " .. tostring(result.error))
+            return
+        end
+        local desc = shdc.shader_desc(result.reflection)
+        desc.vertex_func = { source = result.vs_source }
+        desc.fragment_func = { source = result.fs_source }
+        local times = {}
+        for run = 1, RUNS do
+            local t = stm.now()
+            local shd = gfx.make_shader(gfx.ShaderDesc(desc))
+            times[run] = stm.ms(stm.since(t))
+            if gfx.query_shader_state(shd) ~= gfx.ResourceState.VALID then
+                log.error("shader_bench: " .. name .. " (" .. output.name .. "): driver rejected the shader")
+            end
+            gfx.destroy_shader(shd)
+        end
+        local first = times[1]
+        table.sort(times)
+        log.info(string.format("shader_bench: %-16s %-10s %6d bytes, driver first %7.2f ms, median %7.2f ms %s",
+            name, output.name, #result.vs_source + #result.fs_source, first, times[(RUNS + 1) // 2], shader.variant))
+    end
+end
+
+function M:init()
+    gfx.setup(gfx.Desc({
+        environment = glue.environment(),
+    }))
+    stm.setup()
+
+    if not shdc_ok then
+        log.info("shader_bench: shdc not available, skipping")
+        return
+    end
+
+    local total_ms = 0
+    local compiles = 0
+    local t0 = stm.now()
+    for _, path in ipairs(SOURCES) do
+        for _, shader in ipairs(embedded_shaders(path)) do
+            for _, name in ipairs(shader.programs) do
+                for _, lang in ipairs(LANGS) do
+                    local times = {}
+                    for run = 1, RUNS do
+                        local result = shdc.compile(shader.source, name, lang, shader.defines)
+                        if not result.success then
+                            log.error("shader_bench: " .. name .. " (" .. lang .. "): " .. tostring(result.error))
+                            break
+                        end
+                        times[run] = result.compile_ms
+                        total_ms = total_ms + result.compile_ms
+                        compiles = compiles + 1
+                    end
+                    if #times == RUNS then
+                        table.sort(times)
+                        log.info(string.format("shader_bench: %-16s %-12s best %7.2f ms, median %7.2f ms %s",
+                            name, lang, times[1], times[(RUNS + 1) // 2], shader.variant))
+                    end
+                end
+            end
+            -- Every program and language from one parse
+            local all = shdc.compile_all(shader.source, LANGS, shader.defines)
+            if all.success then
+                log.info(string.format("shader_bench: %-16s %-12s %7.2f ms for %d programs %s",
+                    "compile_all", path:match("[^/]+$"), all.compile_ms, #shader.programs, shader.variant))
+            else
+                log.error("shader_bench: compile_all " .. path .. ": " .. tostring(all.error))
+            end
+        end
+    end
+    log.info(string.format("shader_bench: %d compiles, %.1f ms in shdc, %.1f ms wall", compiles, total_ms,
+        stm.ms(stm.since(t0))))
+
+    local backend = gfx.query_backend()
+    if backend ~= gfx.Backend.GLCORE and backend ~= gfx.Backend.GLES3 then
+        log.info("shader_bench: driver compile times need a GL backend, skipping")
+        return
+    end
+    local lang = backend == gfx.Backend.GLES3 and "glsl300es" or "glsl430"
+    for _, path in ipairs(SOURCES) do
+        for _, shader in ipairs(embedded_shaders(path)) do
+            for _, name in ipairs(shader.programs) do
+                driver_bench(shader, name, lang)
+            end
+        end
+    end
+end
+
+function M:frame()
+    gfx.begin_pass(gfx.Pass({ swapchain = glue.swapchain() }))
+    gfx.end_pass()
+    gfx.commit()
+end
+
+function M:cleanup()
+    gfx.shutdown()
+end
+
+function M:event(ev)
+    if ev.type == app.EventType.KEY_DOWN then
+        if ev.key_code == app.Keycode.ESCAPE or ev.key_code == app.Keycode.Q then
+            app.quit()
+        end
+    end
+end
+
+return M
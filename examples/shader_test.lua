@@ -0,0 +1,117 @@
+-- shader_test.lua - Shader module tests
+-- Checks the pure Lua parts of lib.shader: "// @permute" expansion, define
+-- set normalization for cache keys and the scan for shaders embedded in Lua
+-- long strings used by hot reload. None of them need shdc.
+-- Runs headless: lub3d-test examples.shader_test 1
+
+local gfx = require("sokol.gfx")
+local app = require("sokol.app")
+local glue = require("sokol.glue")
+local shader = require("lib.shader")
+local test = require("lib.test")
+
+local M = {}
+M.width = 320
+M.height = 240
+M.window_title = "Lub3d - Shader Test"
+
+-- Define set as "NAME=value,..." in key order
+---@param set shader.Defines
+---@return string
+local function set_string(set)
+    local parts = {}
+    for name, value in pairs(set) do
+        parts[#parts + 1] = name .. "=" .. tostring(value)
+    end
+    table.sort(parts)
+    return table.concat(parts, ",")
+end
+
+local function run_tests()
+    test.run("shader", {
+        permutations_none = function()
+            local sets = shader.permutations("@program p vs fs\n")
+            assert(#sets == 1 and next(sets[1]) == nil)
+        end,
+        permutations_cartesian = function()
+            local sets = shader.permutations("// @permute A 0 1\n//@permute  B x y z\n@program p vs fs\n")
+            assert(#sets == 6, "got " .. #sets)
+            -- First declared name varies slowest, values in declaration order
+            local expected = { "A=0,B=x", "A=0,B=y", "A=0,B=z", "A=1,B=x", "A=1,B=y", "A=1,B=z" }
+            for i, set in ipairs(sets) do
+                assert(set_string(set) == expected[i], i .. ": " .. set_string(set))
+            end
+        end,
+        permutations_values = function()
+            local sets = shader.permutations("// @permute N 4\n// @permute F true false\n// @permute S 0.5 hi\n")
+            assert(#sets == 4)
+            assert(math.type(sets[1].N) == "integer" and sets[1].N == 4)
+            assert(sets[1].F == true and sets[3].F == false)
+            assert(sets[1].S == 0.5 and sets[2].S == "hi")
+        end,
+        embedded_sources = function()
+            local text = "local a = [[\n@program p vs fs\r\nX]]\r\nlocal b = [=[@program q vs fs]=]\n"
+                .. "local c = [[plain]] --[[ comment ]]\n"
+            local list, rest = shader.embedded_sources(text)
+            assert(#list == 2, "got " .. #list)
+            -- String values as the Lua lexer produces them
+            assert(list[1] == "@program p vs fs\nX", list[1])
+            assert(list[2] == "@program q vs fs", list[2])
+            assert(rest == "local a = [[]]\nlocal b = [=[]=]\nlocal c = [[plain]] --[[ comment ]]\n", rest)
+            -- Versions differing only in their shaders share the remainder
+            local _, rest2 = shader.embedded_sources((text:gsub("X", "Y")))
+            assert(rest2 == rest)
+            local _, rest3 = shader.embedded_sources((text:gsub("plain", "other")))
+            assert(rest3 ~= rest)
+        end,
+        define_list_sorted = function()
+            local list = shader.define_list({ ZED = 3, ALPHA = "x", ON = true, OFF = false })
+            assert(#list == 3)
+            assert(list[1] == "ALPHA x" and list[2] == "ON 1" and list[3] == "ZED 3", table.concat(list, ","))
+            assert(#shader.define_list(nil) == 0)
+        end,
+        define_order_same_key = function()
+            -- Same set built in different insertion orders
+            local a, b = {}, {}
+            for i = 1, 16 do
+                a["D" .. i] = i
+                b["D" .. (17 - i)] = 17 - i
+            end
+            assert(table.concat(shader.define_list(a), "\n") == table.concat(shader.define_list(b), "\n"))
+            local source = "@program p vs fs\n"
+            local langs = { "glsl430", "hlsl5" }
+            local p1 = shader.cache_paths(source, langs, { defines = { A = 1, B = 2 } })
+            local p2 = shader.cache_paths(source, langs, { defines = { B = 2, A = 1 } })
+            assert(#p1 == 2 and p1[1] == p2[1] and p1[2] == p2[2])
+            local p3 = shader.cache_paths(source, langs, { defines = { A = 1, B = 3 } })
+            assert(p3[1] ~= p1[1], "different defines share a cache key")
+        end,
+    })
+end
+
+function M:init()
+    gfx.setup(gfx.Desc({
+        environment = glue.environment(),
+    }))
+    run_tests()
+end
+
+function M:frame()
+    gfx.begin_pass(gfx.Pass({ swapchain = glue.swapchain() }))
+    gfx.end_pass()
+    gfx.commit()
+end
+
+function M:cleanup()
+    gfx.shutdown()
+end
+
+function M:event(ev)
+    if ev.type == app.EventType.KEY_DOWN then
+        if ev.key_code == app.Keycode.ESCAPE or ev.key_code == app.Keycode.Q then
+            app.quit()
+        end
+    end
+end
+
+return M
@@ -0,0 +1,228 @@
+-- sprite_bench.lua - Sprite batch throughput benchmark
+-- Draws SPRITES_PER_FRAME rotated/tinted sprites per frame through lib.sprite,
+-- alternating between the vertex, instanced and multi-texture (atlas pages,
+-- sorted by layer/texture/blend) batch modes each frame, and reports sprites
+-- per millisecond (CPU side: draw + flush), upload size and draw calls.
+-- Runs headless: lub3d-test examples.sprite_bench 60
+
+local gfx = require("sokol.gfx")
+local app = require("sokol.app")
+local glue = require("sokol.glue")
+local stm = require("sokol.time")
+local gpu = require("lib.gpu")
+local log = require("lib.log")
+local sprite = require("lib.sprite")
+local atlas = require("lib.atlas")
+local test = require("lib.test")
+
+local SCREEN_W <const> = 800
+local SCREEN_H <const> = 600
+local SPRITES_PER_FRAME <const> = 100000
+local TEX_SIZE <const> = 16
+local ATLAS_IMAGES <const> = 48
+
+local M = {}
+M.width = SCREEN_W
+M.height = SCREEN_H
+M.window_title = "Lub3d - Sprite Benchmark"
+
+function M:init()
+    gfx.setup(gfx.Desc({
+        environment = glue.environment(),
+    }))
+    stm.setup()
+
+    -- Solid white texture so the benchmark needs no assets
+    local pixels = string.rep("\255\255\255\255", TEX_SIZE * TEX_SIZE)
+    local img = gpu.image(gfx.ImageDesc({
+        width = TEX_SIZE,
+        height = TEX_SIZE,
+        pixel_format = gfx.PixelFormat.RGBA8,
+        data = { mip_levels = { gfx.Range(pixels) } },
+    }))
+    self.tex_result = {
+        img = img,
+        view = gpu.view(gfx.ViewDesc({ texture = { image = img.handle } })),
+        smp = gpu.sampler(gfx.SamplerDesc({
+            min_filter = gfx.Filter.NEAREST,
+            mag_filter = gfx.Filter.NEAREST,
+        })),
+    }
+    -- Small atlas pages so the images spread over several textures
+    self.atlas = atlas.new({ page_size = 64, filter = gfx.Filter.NEAREST })
+    self.regions = {}
+    for i = 1, ATLAS_IMAGES do
+        local size = 8 + (i % 3) * 4
+        local c = string.char(255, (i * 40) % 256, (i * 90) % 256, 255)
+        self.regions[i] = assert(self.atlas:add("img" .. i, string.rep(c, size * size), size, size))
+    end
+    self.atlas:build()
+
+    -- Default batch capacity (4096 quads): each frame flushes many times into
+    -- the shared streaming vertex buffer
+    self.modes = {
+        {
+            name = "vertex",
+            batch = sprite.new_batch(self.tex_result, TEX_SIZE, TEX_SIZE, SCREEN_W, SCREEN_H),
+        },
+        {
+            name = "instanced",
+            batch = sprite.new_batch(self.tex_result, TEX_SIZE, TEX_SIZE, SCREEN_W, SCREEN_H,
+                { instanced = true }),
+        },
+        {
+            name = "multi",
+            batch = sprite.new_batch(nil, 1, 1, SCREEN_W, SCREEN_H,
+                { instanced = true }),
+            regions = true,
+        },
+    }
+    for _, mode in ipairs(self.modes) do
+        mode.frames = 0
+        mode.draw_ms = 0
+        mode.flush_ms = 0
+        mode.draw_calls = 0
+    end
+
+    self:run_tests()
+
+    -- Pre-built opts tables: the benchmark measures the batch, not table churn
+    self.opts = {}
+    for i = 1, 64 do
+        self.opts[i] = {
+            rotate = i * 0.1,
+            origin_x = TEX_SIZE / 2,
+            origin_y = TEX_SIZE / 2,
+            scale_x = 1 + (i % 4) * 0.25,
+            scale_y = 1 + (i % 4) * 0.25,
+            color = { (i % 8) / 8, (i % 5) / 5, (i % 3) / 3, 1.0 },
+            layer = i % 2,
+            blend = (i % 7 == 0) and sprite.Blend.ADD or sprite.Blend.ALPHA,
+        }
+    end
+
+    self.frames = 0
+end
+
+function M:run_tests()
+    local regions = self.regions
+    test.run("sprite", {
+        atlas_regions_disjoint = function()
+            for i = 1, #regions do
+                local a = regions[i]
+                assert(a.x + a.w <= a.page.w and a.y + a.h <= a.page.h, "region outside page")
+                for j = i + 1, #regions do
+                    local b = regions[j]
+                    local overlap = a.page == b.page
+                        and a.x < b.x + b.w and b.x < a.x + a.w
+                        and a.y < b.y + b.h and b.y < a.y + a.h
+                    assert(not overlap, a.name .. " overlaps " .. b.name)
+                end
+            end
+            assert(#self.atlas.pages > 1, "expected several pages")
+        end,
+        sort_groups_runs = function()
+            local core = require("lub3d.sprite").new_batch(16, 16, 16, true)
+            core:set_texture(1, 32, 32)
+            -- Interleaved textures/layers: 3 distinct keys -> 3 runs
+            core:draw(0, 0, 1, 1, 0, 0, { texture = 1, layer = 1 })
+            core:draw(0, 0, 1, 1, 0, 0, { texture = 0 })
+            core:draw(0, 0, 1, 1, 0, 0, { texture = 1, layer = 1 })
+            core:draw(0, 0, 1, 1, 0, 0, { texture = 1 })
+            core:draw(0, 0, 1, 1, 0, 0, nil, 0)
+            assert(core:sort() == 3)
+            local layer, tex, blend, first, count = core:run(1)
+            assert(layer == 0 and tex == 0 and blend == 0 and first == 0 and count == 2)
+            layer, tex, _, first, count = core:run(2)
+            assert(layer == 0 and tex == 1 and first == 2 and count == 1)
+            layer, tex, _, first, count = core:run(3)
+            assert(layer == 1 and tex == 1 and first == 3 and count == 2)
+            core:destroy()
+        end,
+    })
+end
+
+function M:frame()
+    gfx.begin_pass(gfx.Pass({
+        action = gfx.PassAction({
+            colors = {
+                gfx.ColorAttachmentAction({
+                    load_action = gfx.LoadAction.CLEAR,
+                    clear_value = gfx.Color({ r = 0.1, g = 0.1, b = 0.15, a = 1.0 }),
+                }),
+            },
+        }),
+        swapchain = glue.swapchain(),
+    }))
+
+    local mode = self.modes[(self.frames % #self.modes) + 1]
+    local batch, opts = mode.batch, self.opts
+    local t = self.frames * 0.02
+    local calls0 = batch.draw_calls
+    local t0 = stm.now()
+    if mode.regions then
+        local regions = self.regions
+        for i = 1, SPRITES_PER_FRAME do
+            local x = (i * 37) % SCREEN_W
+            local y = (i * 53 + t * 60) % SCREEN_H
+            sprite.draw_region(batch, regions[i % ATLAS_IMAGES + 1], x, y, opts[(i & 63) + 1])
+        end
+    else
+        for i = 1, SPRITES_PER_FRAME do
+            local x = (i * 37) % SCREEN_W
+            local y = (i * 53 + t * 60) % SCREEN_H
+            sprite.draw(batch, 0, 0, TEX_SIZE, TEX_SIZE, x, y, opts[(i & 63) + 1])
+        end
+    end
+    local t1 = stm.now()
+    sprite.flush(batch)
+    local t2 = stm.now()
+
+    gfx.end_pass()
+    gfx.commit()
+
+    mode.frames = mode.frames + 1
+    mode.draw_calls = batch.draw_calls - calls0
+    mode.draw_ms = mode.draw_ms + stm.ms(stm.diff(t1, t0))
+    mode.flush_ms = mode.flush_ms + stm.ms(stm.diff(t2, t1))
+    self.frames = self.frames + 1
+end
+
+function M:cleanup()
+    for _, mode in ipairs(self.modes or {}) do
+        if mode.frames > 0 then
+            local total_ms = mode.draw_ms + mode.flush_ms
+            local upload = SPRITES_PER_FRAME * mode.batch.core:quad_bytes()
+            log.info(string.format(
+                "sprite_bench[%s]: %d sprites x %d frames, draw %.3f ms/frame, flush %.3f ms/frame, "
+                    .. "%.1f sprites/ms, %.1f KiB uploaded/frame, %d draw calls/frame",
+                mode.name, SPRITES_PER_FRAME, mode.frames, mode.draw_ms / mode.frames,
+                mode.flush_ms / mode.frames, SPRITES_PER_FRAME * mode.frames / math.max(total_ms, 1e-6),
+                upload / 1024, mode.draw_calls))
+        end
+        sprite.destroy_batch(mode.batch)
+    end
+    self.modes = nil
+    sprite.shutdown()
+    if self.atlas then
+        self.atlas:destroy()
+        self.atlas = nil
+    end
+    if self.tex_result then
+        self.tex_result.img:destroy()
+        self.tex_result.view:destroy()
+        self.tex_result.smp:destroy()
+        self.tex_result = nil
+    end
+    gfx.shutdown()
+end
+
+function M:event(ev)
+    if ev.type == app.EventType.KEY_DOWN then
+        if ev.key_code == app.Keycode.ESCAPE or ev.key_code == app.Keycode.Q then
+            app.quit()
+        end
+    end
+end
+
+return M
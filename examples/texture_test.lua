@@ -0,0 +1,352 @@
+-- texture_test.lua - Texture pipeline tests
+-- Checks decoding into buffers, mip generation and KTX2/DDS parsing
+-- (lub3d.image), and mip-aware texture loading and the content-hash BC7
+-- cache (lib.texture, lib.texture_cache) and background loading
+-- (lub3d.texloader, lib.texture_manager) against a small generated TGA file.
+-- Runs headless: lub3d-test examples.texture_test 1
+
+local gfx = require("sokol.gfx")
+local app = require("sokol.app")
+local glue = require("sokol.glue")
+local fs = require("lub3d.fs")
+local image = require("lub3d.image")
+local hash = require("lub3d.hash")
+local texture = require("lib.texture")
+local texture_cache = require("lib.texture_cache")
+local texloader = require("lub3d.texloader")
+local texture_manager = require("lib.texture_manager")
+local test = require("lib.test")
+
+local bc7enc_ok, bc7enc = pcall(require, "bc7enc")
+
+local M = {}
+M.width = 320
+M.height = 240
+M.window_title = "Lub3d - Texture Test"
+
+-- Uncompressed 32-bit TGA, top-left origin (BGRA pixels)
+---@param w integer
+---@param h integer
+---@return string
+local function make_tga(w, h)
+    local header = string.pack("<BBBI2I2BI2I2I2I2BB", 0, 0, 2, 0, 0, 0, 0, 0, w, h, 32, 0x28)
+    local px = {}
+    for y = 0, h - 1 do
+        for x = 0, w - 1 do
+            px[#px + 1] = string.char((x * 255) // w, (y * 255) // h, 128, 255)
+        end
+    end
+    return header .. table.concat(px)
+end
+
+local function run_tests()
+    local tmp = os.tmpname()
+    local tga = tmp .. ".tga"
+    local cache_dirs = { tmp .. "_bc7", tmp .. "_lru" }
+
+    test.run("texture", {
+        mip_count = function()
+            assert(image.mip_count(1, 1) == 1)
+            assert(image.mip_count(256, 64) == 9)
+            assert(image.mip_count(13, 5) == 4)
+        end,
+        gen_mips_level_sizes = function()
+            local pixels = string.rep("\255\0\0\255", 13 * 5)
+            local levels = image.gen_mips(pixels, 13, 5)
+            assert(#levels == 4)
+            assert(levels[1] == pixels)
+            assert(#levels[2] == 6 * 2 * 4 and #levels[3] == 3 * 1 * 4 and #levels[4] == 4)
+            assert(#image.gen_mips(pixels, 13, 5, { max_levels = 2 }) == 2)
+        end,
+        box_filters_in_linear_space = function()
+            -- Black/white checker: 50% linear coverage is 188 in sRGB
+            local checker = "\0\0\0\255\255\255\255\255\255\255\255\255\0\0\0\255"
+            local srgb = image.gen_mips(checker, 2, 2, { srgb = true })[2]
+            local linear = image.gen_mips(checker, 2, 2)[2]
+            assert(srgb:byte(1) == 188 and srgb:byte(4) == 255, "srgb " .. srgb:byte(1))
+            assert(linear:byte(1) == 128, "linear " .. linear:byte(1))
+        end,
+        kaiser_preserves_flat_color = function()
+            local pixels = string.rep("\100\150\200\255", 16 * 16)
+            local levels = image.gen_mips(pixels, 16, 16, { srgb = true, filter = "kaiser" })
+            assert(levels[2] == string.rep("\100\150\200\255", 8 * 8))
+            assert(levels[5] == "\100\150\200\255")
+        end,
+        decode_into_buffer = function()
+            local tga_data = make_tga(8, 4)
+            local w, h, ch = image.info(tga_data)
+            assert(w == 8 and h == 4 and ch == 4)
+            assert(not image.info("not an image"))
+            local buf, mips = image.buffer(), image.buffer()
+            assert(image.decode(tga_data, buf) == 8)
+            assert(buf:size() == 8 * 4 * 4)
+            local pixels = buf:read()
+            assert(pixels:sub(1, 4) == "\128\0\0\255")
+            -- Mips land in the second buffer and match the string path
+            local levels = image.gen_mips(buf, 8, 4, { into = mips })
+            assert(#levels == 4 and levels[1].size == 128 and levels[2].size == 32 and levels[4].size == 4)
+            assert(mips:size() == 32 + 8 + 4)
+            local ref = image.gen_mips(pixels, 8, 4)
+            assert(mips:read(0, 32) == ref[2] and mips:read(40, 4) == ref[4])
+            assert(not image.decode("not an image", buf))
+            buf:release()
+            assert(buf:size() == 0)
+        end,
+        load_generates_mips = function()
+            assert(fs.write(tga, make_tga(32, 16)), "cannot write " .. tga)
+            local tex = assert(texture.load(tga))
+            assert(gfx.query_image_num_mipmaps(tex.img.handle) == 6)
+            tex = assert(texture.load(tga, { mips = false }))
+            assert(gfx.query_image_num_mipmaps(tex.img.handle) == 1)
+            local w, h = texture.probe(tga)
+            assert(w == 32 and h == 16)
+        end,
+        ktx2_roundtrip = function()
+            local pixels = string.rep("\10\20\30\255", 8 * 4)
+            local levels = image.gen_mips(pixels, 8, 4)
+            local ktx = image.encode_ktx2(levels, 8, 4, gfx.PixelFormat.SRGB8A8)
+            local info = assert(image.parse_texture(ktx))
+            assert(info.container == "ktx2" and info.format == gfx.PixelFormat.SRGB8A8)
+            assert(info.width == 8 and info.height == 4 and info.levels == 4 and info.layers == 1)
+            local handle, made = image.make_image(ktx, "ktx2_roundtrip")
+            assert(handle, made)
+            assert(gfx.query_image_num_mipmaps(handle) == 4)
+            gfx.destroy_image(handle)
+            assert(not image.parse_texture(ktx:sub(1, 60)))
+            -- Crafted headers: sizes that would wrap the level byte counts, too many mips
+            local huge = ktx:sub(1, 20) .. string.pack("<I4I4", 1 << 30, 1 << 30) .. ktx:sub(29)
+            assert(not image.parse_texture(huge), "oversized image accepted")
+            local deep = ktx:sub(1, 40) .. string.pack("<I4", 16) .. ktx:sub(45)
+            assert(not image.parse_texture(deep), "mip count beyond the image size accepted")
+        end,
+        dds_array_layout = function()
+            -- DX10 header, BC1 4x4 array of 2 slices with 3 mips each
+            local header = "DDS " .. string.pack("<I4I4I4I4I4I4I4", 124, 0, 4, 4, 0, 0, 3)
+                .. string.rep("\0", 44)
+                .. string.pack("<I4I4c4", 32, 4, "DX10") .. string.rep("\0", 20)
+                .. string.rep("\0", 20)
+                .. string.pack("<I4I4I4I4I4", 71, 3, 0, 2, 0)
+            assert(#header == 148)
+            local body = {}
+            for slice = 0, 1 do
+                for level = 0, 2 do
+                    body[#body + 1] = string.rep(string.char(slice * 10 + level), 8)
+                end
+            end
+            local dds = header .. table.concat(body)
+            local info = assert(image.parse_texture(dds))
+            assert(info.container == "dds" and info.format == gfx.PixelFormat.BC1_RGBA)
+            assert(info.layers == 2 and info.levels == 3)
+            assert(not image.parse_texture(dds:sub(1, #dds - 1)), "truncated data accepted")
+        end,
+        xxh64_reference_vectors = function()
+            assert(string.format("%016x", hash.xxh64("")) == "ef46db3751d8e999")
+            assert(string.format("%016x", hash.xxh64("abc")) == "44bc2cf5ad770999")
+            assert(string.format("%016x", hash.xxh64("Nobody inspects the spammish repetition"))
+                == "fbcea83c8a378bf1")
+            assert(hash.xxh64("abc", 1) ~= hash.xxh64("abc"))
+        end,
+        bc7_cache_has_mips = function()
+            if not bc7enc_ok then
+                return
+            end
+            texture_cache.config.dir = cache_dirs[1]
+            assert(fs.write(tga, make_tga(32, 16)), "cannot write " .. tga)
+            local tex = assert(texture.load_bc7(tga))
+            assert(gfx.query_image_num_mipmaps(tex.img.handle) == 6)
+            local key = texture_cache.key(assert(fs.read(tga)), texture_cache.params({}))
+            local info = assert(image.parse_texture(assert(fs.read(texture_cache.path(key)), "cache not written")))
+            assert(info.format == gfx.PixelFormat.BC7_RGBA and info.width == 32 and info.levels == 6)
+            -- Second load is served from the cache; other settings get their own entry
+            tex = assert(texture.load_bc7(tga))
+            assert(gfx.query_image_num_mipmaps(tex.img.handle) == 6)
+            assert(texture_cache.stats().entries == 1)
+            tex = assert(texture.load_bc7(tga, { srgb = true }))
+            assert(gfx.query_image_pixelformat(tex.img.handle) == gfx.PixelFormat.BC7_SRGBA)
+            assert(texture_cache.stats().entries == 2)
+        end,
+        bc_formats_roundtrip = function()
+            if not bc7enc_ok then
+                return
+            end
+            -- 8x4 grey ramp along x, so every format can represent it closely
+            local rows = {}
+            for _ = 1, 4 do
+                for x = 0, 7 do
+                    rows[#rows + 1] = string.char(x * 32, x * 32, x * 32, 255)
+                end
+            end
+            local pixels = table.concat(rows)
+            local buf = image.buffer()
+            for _, format in ipairs({ "bc1", "bc4", "bc5", "bc7" }) do
+                local blocks = assert(bc7enc.encode(pixels, 8, 4, { format = format }))
+                assert(#blocks == bc7enc.calc_size(8, 4, format), format)
+                assert(bc7enc.decode(blocks, 8, 4, { format = format, into = buf }) == buf)
+                local out = buf:read()
+                assert(#out == #pixels, format)
+                for i = 1, #pixels, 4 do
+                    assert(math.abs(out:byte(i) - pixels:byte(i)) <= 8, format .. " red off at " .. i)
+                end
+            end
+            assert(bc7enc.calc_size(8, 4, "bc1") == 16 and bc7enc.calc_size(8, 4, "bc5") == 32)
+            assert(not pcall(bc7enc.encode, pixels, 8, 4, { format = "bc4", srgb = true }))
+            assert(texture.select_format({ usage = "normal" }) == "bc5")
+            assert(texture.select_format({ usage = "opaque", srgb = true }) == "bc7")
+        end,
+        texture_cache_evicts_lru = function()
+            texture_cache.config.dir = cache_dirs[2]
+            local max_bytes = texture_cache.config.max_bytes
+            texture_cache.config.max_bytes = 250
+            local a, b, c = texture_cache.key("a", "p"), texture_cache.key("b", "p"), texture_cache.key("c", "p")
+            assert(texture_cache.put(a, string.rep("a", 100)) and texture_cache.put(b, string.rep("b", 100)))
+            assert(texture_cache.get(a))
+            assert(texture_cache.put(c, string.rep("c", 100)))
+            texture_cache.save()
+            texture_cache.config.max_bytes = max_bytes
+            assert(texture_cache.get(a) and texture_cache.get(c), "recent entries evicted")
+            assert(not fs.exists(texture_cache.path(b)), "least recently used entry kept")
+            assert(fs.read(texture_cache.config.dir .. "/index.txt"):find(c, 1, true))
+        end,
+        texloader_upload_budget = function()
+            assert(fs.write(tga, make_tga(32, 16)), "cannot write " .. tga)
+            -- One worker keeps the ready queue in request order
+            local loader = texloader.new({ threads = 1, budget = 1 })
+            local ids = { loader:request(tga), loader:request(tga, { mips = false }), loader:request(tga .. ".missing") }
+            loader:wait()
+            assert(loader:stats().ready == 3)
+            -- Over budget after the first upload; the rest waits for later calls
+            local first = loader:update()
+            assert(#first == 1 and first[1].id == ids[1] and first[1].levels == 6, "budget not applied")
+            assert(first[1].bytes == (32 * 16 + 16 * 8 + 8 * 4 + 4 * 2 + 2 + 1) * 4)
+            gfx.destroy_image(first[1].image)
+            local rest = loader:update(0)
+            assert(#rest == 2 and rest[1].levels == 1 and rest[2].error, "unexpected results")
+            gfx.destroy_image(rest[1].image)
+            local stats = loader:stats()
+            assert(stats.requested == 3 and stats.uploaded == 2 and stats.failed == 1 and stats.ready == 0)
+            loader:destroy()
+        end,
+        texloader_max_size = function()
+            assert(fs.write(tga, make_tga(32, 16)), "cannot write " .. tga)
+            local loader = texloader.new({ threads = 1 })
+            loader:request(tga, { max_size = 8 })
+            loader:wait()
+            local r = loader:update(0)[1]
+            assert(r.image, r.error)
+            assert(r.width == 8 and r.height == 4 and r.full_width == 32 and r.full_height == 16)
+            assert(r.levels == 4 and r.bytes == (8 * 4 + 4 * 2 + 2 + 1) * 4)
+            gfx.destroy_image(r.image)
+            loader:destroy()
+        end,
+        process_texels = function()
+            local px = string.char(200, 100, 50, 128, 255, 255, 255, 0)
+            assert(image.process(px, { premultiply = true }) == string.char(100, 50, 25, 128, 0, 0, 0, 0))
+            assert(image.process(px, { swizzle = "bgr1" }) == string.char(50, 100, 200, 255, 255, 255, 255, 255))
+            -- Buffers are processed in place (make_tga's texel decodes to 128, 0, 0, 255)
+            local buf = image.buffer()
+            assert(image.decode(make_tga(1, 1), buf, 4))
+            assert(image.process(buf, { swizzle = "bgra" }) == buf)
+            assert(buf:read() == string.char(0, 0, 128, 255))
+            -- Flat normal: z = 1
+            local flat = image.process(string.char(128, 128, 0, 255), { normal_z = true })
+            assert(flat:byte(3) == 255, "normal z " .. flat:byte(3))
+            -- sRGB round trip keeps the extremes
+            local lin = image.process(string.char(0, 128, 255, 255), { convert = "linear" })
+            assert(lin:byte(1) == 0 and lin:byte(2) < 128 and lin:byte(3) == 255)
+            assert(image.process(lin, { convert = "srgb" }):byte(3) == 255)
+            assert(not pcall(image.process, px, { swizzle = "rgbx" }))
+        end,
+        texloader_decode_only = function()
+            assert(fs.write(tga, make_tga(32, 16)), "cannot write " .. tga)
+            local loader = texloader.new({ threads = 1 })
+            loader:request(tga, { upload = false })
+            loader:wait()
+            local r = loader:update(0)[1]
+            assert(not r.error, r.error)
+            assert(not r.image and r.width == 32 and r.levels == 6)
+            assert(loader:stats().uploaded == 0)
+            loader:destroy()
+        end,
+        texture_manager_streams_and_evicts = function()
+            assert(fs.write(tga, make_tga(32, 16)), "cannot write " .. tga)
+            -- Room for both small versions and one full one
+            local small, full = (8 * 4 + 4 * 2 + 2 + 1) * 4, (32 * 16 + 16 * 8 + 8 * 4 + 4 * 2 + 2 + 1) * 4
+            local textures = texture_manager.new({
+                threads = 1,
+                stream = { min_size = 8, idle_frames = 0, memory_budget = 2 * small + full + 100 },
+            })
+            local a, b = textures:get(tga), textures:get(tga, { srgb = true })
+            textures:flush()
+            assert(a.width == 8 and a.full_width == 32 and textures:stats().resident_bytes == 2 * small)
+            -- Drawn at 32 pixels: the full size is streamed in
+            textures:use(a, 32)
+            textures:update()
+            textures:flush()
+            assert(a.width == 32 and gfx.query_image_num_mipmaps(a.img.handle) == 6)
+            -- b needs the space a no longer uses
+            textures:use(b, 32)
+            assert(textures:update() == 1, "eviction not reported")
+            assert(a.width == 8 and not a.high)
+            textures:flush()
+            assert(b.width == 32)
+            local stats = textures:stats()
+            assert(stats.upgrades == 2 and stats.evictions == 1 and stats.resident_bytes == 2 * small + full)
+            assert(#textures:residency() == 2)
+            textures:destroy()
+        end,
+        texture_manager_swaps_placeholder = function()
+            assert(fs.write(tga, make_tga(32, 16)), "cannot write " .. tga)
+            local textures = texture_manager.new({ threads = 1 })
+            local tex = textures:get(tga, { srgb = true })
+            assert(textures:get(tga, { srgb = true }) == tex and textures:get(tga) ~= tex)
+            assert(not tex.ready and tex.view == textures.placeholder.view)
+            local missing = textures:get(tga .. ".missing")
+            textures:flush()
+            assert(tex.ready and tex.width == 32 and tex.view ~= textures.placeholder.view)
+            assert(gfx.query_image_num_mipmaps(tex.img.handle) == 6)
+            assert(gfx.query_image_pixelformat(tex.img.handle) == gfx.PixelFormat.SRGB8A8)
+            assert(missing.error and missing.view == textures.placeholder.view)
+            local stats = textures:stats()
+            assert(stats.hits == 1 and stats.misses == 3 and stats.loaded == 2 and stats.failed == 1)
+            assert(stats.pending == 0 and stats.progress == 1)
+            textures:destroy()
+        end,
+    })
+
+    os.remove(tga)
+    os.remove(tmp)
+    for _, dir in ipairs(cache_dirs) do
+        for name in fs.dir(dir) or function() end do
+            os.remove(dir .. "/" .. name)
+        end
+        os.remove(dir)
+    end
+end
+
+function M:init()
+    gfx.setup(gfx.Desc({
+        environment = glue.environment(),
+    }))
+    run_tests()
+end
+
+function M:frame()
+    gfx.begin_pass(gfx.Pass({ swapchain = glue.swapchain() }))
+    gfx.end_pass()
+    gfx.commit()
+end
+
+function M:cleanup()
+    collectgarbage("collect")
+    gfx.shutdown()
+end
+
+function M:event(ev)
+    if ev.type == app.EventType.KEY_DOWN then
+        if ev.key_code == app.Keycode.ESCAPE or ev.key_code == app.Keycode.Q then
+            app.quit()
+        end
+    end
+end
+
+return M
@@ -0,0 +1,309 @@
+-- lib/atlas.lua
+-- Runtime texture atlas builder
+-- Packs RGBA8 images into shared atlas pages with a skyline (bottom-left)
+-- packer, so sprites from many source images can be drawn from a few
+-- textures and collapse into few draw calls (see sprite.draw_region).
+local gfx = require("sokol.gfx")
+local gpu = require("lib.gpu")
+local log = require("lib.log")
+local texture = require("lib.texture")
+
+---@class atlas
+local M = {}
+
+local DEFAULT_PAGE_SIZE <const> = 2048
+local DEFAULT_PADDING <const> = 1
+
+---@class atlas.Region
+---@field name string
+---@field page atlas.Page
+---@field x integer position in page (pixels)
+---@field y integer
+---@field w integer size (pixels)
+---@field h integer
+
+---@class atlas.Page
+---@field index integer 1-based page number
+---@field w integer
+---@field h integer
+---@field skyline { x: integer, y: integer, w: integer }[] skyline segments, sorted by x
+---@field pending { region: atlas.Region, pixels: string }[] images not yet uploaded
+---@field img gpu.Image? set by build
+---@field view gpu.View? set by build
+---@field smp gpu.Sampler? set by build
+
+---@class atlas.Atlas
+---@field page_size integer
+---@field padding integer
+---@field pages atlas.Page[]
+---@field regions table<string, atlas.Region>
+---@field filter sokol.gfx.Filter
+local Atlas = {}
+Atlas.__index = Atlas
+
+---@param atlas atlas.Atlas
+---@return atlas.Page
+local function new_page(atlas)
+    local page = {
+        index = #atlas.pages + 1,
+        w = atlas.page_size,
+        h = atlas.page_size,
+        skyline = { { x = 0, y = 0, w = atlas.page_size } },
+        pending = {},
+    }
+    atlas.pages[#atlas.pages + 1] = page
+    return page
+end
+
+-- Height at which a w-wide rect fits when its left edge sits on segment i,
+-- or nil if it runs off the right edge of the page
+---@param page atlas.Page
+---@param i integer
+---@param w integer
+---@return integer?
+local function fit_at(page, i, w)
+    local sky = page.skyline
+    local x = sky[i].x
+    if x + w > page.w then
+        return nil
+    end
+    local y = 0
+    local remaining = w
+    while remaining > 0 do
+        local seg = sky[i]
+        if seg.y > y then
+            y = seg.y
+        end
+        remaining = remaining - seg.w
+        i = i + 1
+    end
+    return y
+end
+
+-- Find the bottom-left position for a w x h rect
+---@param page atlas.Page
+---@param w integer
+---@param h integer
+---@return integer? index skyline segment index
+---@return integer? x
+---@return integer? y
+local function find_position(page, w, h)
+    local best_i, best_y, best_w
+    for i, seg in ipairs(page.skyline) do
+        local y = fit_at(page, i, w)
+        if y and y + h <= page.h then
+            if not best_y or y + h < best_y + h or (y == best_y and seg.w < best_w) then
+                best_i, best_y, best_w = i, y, seg.w
+            end
+        end
+    end
+    if not best_i then
+        return nil
+    end
+    return best_i, page.skyline[best_i].x, best_y
+end
+
+-- Raise the skyline under a placed rect and merge equal-height neighbours
+---@param page atlas.Page
+---@param i integer
+---@param x integer
+---@param y integer
+---@param w integer
+---@param h integer
+local function add_skyline_level(page, i, x, y, w, h)
+    local sky = page.skyline
+    table.insert(sky, i, { x = x, y = y + h, w = w })
+
+    -- Trim or remove segments now covered by the new one
+    local right = x + w
+    local j = i + 1
+    while j <= #sky do
+        local seg = sky[j]
+        if seg.x >= right then
+            break
+        end
+        local seg_right = seg.x + seg.w
+        if seg_right <= right then
+            table.remove(sky, j)
+        else
+            seg.w = seg_right - right
+            seg.x = right
+            break
+        end
+    end
+
+    j = 1
+    while j < #sky do
+        if sky[j].y == sky[j + 1].y then
+            sky[j].w = sky[j].w + sky[j + 1].w
+            table.remove(sky, j + 1)
+        else
+            j = j + 1
+        end
+    end
+end
+
+--- Create an empty atlas
+---@param opts? { page_size?: integer, padding?: integer, filter?: sokol.gfx.Filter }
+---@return atlas.Atlas
+function M.new(opts)
+    opts = opts or {}
+    local atlas = setmetatable({
+        page_size = opts.page_size or DEFAULT_PAGE_SIZE,
+        padding = opts.padding or DEFAULT_PADDING,
+        pages = {},
+        regions = {},
+        filter = opts.filter or gfx.Filter.LINEAR,
+    }, Atlas)
+    return atlas
+end
+
+--- Pack an RGBA8 image into the atlas
+--- Tries existing pages first and opens a new page when none has room.
+---@param name string region name (must be unique)
+---@param pixels string RGBA8 pixel data (w * h * 4 bytes)
+---@param w integer
+---@param h integer
+---@return atlas.Region?
+---@return string? err
+function Atlas:add(name, pixels, w, h)
+    if self.regions[name] then
+        return nil, "atlas: duplicate region " .. name
+    end
+    if #pixels ~= w * h * 4 then
+        return nil, "atlas: " .. name .. " pixel data size mismatch"
+    end
+    local pw, ph = w + self.padding, h + self.padding
+    if pw > self.page_size or ph > self.page_size then
+        return nil, "atlas: " .. name .. " does not fit in a page"
+    end
+
+    local page, i, x, y
+    for _, p in ipairs(self.pages) do
+        if not p.view then
+            i, x, y = find_position(p, pw, ph)
+            if i then
+                page = p
+                break
+            end
+        end
+    end
+    if not page then
+        page = new_page(self)
+        i, x, y = find_position(page, pw, ph)
+    end
+    ---@cast i integer
+    ---@cast x integer
+    ---@cast y integer
+    add_skyline_level(page, i, x, y, pw, ph)
+
+    ---@type atlas.Region
+    local region = { name = name, page = page, x = x, y = y, w = w, h = h }
+    page.pending[#page.pending + 1] = { region = region, pixels = pixels }
+    self.regions[name] = region
+    return region, nil
+end
+
+--- Load an image file and pack it
+---@param name string region name
+---@param filename string image path (PNG, JPG, etc.)
+---@return atlas.Region?
+---@return string? err
+function Atlas:add_file(name, filename)
+    local data, err = texture.load_image_data(filename)
+    if not data then
+        return nil, err
+    end
+    return self:add(name, data.pixels, data.w, data.h)
+end
+
+---@param name string
+---@return atlas.Region?
+function Atlas:region(name)
+    return self.regions[name]
+end
+
+-- Compose a page's RGBA8 pixel data row by row from its pending images
+---@param page atlas.Page
+---@return string
+local function compose_page(page)
+    local row_bytes = page.w * 4
+    local empty_row = string.rep("\0", row_bytes)
+    local zeros = {}
+    local function gap(n)
+        local z = zeros[n]
+        if not z then
+            z = string.rep("\0", n)
+            zeros[n] = z
+        end
+        return z
+    end
+
+    -- Images sorted by x so each row concatenates left to right
+    local items = page.pending
+    table.sort(items, function(a, b) return a.region.x < b.region.x end)
+
+    local rows = {}
+    for y = 0, page.h - 1 do
+        local parts, cursor = nil, 0
+        for _, item in ipairs(items) do
+            local r = item.region
+            if y >= r.y and y < r.y + r.h then
+                parts = parts or {}
+                if r.x > cursor then
+                    parts[#parts + 1] = gap((r.x - cursor) * 4)
+                end
+                local src = (y - r.y) * r.w * 4
+                parts[#parts + 1] = item.pixels:sub(src + 1, src + r.w * 4)
+                cursor = r.x + r.w
+            end
+        end
+        if parts then
+            if cursor < page.w then
+                parts[#parts + 1] = gap((page.w - cursor) * 4)
+            end
+            rows[y + 1] = table.concat(parts)
+        else
+            rows[y + 1] = empty_row
+        end
+    end
+    return table.concat(rows)
+end
+
+--- Upload all pages that have not been built yet
+--- Built pages are frozen: later adds go to new pages.
+function Atlas:build()
+    for _, page in ipairs(self.pages) do
+        if not page.view then
+            local img = gpu.image(gfx.ImageDesc({
+                width = page.w,
+                height = page.h,
+                pixel_format = gfx.PixelFormat.RGBA8,
+                data = { mip_levels = { gfx.Range(compose_page(page)) } },
+            }))
+            page.img = img
+            page.view = gpu.view(gfx.ViewDesc({ texture = { image = img.handle } }))
+            page.smp = gpu.sampler(gfx.SamplerDesc({
+                min_filter = self.filter,
+                mag_filter = self.filter,
+                wrap_u = gfx.Wrap.CLAMP_TO_EDGE,
+                wrap_v = gfx.Wrap.CLAMP_TO_EDGE,
+            }))
+            log.info(string.format("atlas: built page %d (%dx%d, %d images)",
+                page.index, page.w, page.h, #page.pending))
+            page.pending = {}
+        end
+    end
+end
+
+--- Destroy GPU resources of all pages
+function Atlas:destroy()
+    for _, page in ipairs(self.pages) do
+        if page.img then page.img:destroy() end
+        if page.view then page.view:destroy() end
+        if page.smp then page.smp:destroy() end
+        page.img, page.view, page.smp = nil, nil, nil
+    end
+end
+
+return M
@@ -69,11 +69,23 @@ desc.frame = function()
     if hotreload then
         pcall(hotreload.update)
     end
+    -- Hand out shaders finished by background compiles (lib.shader.compile_async)
+    local shader = package.loaded["lib.shader"]
+    if shader then
+        shader.update()
+    end
     if M.frame then M:frame() end
 end
 
 desc.cleanup = function()
     if M.cleanup then M:cleanup() end
+    -- Cached pipelines went away with the gfx context
+    require("lub3d.pipeline_cache").reset()
+    -- Flush texture cache index updates not saved yet
+    local texture_cache = package.loaded["lib.texture_cache"]
+    if texture_cache then
+        texture_cache.save()
+    end
 end
 
 desc.event = function(ev)
@@ -0,0 +1,134 @@
+-- convert.lua
+-- Offline texture converter for lub3d CLI (stdout output, no GUI)
+-- Encodes images to KTX2 with a full mip chain (BCn when bc7enc is built in),
+-- ready for texture.load / texture.load_container.
+--
+-- Globals:
+--   _lub3d_args (string[]) - command line arguments after "convert"
+
+local stm = require("sokol.time")
+local fs = require("lub3d.fs")
+local image = require("lub3d.image")
+local texture = require("lib.texture")
+
+---@type string[]
+local args = _lub3d_args or {} ---@diagnostic disable-line: undefined-global
+
+local function usage()
+    print("Usage: lub3d convert [options] <image>...")
+    print("")
+    print("Options:")
+    print("  -o <dir>               Output directory (default: next to each input)")
+    print("  --format <format>      bc1|bc4|bc5|bc7|rgba8 (default: from --usage if bc7enc is available)")
+    print("  --usage <usage>        color|normal|mask|opaque: picks bc7|bc5|bc4|bc1 (default: color)")
+    print("  --srgb                 Color data: sRGB format, mips filtered in linear space")
+    print("  --no-mips              Only write the top level")
+    print("  --premultiply          Premultiply color by alpha")
+    print("  --swizzle <rgba01>     Reorder channels, e.g. bgra or ag01")
+    print("  --normal-z             Rebuild blue as the z of a unit normal from red and green")
+    print("  --to-linear            Convert color from sRGB to linear")
+    print("  --mip-filter box|kaiser")
+    print("  --rdo <quality>        BC7 rate-distortion optimization (0 = off)")
+    print("  --threads <n>          Encoder threads (default: all cores)")
+    print("  --force                Convert even if the output is up to date")
+end
+
+local opts = {}
+local out_dir, force
+local inputs = {}
+
+local i = 1
+while i <= #args do
+    local a = args[i]
+    if a == "-o" then
+        i = i + 1
+        out_dir = args[i]
+    elseif a == "--format" then
+        i = i + 1
+        opts.format = args[i]
+    elseif a == "--usage" then
+        i = i + 1
+        opts.usage = args[i]
+    elseif a == "--srgb" then
+        opts.srgb = true
+    elseif a == "--no-mips" then
+        opts.mips = false
+    elseif a == "--premultiply" then
+        opts.premultiply = true
+    elseif a == "--swizzle" then
+        i = i + 1
+        opts.swizzle = args[i]
+    elseif a == "--normal-z" then
+        opts.normal_z = true
+    elseif a == "--to-linear" then
+        opts.convert = "linear"
+    elseif a == "--mip-filter" then
+        i = i + 1
+        opts.mip_filter = args[i]
+    elseif a == "--rdo" then
+        i = i + 1
+        opts.rdo_quality = tonumber(args[i])
+    elseif a == "--threads" then
+        i = i + 1
+        opts.threads = math.tointeger(tonumber(args[i]))
+    elseif a == "--force" then
+        force = true
+    elseif a == "--help" or a == "-h" then
+        usage()
+        os.exit(0)
+    elseif a:sub(1, 1) == "-" then
+        print("Unknown option: " .. a)
+        usage()
+        os.exit(1)
+    else
+        inputs[#inputs + 1] = a
+    end
+    i = i + 1
+end
+
+if #inputs == 0 then
+    usage()
+    os.exit(1)
+end
+
+stm.setup()
+
+local failed = 0
+for _, input in ipairs(inputs) do
+    local output = input:gsub("%.[^./\\]+$", "") .. ".ktx2"
+    if out_dir then
+        output = out_dir .. "/" .. output:match("[^/\\]+$")
+    end
+
+    local src_mtime, out_mtime = fs.mtime(input), fs.mtime(output)
+    if not force and src_mtime and out_mtime and out_mtime >= src_mtime then
+        print("up to date: " .. output)
+    else
+        local t0 = stm.now()
+        local data, err = texture.load_image_data(input)
+        local levels, format
+        if data then
+            levels, format = texture.encode_levels(data, opts)
+            err = not levels and tostring(format) or nil
+        end
+        if levels and data then
+            ---@cast format integer
+            local ktx = image.encode_ktx2(levels, data.w, data.h, format)
+            if fs.write(output, ktx) then
+                local info = assert(image.parse_texture(ktx))
+                print(string.format("%s -> %s (%dx%d %s, %d mips, %d KiB, %.2f s)", input, output,
+                    data.w, data.h, info.format_name, #levels, #ktx // 1024, stm.sec(stm.since(t0))))
+            else
+                err = "cannot write " .. output
+            end
+        end
+        if err then
+            print("error: " .. input .. ": " .. err)
+            failed = failed + 1
+        end
+    end
+end
+
+if failed > 0 then
+    os.exit(1)
+end
@@ -0,0 +1,468 @@
+-- cook.lua
+-- Offline asset cook for lub3d CLI (stdout output, no GUI)
+-- Mirrors a project directory into an output directory, doing ahead of
+-- time the work that otherwise happens on first launch:
+--   *.lua   compiled to bytecode under the same name (require and dofile
+--           load bytecode transparently); long strings containing
+--           "@program" are precompiled as shaders
+--   *.glsl  sokol-shdc sources: every @program is precompiled, once per
+--           combination of the source's "// @permute NAME values..." lines
+--   images  copied, and encoded (mips, BCn) into the texture cache
+--   others  copied
+-- Shaders are compiled for every --lang into <out>/<shader cache dir> and
+-- textures into <out>/<texture cache dir>, so the cooked project run from
+-- <out> starts with warm caches. Textures are encoded on lub3d.texloader
+-- worker threads and shaders compiled on the shdc threads (one job per
+-- source, language and permutation) while the main thread compiles Lua.
+-- A dependency database (<out>/cook.db) records the mtime and content hash
+-- of every input and the cache files cooked from it, together with the cook
+-- settings; unchanged inputs whose outputs all still exist are skipped, so
+-- cooking again after an edit (or a cache eviction) only redoes what changed.
+--
+-- Globals:
+--   _lub3d_args (string[]) - command line arguments after "cook"
+
+local stm = require("sokol.time")
+local fs = require("lub3d.fs")
+local hash = require("lub3d.hash")
+local texloader = require("lub3d.texloader")
+local shader = require("lib.shader")
+local texture = require("lib.texture")
+local texture_cache = require("lib.texture_cache")
+
+local bc7enc_ok, bc7enc = pcall(require, "bc7enc")
+local shdc_ok, shdc = pcall(require, "shdc")
+
+---@type string[]
+local args = _lub3d_args or {} ---@diagnostic disable-line: undefined-global
+
+local ALL_LANGS <const> = "glsl430,glsl300es,hlsl5,metal_macos,wgsl"
+local DB_FILE <const> = "cook.db"
+local DB_HEADER <const> = "lub3d-cook 2"
+
+local IMAGE_EXTS <const> = {
+    png = true, jpg = true, jpeg = true, tga = true, bmp = true,
+    psd = true, gif = true, hdr = true, pic = true, pnm = true,
+}
+
+local function usage()
+    print("Usage: lub3d cook [options] <dir>")
+    print("")
+    print("Options:")
+    print("  -o <dir>               Output directory (default: <dir>/cooked)")
+    print("  --lang <list>          Shader languages, comma separated (default: " .. ALL_LANGS .. ")")
+    print("  --srgb                 Color textures are sRGB")
+    print("  --strip                Strip debug info from Lua bytecode")
+    print("  --optimize             Optimize shaders (spirv-opt performance passes)")
+    print("  --minify               Minify shader sources")
+    print("  --threads <n>          Texture encoder and shader compiler threads (default: all cores)")
+    print("  --force                Cook every input even if it is unchanged")
+    print("")
+    print("Images named *_n, *_nrm, *_norm or *_normal are encoded as normal maps (BC5).")
+    print("With --optimize or --minify the game must set shader.output to match, or")
+    print("the cooked shaders are never used.")
+end
+
+local dir, out_dir, force, strip, srgb, threads
+local langs = {}
+local lang_list = ALL_LANGS
+
+local i = 1
+while i <= #args do
+    local a = args[i]
+    if a == "-o" then
+        i = i + 1
+        out_dir = args[i]
+    elseif a == "--lang" then
+        i = i + 1
+        lang_list = args[i] or ""
+    elseif a == "--srgb" then
+        srgb = true
+    elseif a == "--strip" then
+        strip = true
+    elseif a == "--optimize" then
+        shader.output.optimize = true
+    elseif a == "--minify" then
+        shader.output.minify = true
+    elseif a == "--threads" then
+        i = i + 1
+        threads = math.tointeger(tonumber(args[i]))
+    elseif a == "--force" then
+        force = true
+    elseif a == "--help" or a == "-h" then
+        usage()
+        os.exit(0)
+    elseif a:sub(1, 1) == "-" or dir then
+        print("Unknown option: " .. a)
+        usage()
+        os.exit(1)
+    else
+        dir = a
+    end
+    i = i + 1
+end
+
+if not dir then
+    usage()
+    os.exit(1)
+end
+dir = dir:gsub("[/\\]+$", "")
+out_dir = (out_dir or dir .. "/cooked"):gsub("[/\\]+$", "")
+for lang in lang_list:gmatch("[^,%s]+") do
+    langs[#langs + 1] = lang
+end
+
+-- Source-tree caches are rebuilt in the output, never copied
+local skip_dirs = {
+    [out_dir] = true,
+    [dir .. "/" .. shader.cache.dir] = true,
+    [dir .. "/" .. texture_cache.config.dir] = true,
+}
+shader.cache.dir = out_dir .. "/" .. shader.cache.dir
+texture_cache.config.dir = out_dir .. "/" .. texture_cache.config.dir
+
+-- Settings that change every output; a different value invalidates the database
+local settings = string.format("langs=%s|srgb=%s|strip=%s|shader=v%d%s%s|shdc=%s|%s", table.concat(langs, ","),
+    srgb and 1 or 0, strip and 1 or 0, shader.cache.version, shader.output.optimize and "O" or "",
+    shader.output.minify and "M" or "", shdc_ok and shdc.version() or "none", texture_cache.params({}))
+
+---@class cook.Record
+---@field mtime integer
+---@field hash string
+---@field outputs string[] cache files cooked from the input, relative to out_dir
+
+-- Database format: the header and settings lines, then per input a
+-- "mtime hash path" line followed by one tab-indented line per output
+---@return table<string, cook.Record>
+local function read_db()
+    local db = {}
+    local data = fs.read(out_dir .. "/" .. DB_FILE)
+    local head = DB_HEADER .. "\n" .. settings .. "\n"
+    if not data or data:sub(1, #head) ~= head then
+        return db
+    end
+    local record = nil ---@type cook.Record?
+    for line in data:sub(#head + 1):gmatch("([^\n]*)\n") do
+        if line:sub(1, 1) == "\t" then
+            if record then
+                record.outputs[#record.outputs + 1] = line:sub(2)
+            end
+        else
+            local mtime, h, rel = line:match("^(%d+) (%x+) (.+)$")
+            record = rel and { mtime = tonumber(mtime) --[[@as integer]], hash = h, outputs = {} }
+            if rel then
+                db[rel] = record
+            end
+        end
+    end
+    return db
+end
+
+---@param db table<string, cook.Record>
+local function write_db(db)
+    local rels = {}
+    for rel in pairs(db) do
+        rels[#rels + 1] = rel
+    end
+    table.sort(rels)
+    local lines = { DB_HEADER, settings }
+    for _, rel in ipairs(rels) do
+        lines[#lines + 1] = string.format("%d %s %s", db[rel].mtime, db[rel].hash, rel)
+        for _, output in ipairs(db[rel].outputs) do
+            lines[#lines + 1] = "\t" .. output
+        end
+    end
+    fs.write_atomic(out_dir .. "/" .. DB_FILE, table.concat(lines, "\n") .. "\n")
+end
+
+-- Files below root as paths relative to it (directories are what fs.dir opens)
+---@param root string
+---@param prefix string?
+---@param list string[]
+local function walk(root, prefix, list)
+    local path = prefix and root .. "/" .. prefix or root
+    local iter = fs.dir(path)
+    if not iter then
+        return
+    end
+    local names = {}
+    for name in iter do
+        if name:sub(1, 1) ~= "." then
+            names[#names + 1] = name
+        end
+    end
+    table.sort(names)
+    for _, name in ipairs(names) do
+        local rel = prefix and prefix .. "/" .. name or name
+        local full = root .. "/" .. rel
+        if not skip_dirs[full] then
+            if fs.dir(full) then
+                walk(root, rel, list)
+            else
+                list[#list + 1] = rel
+            end
+        end
+    end
+end
+
+---@param path string
+---@param data string
+---@return boolean
+local function write_file(path, data)
+    local parent = path:match("^(.*)/[^/]*$")
+    if parent then
+        fs.mkdir(parent)
+    end
+    return fs.write(path, data)
+end
+
+-- Record a cache file cooked from an input
+---@param record cook.Record
+---@param path string
+local function add_output(record, path)
+    local prefix = out_dir .. "/"
+    record.outputs[#record.outputs + 1] = path:sub(1, #prefix) == prefix and path:sub(#prefix + 1) or path
+end
+
+local shader_prefix = shader.cache.dir:sub(#out_dir + 2) .. "/"
+
+-- Whether shader cache files were cooked from an input
+---@param record cook.Record
+---@return boolean
+local function has_shaders(record)
+    for _, path in ipairs(record.outputs) do
+        if path:sub(1, #shader_prefix) == shader_prefix then
+            return true
+        end
+    end
+    return false
+end
+
+-- Whether the shader cache has every file the runtime will look up for the
+-- shaders of an input. Their keys cover the @included files, so this catches
+-- include edits the input's own mtime and hash miss.
+---@param rel string
+---@param data string
+---@return boolean
+local function shaders_current(rel, data)
+    local sources = rel:lower():match("%.glsl$") and { data } or shader.embedded_sources(data)
+    for _, source in ipairs(sources) do
+        for _, path in ipairs(shader.cache_paths(source, langs)) do
+            if not fs.exists(path) then
+                return false
+            end
+        end
+    end
+    return true
+end
+
+-- Whether every cache file cooked from an input is still there (the texture
+-- cache evicts least recently used entries)
+---@param record cook.Record
+---@return boolean
+local function outputs_exist(record)
+    for _, path in ipairs(record.outputs) do
+        if not fs.exists(out_dir .. "/" .. path) then
+            return false
+        end
+    end
+    return true
+end
+
+local stats = { lua = 0, programs = 0, textures = 0, copied = 0, skipped = 0, failed = 0 }
+
+---@param rel string
+---@param err string
+local function fail(rel, err)
+    print("error: " .. rel .. ": " .. err)
+    stats.failed = stats.failed + 1
+end
+
+-- Shader batches in flight: { rel, batch }
+local shader_batches = {}
+
+-- Queue every program of source for every language (finished after the walk)
+---@param record cook.Record
+---@return boolean
+local function cook_shaders(rel, source, record)
+    local batch = shader.precompile_async(source, langs)
+    if batch.err then
+        fail(rel, batch.err)
+        return false
+    end
+    for _, path in ipairs(batch.paths) do
+        add_output(record, path)
+    end
+    shader_batches[#shader_batches + 1] = { rel = rel, batch = batch }
+    return true
+end
+
+---@param record cook.Record
+---@return boolean
+local function cook_lua(rel, data, record)
+    local fn, err = load(data, "@" .. rel, "t")
+    if not fn then
+        fail(rel, tostring(err))
+        return false
+    end
+    if not write_file(out_dir .. "/" .. rel, string.dump(fn, strip)) then
+        fail(rel, "cannot write output")
+        return false
+    end
+    stats.lua = stats.lua + 1
+    local ok = true
+    for _, source in ipairs((shader.embedded_sources(data))) do
+        ok = cook_shaders(rel, source, record) and ok
+    end
+    return ok
+end
+
+-- Texture requests in flight: id -> { rel, record }
+local loader = nil ---@type lub3d.texloader.Loader?
+local pending = {}
+
+---@return boolean? ok nil while the texture is encoding
+local function cook_image(rel, data, record)
+    if not write_file(out_dir .. "/" .. rel, data) then
+        fail(rel, "cannot write output")
+        return false
+    end
+    stats.copied = stats.copied + 1
+    if not bc7enc_ok then
+        return true
+    end
+    local stem = rel:lower():match("([^/]+)%.[^./]+$") or ""
+    local normal = stem:find("[_%-]n$") or stem:find("[_%-]nrm$") or stem:find("[_%-]norm$")
+        or stem:find("[_%-]normal$")
+    local format = texture.select_format({ usage = normal and "normal" or "color", srgb = srgb and not normal })
+    if not loader then
+        texture_cache.prepare()
+        loader = texloader.new({ threads = threads or math.min(bc7enc.max_threads(), 16) })
+    end
+    local id = loader:request(dir .. "/" .. rel, {
+        srgb = srgb and not normal,
+        format = format,
+        cache_dir = texture_cache.config.dir,
+        cache_params = texture_cache.params({ format = format, srgb = srgb and not normal }),
+        upload = false,
+    })
+    pending[id] = { rel = rel, record = record }
+    return nil
+end
+
+stm.setup()
+local t0 = stm.now()
+
+if #langs > 0 and not shdc_ok then
+    print("note: shdc not available, shaders are not precompiled")
+    langs = {}
+elseif shdc_ok then
+    shdc.set_threads(threads)
+end
+if not bc7enc_ok then
+    print("note: bc7enc not available, textures are copied without encoding")
+end
+
+local files = {}
+walk(dir, nil, files)
+if #files == 0 then
+    print("error: no files in " .. dir)
+    os.exit(1)
+end
+fs.mkdir(out_dir)
+
+local db = force and {} or read_db()
+local new_db = {}
+
+for _, rel in ipairs(files) do
+    local src = dir .. "/" .. rel
+    local mtime = fs.mtime(src) or 0
+    local prev = db[rel]
+    local exists = fs.exists(out_dir .. "/" .. rel) and (not prev or outputs_exist(prev))
+    if prev and prev.mtime == mtime and exists and not has_shaders(prev) then
+        new_db[rel] = prev
+        stats.skipped = stats.skipped + 1
+    else
+        local data = fs.read(src)
+        if not data then
+            fail(rel, "cannot read")
+        else
+            local record = { mtime = mtime, hash = string.format("%016x", hash.xxh64(data)), outputs = {} }
+            local ext = (rel:match("%.([^./]+)$") or ""):lower()
+            local ok
+            local current = prev and prev.hash == record.hash and exists
+                and (not has_shaders(prev) or shaders_current(rel, data))
+            if current then
+                ok = true -- touched but unchanged
+                record.outputs = prev.outputs
+                stats.skipped = stats.skipped + 1
+            elseif ext == "lua" then
+                ok = cook_lua(rel, data, record)
+            elseif ext == "glsl" then
+                ok = write_file(out_dir .. "/" .. rel, data)
+                if ok then
+                    stats.copied = stats.copied + 1
+                    ok = cook_shaders(rel, data, record)
+                else
+                    fail(rel, "cannot write output")
+                end
+            elseif IMAGE_EXTS[ext] then
+                ok = cook_image(rel, data, record)
+            else
+                ok = write_file(out_dir .. "/" .. rel, data)
+                if ok then
+                    stats.copied = stats.copied + 1
+                else
+                    fail(rel, "cannot write output")
+                end
+            end
+            if ok then
+                new_db[rel] = record
+            end
+        end
+    end
+end
+
+-- Collect the shaders compiled meanwhile
+for _, entry in ipairs(shader_batches) do
+    local ok, err, compiled = shader.precompile_wait(entry.batch)
+    if ok then
+        stats.programs = stats.programs + compiled
+    else
+        fail(entry.rel, tostring(err))
+        new_db[entry.rel] = nil
+    end
+end
+
+-- Collect the textures the workers encoded meanwhile
+if loader then
+    loader:wait()
+    for _, r in ipairs(loader:update(0)) do
+        local job = pending[r.id]
+        if r.error then
+            fail(job.rel, r.error)
+        else
+            if r.cache_key then
+                add_output(job.record, texture_cache.path(r.cache_key))
+                if r.cache_bytes then
+                    texture_cache.record(r.cache_key, r.cache_bytes)
+                    stats.textures = stats.textures + 1
+                else
+                    texture_cache.touch(r.cache_key)
+                end
+            end
+            new_db[job.rel] = job.record
+        end
+    end
+    loader:destroy()
+    texture_cache.save()
+end
+
+write_db(new_db)
+print(string.format("%s -> %s: %d lua, %d shader programs, %d textures encoded, %d copied, %d unchanged, "
+    .. "%d failed (%.2f s)", dir, out_dir, stats.lua, stats.programs, stats.textures, stats.copied,
+    stats.skipped, stats.failed, stm.sec(stm.since(t0))))
+
+if stats.failed > 0 then
+    os.exit(1)
+end
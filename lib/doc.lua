@@ -21,15 +21,20 @@ local modules = {
     { name = "stb.image",       desc = "Image loading" },
     { name = "lub3d.fs",        desc = "File system abstraction" },
     { name = "lub3d.licenses",  desc = "Third-party license info" },
+    { name = "lub3d.image",     desc = "Image decoding, mipmaps, KTX2/DDS textures" },
+    { name = "lub3d.texloader", desc = "Background texture loading" },
+    { name = "lub3d.hash",      desc = "XXH64 content hashing" },
     { name = "imgui",           desc = "Dear ImGui API (optional)" },
     { name = "shdc",            desc = "Runtime shader compiler (optional)" },
-    { name = "bc7enc",          desc = "BC7 texture encoder (optional)" },
+    { name = "bc7enc",          desc = "BC1/BC4/BC5/BC7 texture encoder (optional)" },
     { name = "lib.glm",        desc = "vec2/vec3/vec4/mat4 math" },
     { name = "lib.gpu",        desc = "GC-safe GPU resource wrappers" },
     { name = "lib.util",       desc = "Shader compilation, texture loading helpers" },
     { name = "lib.audio",      desc = "Shared miniaudio engine creation" },
     { name = "lib.shader",     desc = "Shader utilities" },
     { name = "lib.texture",    desc = "Texture utilities" },
+    { name = "lib.texture_manager", desc = "Async texture loading and streaming" },
+    { name = "lib.texture_cache",   desc = "Content-hash texture cache" },
     { name = "lib.hotreload",  desc = "File-watching hot reload" },
     { name = "lib.notify",     desc = "Notification utilities" },
     { name = "lib.log",        desc = "Logging utilities" },
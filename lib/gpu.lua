@@ -4,6 +4,7 @@ local gfx = require("sokol.gfx")
 local slog = require("sokol.log")
 local log = require("lib.log")
 local shader = require("lib.shader")
+local pipeline_cache = require("lub3d.pipeline_cache")
 
 ---@class gpu
 local M = {}
@@ -70,6 +71,13 @@ function M.image(desc)
     return wrap(gfx.make_image(desc), gfx.destroy_image) --[[@as gpu.Image]]
 end
 
+---Wrap an image created outside of lib.gpu (e.g. by lub3d.image.make_image)
+---@param handle sokol.gfx.Image
+---@return gpu.Image
+function M.wrap_image(handle)
+    return wrap(handle, gfx.destroy_image) --[[@as gpu.Image]]
+end
+
 ---Create a view resource
 ---@param desc sokol.gfx.ViewDesc
 ---@return gpu.View
@@ -94,10 +102,11 @@ end
 ---Compile and create a shader resource
 ---@param source string Shader source code
 ---@param name string Program name
----@param desc table Shader descriptor
+---@param desc? table Shader descriptor (nil: built from the program's reflection)
+---@param opts? shader.Options Permutation defines
 ---@return gpu.Shader?
-function M.shader(source, name, desc)
-    local handle = shader.compile_full(source, name, desc)
+function M.shader(source, name, desc, opts)
+    local handle = shader.compile_full(source, name, desc, opts)
     if not handle then
         log.error("Failed to compile shader: " .. name)
         return nil
@@ -105,11 +114,108 @@ function M.shader(source, name, desc)
     return wrap(handle, gfx.destroy_shader) --[[@as gpu.Shader]]
 end
 
----Create a pipeline resource
+---Compile a shader resource in the background (see shader.compile_async).
+---on_ready(shader) runs on a later frame with the wrapped shader, or nil on failure.
+---@param source string Shader source code
+---@param name string Program name
+---@param desc? table Shader descriptor (nil: built from the program's reflection)
+---@param on_ready fun(shader: gpu.Shader?)
+---@param opts? shader.Options Permutation defines
+---@return shader.Pending
+function M.shader_async(source, name, desc, on_ready, opts)
+    return shader.compile_async(source, name, desc, function(handle)
+        if not handle then
+            log.error("Failed to compile shader: " .. name)
+            on_ready(nil)
+            return
+        end
+        on_ready(wrap(handle, gfx.destroy_shader) --[[@as gpu.Shader]])
+    end, opts)
+end
+
+---Create a pipeline resource. Pipelines come from lub3d.pipeline_cache:
+---equal descriptors share one ref-counted pipeline, also across hot reloads.
 ---@param desc sokol.gfx.PipelineDesc
 ---@return gpu.Pipeline
 function M.pipeline(desc)
-    return wrap(gfx.make_pipeline(desc), gfx.destroy_pipeline) --[[@as gpu.Pipeline]]
+    return wrap(pipeline_cache.get(desc), pipeline_cache.release) --[[@as gpu.Pipeline]]
+end
+
+---@class gpu.StreamBuffer
+---@field chunks gpu.Buffer[] backing buffers, reused every frame
+---@field chunk_size integer minimum size of each backing buffer
+---@field usage table sokol.gfx.BufferUsage fields
+---@field label string?
+local StreamBuffer = {}
+StreamBuffer.__index = StreamBuffer
+
+local DEFAULT_STREAM_SIZE <const> = 4 * 1024 * 1024
+
+---Create a ring-allocated streaming buffer for per-frame geometry
+---Data is written with sg_append_buffer, so any number of appends can share
+---a buffer within one frame; each returns the byte offset to bind with.
+---The append cursor rewinds at the start of every frame, and sokol rotates
+---the buffer's in-flight copies, so last frame's data is never overwritten
+---while the GPU may still read it. When a frame needs more room than the
+---existing buffers have, another buffer is added and kept for later frames.
+---@param opts? { size?: integer, index_buffer?: boolean, storage_buffer?: boolean, label?: string }
+---@return gpu.StreamBuffer
+function M.stream_buffer(opts)
+    opts = opts or {}
+    local usage = { stream_update = true }
+    if opts.index_buffer then
+        usage.index_buffer = true
+    elseif opts.storage_buffer then
+        usage.storage_buffer = true
+    else
+        usage.vertex_buffer = true
+    end
+    return setmetatable({
+        chunks = {},
+        chunk_size = opts.size or DEFAULT_STREAM_SIZE,
+        usage = usage,
+        label = opts.label,
+    }, StreamBuffer)
+end
+
+---Get a backing buffer with room for size more bytes this frame
+---Use it to append from native code (e.g. sprite batches) yourself.
+---@param size integer
+---@return gpu.Buffer
+function StreamBuffer:acquire(size)
+    for _, chunk in ipairs(self.chunks) do
+        if not gfx.query_buffer_will_overflow(chunk.handle, size) then
+            return chunk
+        end
+    end
+    local chunk = M.buffer(gfx.BufferDesc({
+        usage = self.usage,
+        size = math.max(self.chunk_size, size),
+        label = self.label,
+    }))
+    self.chunks[#self.chunks + 1] = chunk
+    if #self.chunks > 1 then
+        log.info(string.format("gpu: stream buffer %s grew to %d chunks",
+            self.label or "?", #self.chunks))
+    end
+    return chunk
+end
+
+---Append data for this frame
+---@param data string
+---@return any buffer raw sokol.gfx.Buffer handle to bind
+---@return integer offset byte offset for vertex_buffer_offsets / index_buffer_offset
+function StreamBuffer:append(data)
+    local chunk = self:acquire(#data)
+    return chunk.handle, gfx.append_buffer(chunk.handle, gfx.Range(data))
+end
+
+---Destroy all backing buffers
+function StreamBuffer:destroy()
+    for _, chunk in ipairs(self.chunks) do
+        chunk:destroy()
+    end
+    self.chunks = {}
 end
 
 return M
@@ -1,6 +1,12 @@
 -- hotreload.lua
 -- Hot reload module using rxi/lume hotswap
 -- Tracks require'd files and reloads them when modified
+--
+-- Edits confined to a module's embedded shaders (long strings with an
+-- @program) skip the module reload: the shaders built from the old strings
+-- are recompiled and swapped in place (see shader.reload_source), keeping the
+-- module's state. Other files, such as *.glsl sources, can be watched with
+-- watch_file.
 
 ---@class hotreload
 local M = {}
@@ -15,6 +21,8 @@ M.enabled = true
 -- Internal state
 local watched = {}     -- { [filepath] = mtime }
 local mod_to_path = {} -- { [modname] = filepath }
+local file_hooks = {}  -- { [filepath] = on_change } for watch_file
+local texts = {}       -- { [filepath] = source } of modules with embedded shaders
 local last_check = 0
 
 -- Resolve module name to file path
@@ -36,10 +44,25 @@ function M.watch(modname)
     local filepath = mod_to_path[modname] or resolve_path(modname)
     if filepath then
         mod_to_path[modname] = filepath
-        watched[filepath] = fs.mtime(filepath)
+        if not watched[filepath] then
+            watched[filepath] = fs.mtime(filepath)
+            local text = fs.read(filepath)
+            if text and text:find("@program", 1, true) then
+                texts[filepath] = text
+            end
+        end
     end
 end
 
+-- Watch a non-module file: on_change(text) is called with its new contents
+-- whenever it is modified
+---@param filepath string
+---@param on_change fun(text: string)
+function M.watch_file(filepath, on_change)
+    watched[filepath] = fs.mtime(filepath)
+    file_hooks[filepath] = on_change
+end
+
 -- Hook require to auto-watch modules
 local original_require = require
 function require(modname)
@@ -57,6 +80,53 @@ pcall(function()
     notify = require("lib.notify")
 end)
 
+-- Report a shader swapped in place by shader.reload_source
+local function shader_done(ok, program_name)
+    if ok then
+        print(string.format("[hotreload] Shader reloaded: %s", program_name))
+        if notify then
+            notify.ok("[reload] " .. program_name .. " OK")
+        end
+    else
+        print(string.format("[hotreload] Shader error, keeping last version: %s", program_name))
+        if notify then
+            notify.error("[reload] " .. program_name .. " ERROR")
+        end
+    end
+end
+
+-- Reload only the shaders of a module whose other code is unchanged.
+-- Returns false when the module itself has to be reloaded.
+---@param old_text string
+---@param new_text string
+---@return boolean
+local function reload_shaders(old_text, new_text)
+    local shader = package.loaded["lib.shader"]
+    if not shader then
+        return false
+    end
+    local old_list, old_rest = shader.embedded_sources(old_text)
+    local new_list, new_rest = shader.embedded_sources(new_text)
+    if old_rest ~= new_rest or #old_list ~= #new_list then
+        return false
+    end
+    -- All or nothing: a changed string without a live shader needs the
+    -- module reload, which rebuilds every shader anyway
+    local changed = {}
+    for i, source in ipairs(new_list) do
+        if source ~= old_list[i] then
+            if not shader.has_live(old_list[i]) then
+                return false
+            end
+            changed[#changed + 1] = i
+        end
+    end
+    for _, i in ipairs(changed) do
+        shader.reload_source(old_list[i], new_list[i], shader_done)
+    end
+    return true
+end
+
 -- Check for changes and reload
 function M.update()
     if not M.enabled then
@@ -72,42 +142,59 @@ function M.update()
     for filepath, old_mtime in pairs(watched) do
         local new_mtime = fs.mtime(filepath)
         if new_mtime and new_mtime ~= old_mtime then
-            -- Find module name for this file
-            for modname, path in pairs(mod_to_path) do
-                if path == filepath then
-                    -- Get short name for display
-                    local short = modname:match("[^.]+$") or modname
-
-                    local mod, err = lume.hotswap(modname)
-                    if err then
+            local hook = file_hooks[filepath]
+            local old_text = texts[filepath]
+            local new_text = (hook or old_text) and fs.read(filepath)
+            if hook then
+                if new_text then
+                    local ok, err = pcall(hook, new_text)
+                    if not ok then
                         print(string.format("[hotreload] Error: %s", err))
-                        if notify then
-                            notify.error("[reload] " .. short .. " ERROR")
-                        end
-                    else
-                        -- Call reload hook if module defines one
-                        local hook_ok = true
-                        if mod and type(mod.on_reload) == "function" then
-                            local ok, hook_err = pcall(mod.on_reload, mod)
-                            if not ok then
-                                print(string.format("[hotreload] on_reload error: %s", hook_err))
-                                hook_ok = false
-                            end
-                        end
-                        if hook_ok then
-                            print(string.format("[hotreload] Reloaded: %s", modname))
+                    end
+                end
+            elseif new_text and reload_shaders(old_text, new_text) then
+                print(string.format("[hotreload] Reloading shaders: %s", filepath))
+            else
+                -- Find module name for this file
+                for modname, path in pairs(mod_to_path) do
+                    if path == filepath then
+                        -- Get short name for display
+                        local short = modname:match("[^.]+$") or modname
+
+                        local mod, err = lume.hotswap(modname)
+                        if err then
+                            print(string.format("[hotreload] Error: %s", err))
                             if notify then
-                                notify.ok("[reload] " .. short .. " OK")
+                                notify.error("[reload] " .. short .. " ERROR")
                             end
                         else
-                            if notify then
-                                notify.warn("[reload] " .. short .. " hook failed")
+                            -- Call reload hook if module defines one
+                            local hook_ok = true
+                            if mod and type(mod.on_reload) == "function" then
+                                local ok, hook_err = pcall(mod.on_reload, mod)
+                                if not ok then
+                                    print(string.format("[hotreload] on_reload error: %s", hook_err))
+                                    hook_ok = false
+                                end
+                            end
+                            if hook_ok then
+                                print(string.format("[hotreload] Reloaded: %s", modname))
+                                if notify then
+                                    notify.ok("[reload] " .. short .. " OK")
+                                end
+                            else
+                                if notify then
+                                    notify.warn("[reload] " .. short .. " hook failed")
+                                end
                             end
                         end
+                        break
                     end
-                    break
                 end
             end
+            if old_text and new_text then
+                texts[filepath] = new_text
+            end
             watched[filepath] = new_mtime
         end
     end
@@ -126,6 +213,8 @@ end
 function M.clear()
     watched = {}
     mod_to_path = {}
+    file_hooks = {}
+    texts = {}
 end
 
 return M
@@ -0,0 +1,318 @@
+-- lib/particles.lua
+-- Particle systems on top of the native lub3d.particles pool
+-- Simulation runs in C (structure-of-arrays, no per-particle Lua objects);
+-- live particles are streamed once per draw as 20-byte instances and
+-- expanded from a small static mesh in the vertex shader.
+local gfx = require("sokol.gfx")
+local gpu = require("lib.gpu")
+local shader_mod = require("lib.shader")
+local util = require("lib.util")
+local log = require("lib.log")
+local particles_core = require("lub3d.particles")
+
+---@class particles
+local M = {}
+
+local DEFAULT_MAX_PARTICLES <const> = 10000
+
+local shader_source = [[
+@vs vs
+in vec4 corner;    // xyz = offset along the axes, w = 1: round soft billboard
+in vec4 pos_size;  // xyz = world position, w = size
+in vec4 color;
+
+out vec4 v_color;
+out vec3 v_corner; // xy = quad position, z = round flag
+
+layout(binding=0) uniform vs_params {
+    mat4 view_proj;
+    vec4 axis_x;   // corner.x direction (camera right for billboards)
+    vec4 axis_y;   // corner.y direction (camera up for billboards)
+    vec4 axis_z;
+};
+
+void main() {
+    vec3 offset = axis_x.xyz * corner.x + axis_y.xyz * corner.y + axis_z.xyz * corner.z;
+    gl_Position = view_proj * vec4(pos_size.xyz + offset * pos_size.w, 1.0);
+    v_color = color;
+    v_corner = vec3(corner.xy, corner.w);
+}
+@end
+
+@fs fs
+in vec4 v_color;
+in vec3 v_corner;
+
+out vec4 frag_color;
+
+void main() {
+    float a = 1.0;
+    if (v_corner.z > 0.5) {
+        a = 1.0 - smoothstep(0.5, 1.0, length(v_corner.xy));
+    }
+    frag_color = v_color * a;
+}
+@end
+
+@program particles vs fs
+]]
+
+---@alias particles.Shape "quad"|"cross"
+---@alias particles.Blend "add"|"alpha"|"none"
+
+---@class particles.Emitter
+---@field pos? vec3|number[] spawn center
+---@field pos_range? vec3|number[] spawn box half extents
+---@field yaw? number horizontal direction (radians)
+---@field yaw_range? number
+---@field pitch? number elevation (radians)
+---@field pitch_range? number
+---@field speed? number
+---@field speed_range? number
+---@field acc? vec3|number[] acceleration
+---@field acc_range? vec3|number[]
+---@field life? number lifetime in seconds
+---@field life_range? number
+---@field size? number
+---@field size_range? number
+---@field color? number[] {r, g, b, a}
+
+---@class particles.System
+---@field pool lub3d.particles.Pool
+---@field shape particles.Shape
+---@field pipeline gpu.Pipeline
+---@field mesh gpu.Buffer static per-vertex corner mesh
+---@field mesh_vertices integer
+---@field stream gpu.StreamBuffer
+
+-- Static corner meshes (x, y, z, round): billboard quad (triangle strip)
+-- and 3-axis cross (lines)
+local MESHES <const> = {
+    quad = {
+        primitive_type = gfx.PrimitiveType.TRIANGLE_STRIP,
+        vertices = { -1, -1, 0, 1, 1, -1, 0, 1, -1, 1, 0, 1, 1, 1, 0, 1 },
+    },
+    cross = {
+        primitive_type = gfx.PrimitiveType.LINES,
+        vertices = {
+            -1, 0, 0, 0, 1, 0, 0, 0,
+            0, -1, 0, 0, 0, 1, 0, 0,
+            0, 0, -1, 0, 0, 0, 1, 0,
+        },
+    },
+}
+
+local BLEND_STATES <const> = {
+    add = {
+        enabled = true,
+        src_factor_rgb = gfx.BlendFactor.ONE,
+        dst_factor_rgb = gfx.BlendFactor.ONE,
+        src_factor_alpha = gfx.BlendFactor.ONE,
+        dst_factor_alpha = gfx.BlendFactor.ONE,
+    },
+    -- Instance colors are faded (premultiplied) by remaining life
+    alpha = {
+        enabled = true,
+        src_factor_rgb = gfx.BlendFactor.ONE,
+        dst_factor_rgb = gfx.BlendFactor.ONE_MINUS_SRC_ALPHA,
+        src_factor_alpha = gfx.BlendFactor.ONE,
+        dst_factor_alpha = gfx.BlendFactor.ONE_MINUS_SRC_ALPHA,
+    },
+    none = { enabled = false },
+}
+
+-- Shared resources (lazily created)
+local shared_shader = nil
+---@type gpu.StreamBuffer? default stream for systems created without opts.stream
+local shared_stream = nil
+
+local function ensure_shader()
+    if shared_shader then
+        return shared_shader
+    end
+    shared_shader = shader_mod.compile_full(shader_source, "particles", {
+        uniform_blocks = {
+            {
+                stage = gfx.ShaderStage.VERTEX,
+                size = 112,
+                glsl_uniforms = {
+                    { type = gfx.UniformType.MAT4, glsl_name = "view_proj" },
+                    { type = gfx.UniformType.FLOAT4, glsl_name = "axis_x" },
+                    { type = gfx.UniformType.FLOAT4, glsl_name = "axis_y" },
+                    { type = gfx.UniformType.FLOAT4, glsl_name = "axis_z" },
+                },
+            },
+        },
+        attrs = {
+            { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 0 },
+            { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 1 },
+            { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 2 },
+        },
+    })
+    if not shared_shader then
+        log.error("particles: failed to compile shader")
+    end
+    return shared_shader
+end
+
+--- Create a particle system
+---@param opts? { max_particles?: integer, shape?: particles.Shape, blend?: particles.Blend, depth_write?: boolean, stream?: gpu.StreamBuffer, seed?: integer }
+---@return particles.System?
+function M.new_system(opts)
+    opts = opts or {}
+    local shape = opts.shape or "quad"
+    local mesh_def = MESHES[shape]
+    local blend = BLEND_STATES[opts.blend or "add"]
+    assert(mesh_def, "particles: unknown shape " .. tostring(shape))
+    assert(blend, "particles: unknown blend " .. tostring(opts.blend))
+
+    local shd = ensure_shader()
+    if not shd then
+        return nil
+    end
+
+    -- Buffer 0: corner mesh (per vertex), buffer 1: particles (per instance)
+    local pipeline = gpu.pipeline(gfx.PipelineDesc({
+        shader = shd,
+        layout = {
+            buffers = {
+                {},
+                { step_func = gfx.VertexStep.PER_INSTANCE },
+            },
+            attrs = {
+                { format = gfx.VertexFormat.FLOAT4, buffer_index = 0 },  -- corner
+                { format = gfx.VertexFormat.FLOAT4, buffer_index = 1 },  -- pos_size
+                { format = gfx.VertexFormat.UBYTE4N, buffer_index = 1 }, -- color
+            },
+        },
+        primitive_type = mesh_def.primitive_type,
+        colors = { { blend = blend } },
+        depth = {
+            compare = gfx.CompareFunc.LESS_EQUAL,
+            write_enabled = opts.depth_write or false,
+        },
+    }))
+    if gfx.query_pipeline_state(pipeline.handle) ~= gfx.ResourceState.VALID then
+        log.error("particles: failed to create pipeline")
+        return nil
+    end
+
+    local stream = opts.stream
+    if not stream then
+        shared_stream = shared_stream or gpu.stream_buffer({ label = "particles" })
+        stream = shared_stream
+    end
+
+    ---@type particles.System
+    local sys = {
+        pool = particles_core.new_pool(opts.max_particles or DEFAULT_MAX_PARTICLES, opts.seed),
+        shape = shape,
+        pipeline = pipeline,
+        mesh = gpu.buffer(gfx.BufferDesc({
+            usage = { vertex_buffer = true },
+            data = gfx.Range(util.pack_floats(mesh_def.vertices)),
+        })),
+        mesh_vertices = #mesh_def.vertices // 4,
+        stream = stream,
+    }
+    return sys
+end
+
+--- Spawn up to count particles
+---@param sys particles.System
+---@param count integer
+---@param emitter particles.Emitter
+---@return integer emitted (less than count when the pool is full)
+function M.emit(sys, count, emitter)
+    return sys.pool:emit(count, emitter)
+end
+
+--- Advance the simulation and retire expired particles
+---@param sys particles.System
+---@param dt number seconds
+function M.update(sys, dt)
+    sys.pool:update(dt)
+end
+
+--- Draw all live particles (call inside a pass)
+--- view is used to orient billboards towards the camera; cross particles
+--- are aligned to the world axes.
+---@param sys particles.System
+---@param proj mat4
+---@param view mat4
+function M.draw(sys, proj, view)
+    local pool = sys.pool
+    local n = pool:count()
+    if n == 0 then
+        return
+    end
+    local vbuf = sys.stream:acquire(n * particles_core.INSTANCE_BYTES).handle
+    local offset = pool:append(vbuf)
+
+    local ax, ay, az
+    if sys.shape == "quad" then
+        -- Camera right/up are the first two rows of the view matrix
+        ax = { view[1], view[5], view[9], 0 }
+        ay = { view[2], view[6], view[10], 0 }
+        az = { 0, 0, 0, 0 }
+    else
+        ax, ay, az = { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }
+    end
+    local vs_params = (proj * view):pack() .. util.pack_floats({
+        ax[1], ax[2], ax[3], ax[4],
+        ay[1], ay[2], ay[3], ay[4],
+        az[1], az[2], az[3], az[4],
+    })
+
+    gfx.apply_pipeline(sys.pipeline.handle)
+    gfx.apply_bindings(gfx.Bindings({
+        vertex_buffers = { sys.mesh.handle, vbuf },
+        vertex_buffer_offsets = { 0, offset },
+    }))
+    gfx.apply_uniforms(0, gfx.Range(vs_params))
+    gfx.draw(0, sys.mesh_vertices, n)
+end
+
+---@param sys particles.System
+---@return integer
+function M.count(sys)
+    return sys.pool:count()
+end
+
+--- Remove all particles
+---@param sys particles.System
+function M.clear(sys)
+    sys.pool:clear()
+end
+
+--- Destroy a system's resources (call before gfx.shutdown)
+---@param sys particles.System
+function M.destroy(sys)
+    if sys.pool then
+        sys.pool:destroy()
+        sys.pool = nil
+    end
+    if sys.pipeline then
+        sys.pipeline:destroy()
+        sys.pipeline = nil
+    end
+    if sys.mesh then
+        sys.mesh:destroy()
+        sys.mesh = nil
+    end
+    sys.stream = nil
+end
+
+--- Shutdown shared resources (call before gfx.shutdown)
+function M.shutdown()
+    if shared_stream then
+        shared_stream:destroy()
+        shared_stream = nil
+    end
+    if shared_shader then
+        gfx.destroy_shader(shared_shader)
+        shared_shader = nil
+    end
+end
+
+return M
@@ -9,52 +9,73 @@ pcall(function() notify = require("lib.notify") end)
 ---@class render_pass
 local M = {}
 
+---Destroy a pass's shader/pipeline pair
+---@param resources {shader: gpu.Shader, pipeline: gpu.Pipeline}?
+local function destroy_resources(resources)
+    if resources then
+        resources.pipeline:destroy()
+        resources.shader:destroy()
+    end
+end
+
 ---Setup common resource management on a pass module
 ---@param pass table The pass module table
----@param opts {shader_name: string, pipeline_desc: fun(shader_handle: any): sokol.gfx.PipelineDesc}
+---@param opts {shader_name: string, pipeline_desc: fun(shader_handle: any): sokol.gfx.PipelineDesc, defines: shader.Defines?}
 function M.setup(pass, opts)
     -- Preserve across hotreload
     pass.resources = pass.resources
     pass._compile_attempted = pass._compile_attempted or false
 
-    ---Ensure shader/pipeline resources are initialized
-    ---@return boolean success
-    function pass.ensure_resources()
-        if pass.resources then return true end
-        if pass._compile_attempted then return false end
+    ---Compile the pass shader in the background; the resources are swapped
+    ---in once it is ready, so the previous ones (if any) keep drawing until then
+    local function start_compile()
         pass._compile_attempted = true
+        local compile = {}
+        pass._compile = compile
+        gpu.shader_async(pass.shader_source, opts.shader_name, pass.shader_desc, function(shader)
+            if pass._compile ~= compile then
+                -- Superseded by a newer reload or destroyed meanwhile
+                if shader then shader:destroy() end
+                return
+            end
+            pass._compile = nil
+            if not shader then
+                if notify then notify.error("[shader] " .. pass.name .. " FAILED") end
+                return
+            end
 
-        local shader = gpu.shader(pass.shader_source, opts.shader_name, pass.shader_desc)
-        if not shader then
-            if notify then notify.error("[shader] " .. pass.name .. " FAILED") end
-            return false
-        end
+            local pip_desc = opts.pipeline_desc(shader.handle)
+            local pipeline = gpu.pipeline(pip_desc)
 
-        local pip_desc = opts.pipeline_desc(shader.handle)
-        local pipeline = gpu.pipeline(pip_desc)
+            destroy_resources(pass.resources)
+            pass.resources = { shader = shader, pipeline = pipeline }
+            if notify then notify.ok("[shader] " .. pass.name .. " OK") end
+        end, { defines = opts.defines })
+    end
 
-        pass.resources = { shader = shader, pipeline = pipeline }
-        if notify then notify.ok("[shader] " .. pass.name .. " OK") end
-        return true
+    ---Ensure shader/pipeline resources are initialized. The first call starts
+    ---the compile; false until it has finished (draw nothing or a fallback).
+    ---@return boolean success
+    function pass.ensure_resources()
+        if pass.resources then return true end
+        if not pass._compile_attempted then
+            start_compile()
+        end
+        return false
     end
 
-    ---Called by hotreload when this module is reloaded
+    ---Called by hotreload when this module is reloaded. Recompiles without
+    ---blocking the frame: the old shader and pipeline stay in use until the
+    ---new ones are ready, and are kept if the new shader fails to compile.
     function pass.on_reload()
-        if pass.resources then
-            pass.resources.pipeline:destroy()
-            pass.resources.shader:destroy()
-            pass.resources = nil
-        end
-        pass._compile_attempted = false
+        start_compile()
     end
 
     ---Destroy pass resources
     function pass.destroy()
-        if pass.resources then
-            pass.resources.pipeline:destroy()
-            pass.resources.shader:destroy()
-            pass.resources = nil
-        end
+        destroy_resources(pass.resources)
+        pass.resources = nil
+        pass._compile = nil
         pass._compile_attempted = false
     end
 end
@@ -1,7 +1,11 @@
 -- Shader compilation utilities for lub3d
 local gfx = require("sokol.gfx")
 local log = require("lib.log")
+local util = require("lib.util")
 local fs = require("lub3d.fs")
+local hash = require("lub3d.hash")
+local pipeline_cache = require("lub3d.pipeline_cache")
+local program_cache = require("lub3d.program_cache")
 
 -- Optional shdc module (requires LUB3D_BUILD_SHDC=ON)
 ---@type shdc?
@@ -14,126 +18,276 @@ end
 ---@class shader
 local M = {}
 
--- Simple string hash for cache keys (djb2 algorithm)
----@param str string
----@return integer
-local function hash_string(str)
-    local hash = 5381
-    for i = 1, #str do
-        hash = ((hash * 33) + string.byte(str, i)) & 0xFFFFFFFF
+-- Shader cache configuration
+M.cache = {
+    enabled = true,
+    dir = "assets/shader_cache",
+    version = 5, -- Bump to invalidate all caches
+    program_binaries = true, -- GL: also keep linked driver programs (lub3d.program_cache)
+}
+
+-- Cache directory the last fs.mkdir was made for, so it runs once per
+-- M.cache.dir setting rather than once per file written
+local made_dir = nil
+
+-- Create the cache directory if this is the first write into it
+local function ensure_cache_dir()
+    if made_dir ~= M.cache.dir and fs.mkdir(M.cache.dir) then
+        made_dir = M.cache.dir
     end
-    return hash
 end
 
--- Ensure directory exists (platform-independent)
----@param path string directory path
----@return boolean success
-local function ensure_dir(path)
-    local sep = package.config:sub(1, 1)
-    local cmd
-    if sep == "\\" then
-        cmd = 'mkdir "' .. path:gsub("/", "\\") .. '" 2>nul'
-    else
-        cmd = 'mkdir -p "' .. path .. '" 2>/dev/null'
+-- Compiler output options, applied to every compile and part of the cache
+-- key (a cooked cache only serves the settings it was cooked with):
+--   optimize  spirv-opt performance passes before cross-compiling
+--   minify    strip indentation and empty lines from the GLSL/MSL/WGSL
+--             handed to the driver (shorter driver compiles, smaller cache)
+---@type shdc.OutputOptions
+M.output = {
+    optimize = false,
+    minify = false,
+}
+
+---@alias shader.Defines table<string, string|number|boolean> preprocessor defines: NAME = value
+---  (true defines NAME as 1, false leaves it undefined)
+
+---@class shader.Options
+---@field defines? shader.Defines compile this permutation of the source
+
+-- Define set as shdc define strings ("NAME VALUE"), sorted so that equal
+-- sets give equal cache keys
+---@param defines? shader.Defines
+---@return string[]
+function M.define_list(defines)
+    local list = {}
+    for name, value in pairs(defines or {}) do
+        if value == true then
+            list[#list + 1] = name .. " 1"
+        elseif value ~= false then
+            list[#list + 1] = name .. " " .. tostring(value)
+        end
     end
-    os.execute(cmd)
-    return true
+    table.sort(list)
+    return list
 end
+local define_list = M.define_list
 
--- Shader cache configuration
-M.cache = {
-    enabled = true,
-    dir = "assets/shader_cache",
-    version = 1, -- Bump to invalidate all caches
-}
+-- Seed of every cache key: compiler build, cache format, output options,
+-- language and defines
+---@param lang string shader language
+---@param defines string[] define_list result
+---@return integer
+local function key_seed(lang, defines)
+    local compiler = shdc and shdc.version() or "none"
+    local output = (M.output.optimize and "O" or "") .. (M.output.minify and "M" or "")
+    return hash.xxh64(compiler .. "\0" .. M.cache.version .. "\0" .. output .. "\0" .. lang .. "\0"
+        .. table.concat(defines, "\n"))
+end
 
--- Get shader cache file path
+-- Get shader cache file path. One file per source, language and define set
+-- holds every program of the source, since shdc compiles them together. The
+-- key is an XXH64 over the compiler version, cache version, output options,
+-- language, defines, source and the contents of every file the source
+-- @includes.
 ---@param source string shader source
----@param program_name string program name
 ---@param lang string shader language
+---@param defines string[] define_list result
 ---@return string path
-local function get_cache_path(source, program_name, lang)
-    local hash = hash_string(source)
-    local filename = string.format("%s_%s_%08x.cache", program_name, lang, hash)
-    return M.cache.dir .. "/" .. filename
+local function get_cache_path(source, lang, defines)
+    local key = hash.xxh64(source, key_seed(lang, defines))
+    for path in source:gmatch("@include%s+(%S+)") do
+        key = hash.xxh64(fs.read(path) or path, key)
+    end
+    return string.format("%s/%s_%016x.cache", M.cache.dir, lang, key)
 end
 
--- Save compiled shader to cache
+-- Save compiled programs to cache
 ---@param cache_path string cache file path
----@param result table compile result from shdc
+---@param programs table<string, shdc.CompileResult> compile results by program name
 ---@return boolean success
-local function save_cache(cache_path, result)
-    ensure_dir(M.cache.dir)
+local function save_cache(cache_path, programs)
+    ensure_cache_dir()
 
-    local vs_src = result.vs_source or ""
-    local fs_src = result.fs_source or ""
+    local names = {}
+    for name in pairs(programs) do
+        names[#names + 1] = name
+    end
+    table.sort(names)
 
     -- Cache format:
     -- version (u8)
-    -- has_bytecode (u8): 1 if bytecode, 0 if source only
-    -- vs_bytecode_len (u32) + vs_bytecode
-    -- fs_bytecode_len (u32) + fs_bytecode
-    -- vs_source_len (u32) + vs_source
-    -- fs_source_len (u32) + fs_source
-    local has_bytecode = (result.vs_bytecode and result.fs_bytecode) and 1 or 0
-    local data = string.pack(
-        "<BB I4 I4 I4 I4",
-        M.cache.version,
-        has_bytecode,
-        #(result.vs_bytecode or ""),
-        #(result.fs_bytecode or ""),
-        #vs_src,
-        #fs_src
-    )
-    data = data .. (result.vs_bytecode or "") .. (result.fs_bytecode or "") .. vs_src .. fs_src
+    -- program_count (u32)
+    -- per program:
+    --   name (u8 length + string)
+    --   has_bytecode (u8): 1 if bytecode, 0 if source only
+    --   vs_bytecode, fs_bytecode, vs_source, fs_source, reflection (u32 length + data each)
+    local parts = { string.pack("<B I4", M.cache.version, #names) }
+    for _, name in ipairs(names) do
+        local result = programs[name]
+        local has_bytecode = (result.vs_bytecode and result.fs_bytecode) and 1 or 0
+        parts[#parts + 1] = string.pack(
+            "<s1 B s4 s4 s4 s4 s4",
+            name,
+            has_bytecode,
+            result.vs_bytecode or "",
+            result.fs_bytecode or "",
+            result.vs_source or "",
+            result.fs_source or "",
+            result.reflection or ""
+        )
+    end
 
-    return fs.write(cache_path, data)
+    return fs.write_atomic(cache_path, table.concat(parts))
 end
 
--- Load compiled shader from cache
+-- Load compiled programs from cache
 ---@param cache_path string cache file path
----@return table|nil result compile result or nil if invalid
+---@return table<string, shdc.CompileResult>|nil programs compile results by program name, or nil if invalid
 local function load_cache(cache_path)
     local data = fs.read(cache_path)
-    if not data or #data < 18 then
+    if not data or #data < 5 then
         return nil
     end
 
-    local version, has_bytecode, vs_bc_len, fs_bc_len, vs_src_len, fs_src_len = string.unpack("<BB I4 I4 I4 I4", data)
-
+    local version, count, pos = string.unpack("<B I4", data)
     if version ~= M.cache.version then
         return nil -- Version mismatch, invalidate cache
     end
 
-    local offset = 18
-    local vs_bytecode = nil
-    local fs_bytecode = nil
-    if has_bytecode == 1 and vs_bc_len > 0 and fs_bc_len > 0 then
-        vs_bytecode = data:sub(offset + 1, offset + vs_bc_len)
-        offset = offset + vs_bc_len
-        fs_bytecode = data:sub(offset + 1, offset + fs_bc_len)
-        offset = offset + fs_bc_len
-    else
-        offset = offset + vs_bc_len + fs_bc_len
+    local programs = {}
+    for _ = 1, count do
+        -- string.unpack raises on a truncated file
+        local ok, name, has_bytecode, vs_bytecode, fs_bytecode, vs_source, fs_source, reflection, next_pos =
+            pcall(string.unpack, "<s1 B s4 s4 s4 s4 s4", data, pos)
+        if not ok then
+            return nil
+        end
+        if #reflection > 0 and shdc and not shdc.valid_reflection(reflection) then
+            return nil -- Corrupt entry, compile again
+        end
+        local bytecode = has_bytecode == 1 and #vs_bytecode > 0 and #fs_bytecode > 0
+        programs[name] = {
+            success = true,
+            vs_bytecode = bytecode and vs_bytecode or nil,
+            fs_bytecode = bytecode and fs_bytecode or nil,
+            vs_source = #vs_source > 0 and vs_source or nil,
+            fs_source = #fs_source > 0 and fs_source or nil,
+            reflection = #reflection > 0 and reflection or nil,
+        }
+        pos = next_pos
     end
+    return programs
+end
 
-    local vs_source = nil
-    local fs_source = nil
-    if vs_src_len > 0 then
-        vs_source = data:sub(offset + 1, offset + vs_src_len)
-        offset = offset + vs_src_len
+-- Compile results of a shdc.compile_all table, by language then program
+---@param result table shdc.compile_all / Job:result() table
+---@param langs string[] shader languages
+---@return table<string, table<string, shdc.CompileResult>>? programs by language, then by program name
+---@return string? err
+---@return number? compile_ms
+local function split_result(result, langs)
+    if not result.success then
+        return nil, result.error or "unknown"
     end
-    if fs_src_len > 0 then
-        fs_source = data:sub(offset + 1, offset + fs_src_len)
+    local by_lang = {}
+    for _, lang in ipairs(langs) do
+        by_lang[lang] = {}
     end
+    for name, variants in pairs(result.programs) do
+        for lang, stages in pairs(variants) do
+            stages.success = true
+            by_lang[lang][name] = stages
+        end
+    end
+    return by_lang, nil, result.compile_ms
+end
 
-    return {
-        success = true,
-        vs_bytecode = vs_bytecode,
-        fs_bytecode = fs_bytecode,
-        vs_source = vs_source,
-        fs_source = fs_source,
-    }
+-- Compile every program of source for langs in one shdc pass
+---@param source string shader source code
+---@param langs string[] shader languages
+---@param defines string[] define_list result
+---@return table<string, table<string, shdc.CompileResult>>? programs by language, then by program name
+---@return string? err
+---@return number? compile_ms
+local function compile_all(source, langs, defines)
+    return split_result(shdc.compile_all(source, langs, defines, M.output), langs)
+end
+
+-- Report a fresh compile and save its programs to the cache
+---@param cache_path string cache file path
+---@param programs table<string, shdc.CompileResult> compile results by program name
+---@param program_name string program the caller wants (for log messages)
+---@param lang string shader language
+---@param compile_ms number
+---@return table<string, shdc.CompileResult> programs
+local function store_programs(cache_path, programs, program_name, lang, compile_ms)
+    util.profile_report("shader", "compile " .. program_name .. " (" .. lang .. ")", compile_ms)
+    if M.cache.enabled then
+        if save_cache(cache_path, programs) then
+            log.info("Saved shader cache: " .. program_name)
+        end
+    end
+    return programs
+end
+
+-- Compiled programs of source for lang: from the cache, or compiled
+-- together and cached
+---@param source string shader source code
+---@param program_name string program the caller wants (for log messages)
+---@param lang string shader language
+---@param defines string[] define_list result
+---@return table<string, shdc.CompileResult>? programs compile results by program name
+---@return string? err
+local function load_programs(source, program_name, lang, defines)
+    local cache_path = get_cache_path(source, lang, defines)
+
+    if M.cache.enabled then
+        local programs = load_cache(cache_path)
+        if programs then
+            log.info("Loaded shader from cache: " .. program_name)
+            return programs
+        end
+    end
+
+    log.info("Compiling shader: " .. program_name .. " for " .. lang)
+    local by_lang, err, compile_ms = compile_all(source, { lang }, defines)
+    if not by_lang then
+        return nil, err
+    end
+    return store_programs(cache_path, by_lang[lang], program_name, lang, compile_ms)
+end
+
+-- program_name out of a source's compiled programs, or nil after logging why not
+---@param programs table<string, shdc.CompileResult>?
+---@param err string? why programs is nil
+---@param program_name string
+---@return shdc.CompileResult?
+local function pick_program(programs, err, program_name)
+    if not programs then
+        log.error("Shader compile error: " .. tostring(err))
+        return nil
+    end
+    local result = programs[program_name]
+    if not result then
+        log.error("Shader compile error: program not found: " .. program_name)
+        return nil
+    end
+    return result
+end
+
+-- Compiled program_name for the current backend, or nil after logging why not
+---@param source string shader source code
+---@param program_name string program name in shader
+---@param opts? shader.Options
+---@return shdc.CompileResult?
+local function load_program(source, program_name, opts)
+    if not shdc then
+        log.error("shdc module not available (requires LUB3D_BUILD_SHDC=ON)")
+        return nil
+    end
+    local defines = define_list(opts and opts.defines)
+    local programs, err = load_programs(source, program_name, M.get_lang(), defines)
+    return pick_program(programs, err, program_name)
 end
 
 -- Get shader language for current backend
@@ -158,48 +312,173 @@ function M.get_lang()
     end
 end
 
--- Compile shader using sokol-shdc library
+-- Permutation matrix declared in a source by comment lines
+--   // @permute NAME value1 value2 ...
+-- (shdc ignores comments). Values are numbers, true/false or raw text.
+-- Returns every combination of the values as a define set, or a single
+-- empty set when nothing is declared.
 ---@param source string shader source code
----@param program_name string program name in shader
----@param uniform_blocks? table uniform block descriptors
----@param attrs? table vertex attribute semantics for D3D11
----@param texture_sampler_pairs? table texture-sampler pair descriptors
----@return sokol.gfx.Shader? shader shader handle or nil on failure
-function M.compile(source, program_name, uniform_blocks, attrs, texture_sampler_pairs)
-    if not shdc then
-        log.error("shdc module not available (requires LUB3D_BUILD_SHDC=ON)")
-        return nil
+---@return shader.Defines[]
+function M.permutations(source)
+    local sets = { {} }
+    for name, values in source:gmatch("//%s*@permute%s+([%w_]+)([^\n]*)") do
+        local expanded = {}
+        for _, set in ipairs(sets) do
+            for word in values:gmatch("%S+") do
+                local value
+                if word == "true" or word == "false" then
+                    value = word == "true"
+                else
+                    value = math.tointeger(tonumber(word)) or tonumber(word) or word
+                end
+                local copy = { [name] = value }
+                for k, v in pairs(set) do
+                    copy[k] = v
+                end
+                expanded[#expanded + 1] = copy
+            end
+        end
+        sets = expanded
     end
-    local lang = M.get_lang()
-
-    -- Try to load from cache first
-    local cache_path = get_cache_path(source, program_name, lang)
-    local result = nil
+    return sets
+end
 
-    if M.cache.enabled then
-        result = load_cache(cache_path)
-        if result then
-            log.info("Loaded shader from cache: " .. program_name)
+---@class shader.Precompile
+---@field jobs { job: shdc.Job, lang: string, defines: string[], cache_path: string }[]
+---@field paths string[] cache file of every language and permutation
+---@field err string?
+
+-- Start compiling every program of source into the shader cache for each of
+-- langs, without creating shaders, so no graphics context is needed (used by
+-- lub3d cook for every backend). Languages already cached are skipped; each
+-- missing language and permutation is queued as its own shdc.compile_async
+-- job, so they compile in parallel. Without opts.defines every permutation
+-- the source declares (see M.permutations) is compiled. Finish with
+-- M.precompile_wait.
+---@param source string shader source code
+---@param langs string[] shader languages (see M.get_lang)
+---@param opts? shader.Options
+---@return shader.Precompile
+function M.precompile_async(source, langs, opts)
+    local batch = { jobs = {}, paths = {} }
+    if not shdc then
+        batch.err = "shdc module not available (requires LUB3D_BUILD_SHDC=ON)"
+        return batch
+    end
+    local sets = opts and opts.defines and { opts.defines } or M.permutations(source)
+    for _, set in ipairs(sets) do
+        local defines = define_list(set)
+        for _, lang in ipairs(langs) do
+            local cache_path = get_cache_path(source, lang, defines)
+            batch.paths[#batch.paths + 1] = cache_path
+            if not load_cache(cache_path) then
+                batch.jobs[#batch.jobs + 1] = {
+                    job = shdc.compile_async(source, { lang }, defines, M.output),
+                    lang = lang,
+                    defines = defines,
+                    cache_path = cache_path,
+                }
+            end
         end
     end
+    return batch
+end
 
-    -- Compile if not cached
-    if not result then
-        log.info("Compiling shader: " .. program_name .. " for " .. lang)
-
-        result = shdc.compile(source, program_name, lang)
-        if not result.success then
-            log.error("Shader compile error: " .. (result.error or "unknown"))
-            return nil
+-- Shader cache files of source for langs and every permutation it declares
+-- (or opts.defines), as written by M.precompile_async. They change with
+-- the compiler, output options and @included files, so a missing one means
+-- the source needs compiling again.
+---@param source string shader source code
+---@param langs string[] shader languages (see M.get_lang)
+---@param opts? shader.Options
+---@return string[] paths
+function M.cache_paths(source, langs, opts)
+    local paths = {}
+    local sets = opts and opts.defines and { opts.defines } or M.permutations(source)
+    for _, set in ipairs(sets) do
+        local defines = define_list(set)
+        for _, lang in ipairs(langs) do
+            paths[#paths + 1] = get_cache_path(source, lang, defines)
         end
+    end
+    return paths
+end
 
-        -- Save to cache
-        if M.cache.enabled then
-            if save_cache(cache_path, result) then
-                log.info("Saved shader cache: " .. program_name)
+-- Wait for a M.precompile_async batch and write its cache files
+---@param batch shader.Precompile
+---@return boolean success
+---@return string? err
+---@return integer? compiled number of program variants compiled (0 when all were cached)
+---@return string[]? paths cache file of every language and permutation
+function M.precompile_wait(batch)
+    if batch.err then
+        return false, batch.err
+    end
+    local compiled = 0
+    local err = nil
+    for _, entry in ipairs(batch.jobs) do
+        if err then
+            entry.job:cancel()
+        else
+            local by_lang, compile_err = split_result(entry.job:wait(), { entry.lang })
+            if not by_lang then
+                err = tostring(compile_err)
+                if #entry.defines > 0 then
+                    err = "[" .. table.concat(entry.defines, ", ") .. "] " .. err
+                end
+            elseif not save_cache(entry.cache_path, by_lang[entry.lang]) then
+                err = "cannot write " .. entry.cache_path
+            else
+                for _ in pairs(by_lang[entry.lang]) do
+                    compiled = compiled + 1
+                end
             end
         end
     end
+    if err then
+        return false, err
+    end
+    return true, nil, compiled, batch.paths
+end
+
+-- M.precompile_async and M.precompile_wait in one call
+---@param source string shader source code
+---@param langs string[] shader languages (see M.get_lang)
+---@param opts? shader.Options
+---@return boolean success
+---@return string? err
+---@return integer? compiled number of program variants compiled (0 when all were cached)
+---@return string[]? paths cache file of every language and permutation
+function M.precompile_all(source, langs, opts)
+    return M.precompile_wait(M.precompile_async(source, langs, opts))
+end
+
+-- Reflection of a program for the current backend: uniform block layouts
+-- (member types and offsets), texture/sampler slots and vertex attributes
+---@param source string shader source code
+---@param program_name string program name in shader
+---@param opts? shader.Options
+---@return shdc.Reflection?
+function M.reflect(source, program_name, opts)
+    local result = load_program(source, program_name, opts)
+    if not result or not result.reflection then
+        return nil
+    end
+    return shdc.reflect(result.reflection)
+end
+
+-- Compile shader using sokol-shdc library
+---@param source string shader source code
+---@param program_name string program name in shader
+---@param uniform_blocks? table uniform block descriptors
+---@param attrs? table vertex attribute semantics for D3D11
+---@param texture_sampler_pairs? table texture-sampler pair descriptors
+---@return sokol.gfx.Shader? shader shader handle or nil on failure
+function M.compile(source, program_name, uniform_blocks, attrs, texture_sampler_pairs)
+    local result = load_program(source, program_name)
+    if not result then
+        return nil
+    end
 
     log.info(
         "Shader compiled: vs="
@@ -260,47 +539,14 @@ function M.compile(source, program_name, uniform_blocks, attrs, texture_sampler_
     return shd
 end
 
--- Compile shader with full descriptor control
----@param source string shader source code
+-- Shader descriptor of a compiled program for the current backend
+---@param result shdc.CompileResult
 ---@param program_name string program name in shader
----@param shader_desc table full shader descriptor (uniform_blocks, views, samplers, texture_sampler_pairs, attrs)
----@return sokol.gfx.Shader? shader shader handle or nil on failure
-function M.compile_full(source, program_name, shader_desc)
-    if not shdc then
-        log.error("shdc module not available (requires LUB3D_BUILD_SHDC=ON)")
-        return nil
-    end
-    local lang = M.get_lang()
-
-    -- Try to load from cache first
-    local cache_path = get_cache_path(source, program_name, lang)
-    local result = nil
-
-    if M.cache.enabled then
-        result = load_cache(cache_path)
-        if result then
-            log.info("Loaded shader from cache: " .. program_name)
-        end
-    end
-
-    -- Compile if not cached
-    if not result then
-        log.info("Compiling shader: " .. program_name .. " for " .. lang)
-
-        result = shdc.compile(source, program_name, lang)
-        if not result.success then
-            log.error("Shader compile error: " .. (result.error or "unknown"))
-            return nil
-        end
-
-        -- Save to cache
-        if M.cache.enabled then
-            if save_cache(cache_path, result) then
-                log.info("Saved shader cache: " .. program_name)
-            end
-        end
-    end
-
+---@param shader_desc? table full shader descriptor, or nil to build it from the reflection
+---@return sokol.gfx.ShaderDesc? desc descriptor or nil on failure
+---@return string? vs_data vertex stage source or bytecode
+---@return string? fs_data fragment stage source or bytecode
+local function build_desc(result, program_name, shader_desc)
     log.info(
         "Shader compiled: vs="
         .. tostring(result.vs_source and #result.vs_source or "nil")
@@ -325,35 +571,429 @@ function M.compile_full(source, program_name, shader_desc)
         return nil
     end
 
-    local desc_table = {
-        vertex_func = is_source and { source = vs_data } or { bytecode = vs_data },
-        fragment_func = is_source and { source = fs_data } or { bytecode = fs_data },
-    }
-
-    -- Copy all fields from shader_desc
-    if shader_desc.uniform_blocks then
-        desc_table.uniform_blocks = shader_desc.uniform_blocks
+    local desc_table
+    if shader_desc then
+        -- Copy all fields from shader_desc
+        desc_table = {}
+        if shader_desc.uniform_blocks then
+            desc_table.uniform_blocks = shader_desc.uniform_blocks
+        end
+        if shader_desc.views then
+            desc_table.views = shader_desc.views
+        end
+        if shader_desc.samplers then
+            desc_table.samplers = shader_desc.samplers
+        end
+        if shader_desc.texture_sampler_pairs then
+            desc_table.texture_sampler_pairs = shader_desc.texture_sampler_pairs
+        end
+        if backend == gfx.Backend.D3D11 and shader_desc.attrs then
+            desc_table.attrs = shader_desc.attrs
+        end
+    elseif result.reflection then
+        -- Bindings for every backend, built in C from shdc's reflection
+        desc_table = shdc.shader_desc(result.reflection)
+    else
+        log.error("No shader descriptor or reflection for: " .. program_name)
+        return nil
     end
-    if shader_desc.views then
-        desc_table.views = shader_desc.views
+    desc_table.vertex_func = is_source and { source = vs_data } or { bytecode = vs_data }
+    desc_table.fragment_func = is_source and { source = fs_data } or { bytecode = fs_data }
+    return gfx.ShaderDesc(desc_table), vs_data, fs_data
+end
+
+-- Seed of the program binary keys: the driver that produced them
+local driver_seed
+
+-- Program binary file for GL stage sources, or nil when not kept. Keyed by
+-- the sources and the driver's vendor, renderer and version; a binary the
+-- driver refuses anyway (same version string, other build) is rebuilt.
+---@param vs_data string
+---@param fs_data string
+---@return string? path
+local function program_binary_path(vs_data, fs_data)
+    if not (M.cache.enabled and M.cache.program_binaries and program_cache.supported()) then
+        return nil
     end
-    if shader_desc.samplers then
-        desc_table.samplers = shader_desc.samplers
+    driver_seed = driver_seed or hash.xxh64(program_cache.driver())
+    local key = hash.xxh64(fs_data, hash.xxh64(vs_data, driver_seed))
+    return string.format("%s/gl_%016x.bin", M.cache.dir, key)
+end
+
+-- gfx.make_shader, from the driver's program binary saved by an earlier
+-- run when there is one (GL), so warm starts skip the driver compile
+---@param desc sokol.gfx.ShaderDesc
+---@param vs_data string
+---@param fs_data string
+---@return sokol.gfx.Shader
+local function create_shader(desc, vs_data, fs_data)
+    local path = program_binary_path(vs_data, fs_data)
+    if not path then
+        return gfx.make_shader(desc)
     end
-    if shader_desc.texture_sampler_pairs then
-        desc_table.texture_sampler_pairs = shader_desc.texture_sampler_pairs
+    local shd, _, binary = program_cache.make_shader(desc, fs.read(path))
+    if binary then
+        ensure_cache_dir()
+        fs.write_atomic(path, binary)
     end
-    if backend == gfx.Backend.D3D11 and shader_desc.attrs then
-        desc_table.attrs = shader_desc.attrs
+    return shd
+end
+
+-- Shaders created from compile_full and compile_async, for hot reload:
+-- shader -> { source, program_name, shader_desc, opts }. Weak keys, so
+-- collected handles drop out.
+local live = setmetatable({}, { __mode = "k" })
+
+-- Create the shader of a compiled program (main thread only)
+---@param result shdc.CompileResult
+---@param source string shader source code the program was compiled from
+---@param program_name string program name in shader
+---@param shader_desc? table full shader descriptor, or nil to build it from the reflection
+---@param opts? shader.Options
+---@return sokol.gfx.Shader? shader shader handle or nil on failure
+local function make_shader(result, source, program_name, shader_desc, opts)
+    local desc, vs_data, fs_data = build_desc(result, program_name, shader_desc)
+    if not desc then
+        return nil
     end
 
-    local shd = gfx.make_shader(gfx.ShaderDesc(desc_table))
+    local shd = create_shader(desc, vs_data, fs_data)
     if gfx.query_shader_state(shd) ~= gfx.ResourceState.VALID then
         log.error("Failed to create shader")
         return nil
     end
 
+    live[shd] = { source = source, program_name = program_name, shader_desc = shader_desc, opts = opts }
     return shd
 end
 
+-- Re-initialize shd in place from a compiled program and rebuild the cached
+-- pipelines that use it. The new program is first created on a scratch
+-- shader: if that fails, shd keeps its last good version.
+---@param shd sokol.gfx.Shader
+---@param result shdc.CompileResult
+---@param program_name string
+---@param shader_desc? table
+---@return boolean ok
+local function swap_shader(shd, result, program_name, shader_desc)
+    local desc = build_desc(result, program_name, shader_desc)
+    if not desc then
+        return false
+    end
+    local scratch = gfx.make_shader(desc)
+    local ok = gfx.query_shader_state(scratch) == gfx.ResourceState.VALID
+    gfx.destroy_shader(scratch)
+    if not ok then
+        log.error("Failed to create shader, keeping the previous version: " .. program_name)
+        return false
+    end
+    gfx.uninit_shader(shd)
+    gfx.init_shader(shd, desc)
+    local pipelines = pipeline_cache.refresh(shd)
+    log.info("Shader swapped: " .. program_name .. " (" .. pipelines .. " pipelines rebuilt)")
+    return true
+end
+
+-- Compile shader with full descriptor control
+---@param source string shader source code
+---@param program_name string program name in shader
+---@param shader_desc? table full shader descriptor (uniform_blocks, views, samplers, texture_sampler_pairs, attrs);
+---  nil builds it from the program's reflection
+---@param opts? shader.Options
+---@return sokol.gfx.Shader? shader shader handle or nil on failure
+function M.compile_full(source, program_name, shader_desc, opts)
+    local result = load_program(source, program_name, opts)
+    if not result then
+        return nil
+    end
+    return make_shader(result, source, program_name, shader_desc, opts)
+end
+
+-- compile_full for a sokol-shdc source file (*.glsl). With lib.hotreload
+-- running, the shader follows edits to the file (see M.reload_source).
+---@param path string shader source file
+---@param program_name string program name in shader
+---@param shader_desc? table full shader descriptor, or nil to build it from the reflection
+---@param opts? shader.Options
+---@return sokol.gfx.Shader? shader shader handle or nil on failure
+function M.compile_file(path, program_name, shader_desc, opts)
+    local source = fs.read(path)
+    if not source then
+        log.error("Failed to read shader: " .. path)
+        return nil
+    end
+    local shd = M.compile_full(source, program_name, shader_desc, opts)
+    local hotreload = package.loaded["lib.hotreload"]
+    if shd and hotreload then
+        hotreload.watch_file(path, function(text)
+            local count = M.reload_source(source, text)
+            source = text
+            return count
+        end)
+    end
+    return shd
+end
+
+---@class shader.Variants
+---@field source string
+---@field program_name string
+---@field shader_desc table?
+---@field shaders table<string, sokol.gfx.Shader|false> created shaders by define set (false: failed)
+local Variants = {}
+Variants.__index = Variants
+
+-- Shaders of one program across define sets. Each set is loaded (from the
+-- shader cache when cooked, compiled otherwise) on first use; after that,
+-- selecting a permutation is a table lookup.
+---@param source string shader source code
+---@param program_name string program name in shader
+---@param shader_desc? table full shader descriptor, or nil to build it from the reflection
+---@return shader.Variants
+function M.variants(source, program_name, shader_desc)
+    return setmetatable({
+        source = source,
+        program_name = program_name,
+        shader_desc = shader_desc,
+        shaders = {},
+    }, Variants)
+end
+
+-- Shader for a define set, or nil if it failed to compile
+---@param defines? shader.Defines
+---@return sokol.gfx.Shader?
+function Variants:get(defines)
+    local key = table.concat(define_list(defines), "\n")
+    local shd = self.shaders[key]
+    if shd == nil then
+        shd = M.compile_full(self.source, self.program_name, self.shader_desc, { defines = defines }) or false
+        self.shaders[key] = shd
+    end
+    return shd or nil
+end
+
+-- Create every permutation the source declares (see M.permutations) now,
+-- so later gets never load or compile
+function Variants:preload()
+    for _, set in ipairs(M.permutations(self.source)) do
+        self:get(set)
+    end
+end
+
+-- Destroy every created shader
+function Variants:destroy()
+    for _, shd in pairs(self.shaders) do
+        if shd then
+            gfx.destroy_shader(shd)
+        end
+    end
+    self.shaders = {}
+end
+
+---@class shader.Pending
+---@field ready boolean true once the compile finished (successfully or not)
+---@field shader sokol.gfx.Shader? shader handle once ready, nil on failure
+---@field program_name string
+---@field shader_desc table?
+---@field on_ready fun(shd: sokol.gfx.Shader?, pending: shader.Pending)?
+---@field source string
+---@field opts shader.Options?
+---@field target sokol.gfx.Shader? shader re-initialized in place instead of creating one (hot reload)
+---@field programs table<string, shdc.CompileResult>? compiled programs, set when resolved
+---@field err string? compile error, set when resolved
+
+-- Background compiles, one per cache file so every program of a source
+-- waiting on it shares the job: cache_path -> { job, lang, waiting }
+local jobs = {}
+-- Requests resolved but not yet handed out (cache hits, failures)
+local resolved = {}
+
+-- Start or join the background compile of pending.source, or resolve it
+-- from the shader cache
+---@param pending shader.Pending
+---@return shader.Pending
+local function submit(pending)
+    if not shdc then
+        pending.err = "shdc module not available (requires LUB3D_BUILD_SHDC=ON)"
+        resolved[#resolved + 1] = pending
+        return pending
+    end
+
+    local source, program_name, opts = pending.source, pending.program_name, pending.opts
+    local lang = M.get_lang()
+    local defines = define_list(opts and opts.defines)
+    local cache_path = get_cache_path(source, lang, defines)
+    local entry = jobs[cache_path]
+    if entry then
+        entry.waiting[#entry.waiting + 1] = pending
+        return pending
+    end
+
+    if M.cache.enabled then
+        local programs = load_cache(cache_path)
+        if programs then
+            log.info("Loaded shader from cache: " .. program_name)
+            pending.programs = programs
+            resolved[#resolved + 1] = pending
+            return pending
+        end
+    end
+
+    log.info("Compiling shader in background: " .. program_name .. " for " .. lang)
+    jobs[cache_path] = {
+        job = shdc.compile_async(source, { lang }, defines, M.output),
+        lang = lang,
+        waiting = { pending },
+    }
+    return pending
+end
+
+-- Compile like compile_full without blocking the frame. Cache hits and
+-- misses alike are delivered from M.update (called every frame by boot.lua):
+-- the shader is created there on the main thread, pending.ready is set and
+-- on_ready(shader, pending) is called. Until then draw with a fallback.
+---@param source string shader source code
+---@param program_name string program name in shader
+---@param shader_desc? table full shader descriptor, or nil to build it from the reflection
+---@param on_ready? fun(shd: sokol.gfx.Shader?, pending: shader.Pending)
+---@param opts? shader.Options
+---@return shader.Pending
+function M.compile_async(source, program_name, shader_desc, on_ready, opts)
+    local pending = {
+        ready = false,
+        source = source,
+        program_name = program_name,
+        shader_desc = shader_desc,
+        on_ready = on_ready,
+        opts = opts,
+    }
+    return submit(pending)
+end
+
+-- Whether a live shader (see M.reload_source) was created from source
+---@param source string
+---@return boolean
+function M.has_live(source)
+    for shd, info in pairs(live) do
+        if info.source == source and gfx.query_shader_state(shd) == gfx.ResourceState.VALID then
+            return true
+        end
+    end
+    return false
+end
+
+-- Hot reload: recompile every live shader created from old_source
+-- (compile_full, compile_async, compile_file, variants) from new_source in
+-- the background. Once built, each is re-initialized in place and keeps its
+-- handle, so whatever draws with it and its pipelines from lub3d.pipeline_cache
+-- pick up the new version without being recreated; buffers and images are
+-- untouched. A program that fails to compile or create keeps its last good
+-- version. on_done(ok, program_name) is called per shader from M.update.
+---@param old_source string
+---@param new_source string
+---@param on_done? fun(ok: boolean, program_name: string)
+---@return integer count shaders being reloaded
+function M.reload_source(old_source, new_source, on_done)
+    local count = 0
+    for shd, info in pairs(live) do
+        if info.source == old_source then
+            -- Later edits follow the text, even when this version fails
+            info.source = new_source
+            if gfx.query_shader_state(shd) == gfx.ResourceState.VALID then
+                local program_name = info.program_name
+                submit({
+                    ready = false,
+                    source = new_source,
+                    program_name = program_name,
+                    shader_desc = info.shader_desc,
+                    opts = info.opts,
+                    target = shd,
+                    on_ready = on_done and function(swapped)
+                        on_done(swapped ~= nil, program_name)
+                    end,
+                })
+                count = count + 1
+            else
+                live[shd] = nil
+            end
+        end
+    end
+    return count
+end
+
+-- Shader sources embedded in Lua long strings (those with an @program), as
+-- the strings' values, and the text with their bodies emptied: two versions
+-- of a file with the same remainder differ only in their shaders.
+---@param text string Lua source
+---@return string[] sources
+---@return string rest
+function M.embedded_sources(text)
+    local list = {}
+    -- The lexer turns line breaks in long strings into \n and drops the first one
+    text = text:gsub("\r\n", "\n")
+    local rest = text:gsub("%[(=*)%[(.-)%]%1%]", function(eq, body)
+        if body:find("@program", 1, true) then
+            list[#list + 1] = (body:gsub("^\n", ""))
+            return "[" .. eq .. "[]" .. eq .. "]"
+        end
+    end)
+    return list, rest
+end
+
+-- Number of shaders still compiling in the background
+---@return integer
+function M.pending_count()
+    local count = 0
+    for _, entry in pairs(jobs) do
+        count = count + #entry.waiting
+    end
+    return count
+end
+
+-- Hand out finished background compiles: create their shaders and call
+-- their on_ready callbacks. Called once per frame by boot.lua.
+function M.update()
+    for cache_path, entry in pairs(jobs) do
+        local result = entry.job:result()
+        if result then
+            jobs[cache_path] = nil
+            local by_lang, err, compile_ms = split_result(result, { entry.lang })
+            local programs
+            if by_lang then
+                programs = store_programs(cache_path, by_lang[entry.lang], entry.waiting[1].program_name, entry.lang,
+                    compile_ms)
+            end
+            for _, pending in ipairs(entry.waiting) do
+                pending.programs = programs
+                pending.err = err
+                resolved[#resolved + 1] = pending
+            end
+        end
+    end
+
+    if #resolved == 0 then
+        return
+    end
+    local ready = resolved
+    resolved = {}
+    for _, pending in ipairs(ready) do
+        local result = pick_program(pending.programs, pending.err, pending.program_name)
+        if pending.target then
+            local swapped = result and swap_shader(pending.target, result, pending.program_name, pending.shader_desc)
+            pending.shader = swapped and pending.target or nil
+        else
+            pending.shader = result
+                and make_shader(result, pending.source, pending.program_name, pending.shader_desc, pending.opts)
+        end
+        pending.programs = nil
+        pending.ready = true
+        if pending.on_ready then
+            -- A failing callback must not drop the rest of the batch
+            local ok, err = pcall(pending.on_ready, pending.shader, pending)
+            if not ok then
+                log.error("Shader on_ready error: " .. tostring(err))
+            end
+        end
+    end
+end
+
 return M
@@ -6,14 +6,14 @@ local gpu = require("lib.gpu")
 local shader_mod = require("lib.shader")
 local util = require("lib.util")
 local log = require("lib.log")
+local sprite_core = require("lub3d.sprite")
+local pipeline_cache = require("lub3d.pipeline_cache")
 
 ---@class sprite
 local M = {}
 
 local MAX_QUADS <const> = 4096
-local VERTS_PER_QUAD <const> = 4
 local INDICES_PER_QUAD <const> = 6
-local FLOATS_PER_VERT <const> = 8 -- x, y, u, v, r, g, b, a
 
 local shader_source = [[
 @vs vs
@@ -57,95 +57,135 @@ void main() {
 @program sprite vs fs
 ]]
 
+-- Instanced variant: one 40-byte instance per sprite, expanded from a
+-- static unit quad (triangle strip) in the vertex shader
+local instanced_shader_source = [[
+@vs vs
+in vec2 corner;
+in vec3 pivot_rot;  // xy = pivot (pixels), z = rotation (radians)
+in vec4 rect;       // local corners relative to pivot: x0, y0, x1, y1
+in vec4 uv_rect;    // u0, v0, u1, v1
+in vec4 color;
+
+out vec2 v_uv;
+out vec4 v_color;
+
+layout(binding=0) uniform vs_params {
+    vec4 screen_size; // xy = screen size, zw = unused
+};
+
+void main() {
+    vec2 local_pos = mix(rect.xy, rect.zw, corner);
+    float c = cos(pivot_rot.z);
+    float s = sin(pivot_rot.z);
+    vec2 pos = pivot_rot.xy + vec2(local_pos.x * c - local_pos.y * s,
+                                   local_pos.x * s + local_pos.y * c);
+    vec2 ndc = vec2(
+        pos.x / screen_size.x * 2.0 - 1.0,
+        1.0 - pos.y / screen_size.y * 2.0
+    );
+    gl_Position = vec4(ndc, 0.0, 1.0);
+    v_uv = mix(uv_rect.xy, uv_rect.zw, corner);
+    v_color = color;
+}
+@end
+
+@fs fs
+in vec2 v_uv;
+in vec4 v_color;
+
+out vec4 frag_color;
+
+layout(binding=0) uniform texture2D tex;
+layout(binding=0) uniform sampler smp;
+
+void main() {
+    frag_color = texture(sampler2D(tex, smp), v_uv) * v_color;
+}
+@end
+
+@program sprite_instanced vs fs
+]]
+
+---@class sprite.Texture
+---@field view gpu.View
+---@field smp gpu.Sampler
+
 ---@class sprite.Batch
 ---@field tex_view gpu.View
 ---@field tex_smp gpu.Sampler
 ---@field tex_w number atlas width in pixels
 ---@field tex_h number atlas height in pixels
----@field verts number[] vertex data accumulator
----@field quad_count number quads queued this frame
----@field vbuf gpu.Buffer
----@field ibuf gpu.Buffer
+---@field core lub3d.sprite.Batch native vertex/instance accumulator
+---@field instanced boolean true if drawn with the instanced pipeline
+---@field textures sprite.Texture[] texture slots (slot 0 = tex_result) indexed by slot + 1
+---@field texture_slots table<table, integer> texture table -> slot
+---@field draw_calls integer total draw calls issued by flush
+---@field stream gpu.StreamBuffer per-vertex data, or per-instance data when instanced
+---@field ibuf gpu.Buffer? shared quad indices (vertex mode only)
 ---@field screen_w number logical screen width
 ---@field screen_h number logical screen height
 
--- Shared index buffer data (generated once)
-local shared_ibuf_data = nil
+-- Shared index buffer data (generated once per size)
+local shared_ibuf_data = {}
 
-local function get_ibuf_data()
-    if shared_ibuf_data then
-        return shared_ibuf_data
-    end
-    local indices = {}
-    for i = 0, MAX_QUADS - 1 do
-        local base = i * VERTS_PER_QUAD
-        indices[#indices + 1] = base + 0
-        indices[#indices + 1] = base + 1
-        indices[#indices + 1] = base + 2
-        indices[#indices + 1] = base + 0
-        indices[#indices + 1] = base + 2
-        indices[#indices + 1] = base + 3
+---@param max_quads integer
+---@return string
+local function get_ibuf_data(max_quads)
+    local data = shared_ibuf_data[max_quads]
+    if not data then
+        data = sprite_core.quad_indices(max_quads)
+        shared_ibuf_data[max_quads] = data
     end
-    shared_ibuf_data = util.pack_u32(indices)
-    return shared_ibuf_data
+    return data
 end
 
 -- Shared resources (lazily created, shared across batches)
-local shared_shader = nil       -- raw handle for pipeline creation
----@type sokol.gfx.Pipeline? raw handle for draw calls
-local shared_pipeline = nil
-
-local function ensure_shared_resources()
-    if shared_pipeline then
-        return
-    end
+-- Shaders are per vertex layout; pipelines per (layout, blend mode)
+---@type table<string, sokol.gfx.Shader>
+local shaders = {}
+---@type table<string, table<integer, sokol.gfx.Pipeline>> raw handles for draw calls
+local pipelines = { vertex = {}, instanced = {} }
+---@type gpu.Buffer? static unit quad for the instanced pipeline
+local unit_quad_vbuf = nil
+---@type gpu.StreamBuffer? default stream shared by batches created without opts.stream
+local shared_stream = nil
+
+--- Blend modes for opts.blend (part of the draw sort key)
+M.Blend = {
+    ALPHA = 0,
+    ADD = 1,
+    PREMULTIPLIED = 2,
+}
 
-    local shd = shader_mod.compile_full(shader_source, "sprite", {
-        uniform_blocks = {
-            {
-                stage = gfx.ShaderStage.VERTEX,
-                size = 16,
-                glsl_uniforms = {
-                    { type = gfx.UniformType.FLOAT4, glsl_name = "screen_size" },
-                },
-            },
-        },
-        views = {
-            {
-                texture = {
-                    stage = gfx.ShaderStage.FRAGMENT,
-                    image_type = gfx.ImageType["2D"],
-                    sample_type = gfx.ImageSampleType.FLOAT,
-                    hlsl_register_t_n = 0,
-                    wgsl_group1_binding_n = 0,
-                },
-            },
-        },
-        samplers = {
-            {
-                stage = gfx.ShaderStage.FRAGMENT,
-                sampler_type = gfx.SamplerType.FILTERING,
-                hlsl_register_s_n = 0,
-                wgsl_group1_binding_n = 32,
-            },
-        },
-        texture_sampler_pairs = {
-            { stage = gfx.ShaderStage.FRAGMENT, view_slot = 0, sampler_slot = 0, glsl_name = "tex_smp" },
-        },
-        attrs = {
-            { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 0 },
-            { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 1 },
-            { hlsl_sem_name = "TEXCOORD", hlsl_sem_index = 2 },
-        },
-    })
-    if not shd then
-        log.error("sprite: failed to compile shader")
-        return
-    end
-    shared_shader = shd
+local BLEND_STATES <const> = {
+    [M.Blend.ALPHA] = {
+        enabled = true,
+        src_factor_rgb = gfx.BlendFactor.SRC_ALPHA,
+        dst_factor_rgb = gfx.BlendFactor.ONE_MINUS_SRC_ALPHA,
+        src_factor_alpha = gfx.BlendFactor.ONE,
+        dst_factor_alpha = gfx.BlendFactor.ONE_MINUS_SRC_ALPHA,
+    },
+    [M.Blend.ADD] = {
+        enabled = true,
+        src_factor_rgb = gfx.BlendFactor.SRC_ALPHA,
+        dst_factor_rgb = gfx.BlendFactor.ONE,
+        src_factor_alpha = gfx.BlendFactor.ONE,
+        dst_factor_alpha = gfx.BlendFactor.ONE,
+    },
+    [M.Blend.PREMULTIPLIED] = {
+        enabled = true,
+        src_factor_rgb = gfx.BlendFactor.ONE,
+        dst_factor_rgb = gfx.BlendFactor.ONE_MINUS_SRC_ALPHA,
+        src_factor_alpha = gfx.BlendFactor.ONE,
+        dst_factor_alpha = gfx.BlendFactor.ONE_MINUS_SRC_ALPHA,
+    },
+}
 
-    local pip = gfx.make_pipeline(gfx.PipelineDesc({
-        shader = shd,
+local LAYOUTS <const> = {
+    vertex = {
+        source = shader_source,
+        name = "sprite",
         layout = {
             attrs = {
                 { format = gfx.VertexFormat.FLOAT2 }, -- pos
@@ -154,67 +194,158 @@ local function ensure_shared_resources()
             },
         },
         index_type = gfx.IndexType.UINT32,
-        colors = {
-            {
-                blend = {
-                    enabled = true,
-                    src_factor_rgb = gfx.BlendFactor.SRC_ALPHA,
-                    dst_factor_rgb = gfx.BlendFactor.ONE_MINUS_SRC_ALPHA,
-                    src_factor_alpha = gfx.BlendFactor.ONE,
-                    dst_factor_alpha = gfx.BlendFactor.ONE_MINUS_SRC_ALPHA,
-                },
+        primitive_type = gfx.PrimitiveType.TRIANGLES,
+    },
+    -- Buffer 0: unit quad corners (per vertex), buffer 1: sprites (per instance)
+    instanced = {
+        source = instanced_shader_source,
+        name = "sprite_instanced",
+        layout = {
+            buffers = {
+                {},
+                { step_func = gfx.VertexStep.PER_INSTANCE },
+            },
+            attrs = {
+                { format = gfx.VertexFormat.FLOAT2, buffer_index = 0 },   -- corner
+                { format = gfx.VertexFormat.FLOAT3, buffer_index = 1 },   -- pivot_rot
+                { format = gfx.VertexFormat.FLOAT4, buffer_index = 1 },   -- rect
+                { format = gfx.VertexFormat.USHORT4N, buffer_index = 1 }, -- uv_rect
+                { format = gfx.VertexFormat.UBYTE4N, buffer_index = 1 },  -- color
             },
         },
+        index_type = gfx.IndexType.NONE,
+        primitive_type = gfx.PrimitiveType.TRIANGLE_STRIP,
+    },
+}
+
+--- Get (creating on first use) the pipeline for a vertex layout and blend mode
+---@param kind string "vertex" or "instanced"
+---@param blend integer sprite.Blend value
+---@return sokol.gfx.Pipeline?
+local function get_pipeline(kind, blend)
+    local pip = pipelines[kind][blend]
+    if pip then
+        return pip
+    end
+    local def = LAYOUTS[kind]
+    local blend_state = BLEND_STATES[blend]
+    if not blend_state then
+        log.error("sprite: unknown blend mode " .. tostring(blend))
+        return nil
+    end
+
+    local shd = shaders[kind]
+    if not shd then
+        shd = shader_mod.compile_full(def.source, def.name)
+        if not shd then
+            log.error("sprite: failed to compile " .. kind .. " shader")
+            return nil
+        end
+        shaders[kind] = shd
+    end
+
+    pip = pipeline_cache.get(gfx.PipelineDesc({
+        shader = shd,
+        layout = def.layout,
+        index_type = def.index_type,
+        primitive_type = def.primitive_type,
+        colors = { { blend = blend_state } },
         depth = {
             write_enabled = false,
         },
     }))
     if gfx.query_pipeline_state(pip) ~= gfx.ResourceState.VALID then
-        log.error("sprite: failed to create pipeline")
-        gfx.destroy_shader(shd)
-        shared_shader = nil
-        return
+        log.error("sprite: failed to create " .. kind .. " pipeline")
+        pipeline_cache.release(pip)
+        return nil
+    end
+    pipelines[kind][blend] = pip
+
+    if kind == "instanced" and not unit_quad_vbuf then
+        unit_quad_vbuf = gpu.buffer(gfx.BufferDesc({
+            usage = { vertex_buffer = true },
+            data = gfx.Range(util.pack_floats({ 0, 0, 1, 0, 0, 1, 1, 1 })),
+        }))
     end
-    shared_pipeline = pip
+    return pip
 end
 
 --- Create a new sprite batch for a given texture atlas
----@param tex_result texture.LoadResult from lib.texture.Load()
+--- Further textures can be added with sprite.add_texture and selected per
+--- sprite with opts.texture; flush sorts by (layer, texture, blend).
+---@param tex_result? texture.LoadResult from lib.texture.Load() (texture slot 0)
 ---@param tex_w number atlas width in pixels
 ---@param tex_h number atlas height in pixels
 ---@param screen_w number logical screen width (for orthographic projection)
 ---@param screen_h number logical screen height
+---@param opts? { instanced?: boolean, max_quads?: integer, stream?: gpu.StreamBuffer }
 ---@return sprite.Batch
-function M.new_batch(tex_result, tex_w, tex_h, screen_w, screen_h)
-    ensure_shared_resources()
-
-    local vbuf = gpu.buffer(gfx.BufferDesc({
-        usage = { vertex_buffer = true, dynamic_update = true },
-        size = MAX_QUADS * VERTS_PER_QUAD * FLOATS_PER_VERT * 4,
-    }))
+function M.new_batch(tex_result, tex_w, tex_h, screen_w, screen_h, opts)
+    local instanced = opts and opts.instanced or false
+    local max_quads = opts and opts.max_quads or MAX_QUADS
+    local core = sprite_core.new_batch(max_quads, tex_w, tex_h, instanced)
+
+    local ibuf = nil
+    if instanced then
+        get_pipeline("instanced", M.Blend.ALPHA)
+    else
+        get_pipeline("vertex", M.Blend.ALPHA)
+        ibuf = gpu.buffer(gfx.BufferDesc({
+            usage = { index_buffer = true },
+            data = gfx.Range(get_ibuf_data(max_quads)),
+        }))
+    end
 
-    local ibuf = gpu.buffer(gfx.BufferDesc({
-        usage = { index_buffer = true },
-        data = gfx.Range(get_ibuf_data()),
-    }))
+    -- Vertex data is appended to a streaming buffer, so a batch can be
+    -- flushed any number of times per frame
+    local stream = opts and opts.stream
+    if not stream then
+        shared_stream = shared_stream or gpu.stream_buffer({ label = "sprite" })
+        stream = shared_stream
+    end
 
     ---@type sprite.Batch
     local batch = {
-        tex_view = tex_result.view,
-        tex_smp = tex_result.smp,
+        tex_view = tex_result and tex_result.view,
+        tex_smp = tex_result and tex_result.smp,
         tex_w = tex_w,
         tex_h = tex_h,
-        verts = {},
-        quad_count = 0,
-        vbuf = vbuf,
+        core = core,
+        instanced = instanced,
+        textures = { tex_result or false },
+        texture_slots = {},
+        draw_calls = 0,
+        stream = stream,
         ibuf = ibuf,
         screen_w = screen_w,
         screen_h = screen_h,
     }
+    if tex_result then
+        batch.texture_slots[tex_result] = 0
+    end
 
     return batch
 end
 
+--- Register an additional texture with a batch
+--- Returns the slot to pass as opts.texture; adding the same texture twice
+--- returns the existing slot.
+---@param batch sprite.Batch
+---@param tex sprite.Texture texture.LoadResult or anything with view/smp
+---@param tex_w number width in pixels
+---@param tex_h number height in pixels
+---@return integer slot
+function M.add_texture(batch, tex, tex_w, tex_h)
+    local slot = batch.texture_slots[tex]
+    if not slot then
+        slot = #batch.textures
+        batch.textures[slot + 1] = tex
+        batch.texture_slots[tex] = slot
+    end
+    batch.core:set_texture(slot, tex_w, tex_h)
+    return slot
+end
+
 --- Draw a sprite from the atlas
 ---@param batch sprite.Batch
 ---@param sx number source X in atlas (pixels)
@@ -223,138 +354,107 @@ end
 ---@param sh number source height (pixels)
 ---@param dx number destination X on screen (pixels)
 ---@param dy number destination Y on screen (pixels)
----@param opts? table { rotate, scale_x, scale_y, origin_x, origin_y, color }
+---@param opts? table { rotate, scale_x, scale_y, origin_x, origin_y, color, layer, blend, texture }
 function M.draw(batch, sx, sy, sw, sh, dx, dy, opts)
-    if batch.quad_count >= MAX_QUADS then
+    local core = batch.core
+    if not core:draw(sx, sy, sw, sh, dx, dy, opts) then
         M.flush(batch)
+        core:draw(sx, sy, sw, sh, dx, dy, opts)
     end
+end
 
-    local r, g, b, a = 1.0, 1.0, 1.0, 1.0
-    local rotate = 0
-    local scale_x, scale_y = 1.0, 1.0
-    local origin_x, origin_y = 0, 0
-
-    if opts then
-        if opts.color then
-            r = opts.color[1] or 1.0
-            g = opts.color[2] or 1.0
-            b = opts.color[3] or 1.0
-            a = opts.color[4] or 1.0
-        end
-        rotate = opts.rotate or 0
-        scale_x = opts.scale_x or 1.0
-        scale_y = opts.scale_y or 1.0
-        origin_x = opts.origin_x or 0
-        origin_y = opts.origin_y or 0
+--- Draw a packed atlas region (see lib.atlas)
+--- The region's page texture is registered with the batch on first use.
+---@param batch sprite.Batch
+---@param region atlas.Region
+---@param dx number destination X on screen (pixels)
+---@param dy number destination Y on screen (pixels)
+---@param opts? table same as sprite.draw (opts.texture is ignored)
+function M.draw_region(batch, region, dx, dy, opts)
+    local page = region.page
+    local slot = batch.texture_slots[page]
+    if not slot then
+        assert(page.view, "atlas page not built (call atlas:build() first)")
+        slot = M.add_texture(batch, page, page.w, page.h)
     end
-
-    -- UV coordinates
-    local u0 = sx / batch.tex_w
-    local v0 = sy / batch.tex_h
-    local u1 = (sx + sw) / batch.tex_w
-    local v1 = (sy + sh) / batch.tex_h
-
-    -- Local quad corners relative to origin
-    local x0 = -origin_x * scale_x
-    local y0 = -origin_y * scale_y
-    local x1 = (sw - origin_x) * scale_x
-    local y1 = (sh - origin_y) * scale_y
-
-    -- Apply rotation and translate to destination
-    local cos_r, sin_r = math.cos(rotate), math.sin(rotate)
-    local function transform(lx, ly)
-        return dx + origin_x + lx * cos_r - ly * sin_r, dy + origin_y + lx * sin_r + ly * cos_r
+    local core = batch.core
+    if not core:draw(region.x, region.y, region.w, region.h, dx, dy, opts, slot) then
+        M.flush(batch)
+        core:draw(region.x, region.y, region.w, region.h, dx, dy, opts, slot)
     end
-
-    local ax, ay = transform(x0, y0)
-    local bx, by = transform(x1, y0)
-    local cx, cy = transform(x1, y1)
-    local ddx, ddy = transform(x0, y1)
-
-    -- Append 4 vertices (top-left, top-right, bottom-right, bottom-left)
-    local v = batch.verts
-    local n = #v
-    -- top-left
-    v[n + 1] = ax
-    v[n + 2] = ay
-    v[n + 3] = u0
-    v[n + 4] = v0
-    v[n + 5] = r
-    v[n + 6] = g
-    v[n + 7] = b
-    v[n + 8] = a
-    -- top-right
-    v[n + 9] = bx
-    v[n + 10] = by
-    v[n + 11] = u1
-    v[n + 12] = v0
-    v[n + 13] = r
-    v[n + 14] = g
-    v[n + 15] = b
-    v[n + 16] = a
-    -- bottom-right
-    v[n + 17] = cx
-    v[n + 18] = cy
-    v[n + 19] = u1
-    v[n + 20] = v1
-    v[n + 21] = r
-    v[n + 22] = g
-    v[n + 23] = b
-    v[n + 24] = a
-    -- bottom-left
-    v[n + 25] = ddx
-    v[n + 26] = ddy
-    v[n + 27] = u0
-    v[n + 28] = v1
-    v[n + 29] = r
-    v[n + 30] = g
-    v[n + 31] = b
-    v[n + 32] = a
-
-    batch.quad_count = batch.quad_count + 1
 end
 
---- Flush queued sprites: upload vertex data and issue draw call
+--- Flush queued sprites: sort into runs, upload once, and issue one draw
+--- call per (layer, texture, blend) run
 --- Must be called between gfx.begin_pass and gfx.end_pass
 ---@param batch sprite.Batch
 function M.flush(batch)
-    if batch.quad_count == 0 then
+    local core = batch.core
+    local quad_count = core:count()
+    if quad_count == 0 then
         return
     end
 
-    -- Upload vertex data
-    local packed = util.pack_floats(batch.verts)
-    gfx.update_buffer(batch.vbuf.handle, gfx.Range(packed))
-
-    -- Apply pipeline and bindings
-    assert(shared_pipeline, "shared_pipeline not initialized")
-    gfx.apply_pipeline(shared_pipeline)
-    gfx.apply_bindings(gfx.Bindings({
-        vertex_buffers = { batch.vbuf.handle },
-        index_buffer = batch.ibuf.handle,
-        views = { batch.tex_view.handle },
-        samplers = { batch.tex_smp.handle },
-    }))
-
-    -- Set screen size uniform
-    local params = util.pack_floats({ batch.screen_w, batch.screen_h, 0, 0 })
-    gfx.apply_uniforms(0, gfx.Range(params))
+    -- Sort first: append uploads the reordered data
+    local run_count = core:sort()
+    local quad_bytes = core:quad_bytes()
+    local vbuf = batch.stream:acquire(quad_count * quad_bytes).handle
+    local base = core:append(vbuf)
+
+    local kind = batch.instanced and "instanced" or "vertex"
+    local params = gfx.Range(util.pack_floats({ batch.screen_w, batch.screen_h, 0, 0 }))
+    local cur_pip, cur_tex = nil, nil
+    for i = 1, run_count do
+        local _, tex_slot, blend, first, count = core:run(i)
+        local pip = get_pipeline(kind, blend)
+        local tex = batch.textures[tex_slot + 1]
+        assert(pip, "sprite pipeline not initialized")
+        assert(tex, "sprite texture slot has no texture")
+
+        local pip_changed = pip ~= cur_pip
+        if pip_changed then
+            gfx.apply_pipeline(pip)
+            gfx.apply_uniforms(0, params)
+            cur_pip = pip
+        end
 
-    -- Draw
-    gfx.draw(0, batch.quad_count * INDICES_PER_QUAD, 1)
+        if batch.instanced then
+            -- Instance data is addressed through the vertex buffer offset
+            gfx.apply_bindings(gfx.Bindings({
+                vertex_buffers = { unit_quad_vbuf.handle, vbuf },
+                vertex_buffer_offsets = { 0, base + first * quad_bytes },
+                views = { tex.view.handle },
+                samplers = { tex.smp.handle },
+            }))
+            gfx.draw(0, 4, count)
+        else
+            if pip_changed or tex ~= cur_tex then
+                gfx.apply_bindings(gfx.Bindings({
+                    vertex_buffers = { vbuf },
+                    vertex_buffer_offsets = { base },
+                    index_buffer = batch.ibuf.handle,
+                    views = { tex.view.handle },
+                    samplers = { tex.smp.handle },
+                }))
+            end
+            gfx.draw(first * INDICES_PER_QUAD, count * INDICES_PER_QUAD, 1)
+        end
+        cur_tex = tex
+        batch.draw_calls = batch.draw_calls + 1
+    end
 
     -- Reset
-    batch.verts = {}
-    batch.quad_count = 0
+    core:clear()
 end
 
 --- Destroy a batch's GPU resources (call before gfx.shutdown)
 ---@param batch sprite.Batch
 function M.destroy_batch(batch)
-    if batch.vbuf then
-        batch.vbuf:destroy()
-        batch.vbuf = nil
+    if batch.core then
+        batch.core:destroy()
+        batch.core = nil
     end
+    batch.stream = nil
     if batch.ibuf then
         batch.ibuf:destroy()
         batch.ibuf = nil
@@ -363,14 +463,25 @@ end
 
 --- Shutdown shared resources (call before gfx.shutdown)
 function M.shutdown()
-    if shared_pipeline then
-        gfx.destroy_pipeline(shared_pipeline)
-        shared_pipeline = nil
+    for _, by_blend in pairs(pipelines) do
+        for blend, pip in pairs(by_blend) do
+            pipeline_cache.release(pip)
+            by_blend[blend] = nil
+        end
+    end
+    for kind, shd in pairs(shaders) do
+        gfx.destroy_shader(shd)
+        shaders[kind] = nil
+    end
+    if unit_quad_vbuf then
+        unit_quad_vbuf:destroy()
+        unit_quad_vbuf = nil
     end
-    if shared_shader then
-        gfx.destroy_shader(shared_shader)
-        shared_shader = nil
+    if shared_stream then
+        shared_stream:destroy()
+        shared_stream = nil
     end
+    shared_ibuf_data = {}
 end
 
 return M
@@ -4,6 +4,9 @@ local gpu = require("lib.gpu")
 local log = require("lib.log")
 local stb = require("stb.image")
 local fs = require("lub3d.fs")
+local image = require("lub3d.image")
+local texture_cache = require("lib.texture_cache")
+local util = require("lib.util")
 
 -- Optional bc7enc module
 local bc7enc_ok, bc7enc = pcall(require, "bc7enc")
@@ -35,6 +38,28 @@ end
 ---@field img gpu.Image
 ---@field view gpu.View
 ---@field smp gpu.Sampler
+---@field premultiplied boolean? color is premultiplied by alpha (draw with sprite.Blend.PREMULTIPLIED)
+
+-- Reused by M.load: pixels are decoded into pixel_buffer and mips generated
+-- into mip_buffer, so neither is copied into Lua strings on the way to
+-- gfx.Range. mip_buffer keeps its allocation for the next texture.
+local pixel_buffer = image.buffer()
+local mip_buffer = image.buffer()
+
+-- Decode an image file already in memory
+---@param data string file contents
+---@param name string file name for error messages
+---@return texture.ImageData?
+---@return string? err
+local function decode_image_data(data, name)
+    util.profile_begin("texture", "decode " .. name)
+    local w, h, ch, pixels = stb.load_from_memory(data, 4)
+    util.profile_end("texture", "decode " .. name)
+    if not w then
+        return nil, "Failed to load: " .. name .. " (stb error: " .. tostring(h) .. ")"
+    end
+    return { w = w, h = h, ch = ch, pixels = pixels }, nil
+end
 
 -- Load raw image data from file
 ---@param filename string path to image file
@@ -46,146 +71,350 @@ function M.load_image_data(filename)
     if not data then
         return nil, "Failed to read: " .. resolved
     end
-    local w, h, ch, pixels = stb.load_from_memory(data, 4)
-    if not w then
-        return nil, "Failed to load: " .. resolved .. " (stb error: " .. tostring(h) .. ")"
-    end
-    return { w = w, h = h, ch = ch, pixels = pixels }, nil
+    return decode_image_data(data, resolved)
 end
 
--- Load texture from file using gpu wrappers (GC-safe)
----@param filename string path to image file (PNG, JPG, etc.)
----@param opts? table optional settings { filter_min, filter_mag, wrap_u, wrap_v }
----@return texture.LoadResult?
----@return string? err
-function M.load(filename, opts)
-    opts = opts or {}
-
-    local data, err = M.load_image_data(filename)
+-- Read the size of an image without decoding its pixels
+---@param filename string path to image file (PNG, JPG, KTX2, DDS, etc.)
+---@return integer? width
+---@return integer|string height or error message
+function M.probe(filename)
+    local resolved = resolve_path(filename)
+    local data = fs.read(resolved)
     if not data then
-        return nil, err or "Failed to load image"
+        return nil, "Failed to read: " .. resolved
     end
+    local info = image.parse_texture(data)
+    if info then
+        return info.width, info.height
+    end
+    local w, h = image.info(data)
+    if not w then
+        return nil, "Failed to probe: " .. resolved .. " (stb error: " .. tostring(h) .. ")"
+    end
+    return w, h
+end
 
-    log.info("Loaded texture: " .. filename .. " (" .. data.w .. "x" .. data.h .. ")")
-
-    -- Create image with gpu wrapper (GC-safe)
-    local img = gpu.image(gfx.ImageDesc({
-        width = data.w,
-        height = data.h,
-        pixel_format = gfx.PixelFormat.RGBA8,
-        data = { mip_levels = { gfx.Range(data.pixels) } },
-    }))
+-- Texel processing requested by load options (see image.process), nil for none
+-- premultiply, swizzle, normal_z and convert run once here instead of in
+-- every shader invocation, before the mips are built.
+---@param opts table
+---@return table?
+local function process_ops(opts)
+    if not (opts.premultiply or opts.swizzle or opts.normal_z or opts.convert) then
+        return nil
+    end
+    return {
+        premultiply = opts.premultiply,
+        swizzle = opts.swizzle,
+        normal_z = opts.normal_z,
+        convert = opts.convert,
+        srgb = opts.srgb,
+    }
+end
 
-    if gfx.query_image_state(img.handle) ~= gfx.ResourceState.VALID then
-        return nil, "Failed to create image"
+-- Build the mip chain for an RGBA8 image (just level 0 when opts.mips is false)
+---@param data texture.ImageData
+---@param opts table
+---@return string[] levels
+local function mip_levels(data, opts)
+    local pixels = data.pixels
+    local ops = process_ops(opts)
+    if ops then
+        pixels = image.process(pixels, ops)
+    end
+    if opts.mips == false then
+        return { pixels }
     end
+    return image.gen_mips(pixels, data.w, data.h, {
+        srgb = opts.srgb or false,
+        filter = opts.mip_filter,
+    })
+end
 
+-- Create view and sampler for an uploaded image
+---@param img gpu.Image
+---@param opts table
+---@param processed boolean? the texels went through process_ops(opts)
+---@return texture.LoadResult
+local function finish_texture(img, opts, processed)
     -- Create view from image (required for binding)
     local view = gpu.view(gfx.ViewDesc({
         texture = { image = img.handle },
     }))
 
-    -- Create sampler
     local smp = gpu.sampler(gfx.SamplerDesc({
         min_filter = opts.filter_min or gfx.Filter.LINEAR,
         mag_filter = opts.filter_mag or gfx.Filter.LINEAR,
+        mipmap_filter = opts.filter_mip or gfx.Filter.LINEAR,
         wrap_u = opts.wrap_u or gfx.Wrap.REPEAT,
         wrap_v = opts.wrap_v or gfx.Wrap.REPEAT,
     }))
 
-    return { img = img, view = view, smp = smp }, nil
+    return { img = img, view = view, smp = smp, premultiplied = processed and opts.premultiply or nil }
 end
 
--- Load texture with BC7 compression support
--- If .bc7 file exists, use it directly. Otherwise, load PNG and convert to BC7.
----@param filename string path to image file (PNG, JPG, etc.)
----@param opts? table optional settings { filter_min, filter_mag, wrap_u, wrap_v, srgb, rdo_quality }
+-- Create view and sampler for an image uploaded elsewhere (e.g. by lub3d.texloader)
+---@param img gpu.Image
+---@param opts? table optional settings { filter_min, filter_mag, filter_mip, wrap_u, wrap_v, premultiply }
+---@return texture.LoadResult
+function M.from_image(img, opts)
+    return finish_texture(img, opts or {}, true)
+end
+
+-- Create image, view and sampler from per-level pixel data
+---@param w integer
+---@param h integer
+---@param pixel_format sokol.gfx.PixelFormat
+---@param levels (string|{ ptr: lightuserdata, size: integer })[] strings or buffer ranges
+---@param opts table
 ---@return texture.LoadResult?
 ---@return string? err
-function M.load_bc7(filename, opts)
+local function create_texture(w, h, pixel_format, levels, opts)
+    local ranges = {}
+    for i, level in ipairs(levels) do
+        ranges[i] = gfx.Range(level)
+    end
+    local img = gpu.image(gfx.ImageDesc({
+        width = w,
+        height = h,
+        num_mipmaps = #levels,
+        pixel_format = pixel_format,
+        data = { mip_levels = ranges },
+    }))
+
+    if gfx.query_image_state(img.handle) ~= gfx.ResourceState.VALID then
+        return nil, "Failed to create image"
+    end
+
+    return finish_texture(img, opts, true), nil
+end
+
+-- Load a precompressed KTX2 or DDS texture
+-- Headers are parsed natively and every mip level / array layer is uploaded
+-- straight from the file data.
+---@param filename string path to .ktx2 or .dds file
+---@param opts? table optional settings { filter_min, filter_mag, filter_mip, wrap_u, wrap_v }
+---@return texture.LoadResult?
+---@return string? err
+function M.load_container(filename, opts)
     opts = opts or {}
+    local resolved = resolve_path(filename)
+    local data = fs.read(resolved)
+    if not data then
+        return nil, "Failed to read: " .. resolved
+    end
+    local handle, info = image.make_image(data, filename)
+    if not handle then
+        return nil, "Failed to load: " .. resolved .. " (" .. tostring(info) .. ")"
+    end
+    ---@cast info -string
+    log.info(string.format("Loaded texture: %s (%dx%d %s, %d mips, %d layers)",
+        filename, info.width, info.height, info.format_name, info.levels, info.layers * info.faces))
+    return finish_texture(gpu.wrap_image(handle), opts), nil
+end
 
-    -- If bc7enc not available, fall back to regular load
-    if not bc7enc then
-        return M.load(filename, opts)
+-- Load texture from file using gpu wrappers (GC-safe)
+-- Generates a full mip chain unless opts.mips is false. KTX2 and DDS files
+-- are loaded with load_container. premultiply, swizzle ("bgra", "ag01", ...),
+-- normal_z (rebuild b from r, g) and convert ("linear" or "srgb") process
+-- the decoded texels once, before the mips (see image.process).
+---@param filename string path to image file (PNG, JPG, KTX2, DDS, etc.)
+---@param opts? table optional settings { filter_min, filter_mag, filter_mip, wrap_u, wrap_v, srgb, mips, mip_filter, premultiply, swizzle, normal_z, convert }
+---@return texture.LoadResult?
+---@return string? err
+function M.load(filename, opts)
+    opts = opts or {}
+
+    local ext = filename:match("%.([^./\\]+)$")
+    ext = ext and ext:lower()
+    if ext == "ktx2" or ext == "dds" then
+        return M.load_container(filename, opts)
     end
 
-    -- Generate BC7 cache path
-    local bc7_path = filename:gsub("%.[^.]+$", ".bc7")
     local resolved = resolve_path(filename)
-    local resolved_bc7 = resolve_path(bc7_path)
-
-    local w, h, compressed
-
-    -- Check timestamps: use BC7 cache only if it's newer than source
-    local src_mtime = fs.mtime(resolved)
-    local bc7_mtime = fs.mtime(resolved_bc7)
-    local use_cache = bc7_mtime and src_mtime and bc7_mtime >= src_mtime
-
-    -- Try to load existing BC7 file if cache is valid
-    if use_cache then
-        local cache_data = fs.read(resolved_bc7)
-        if cache_data and #cache_data >= 8 then
-            -- BC7 file format: 4 bytes width, 4 bytes height, then compressed data
-            w, h = string.unpack("<I4I4", cache_data)
-            compressed = cache_data:sub(9)
-            log.info("Loaded BC7 cache: " .. bc7_path .. " (" .. w .. "x" .. h .. ")")
-        end
+    local data = fs.read(resolved)
+    if not data then
+        return nil, "Failed to read: " .. resolved
+    end
+    util.profile_begin("texture", "decode " .. filename)
+    local w, h = image.decode(data, pixel_buffer, 4)
+    local decode_ms = util.profile_end("texture", "decode " .. filename)
+    if not w then
+        return nil, "Failed to load: " .. resolved .. " (stb error: " .. tostring(h) .. ")"
+    end
+    ---@cast h integer
+    local ops = process_ops(opts)
+    if ops then
+        image.process(pixel_buffer, ops)
     end
 
-    -- If no valid cache, load source and encode to BC7
-    if not compressed then
-        local img_data, err = M.load_image_data(filename)
-        if not img_data then
-            return nil, err or "Failed to load image"
-        end
-        w, h = img_data.w, img_data.h
+    local levels
+    if opts.mips == false then
+        levels = { pixel_buffer:range() }
+    else
+        levels = image.gen_mips(pixel_buffer, w, h, {
+            srgb = opts.srgb or false,
+            filter = opts.mip_filter,
+            into = mip_buffer,
+        })
+    end
+    log.info(string.format("Loaded texture: %s (%dx%d, %d mips%s)", filename, w, h, #levels,
+        decode_ms and string.format(", decoded in %.1fms", decode_ms) or ""))
+
+    -- sokol copies the levels, so the decoded pixels can go right away
+    local pixel_format = opts.srgb and gfx.PixelFormat.SRGB8A8 or gfx.PixelFormat.RGBA8
+    local result, err = create_texture(w, h, pixel_format, levels, opts)
+    pixel_buffer:release()
+    return result, err
+end
+
+-- Block format for each kind of texture: BC7 for color, BC5 (two channels,
+-- the shader rebuilds z) for tangent-space normals, BC4 for single-channel
+-- masks such as roughness or AO, and BC1 for opaque color where half the
+-- memory of BC7 matters more than its quality.
+local USAGE_FORMATS <const> = { color = "bc7", normal = "bc5", mask = "bc4", opaque = "bc1" }
 
-        compressed = bc7enc.encode(img_data.pixels, w, h, {
+local PIXEL_FORMATS <const> = {
+    bc1 = gfx.PixelFormat.BC1_RGBA,
+    bc4 = gfx.PixelFormat.BC4_R,
+    bc5 = gfx.PixelFormat.BC5_RG,
+    bc7 = gfx.PixelFormat.BC7_RGBA,
+}
+
+---Block format for opts.format, or else for opts.usage
+---("color" (default), "normal", "mask" or "opaque"). Only BC7 has an sRGB
+---variant, so sRGB textures chosen by usage are encoded to BC7.
+---@param opts? table { format, usage, srgb }
+---@return string format
+function M.select_format(opts)
+    opts = opts or {}
+    if opts.format then
+        return opts.format
+    end
+    local format = USAGE_FORMATS[opts.usage or "color"]
+    if not format then
+        error("Unknown texture usage: " .. tostring(opts.usage))
+    end
+    if opts.srgb then
+        return "bc7"
+    end
+    return format
+end
+
+-- Generate mips and compress every level
+-- opts.format is "bc1", "bc4", "bc5", "bc7" or "rgba8"; without it the
+-- format follows opts.usage (see M.select_format) when bc7enc is available.
+---@param data texture.ImageData
+---@param opts? table { format, usage, srgb, mips, mip_filter, rdo_quality, threads, premultiply, swizzle, normal_z, convert }
+---@return string[]? levels
+---@return sokol.gfx.PixelFormat|string pixel_format or error message
+function M.encode_levels(data, opts)
+    opts = opts or {}
+    local srgb = opts.srgb or false
+    if opts.usage and not USAGE_FORMATS[opts.usage] then
+        return nil, "Unknown texture usage: " .. tostring(opts.usage)
+    end
+    local format = opts.format or (bc7enc and M.select_format(opts) or "rgba8")
+    if format ~= "rgba8" and not PIXEL_FORMATS[format] then
+        return nil, "Unknown texture format: " .. tostring(format)
+    elseif format ~= "rgba8" and not bc7enc then
+        return nil, format:upper() .. " encoding requires bc7enc"
+    elseif srgb and format ~= "rgba8" and format ~= "bc7" then
+        return nil, format:upper() .. " has no sRGB variant"
+    end
+    local levels = mip_levels(data, opts)
+    if format == "rgba8" then
+        return levels, srgb and gfx.PixelFormat.SRGB8A8 or gfx.PixelFormat.RGBA8
+    end
+
+    local w, h = data.w, data.h
+    for i, pixels in ipairs(levels) do
+        local compressed = bc7enc.encode(pixels, w, h, {
+            format = format,
             quality = 5,
-            srgb = opts.srgb or false,
+            srgb = srgb,
             rdo_quality = opts.rdo_quality or 0,
+            threads = opts.threads or 0,
         })
-
         if not compressed then
-            return nil, "BC7 encoding failed"
+            return nil, format:upper() .. " encoding failed"
         end
-
-        -- Save BC7 cache file
-        local header = string.pack("<I4I4", w, h)
-        fs.write(resolved_bc7, header .. compressed)
-        log.info("Saved BC7 cache: " .. bc7_path .. " (" .. w .. "x" .. h .. ")")
+        levels[i] = compressed
+        w, h = math.max(1, w // 2), math.max(1, h // 2)
     end
+    if srgb then
+        return levels, gfx.PixelFormat.BC7_SRGBA
+    end
+    return levels, PIXEL_FORMATS[format]
+end
 
-    if not w or not h or not compressed then
-        return nil, "Invalid image data"
+-- Load texture with block compression (BC7, or the format M.select_format
+-- picks for opts.format / opts.usage)
+-- Encoded textures are kept in lib.texture_cache, keyed by a hash of the
+-- source bytes and the encoder settings, so the cache works for read-only
+-- and packed assets and is rebuilt whenever either changes. On a miss,
+-- decode the source, generate mips and compress every level.
+---@param filename string path to image file (PNG, JPG, etc.)
+---@param opts? table optional settings { filter_min, filter_mag, filter_mip, wrap_u, wrap_v, srgb, format, usage, mips, mip_filter, rdo_quality, threads, premultiply, swizzle, normal_z, convert }
+---@return texture.LoadResult?
+---@return string? err
+function M.load_bc7(filename, opts)
+    opts = opts or {}
+
+    -- If bc7enc not available, fall back to regular load
+    if not bc7enc then
+        return M.load(filename, opts)
     end
 
-    -- Upload BC7 to GPU
-    local pixel_format = opts.srgb and gfx.PixelFormat.BC7_SRGBA or gfx.PixelFormat.BC7_RGBA
-    local img = gpu.image(gfx.ImageDesc({
-        width = w,
-        height = h,
-        pixel_format = pixel_format,
-        data = { mip_levels = { gfx.Range(compressed) } },
-    }))
+    local resolved = resolve_path(filename)
+    local data = fs.read(resolved)
+    if not data then
+        return nil, "Failed to read: " .. resolved
+    end
+    local encode_opts = {
+        format = M.select_format(opts),
+        srgb = opts.srgb,
+        mips = opts.mips,
+        mip_filter = opts.mip_filter,
+        rdo_quality = opts.rdo_quality,
+        threads = opts.threads,
+        premultiply = opts.premultiply,
+        swizzle = opts.swizzle,
+        normal_z = opts.normal_z,
+        convert = opts.convert,
+    }
 
-    if gfx.query_image_state(img.handle) ~= gfx.ResourceState.VALID then
-        return nil, "Failed to create BC7 image"
+    -- Try the cached KTX2 file
+    local key = texture_cache.config.enabled and texture_cache.key(data, texture_cache.params(encode_opts))
+    local cached = key and texture_cache.get(key)
+    if cached then
+        local handle, info = image.make_image(cached, filename)
+        if handle then
+            ---@cast info -string
+            log.info("Loaded " .. encode_opts.format:upper() .. " cache: " .. filename .. " (" .. info.width .. "x" .. info.height
+                .. ", " .. info.levels .. " mips)")
+            return finish_texture(gpu.wrap_image(handle), opts, true), nil
+        end
     end
 
-    local view = gpu.view(gfx.ViewDesc({
-        texture = { image = img.handle },
-    }))
+    -- No valid cache: decode source and compress every level
+    local img_data, err = decode_image_data(data, resolved)
+    if not img_data then
+        return nil, err or "Failed to load image"
+    end
+    local levels, format_or_err = M.encode_levels(img_data, encode_opts)
+    if not levels then
+        return nil, tostring(format_or_err)
+    end
+    local pixel_format = format_or_err --[[@as sokol.gfx.PixelFormat]]
 
-    local smp = gpu.sampler(gfx.SamplerDesc({
-        min_filter = opts.filter_min or gfx.Filter.LINEAR,
-        mag_filter = opts.filter_mag or gfx.Filter.LINEAR,
-        wrap_u = opts.wrap_u or gfx.Wrap.REPEAT,
-        wrap_v = opts.wrap_v or gfx.Wrap.REPEAT,
-    }))
+    if key and texture_cache.put(key, image.encode_ktx2(levels, img_data.w, img_data.h, pixel_format)) then
+        log.info("Saved " .. encode_opts.format:upper() .. " cache: " .. filename .. " -> " .. texture_cache.path(key))
+    end
 
-    return { img = img, view = view, smp = smp }, nil
+    -- Upload compressed levels to GPU
+    return create_texture(img_data.w, img_data.h, pixel_format, levels, opts)
 end
 
 return M
@@ -0,0 +1,254 @@
+-- lib/texture_cache.lua
+-- Central cache of encoded textures, keyed by content hash
+-- Entries are KTX2 files named after the XXH64 of the source bytes and the
+-- encoder settings, so they stay valid for read-only asset directories and
+-- pack data, and change whenever the source or the settings change.
+-- An index file records each entry's size and last use; when the cache
+-- grows past max_bytes the least recently used entries are deleted.
+-- The index is saved at most every SAVE_INTERVAL seconds, so batch users
+-- (lub3d cook, the texture manager, app cleanup) call M.save() when done.
+-- Entries and the index are written with fs.write_atomic, and the index is
+-- merged with the copy on disk before saving, so concurrent runs (e.g. a
+-- game and lub3d convert) do not corrupt or forget each other's entries.
+local fs = require("lub3d.fs")
+local hash = require("lub3d.hash")
+local log = require("lib.log")
+
+---@class texture_cache
+local M = {}
+
+-- Texture cache configuration
+M.config = {
+    enabled = true,
+    dir = "assets/texture_cache",
+    max_bytes = 1024 * 1024 * 1024,
+    version = 1, -- Bump to invalidate all entries
+}
+
+local INDEX_FILE <const> = "index.txt"
+local INDEX_HEADER <const> = "lub3d-texture-cache 1"
+local SAVE_INTERVAL <const> = 30 -- seconds between index saves; callers save() when done
+
+---@class texture_cache.Entry
+---@field size integer
+---@field used integer last use (os.time)
+---@field seq integer use order within this run (breaks ties in used)
+
+---@type table<string, texture_cache.Entry>
+local entries = {}
+---@type table<string, boolean>
+local removed = {}
+local loaded_dir = nil ---@type string?
+local dirty = false
+local last_save = 0
+local seq = 0
+
+---@param dir string
+---@return table<string, texture_cache.Entry>
+local function read_index(dir)
+    local result = {}
+    local data = fs.read(dir .. "/" .. INDEX_FILE)
+    if not data or data:sub(1, #INDEX_HEADER) ~= INDEX_HEADER then
+        return result
+    end
+    for key, size, used in data:gmatch("(%x+) (%d+) (%d+)\n") do
+        result[key] = { size = tonumber(size) --[[@as integer]], used = tonumber(used) --[[@as integer]], seq = 0 }
+    end
+    return result
+end
+
+---@param key string
+---@return string path
+function M.path(key)
+    return M.config.dir .. "/" .. key .. ".ktx2"
+end
+
+---Encoder settings that affect the output, as a string for M.key
+---Texel processing (image.process options) is only listed when requested,
+---so entries of unprocessed textures keep their keys.
+---@param opts table { format, srgb, mips, mip_filter, rdo_quality, premultiply, swizzle, normal_z, convert }
+---@return string
+function M.params(opts)
+    local params = string.format("v%d|%s|srgb=%s|mips=%s|filter=%s|rdo=%s", M.config.version,
+        opts.format or "bc7", opts.srgb and 1 or 0, opts.mips == false and 0 or 1,
+        opts.mip_filter or "box", tostring(opts.rdo_quality or 0))
+    if opts.premultiply or opts.swizzle or opts.normal_z or opts.convert then
+        params = params .. string.format("|premultiply=%s|swizzle=%s|normal_z=%s|convert=%s",
+            opts.premultiply and 1 or 0, opts.swizzle or "rgba", opts.normal_z and 1 or 0, opts.convert or "none")
+    end
+    return params
+end
+
+---Cache key for source bytes encoded with params
+---@param data string source file contents
+---@param params string from M.params
+---@return string key 16 hex digits
+function M.key(data, params)
+    return string.format("%016x", hash.xxh64(params, hash.xxh64(data)))
+end
+
+-- Drop least recently used entries of dir until the cache fits max_bytes
+---@param dir string
+local function evict(dir)
+    local total = 0
+    local list = {}
+    for key, e in pairs(entries) do
+        total = total + e.size
+        list[#list + 1] = key
+    end
+    if total <= M.config.max_bytes then
+        return
+    end
+    table.sort(list, function(a, b)
+        local ea, eb = entries[a], entries[b]
+        if ea.used ~= eb.used then
+            return ea.used < eb.used
+        end
+        return ea.seq < eb.seq
+    end)
+    for _, key in ipairs(list) do
+        if total <= M.config.max_bytes then
+            break
+        end
+        os.remove(dir .. "/" .. key .. ".ktx2")
+        total = total - entries[key].size
+        entries[key] = nil
+        removed[key] = true
+        log.info("texture_cache: evicted " .. key)
+    end
+end
+
+-- Write the index of dir, merged with entries other processes added meanwhile
+---@param dir string
+local function flush(dir)
+    for key, e in pairs(read_index(dir)) do
+        local mine = entries[key]
+        if not mine and not removed[key] then
+            entries[key] = e
+        elseif mine and e.used > mine.used then
+            mine.used = e.used
+        end
+    end
+    evict(dir)
+
+    local lines = { INDEX_HEADER }
+    for key, e in pairs(entries) do
+        lines[#lines + 1] = string.format("%s %d %d", key, e.size, e.used)
+    end
+    fs.mkdir(dir)
+    fs.write_atomic(dir .. "/" .. INDEX_FILE, table.concat(lines, "\n") .. "\n")
+    dirty = false
+    last_save = os.time()
+end
+
+-- Load the index when first used or after config.dir changed, saving
+-- unsaved changes of the previous directory first
+local function ensure_index()
+    if loaded_dir ~= M.config.dir then
+        if dirty and loaded_dir then
+            flush(loaded_dir)
+        end
+        loaded_dir = M.config.dir
+        entries = read_index(M.config.dir)
+        removed = {}
+        dirty = false
+    end
+end
+
+---Write the index if it changed, merged with entries other processes
+---added meanwhile
+function M.save()
+    ensure_index()
+    if dirty then
+        flush(M.config.dir)
+    end
+end
+
+---Mark an entry as used (e.g. after a texloader worker read it)
+---@param key string
+function M.touch(key)
+    ensure_index()
+    local e = entries[key]
+    if not e then
+        return
+    end
+    seq = seq + 1
+    e.used, e.seq = os.time(), seq
+    dirty = true
+    if os.time() - last_save >= SAVE_INTERVAL then
+        M.save()
+    end
+end
+
+---Register an entry written directly to M.path(key) (e.g. by a texloader worker)
+---@param key string
+---@param size integer bytes
+function M.record(key, size)
+    ensure_index()
+    seq = seq + 1
+    entries[key] = { size = size, used = os.time(), seq = seq }
+    removed[key] = nil
+    dirty = true
+    if os.time() - last_save >= SAVE_INTERVAL then
+        M.save()
+    end
+end
+
+---Read an entry
+---@param key string
+---@return string? data KTX2 file contents
+function M.get(key)
+    if not M.config.enabled then
+        return nil
+    end
+    ensure_index()
+    local data = fs.read(M.path(key))
+    if data then
+        if not entries[key] then
+            -- Written by a run whose index update was lost
+            M.record(key, #data)
+        else
+            M.touch(key)
+        end
+    elseif entries[key] then
+        entries[key] = nil
+        removed[key] = true
+        dirty = true
+    end
+    return data
+end
+
+---Store an entry
+---@param key string
+---@param data string KTX2 file contents
+---@return boolean success
+function M.put(key, data)
+    if not M.config.enabled then
+        return false
+    end
+    fs.mkdir(M.config.dir)
+    if not fs.write_atomic(M.path(key), data) then
+        return false
+    end
+    M.record(key, #data)
+    return true
+end
+
+---Make sure the cache directory exists (before workers write into it)
+---@return boolean success
+function M.prepare()
+    return M.config.enabled and fs.mkdir(M.config.dir)
+end
+
+---@return { entries: integer, bytes: integer }
+function M.stats()
+    ensure_index()
+    local count, bytes = 0, 0
+    for _, e in pairs(entries) do
+        count = count + 1
+        bytes = bytes + e.size
+    end
+    return { entries = count, bytes = bytes }
+end
+
+return M
@@ -0,0 +1,506 @@
+-- lib/texture_manager.lua
+-- Asynchronous texture loading on top of lub3d.texloader
+-- get() returns immediately with a placeholder texture; files are read,
+-- decoded, mipmapped and (optionally) BCn encoded on worker threads, and
+-- update() uploads finished textures each frame within a byte budget,
+-- swapping them into the objects get() returned. Read tex.view.handle /
+-- tex.smp.handle when drawing rather than caching the handles.
+--
+-- With opts.stream, textures are streamed: get() first loads a small
+-- version (min_size), use() reports how large each texture is drawn, and
+-- update() requests sharper versions of textures drawn larger than they
+-- are resident. When that would exceed memory_budget, the sharp versions
+-- of textures not used for idle_frames are dropped back to their small
+-- version, which always stays resident.
+local gfx = require("sokol.gfx")
+local gpu = require("lib.gpu")
+local log = require("lib.log")
+local texture = require("lib.texture")
+local texture_cache = require("lib.texture_cache")
+local util = require("lib.util")
+local texloader = require("lub3d.texloader")
+
+---@class texture_manager
+local M = {}
+
+---@class texture_manager.Level
+---@field img gpu.Image
+---@field view gpu.View
+---@field smp gpu.Sampler
+---@field width integer
+---@field height integer
+---@field bytes integer
+
+---@class texture_manager.Texture: texture.LoadResult
+---@field path string
+---@field format string? block format ("bc1", "bc4", "bc5" or "bc7"), nil for RGBA8
+---@field params string texture_cache.params of the settings (cache params of BCn requests)
+---@field ready boolean true once the real texture replaced the placeholder
+---@field error string? set when loading failed (the placeholder stays)
+---@field width integer? resident size
+---@field height integer?
+---@field full_width integer? size of the source image
+---@field full_height integer?
+---@field opts table
+---@field stream boolean
+---@field base texture_manager.Level? first version loaded (small when streamed)
+---@field high texture_manager.Level? sharper streamed version
+---@field loading integer? request id in flight
+---@field requested integer? max_size of the request in flight
+---@field failed_size integer? smallest streamed size whose load failed (not requested again)
+---@field reserved integer bytes reserved for a streaming request in flight
+---@field wanted integer largest size passed to use() since the last update
+---@field last_used integer frame of the last use()
+
+---@class texture_manager.Stats
+---@field requested integer load requests (including streaming upgrades)
+---@field hits integer get() calls served by an existing entry
+---@field misses integer get() calls that queued a load
+---@field pending integer requests not uploaded yet
+---@field loaded integer
+---@field failed integer
+---@field bytes integer total uploaded bytes
+---@field frame_bytes integer bytes uploaded by the last update
+---@field cache_hits integer compressed textures read from lib.texture_cache
+---@field cache_misses integer compressed textures encoded
+---@field progress number 0..1
+---@field resident_bytes integer GPU bytes of the textures currently kept
+---@field memory_budget integer? streaming budget in bytes
+---@field upgrades integer sharper versions loaded by streaming
+---@field evictions integer sharper versions dropped to stay in budget
+
+---@class texture_manager.StreamOpts
+---@field min_size? integer largest side of the first version (default 64)
+---@field memory_budget? integer resident bytes (default no limit)
+---@field max_requests? integer upgrades in flight at once (default 4)
+---@field idle_frames? integer frames without use() before a texture may be evicted (default 2)
+
+---@class texture_manager.Manager
+---@field loader lub3d.texloader.Loader
+---@field textures table<string, texture_manager.Texture>
+---@field pending table<integer, texture_manager.Texture>
+---@field placeholder texture.LoadResult
+---@field stream texture_manager.StreamOpts?
+---@field frame integer
+---@field resident_bytes integer
+---@field reserved_bytes integer
+---@field in_flight integer streaming upgrades in flight
+---@field hits integer
+---@field misses integer
+---@field upgrades integer
+---@field evictions integer
+local Manager = {}
+Manager.__index = Manager
+
+-- 1x1 white texture shown until the real one is uploaded
+---@return texture.LoadResult
+local function make_white()
+    local img = gpu.image(gfx.ImageDesc({
+        width = 1,
+        height = 1,
+        pixel_format = gfx.PixelFormat.RGBA8,
+        data = { mip_levels = { gfx.Range("\255\255\255\255") } },
+    }))
+    return texture.from_image(img, {
+        filter_min = gfx.Filter.NEAREST,
+        filter_mag = gfx.Filter.NEAREST,
+        filter_mip = gfx.Filter.NEAREST,
+    })
+end
+
+---Create a texture manager
+---@param opts? { threads?: integer, budget?: integer, stream?: texture_manager.StreamOpts|boolean } budget: upload bytes per update (default 8 MiB)
+---@return texture_manager.Manager
+function M.new(opts)
+    opts = opts or {}
+    local stream = opts.stream
+    if stream then
+        stream = stream == true and {} or stream
+        stream = {
+            min_size = stream.min_size or 64,
+            memory_budget = stream.memory_budget,
+            max_requests = stream.max_requests or 4,
+            idle_frames = stream.idle_frames or 2,
+        }
+    end
+    return setmetatable({
+        loader = texloader.new({ threads = opts.threads, budget = opts.budget }),
+        textures = {},
+        pending = {},
+        placeholder = make_white(),
+        stream = stream or nil,
+        frame = 0,
+        resident_bytes = 0,
+        reserved_bytes = 0,
+        in_flight = 0,
+        hits = 0,
+        misses = 0,
+        upgrades = 0,
+        evictions = 0,
+    }, Manager)
+end
+
+-- Queue a load of tex, reduced to max_size (largest side) when given
+---@param self texture_manager.Manager
+---@param tex texture_manager.Texture
+---@param max_size integer?
+local function request(self, tex, max_size)
+    local opts = tex.opts
+    local req = {
+        srgb = opts.srgb,
+        mips = opts.mips,
+        mip_filter = opts.mip_filter,
+        format = tex.format,
+        max_size = max_size,
+        premultiply = opts.premultiply,
+        swizzle = opts.swizzle,
+        normal_z = opts.normal_z,
+        convert = opts.convert,
+    }
+    if tex.format and texture_cache.prepare() then
+        req.cache_dir = texture_cache.config.dir
+        req.cache_params = tex.params
+    end
+    local id = self.loader:request(tex.path, req)
+    self.pending[id] = tex
+    tex.loading = id
+    tex.requested = max_size
+end
+
+---Get a texture, queueing it for loading on first use
+---opts are those of texture.load (srgb, mips, mip_filter, texel processing
+---(premultiply, swizzle, normal_z, convert; done on the worker) and sampler
+---settings) plus bc7 (block compress, kept in lib.texture_cache; the
+---format follows opts.format or opts.usage as in texture.select_format),
+---placeholder (texture shown until loaded, default 1x1 white) and
+---stream (false to load this texture at full size in a streaming manager).
+---@param path string
+---@param opts? table
+---@return texture_manager.Texture
+function Manager:get(path, opts)
+    opts = opts or {}
+    local format = opts.bc7 and texture.select_format(opts) or nil
+    if format == "rgba8" then
+        format = nil
+    end
+    -- Everything that changes the texels, as for the texture cache
+    local params = texture_cache.params({
+        format = format or "rgba8",
+        srgb = opts.srgb,
+        mips = opts.mips,
+        mip_filter = opts.mip_filter,
+        premultiply = opts.premultiply,
+        swizzle = opts.swizzle,
+        normal_z = opts.normal_z,
+        convert = opts.convert,
+    })
+    local key = path .. "|" .. params
+    local tex = self.textures[key]
+    if tex then
+        self.hits = self.hits + 1
+        return tex
+    end
+    self.misses = self.misses + 1
+
+    local placeholder = opts.placeholder or self.placeholder
+    tex = {
+        path = path,
+        format = format,
+        params = params,
+        premultiplied = opts.premultiply or nil,
+        img = placeholder.img,
+        view = placeholder.view,
+        smp = placeholder.smp,
+        ready = false,
+        opts = opts,
+        -- Smaller versions are picked from the mip chain
+        stream = self.stream ~= nil and opts.stream ~= false and opts.mips ~= false,
+        reserved = 0,
+        wanted = 0,
+        last_used = self.frame,
+    }
+    self.textures[key] = tex
+    request(self, tex, tex.stream and self.stream.min_size or nil)
+    return tex
+end
+
+---Report that tex is drawn this frame at about size texels across (e.g.
+---its projected size in pixels). Ignored for textures that are not streamed.
+---@param tex texture.LoadResult
+---@param size integer
+function Manager:use(tex, size)
+    ---@cast tex texture_manager.Texture
+    if tex.stream then
+        tex.last_used = self.frame
+        if size > tex.wanted then
+            tex.wanted = size
+        end
+    end
+end
+
+---@param level texture_manager.Level
+local function destroy_level(level)
+    level.smp:destroy()
+    level.view:destroy()
+    level.img:destroy()
+end
+
+-- Show the sharpest resident version of tex
+---@param tex texture_manager.Texture
+local function show(tex)
+    local level = tex.high or tex.base
+    if level then
+        tex.img, tex.view, tex.smp = level.img, level.view, level.smp
+        tex.width, tex.height = level.width, level.height
+    end
+end
+
+-- Drop the sharp version of a streamed texture, keeping the small one
+---@param self texture_manager.Manager
+---@param tex texture_manager.Texture
+local function evict(self, tex)
+    local high = assert(tex.high)
+    tex.high = nil
+    show(tex)
+    destroy_level(high)
+    self.resident_bytes = self.resident_bytes - high.bytes
+    self.evictions = self.evictions + 1
+end
+
+-- Largest side of the smallest mip of tex that is at least wanted texels
+---@param self texture_manager.Manager
+---@param tex texture_manager.Texture
+---@return integer
+local function target_size(self, tex)
+    local size = math.max(tex.full_width, tex.full_height)
+    local want = math.max(tex.wanted, self.stream.min_size)
+    while size // 2 >= want do
+        size = size // 2
+    end
+    return size
+end
+
+-- Streamed textures with a sharp version, least recently used first
+---@param self texture_manager.Manager
+---@return texture_manager.Texture[]
+local function idle_textures(self)
+    local idle = {}
+    for _, tex in pairs(self.textures) do
+        if tex.high and not tex.loading and tex.last_used < self.frame - self.stream.idle_frames then
+            idle[#idle + 1] = tex
+        end
+    end
+    table.sort(idle, function(a, b)
+        return a.last_used < b.last_used
+    end)
+    return idle
+end
+
+-- Request sharper versions of textures drawn larger than they are
+-- resident, most blurry first, evicting idle ones to stay in budget
+---@param self texture_manager.Manager
+---@return integer evicted
+local function stream_update(self)
+    local stream = assert(self.stream)
+    local wants = {}
+    for _, tex in pairs(self.textures) do
+        if tex.stream and tex.base and not tex.loading and tex.wanted > 0 then
+            local target = target_size(self, tex)
+            local resident = math.max(tex.width, tex.height)
+            if target > resident and not (tex.failed_size and target >= tex.failed_size) then
+                wants[#wants + 1] = { tex = tex, target = target, gain = target / resident }
+            end
+        end
+        tex.wanted = 0
+    end
+    table.sort(wants, function(a, b)
+        return a.gain > b.gain
+    end)
+
+    local evicted = 0
+    local idle = nil ---@type texture_manager.Texture[]?
+    for _, want in ipairs(wants) do
+        if self.in_flight >= stream.max_requests then
+            break
+        end
+        local tex = want.tex
+        local base = tex.base --[[@as texture_manager.Level]]
+        -- Mip chains scale with the area, so estimate from the small version
+        local bytes = math.ceil(base.bytes * (want.target / math.max(base.width, base.height)) ^ 2)
+        local budget = stream.memory_budget
+        if budget and self.resident_bytes + self.reserved_bytes + bytes > budget then
+            idle = idle or idle_textures(self)
+            while #idle > 0 and self.resident_bytes + self.reserved_bytes + bytes > budget do
+                evict(self, table.remove(idle, 1))
+                evicted = evicted + 1
+            end
+            if self.resident_bytes + self.reserved_bytes + bytes > budget then
+                break
+            end
+        end
+        tex.reserved = bytes
+        self.reserved_bytes = self.reserved_bytes + bytes
+        self.in_flight = self.in_flight + 1
+        request(self, tex, want.target)
+    end
+    return evicted
+end
+
+---Upload finished textures (call once per frame, outside of passes)
+---@param budget? integer bytes to upload this call, defaults to the manager budget
+---@return integer changed number of textures that became ready, changed size or failed
+function Manager:update(budget)
+    self.frame = self.frame + 1
+    local results = self.loader:update(budget)
+    for _, r in ipairs(results) do
+        local tex = self.pending[r.id]
+        self.pending[r.id] = nil
+        if r.cache_bytes then
+            texture_cache.record(r.cache_key, r.cache_bytes)
+        elseif r.cache_key then
+            texture_cache.touch(r.cache_key)
+        end
+        if tex then
+            if r.decode_ms then
+                util.profile_report("texture", "decode " .. tex.path, r.decode_ms)
+            end
+            tex.loading = nil
+            if tex.base then
+                -- Streaming upgrade finished
+                self.in_flight = self.in_flight - 1
+                self.reserved_bytes = self.reserved_bytes - tex.reserved
+                tex.reserved = 0
+            end
+        end
+        if tex and r.image then
+            local loaded = texture.from_image(gpu.wrap_image(r.image), tex.opts)
+            local level = {
+                img = loaded.img,
+                view = loaded.view,
+                smp = loaded.smp,
+                width = r.width,
+                height = r.height,
+                bytes = r.bytes,
+            }
+            self.resident_bytes = self.resident_bytes + level.bytes
+            if not tex.base then
+                tex.base = level
+            else
+                if tex.high then
+                    self.resident_bytes = self.resident_bytes - tex.high.bytes
+                    destroy_level(tex.high)
+                end
+                tex.high = level
+                self.upgrades = self.upgrades + 1
+            end
+            show(tex)
+            tex.full_width, tex.full_height = r.full_width, r.full_height
+            tex.ready = true
+        elseif tex then
+            tex.error = r.error
+            if tex.base then
+                -- Don't re-request a broken upgrade every frame
+                tex.failed_size = tex.requested
+            end
+            log.warn("texture_manager: " .. tostring(r.error))
+        end
+    end
+    local changed = #results
+    if self.stream then
+        changed = changed + stream_update(self)
+    end
+    return changed
+end
+
+---Block until every queued texture is decoded, then upload all of them
+---(e.g. behind a loading screen)
+function Manager:flush()
+    self.loader:wait()
+    self:update(0)
+end
+
+---@return texture_manager.Stats
+function Manager:stats()
+    local s = self.loader:stats()
+    local done = s.uploaded + s.failed
+    return {
+        requested = s.requested,
+        hits = self.hits,
+        misses = self.misses,
+        pending = s.requested - done,
+        loaded = s.uploaded,
+        failed = s.failed,
+        bytes = s.bytes,
+        frame_bytes = s.frame_bytes,
+        cache_hits = s.cache_hits,
+        cache_misses = s.cache_misses,
+        progress = s.requested > 0 and done / s.requested or 1,
+        resident_bytes = self.resident_bytes,
+        memory_budget = self.stream and self.stream.memory_budget,
+        upgrades = self.upgrades,
+        evictions = self.evictions,
+    }
+end
+
+---@class texture_manager.Residency
+---@field path string
+---@field state "loading"|"failed"|"resident"|"streaming" streaming: a sharper version is loading
+---@field width integer resident size (0 while loading)
+---@field height integer
+---@field full_width integer source size (0 until known)
+---@field full_height integer
+---@field bytes integer GPU bytes
+---@field idle integer frames since the last use()
+
+---Residency of every texture, largest first (for debug panels)
+---@return texture_manager.Residency[]
+function Manager:residency()
+    local list = {}
+    for _, tex in pairs(self.textures) do
+        local state = "resident"
+        if not tex.ready then
+            state = tex.error and "failed" or "loading"
+        elseif tex.loading then
+            state = "streaming"
+        end
+        list[#list + 1] = {
+            path = tex.path,
+            state = state,
+            width = tex.width or 0,
+            height = tex.height or 0,
+            full_width = tex.full_width or 0,
+            full_height = tex.full_height or 0,
+            bytes = (tex.base and tex.base.bytes or 0) + (tex.high and tex.high.bytes or 0),
+            idle = self.frame - tex.last_used,
+        }
+    end
+    table.sort(list, function(a, b)
+        if a.bytes ~= b.bytes then
+            return a.bytes > b.bytes
+        end
+        return a.path < b.path
+    end)
+    return list
+end
+
+---Stop loading and destroy every texture owned by the manager
+function Manager:destroy()
+    self.loader:destroy()
+    texture_cache.save()
+    for _, tex in pairs(self.textures) do
+        if tex.base then
+            destroy_level(tex.base)
+        end
+        if tex.high then
+            destroy_level(tex.high)
+        end
+    end
+    self.textures = {}
+    self.pending = {}
+    self.resident_bytes = 0
+    self.placeholder.smp:destroy()
+    self.placeholder.view:destroy()
+    self.placeholder.img:destroy()
+end
+
+return M
@@ -27,9 +27,21 @@ function M.profile_begin(category, name)
     M.profile.pending[key] = stm.now()
 end
 
+--- Report a measurement taken elsewhere (e.g. on a worker thread), log if slow
+---@param category string category (e.g., "shader", "texture")
+---@param name string specific item name
+---@param elapsed_ms number
+function M.profile_report(category, name, elapsed_ms)
+    if not M.profile.enabled then return end
+    if elapsed_ms >= M.profile.threshold_ms then
+        log.warn(string.format("[%s] %.1fms - %s", category, elapsed_ms, name))
+    end
+end
+
 --- End a profiling measurement, log if slow
 ---@param category string category (e.g., "shader", "texture")
 ---@param name string specific item name
+---@return number? elapsed_ms nil when profiling is disabled or not started
 function M.profile_end(category, name)
     if not M.profile.enabled then return end
     local key = category .. ":" .. name
@@ -39,9 +51,8 @@ function M.profile_end(category, name)
     local elapsed_ms = stm.ms(stm.since(start))
     M.profile.pending[key] = nil
 
-    if elapsed_ms >= M.profile.threshold_ms then
-        log.warn(string.format("[%s] %.1fms - %s", category, elapsed_ms, name))
-    end
+    M.profile_report(category, name, elapsed_ms)
+    return elapsed_ms
 end
 
 -- Resolve path relative to script directory
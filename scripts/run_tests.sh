@@ -37,6 +37,11 @@ MODULES=(
     "examples.license"
     "examples.breakout"
     "examples.hakonotaiatari"
+    "examples.sprite_bench"
+    "examples.particle_bench"
+    "examples.texture_test"
+    "examples.shader_test"
+    "examples.pipeline_cache_test"
 )
 
 for mod in "${MODULES[@]}"; do
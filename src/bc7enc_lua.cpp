@@ -1,13 +1,26 @@
-/* Lua bindings for bc7enc_rdo */
+/* Lua bindings for bc7enc_rdo
+ *
+ * BC7 blocks come from bc7enc; BC1, BC4 and BC5 from rgbcx, which ships with
+ * it and is much faster, for textures that do not need BC7's quality:
+ *   bc1 - opaque color (4 bpp, no sRGB variant in sokol)
+ *   bc4 - single channel masks from red (4 bpp)
+ *   bc5 - two channels from red/green, e.g. normal map XY (8 bpp)
+ *   bc7 - color with alpha (8 bpp)
+ */
 #include "rdo_bc_encoder.h"  /* includes bc7enc.h and bc7decomp.h */
+#include "rgbcx.h"
 
 #include <cstdlib>
 #include <cstring>
-#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 extern "C" {
 #include <lua.h>
 #include <lauxlib.h>
+#include "lub3d_image.h"
 }
 
 static bool g_bc7enc_initialized = false;
@@ -15,33 +28,208 @@ static bool g_bc7enc_initialized = false;
 static void ensure_initialized() {
     if (!g_bc7enc_initialized) {
         bc7enc_compress_block_init();
+        rgbcx::init();
         g_bc7enc_initialized = true;
     }
 }
 
-/* Calculate BC7 compressed size
- * bc7.calc_size(width, height) -> size_in_bytes
+/* Resolve the threads option: <= 0 means all available cores.
+ * Always 1 when built without OpenMP (e.g. Emscripten). */
+static int resolve_threads(int requested) {
+#ifdef _OPENMP
+    int max_threads = omp_get_max_threads();
+    if (requested <= 0 || requested > max_threads) return max_threads;
+    return requested;
+#else
+    (void)requested;
+    return 1;
+#endif
+}
+
+/* Number of threads encode uses by default
+ * bc7.max_threads() -> integer
+ */
+static int l_max_threads(lua_State *L) {
+    lua_pushinteger(L, resolve_threads(0));
+    return 1;
+}
+
+/* Bytes per 4x4 block, 0 for formats this module does not encode */
+static int block_bytes(sg_pixel_format format) {
+    switch (format) {
+    case SG_PIXELFORMAT_BC1_RGBA:
+    case SG_PIXELFORMAT_BC4_R:
+        return 8;
+    case SG_PIXELFORMAT_BC5_RG:
+    case SG_PIXELFORMAT_BC7_RGBA:
+    case SG_PIXELFORMAT_BC7_SRGBA:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+/* Copy the 4x4 block at (bx, by) as RGBA8, clamping at the image edges */
+static void load_block(const uint8_t *src, int width, int height, int bx, int by, uint8_t block[64]) {
+    for (int py = 0; py < 4; py++) {
+        int y = by * 4 + py;
+        if (y >= height) y = height - 1;
+        for (int px = 0; px < 4; px++) {
+            int x = bx * 4 + px;
+            if (x >= width) x = width - 1;
+            memcpy(block + (py * 4 + px) * 4, src + ((size_t)y * width + x) * 4, 4);
+        }
+    }
+}
+
+/* Encode RGBA pixels to BC1/BC4/BC5/BC7 blocks without RDO (also used by
+ * texloader workers, so it must not touch Lua state)
+ */
+extern "C" int lub3d_bc_encode(sg_pixel_format format, const uint8_t *src, int width, int height,
+                               int quality, int threads, uint8_t *out) {
+    int bytes = block_bytes(format);
+    if (bytes == 0) return 0;
+    threads = resolve_threads(threads);
+    int blocks_x = (width + 3) / 4;
+    int blocks_y = (height + 3) / 4;
+
+    bc7enc_compress_block_params comp_params;
+    bc7enc_compress_block_params_init(&comp_params);
+    comp_params.m_uber_level = quality - 1;  /* 0-5 range */
+    if (format == SG_PIXELFORMAT_BC7_SRGBA) {
+        bc7enc_compress_block_params_init_perceptual_weights(&comp_params);
+    } else {
+        bc7enc_compress_block_params_init_linear_weights(&comp_params);
+    }
+    /* rgbcx BC1 levels run from 0 (fastest) to 18 */
+    uint32_t bc1_level = (uint32_t)((quality - 1) * rgbcx::MAX_LEVEL / 5);
+
+    /* One block row per work item; rows vary in cost, so schedule dynamically */
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+#endif
+    for (int by = 0; by < blocks_y; by++) {
+        uint8_t *dst = out + (size_t)by * blocks_x * bytes;
+        for (int bx = 0; bx < blocks_x; bx++) {
+            uint8_t block[64];
+            load_block(src, width, height, bx, by, block);
+            switch (format) {
+            case SG_PIXELFORMAT_BC1_RGBA:
+                rgbcx::encode_bc1(bc1_level, dst, block, true, false);
+                break;
+            case SG_PIXELFORMAT_BC4_R:
+                rgbcx::encode_bc4(dst, block);
+                break;
+            case SG_PIXELFORMAT_BC5_RG:
+                rgbcx::encode_bc5(dst, block);
+                break;
+            default:
+                bc7enc_compress_block(dst, block, &comp_params);
+                break;
+            }
+            dst += bytes;
+        }
+    }
+    return 1;
+}
+
+/* Decode blocks to RGBA pixels; channels a format lacks read as 0, alpha as
+ * 255, like sampling them on the GPU
+ */
+extern "C" int lub3d_bc_decode(sg_pixel_format format, const uint8_t *src, int width, int height,
+                               int threads, uint8_t *out) {
+    int bytes = block_bytes(format);
+    if (bytes == 0) return 0;
+    threads = resolve_threads(threads);
+    int blocks_x = (width + 3) / 4;
+    int blocks_y = (height + 3) / 4;
+    int failed = 0;
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) num_threads(threads)
+#endif
+    for (int by = 0; by < blocks_y; by++) {
+        const uint8_t *blk = src + (size_t)by * blocks_x * bytes;
+        for (int bx = 0; bx < blocks_x; bx++, blk += bytes) {
+            uint8_t block[64];
+            for (int i = 0; i < 16; i++) {
+                block[i * 4 + 0] = block[i * 4 + 1] = block[i * 4 + 2] = 0;
+                block[i * 4 + 3] = 255;
+            }
+            bool ok = true;
+            switch (format) {
+            case SG_PIXELFORMAT_BC1_RGBA:
+                rgbcx::unpack_bc1(blk, block);
+                break;
+            case SG_PIXELFORMAT_BC4_R:
+                rgbcx::unpack_bc4(blk, block);
+                break;
+            case SG_PIXELFORMAT_BC5_RG:
+                rgbcx::unpack_bc5(blk, block);
+                break;
+            default:
+                ok = bc7decomp::unpack_bc7(blk, (bc7decomp::color_rgba *)block);
+                break;
+            }
+            if (!ok) {
+#ifdef _OPENMP
+                #pragma omp atomic write
+#endif
+                failed = 1;
+            }
+
+            /* Copy block to output with clipping for edge blocks */
+            for (int py = 0; py < 4 && by * 4 + py < height; py++) {
+                int w = width - bx * 4 < 4 ? width - bx * 4 : 4;
+                memcpy(out + ((size_t)(by * 4 + py) * width + bx * 4) * 4, block + py * 16, (size_t)w * 4);
+            }
+        }
+    }
+    return !failed;
+}
+
+/* Block format from a format name ("bc1", "bc4", "bc5" or "bc7") */
+static sg_pixel_format check_format(lua_State *L, const char *name, bool srgb) {
+    if (strcmp(name, "bc7") == 0) return srgb ? SG_PIXELFORMAT_BC7_SRGBA : SG_PIXELFORMAT_BC7_RGBA;
+    sg_pixel_format format = SG_PIXELFORMAT_NONE;
+    if (strcmp(name, "bc1") == 0) format = SG_PIXELFORMAT_BC1_RGBA;
+    else if (strcmp(name, "bc4") == 0) format = SG_PIXELFORMAT_BC4_R;
+    else if (strcmp(name, "bc5") == 0) format = SG_PIXELFORMAT_BC5_RG;
+    else luaL_error(L, "unknown block format '%s' (expected bc1, bc4, bc5 or bc7)", name);
+    if (srgb) luaL_error(L, "%s has no sRGB variant", name);
+    return format;
+}
+
+/* Calculate compressed size
+ * bc7.calc_size(width, height, format) -> size_in_bytes
+ * format: "bc1", "bc4", "bc5" or "bc7" (default)
  */
 static int l_calc_size(lua_State *L) {
     int width = (int)luaL_checkinteger(L, 1);
     int height = (int)luaL_checkinteger(L, 2);
+    sg_pixel_format format = check_format(L, luaL_optstring(L, 3, "bc7"), false);
 
     int blocks_x = (width + 3) / 4;
     int blocks_y = (height + 3) / 4;
-    size_t size = (size_t)blocks_x * blocks_y * 16;
+    size_t size = (size_t)blocks_x * blocks_y * block_bytes(format);
 
     lua_pushinteger(L, (lua_Integer)size);
     return 1;
 }
 
-/* Encode RGBA pixels to BC7
+/* Encode RGBA pixels to BC7 (or BC1/BC4/BC5)
  * bc7.encode(pixels, width, height, opts) -> compressed, nil
  * bc7.encode(pixels, width, height, opts) -> nil, error_message
  *
  * opts (optional table):
+ *   format: "bc1", "bc4", "bc5" or "bc7" (default: "bc7")
  *   quality: 1-6 (default: 5)
- *   srgb: boolean (default: false)
+ *   srgb: boolean (default: false, bc7 only)
  *   rdo_quality: 0.0-2.0, 0=disabled (default: 0)
+ *   threads: worker threads, 0=all cores (default: 0)
+ *
+ * Block rows are encoded in parallel with OpenMP; the RDO path uses the
+ * encoder's own multithreading.
  */
 static int l_encode(lua_State *L) {
     ensure_initialized();
@@ -63,8 +251,16 @@ static int l_encode(lua_State *L) {
     int quality = 5;
     bool srgb = false;
     float rdo_lambda = 0.0f;
+    int threads = 0;
+    const char *format_name = "bc7";
 
     if (lua_istable(L, 4)) {
+        lua_getfield(L, 4, "format");
+        if (!lua_isnil(L, -1)) {
+            format_name = luaL_checkstring(L, -1);
+        }
+        lua_pop(L, 1); /* still referenced by opts */
+
         lua_getfield(L, 4, "quality");
         if (!lua_isnil(L, -1)) {
             quality = (int)lua_tointeger(L, -1);
@@ -86,11 +282,19 @@ static int l_encode(lua_State *L) {
             if (rdo_lambda > 10.0f) rdo_lambda = 10.0f;
         }
         lua_pop(L, 1);
+
+        lua_getfield(L, 4, "threads");
+        if (!lua_isnil(L, -1)) {
+            threads = (int)lua_tointeger(L, -1);
+        }
+        lua_pop(L, 1);
     }
+    threads = resolve_threads(threads);
+    sg_pixel_format format = check_format(L, format_name, srgb);
 
     int blocks_x = (width + 3) / 4;
     int blocks_y = (height + 3) / 4;
-    size_t output_size = (size_t)blocks_x * blocks_y * 16;
+    size_t output_size = (size_t)blocks_x * blocks_y * block_bytes(format);
 
     /* Use RDO encoder if rdo_lambda > 0 */
     if (rdo_lambda > 0.0f) {
@@ -110,13 +314,20 @@ static int l_encode(lua_State *L) {
 
         /* Setup RDO encoder params */
         rdo_bc::rdo_bc_params params;
-        params.m_dxgi_format = srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+        switch (format) {
+        case SG_PIXELFORMAT_BC1_RGBA: params.m_dxgi_format = DXGI_FORMAT_BC1_UNORM; break;
+        case SG_PIXELFORMAT_BC4_R: params.m_dxgi_format = DXGI_FORMAT_BC4_UNORM; break;
+        case SG_PIXELFORMAT_BC5_RG: params.m_dxgi_format = DXGI_FORMAT_BC5_UNORM; break;
+        default: params.m_dxgi_format = srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM; break;
+        }
         params.m_rdo_lambda = rdo_lambda;
         params.m_bc7_uber_level = quality;
         params.m_perceptual = srgb;
         params.m_status_output = false;
+        params.m_rdo_multithreading = threads > 1;
+        params.m_rdo_max_threads = (uint32_t)threads;
 
-        /* Encode with RDO */
+        /* Encode with RDO (the initial BC7 pass is an OpenMP loop) */
         rdo_bc::rdo_bc_encoder encoder;
         if (!encoder.init(source_image, params)) {
             lua_pushnil(L);
@@ -124,7 +335,15 @@ static int l_encode(lua_State *L) {
             return 2;
         }
 
-        if (!encoder.encode()) {
+#ifdef _OPENMP
+        int prev_threads = omp_get_max_threads();
+        omp_set_num_threads(threads);
+#endif
+        bool encoded = encoder.encode();
+#ifdef _OPENMP
+        omp_set_num_threads(prev_threads);
+#endif
+        if (!encoded) {
             lua_pushnil(L);
             lua_pushstring(L, "RDO encoding failed");
             return 2;
@@ -136,62 +355,51 @@ static int l_encode(lua_State *L) {
         return 1;
     }
 
-    /* Simple block-by-block encoding */
-    std::vector<uint8_t> output(output_size);
-
-    bc7enc_compress_block_params comp_params;
-    bc7enc_compress_block_params_init(&comp_params);
-    comp_params.m_uber_level = quality - 1;  /* 0-5 range */
-    if (srgb) {
-        bc7enc_compress_block_params_init_perceptual_weights(&comp_params);
-    } else {
-        bc7enc_compress_block_params_init_linear_weights(&comp_params);
-    }
-
-    const uint8_t *src = (const uint8_t *)pixels;
-    uint8_t *dst = output.data();
-
-    for (int by = 0; by < blocks_y; by++) {
-        for (int bx = 0; bx < blocks_x; bx++) {
-            /* Extract 4x4 block with padding for edge blocks */
-            color_rgba block[16];
-            for (int py = 0; py < 4; py++) {
-                for (int px = 0; px < 4; px++) {
-                    int x = bx * 4 + px;
-                    int y = by * 4 + py;
-                    if (x >= width) x = width - 1;
-                    if (y >= height) y = height - 1;
-                    const uint8_t *p = src + (y * width + x) * 4;
-                    block[py * 4 + px].m_c[0] = p[0];
-                    block[py * 4 + px].m_c[1] = p[1];
-                    block[py * 4 + px].m_c[2] = p[2];
-                    block[py * 4 + px].m_c[3] = p[3];
-                }
-            }
-
-            bc7enc_compress_block(dst, block, &comp_params);
-            dst += 16;
-        }
-    }
-
-    lua_pushlstring(L, (const char *)output.data(), output_size);
+    /* Block rows in parallel, straight into the result string */
+    luaL_Buffer b;
+    uint8_t *output = (uint8_t *)luaL_buffinitsize(L, &b, output_size);
+    lub3d_bc_encode(format, (const uint8_t *)pixels, width, height, quality, threads, output);
+    luaL_pushresultsize(&b, output_size);
     return 1;
 }
 
-/* Decode BC7 to RGBA pixels
- * bc7.decode(compressed, width, height) -> pixels, nil
- * bc7.decode(compressed, width, height) -> nil, error_message
+/* Decode BC7 (or BC1/BC4/BC5) to RGBA pixels
+ * bc7.decode(compressed, width, height, opts) -> pixels, nil
+ * bc7.decode(compressed, width, height, opts) -> nil, error_message
+ *
+ * opts (optional table):
+ *   format: "bc1", "bc4", "bc5" or "bc7" (default: "bc7")
+ *   into: lub3d.image.Buffer to decode into; it is returned instead of a string
+ *   threads: worker threads, 0=all cores (default: 0)
+ *
+ * Block rows are decoded in parallel with OpenMP.
  */
 static int l_decode(lua_State *L) {
     size_t compressed_len;
     const char *compressed = luaL_checklstring(L, 1, &compressed_len);
     int width = (int)luaL_checkinteger(L, 2);
     int height = (int)luaL_checkinteger(L, 3);
+    luaL_argcheck(L, width > 0, 2, "width must be positive");
+    luaL_argcheck(L, height > 0, 3, "height must be positive");
+
+    const char *format_name = "bc7";
+    int threads = 0;
+    int into = 0;
+    if (lua_istable(L, 4)) {
+        lua_getfield(L, 4, "format");
+        if (!lua_isnil(L, -1)) format_name = luaL_checkstring(L, -1);
+        lua_getfield(L, 4, "threads");
+        threads = (int)luaL_optinteger(L, -1, 0);
+        lua_pop(L, 2);
+        lua_getfield(L, 4, "into");
+        if (!lua_isnil(L, -1)) into = lua_gettop(L); /* stays on the stack as the result */
+        else lua_pop(L, 1);
+    }
+    sg_pixel_format format = check_format(L, format_name, false);
 
     int blocks_x = (width + 3) / 4;
     int blocks_y = (height + 3) / 4;
-    size_t expected_size = (size_t)blocks_x * blocks_y * 16;
-
+    size_t expected_size = (size_t)blocks_x * blocks_y * block_bytes(format);
     if (compressed_len < expected_size) {
         lua_pushnil(L);
         lua_pushstring(L, "compressed data too small for given dimensions");
@@ -199,40 +407,25 @@ static int l_decode(lua_State *L) {
     }
 
     size_t output_size = (size_t)width * height * 4;
-    std::vector<uint8_t> output(output_size);
-
-    const uint8_t *src = (const uint8_t *)compressed;
-    uint8_t *dst = output.data();
-
-    for (int by = 0; by < blocks_y; by++) {
-        for (int bx = 0; bx < blocks_x; bx++) {
-            bc7decomp::color_rgba block[16];
-            if (!bc7decomp::unpack_bc7(src, block)) {
-                lua_pushnil(L);
-                lua_pushstring(L, "failed to decode BC7 block");
-                return 2;
-            }
-
-            /* Copy block to output with clipping for edge blocks */
-            for (int py = 0; py < 4; py++) {
-                for (int px = 0; px < 4; px++) {
-                    int x = bx * 4 + px;
-                    int y = by * 4 + py;
-                    if (x < width && y < height) {
-                        uint8_t *p = dst + (y * width + x) * 4;
-                        p[0] = block[py * 4 + px].r;
-                        p[1] = block[py * 4 + px].g;
-                        p[2] = block[py * 4 + px].b;
-                        p[3] = block[py * 4 + px].a;
-                    }
-                }
-            }
-
-            src += 16;
+    if (into) {
+        uint8_t *out = lub3d_image_check_buffer(L, into, output_size);
+        if (!lub3d_bc_decode(format, (const uint8_t *)compressed, width, height, threads, out)) {
+            lua_pushnil(L);
+            lua_pushstring(L, "failed to decode block");
+            return 2;
         }
+        lua_pushvalue(L, into);
+        return 1;
     }
 
-    lua_pushlstring(L, (const char *)output.data(), output_size);
+    luaL_Buffer b;
+    uint8_t *output = (uint8_t *)luaL_buffinitsize(L, &b, output_size);
+    if (!lub3d_bc_decode(format, (const uint8_t *)compressed, width, height, threads, output)) {
+        lua_pushnil(L);
+        lua_pushstring(L, "failed to decode block");
+        return 2;
+    }
+    luaL_pushresultsize(&b, output_size);
     return 1;
 }
 
@@ -240,10 +433,13 @@ static const luaL_Reg bc7enc_funcs[] = {
     {"encode", l_encode},
     {"decode", l_decode},
     {"calc_size", l_calc_size},
+    {"max_threads", l_max_threads},
     {NULL, NULL}
 };
 
 extern "C" int luaopen_bc7enc(lua_State *L) {
+    /* Initialize up front: lub3d_bc_encode may run on worker threads */
+    ensure_initialized();
     luaL_newlib(L, bc7enc_funcs);
     return 1;
 }
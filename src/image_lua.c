@@ -0,0 +1,1334 @@
+/*
+ * image_lua.c - Native image processing for lib/texture.lua
+ *
+ * Mipmap chains are generated on the CPU from RGBA8 pixels. Each level is
+ * filtered from the previous one in linear space: with srgb set, texels are
+ * decoded through a lookup table before filtering and re-encoded after, so
+ * minified textures keep their brightness instead of darkening.
+ *
+ * Filters:
+ *   box    - 2x2 average (fast)
+ *   kaiser - separable 8-tap Kaiser-windowed sinc (sharper, less aliasing)
+ * Edges are clamped. Odd sizes round down (level n is max(1, size >> n)).
+ *
+ * Pixels are filtered as one float4 per texel, with SSE2 where available
+ * and scalar loops otherwise (e.g. on Emscripten).
+ *
+ * Lua API: require("lub3d.image")
+ *   image.mip_count(w, h) -> count            -- full chain down to 1x1
+ *   image.gen_mips(pixels, w, h, opts?) -> levels
+ *     levels[1] is pixels itself, levels[i] is (w >> i-1) x (h >> i-1)
+ *     opts: srgb (false), filter ("box"), max_levels (full chain), into
+ *     pixels may also be an image.Buffer. With opts.into (a Buffer), levels
+ *     2.. are written back to back into it and the result is a list of
+ *     { ptr, size } tables for gfx.Range instead of strings.
+ *
+ * Texels can be processed once at load time instead of in every shader
+ * invocation (opts fields, applied in this order):
+ *   image.process(pixels, opts) -> pixels
+ *     swizzle     - output channels from "rgba01", e.g. "bgra" or "ag01"
+ *     normal_z    - rebuild b as the z of a unit normal from r and g
+ *     convert     - "linear" (sRGB -> linear) or "srgb" (linear -> sRGB)
+ *     premultiply - multiply rgb by alpha, in linear light when the
+ *                   texels are sRGB (srgb = true, or convert = "srgb")
+ *   pixels is a string (a processed copy is returned) or an image.Buffer
+ *   (processed in place and returned). Opaque and straight-alpha paths
+ *   run 4 texels at a time with SSE2 where available.
+ *
+ * Source images are decoded with stb_image into reusable buffers, so the
+ * pixels reach gfx.Range without being copied into Lua strings:
+ *   image.buffer() -> Buffer
+ *   image.info(data) -> w, h, channels | nil, err      -- header only
+ *   image.decode(data, buffer, channels?) -> w, h, channels | nil, err
+ *   buffer:size(), buffer:range(offset?, size?) -> { ptr, size },
+ *   buffer:read(offset?, size?) -> string, buffer:release()
+ * decode hands stb's allocation to the buffer (freeing the previous one), so
+ * decoded pixels are never copied. Ranges point into the buffer and are only
+ * valid until it is decoded into again or released.
+ *
+ * Precompressed KTX2 and DDS files (BC1/BC3/BC4/BC5/BC7 or RGBA8, with mips,
+ * array layers or cube faces) are parsed here and uploaded with level ranges
+ * pointing straight into the file data, without slicing it in Lua:
+ *   image.parse_texture(data) -> info | nil, err       -- header only
+ *   image.make_image(data, label?) -> sokol.gfx.Image, info | nil, err
+ *   image.encode_ktx2(levels, w, h, pixel_format) -> data
+ * info: container ("ktx2"/"dds"), format (sg_pixel_format), format_name,
+ *       width, height, layers, faces, levels
+ * Supercompressed KTX2 and 3D textures are rejected.
+ *
+ * The same helpers are exported to C through lub3d_image.h; they keep no
+ * state besides the tables built in luaopen, so texloader_lua.c calls them
+ * from its worker threads.
+ */
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sokol_gfx.h"
+#include "stb_image.h"
+#include "lub3d_image.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_SSE2 1
+#endif
+
+#define SG_IMAGE_MT "sokol.gfx.Image"
+#define BUFFER_MT "lub3d.image.Buffer"
+
+#define KAISER_TAPS 8
+#define TEXTURE_MAX_SIZE 16384 /* largest side accepted from KTX2/DDS headers */
+#define LINEAR_LUT_SIZE 4096
+
+static float srgb_to_linear_lut[256];
+static uint8_t linear_to_srgb_lut[LINEAR_LUT_SIZE];
+static uint8_t srgb_to_linear8_lut[256];
+static uint8_t linear8_to_srgb_lut[256];
+static float unorm_to_snorm_lut[256];
+static float kaiser_weights[KAISER_TAPS];
+
+/* Zeroth-order modified Bessel function of the first kind (series) */
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static void init_tables(void)
+{
+    for (int i = 0; i < 256; i++) {
+        double c = i / 255.0;
+        srgb_to_linear_lut[i] = (float)(c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+    }
+    for (int i = 0; i < LINEAR_LUT_SIZE; i++) {
+        double l = i / (double)(LINEAR_LUT_SIZE - 1);
+        double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+        linear_to_srgb_lut[i] = (uint8_t)(c * 255.0 + 0.5);
+    }
+    for (int i = 0; i < 256; i++) {
+        srgb_to_linear8_lut[i] = (uint8_t)(srgb_to_linear_lut[i] * 255.0f + 0.5f);
+        linear8_to_srgb_lut[i] = linear_to_srgb_lut[(i * (LINEAR_LUT_SIZE - 1) + 127) / 255];
+        unorm_to_snorm_lut[i] = i / 127.5f - 1.0f;
+    }
+
+    /* Halving filter: tap k sits at source offset d = k - 3.5 from the
+     * destination texel center; sinc cutoff at half the source rate */
+    const double pi = 3.14159265358979323846;
+    const double radius = KAISER_TAPS / 2, beta = 4.0;
+    double sum = 0.0, w[KAISER_TAPS];
+    for (int k = 0; k < KAISER_TAPS; k++) {
+        double d = k - (KAISER_TAPS - 1) * 0.5;
+        double x = pi * d * 0.5;
+        double r = d / radius;
+        w[k] = (sin(x) / x) * bessel_i0(beta * sqrt(1.0 - r * r)) / bessel_i0(beta);
+        sum += w[k];
+    }
+    for (int k = 0; k < KAISER_TAPS; k++)
+        kaiser_weights[k] = (float)(w[k] / sum);
+}
+
+/* RGBA8 row -> linear float4 row */
+static void load_row(const uint8_t *src, int w, int srgb, float *out)
+{
+    if (srgb) {
+        for (int x = 0; x < w; x++, src += 4, out += 4) {
+            out[0] = srgb_to_linear_lut[src[0]];
+            out[1] = srgb_to_linear_lut[src[1]];
+            out[2] = srgb_to_linear_lut[src[2]];
+            out[3] = src[3] * (1.0f / 255.0f);
+        }
+    } else {
+        for (int x = 0; x < w * 4; x++)
+            out[x] = src[x] * (1.0f / 255.0f);
+    }
+}
+
+/* Linear float4 row -> RGBA8 row (clamped) */
+static void store_row(const float *in, int w, int srgb, uint8_t *dst)
+{
+#ifdef IMAGE_SSE2
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 scale = srgb ? _mm_setr_ps(LINEAR_LUT_SIZE - 1, LINEAR_LUT_SIZE - 1, LINEAR_LUT_SIZE - 1, 255.0f)
+                              : _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (int x = 0; x < w; x++, in += 4, dst += 4) {
+        __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in), zero), one);
+        int32_t q[4];
+        _mm_storeu_si128((__m128i *)q, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half)));
+        if (srgb) {
+            dst[0] = linear_to_srgb_lut[q[0]];
+            dst[1] = linear_to_srgb_lut[q[1]];
+            dst[2] = linear_to_srgb_lut[q[2]];
+        } else {
+            dst[0] = (uint8_t)q[0];
+            dst[1] = (uint8_t)q[1];
+            dst[2] = (uint8_t)q[2];
+        }
+        dst[3] = (uint8_t)q[3];
+    }
+#else
+    for (int x = 0; x < w; x++, in += 4, dst += 4) {
+        for (int c = 0; c < 4; c++) {
+            float v = in[c];
+            if (v < 0.0f) v = 0.0f;
+            if (v > 1.0f) v = 1.0f;
+            if (srgb && c < 3)
+                dst[c] = linear_to_srgb_lut[(int)(v * (LINEAR_LUT_SIZE - 1) + 0.5f)];
+            else
+                dst[c] = (uint8_t)(v * 255.0f + 0.5f);
+        }
+    }
+#endif
+}
+
+static int clamp_index(int i, int n)
+{
+    return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+/* out = 0.25 * (a[i0] + a[i1] + b[i0] + b[i1]) per destination texel */
+static void box_row(const float *a, const float *b, int sw, int dw, float *out)
+{
+    for (int x = 0; x < dw; x++, out += 4) {
+        int i0 = clamp_index(2 * x, sw) * 4;
+        int i1 = clamp_index(2 * x + 1, sw) * 4;
+#ifdef IMAGE_SSE2
+        __m128 s = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(a + i0), _mm_loadu_ps(a + i1)),
+                              _mm_add_ps(_mm_loadu_ps(b + i0), _mm_loadu_ps(b + i1)));
+        _mm_storeu_ps(out, _mm_mul_ps(s, _mm_set1_ps(0.25f)));
+#else
+        for (int c = 0; c < 4; c++)
+            out[c] = 0.25f * (a[i0 + c] + a[i1 + c] + b[i0 + c] + b[i1 + c]);
+#endif
+    }
+}
+
+/* Horizontal halving pass: one filtered float4 per destination texel */
+static void kaiser_h(const float *src, int sw, int dw, float *out)
+{
+    for (int x = 0; x < dw; x++, out += 4) {
+        int base = 2 * x - (KAISER_TAPS / 2 - 1);
+#ifdef IMAGE_SSE2
+        __m128 acc = _mm_setzero_ps();
+        for (int k = 0; k < KAISER_TAPS; k++) {
+            const float *p = src + clamp_index(base + k, sw) * 4;
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(p), _mm_set1_ps(kaiser_weights[k])));
+        }
+        _mm_storeu_ps(out, acc);
+#else
+        out[0] = out[1] = out[2] = out[3] = 0.0f;
+        for (int k = 0; k < KAISER_TAPS; k++) {
+            const float *p = src + clamp_index(base + k, sw) * 4;
+            for (int c = 0; c < 4; c++)
+                out[c] += p[c] * kaiser_weights[k];
+        }
+#endif
+    }
+}
+
+static void kaiser_v(const float *const rows[KAISER_TAPS], int dw, float *out)
+{
+    for (int i = 0; i < dw * 4; i += 4) {
+#ifdef IMAGE_SSE2
+        __m128 acc = _mm_setzero_ps();
+        for (int k = 0; k < KAISER_TAPS; k++)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(kaiser_weights[k])));
+        _mm_storeu_ps(out + i, acc);
+#else
+        for (int c = 0; c < 4; c++) {
+            float acc = 0.0f;
+            for (int k = 0; k < KAISER_TAPS; k++)
+                acc += rows[k][i + c] * kaiser_weights[k];
+            out[i + c] = acc;
+        }
+#endif
+    }
+}
+
+/* Downsample one RGBA8 level into dst (dw x dh). Scratch must hold
+ * 2 * sw + (1 + KAISER_TAPS) * dw float4s (2 * sw + dw for box). */
+static void downsample(const uint8_t *src, int sw, int sh, uint8_t *dst, int dw, int dh,
+                       int srgb, int kaiser, float *scratch)
+{
+    float *row_a = scratch;
+    float *row_b = row_a + (size_t)sw * 4;
+    float *out = row_b + (size_t)sw * 4;
+
+    if (!kaiser) {
+        for (int y = 0; y < dh; y++) {
+            load_row(src + (size_t)clamp_index(2 * y, sh) * sw * 4, sw, srgb, row_a);
+            load_row(src + (size_t)clamp_index(2 * y + 1, sh) * sw * 4, sw, srgb, row_b);
+            box_row(row_a, row_b, sw, dw, out);
+            store_row(out, dw, srgb, dst + (size_t)y * dw * 4);
+        }
+        return;
+    }
+
+    /* Ring of horizontally filtered source rows: the (at most KAISER_TAPS
+     * consecutive) rows a destination row needs map to distinct slots */
+    float *ring = out + (size_t)dw * 4;
+    int ring_row[KAISER_TAPS];
+    for (int k = 0; k < KAISER_TAPS; k++)
+        ring_row[k] = -1;
+
+    for (int y = 0; y < dh; y++) {
+        const float *rows[KAISER_TAPS];
+        int base = 2 * y - (KAISER_TAPS / 2 - 1);
+        for (int k = 0; k < KAISER_TAPS; k++) {
+            int sy = clamp_index(base + k, sh);
+            int slot = sy % KAISER_TAPS;
+            float *filtered = ring + (size_t)slot * dw * 4;
+            if (ring_row[slot] != sy) {
+                load_row(src + (size_t)sy * sw * 4, sw, srgb, row_a);
+                kaiser_h(row_a, sw, dw, filtered);
+                ring_row[slot] = sy;
+            }
+            rows[k] = filtered;
+        }
+        kaiser_v(rows, dw, out);
+        store_row(out, dw, srgb, dst + (size_t)y * dw * 4);
+    }
+}
+
+static int mip_dim(int size, int level)
+{
+    size >>= level;
+    return size > 0 ? size : 1;
+}
+
+int lub3d_image_mip_count(int w, int h)
+{
+    int n = 1;
+    while (w > 1 || h > 1) {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+        n++;
+    }
+    return n;
+}
+
+size_t lub3d_image_mip_bytes(int w, int h, int levels)
+{
+    size_t total = 0;
+    for (int i = 1; i < levels; i++)
+        total += (size_t)mip_dim(w, i) * mip_dim(h, i) * 4;
+    return total;
+}
+
+/* Scratch float4s for downsampling from a w-wide level */
+static size_t scratch_texels(int w, int kaiser)
+{
+    int half_w = w > 1 ? w / 2 : 1;
+    return (size_t)2 * w + (size_t)(1 + (kaiser ? KAISER_TAPS : 0)) * half_w;
+}
+
+int lub3d_image_gen_mips(const uint8_t *pixels, int w, int h, int levels,
+                         int srgb, int kaiser, uint8_t *out)
+{
+    float *scratch = (float *)malloc(scratch_texels(w, kaiser) * 4 * sizeof(float));
+    if (!scratch)
+        return 0;
+    const uint8_t *src = pixels;
+    int sw = w, sh = h;
+    for (int i = 1; i < levels; i++) {
+        int dw = mip_dim(w, i), dh = mip_dim(h, i);
+        downsample(src, sw, sh, out, dw, dh, srgb, kaiser, scratch);
+        src = out;
+        out += (size_t)dw * dh * 4;
+        sw = dw;
+        sh = dh;
+    }
+    free(scratch);
+    return 1;
+}
+
+/* ===== Pixel processing ===== */
+
+/* x * a / 255, rounded (exact for 8-bit x and a) */
+static inline uint8_t mul_div255(unsigned x, unsigned a)
+{
+    unsigned t = x * a + 128;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+}
+
+#ifdef IMAGE_SSE2
+/* Same on 8 16-bit lanes */
+static inline __m128i mul_div255_epi16(__m128i x, __m128i a)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, a), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+/* Premultiply 4 texels per step; returns the number of texels done */
+static size_t premultiply_sse2(uint8_t *p, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha_lanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+    const __m128i one = _mm_and_si128(alpha_lanes, _mm_set1_epi16(255));
+    size_t n = count & ~(size_t)3;
+    for (size_t i = 0; i < n; i += 4, p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        /* Broadcast each texel's alpha; alpha itself is multiplied by 255 */
+        __m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);
+        __m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);
+        alo = _mm_or_si128(_mm_andnot_si128(alpha_lanes, alo), one);
+        ahi = _mm_or_si128(_mm_andnot_si128(alpha_lanes, ahi), one);
+        lo = mul_div255_epi16(lo, alo);
+        hi = mul_div255_epi16(hi, ahi);
+        _mm_storeu_si128((__m128i *)p, _mm_packus_epi16(lo, hi));
+    }
+    return n;
+}
+#endif
+
+static void premultiply(uint8_t *p, size_t count, int srgb)
+{
+    size_t i = 0;
+    if (srgb) {
+        /* Scale linear light, not the encoded values */
+        for (; i < count; i++, p += 4) {
+            float a = p[3] * (1.0f / 255.0f) * (LINEAR_LUT_SIZE - 1);
+            p[0] = linear_to_srgb_lut[(int)(srgb_to_linear_lut[p[0]] * a + 0.5f)];
+            p[1] = linear_to_srgb_lut[(int)(srgb_to_linear_lut[p[1]] * a + 0.5f)];
+            p[2] = linear_to_srgb_lut[(int)(srgb_to_linear_lut[p[2]] * a + 0.5f)];
+        }
+        return;
+    }
+#ifdef IMAGE_SSE2
+    i = premultiply_sse2(p, count);
+    p += i * 4;
+#endif
+    for (; i < count; i++, p += 4) {
+        p[0] = mul_div255(p[0], p[3]);
+        p[1] = mul_div255(p[1], p[3]);
+        p[2] = mul_div255(p[2], p[3]);
+    }
+}
+
+static void swizzle(uint8_t *p, size_t count, const uint8_t map[4])
+{
+    for (size_t i = 0; i < count; i++, p += 4) {
+        uint8_t src[6] = {p[0], p[1], p[2], p[3], 0, 255};
+        p[0] = src[map[0]];
+        p[1] = src[map[1]];
+        p[2] = src[map[2]];
+        p[3] = src[map[3]];
+    }
+}
+
+static void normal_z(uint8_t *p, size_t count)
+{
+    for (size_t i = 0; i < count; i++, p += 4) {
+        float x = unorm_to_snorm_lut[p[0]], y = unorm_to_snorm_lut[p[1]];
+        float zz = 1.0f - x * x - y * y;
+        float z = zz > 0.0f ? sqrtf(zz) : 0.0f;
+        p[2] = (uint8_t)(z * 127.5f + 128.0f);
+    }
+}
+
+static void convert_rgb(uint8_t *p, size_t count, const uint8_t lut[256])
+{
+    for (size_t i = 0; i < count; i++, p += 4) {
+        p[0] = lut[p[0]];
+        p[1] = lut[p[1]];
+        p[2] = lut[p[2]];
+    }
+}
+
+int lub3d_image_check_ops(lua_State *L, int idx, lub3d_image_ops *ops)
+{
+    memset(ops, 0, sizeof(*ops));
+    for (int c = 0; c < 4; c++)
+        ops->swizzle[c] = (uint8_t)c;
+    if (!lua_istable(L, idx))
+        return 0;
+    idx = lua_absindex(L, idx);
+
+    lua_getfield(L, idx, "swizzle");
+    const char *map = lua_tostring(L, -1);
+    if (map) {
+        static const char channels[] = "rgba01";
+        if (strlen(map) != 4)
+            return luaL_error(L, "swizzle must have 4 channels (got '%s')", map);
+        for (int c = 0; c < 4; c++) {
+            const char *ch = strchr(channels, map[c]);
+            if (!ch || !map[c])
+                return luaL_error(L, "invalid swizzle '%s' (channels are r, g, b, a, 0, 1)", map);
+            ops->swizzle[c] = (uint8_t)(ch - channels);
+            ops->swizzled |= ops->swizzle[c] != c;
+        }
+    }
+    lua_getfield(L, idx, "normal_z");
+    ops->normal_z = lua_toboolean(L, -1);
+    lua_getfield(L, idx, "convert");
+    const char *convert = lua_tostring(L, -1);
+    if (convert) {
+        if (strcmp(convert, "linear") == 0)
+            ops->convert = LUB3D_CONVERT_TO_LINEAR;
+        else if (strcmp(convert, "srgb") == 0)
+            ops->convert = LUB3D_CONVERT_TO_SRGB;
+        else
+            return luaL_error(L, "unknown convert '%s' (expected linear or srgb)", convert);
+    }
+    lua_getfield(L, idx, "premultiply");
+    ops->premultiply = lua_toboolean(L, -1);
+    lua_getfield(L, idx, "srgb");
+    ops->srgb = lua_toboolean(L, -1);
+    lua_pop(L, 5);
+    return ops->swizzled || ops->normal_z || ops->convert || ops->premultiply;
+}
+
+void lub3d_image_process(uint8_t *pixels, size_t count, const lub3d_image_ops *ops)
+{
+    if (ops->swizzled)
+        swizzle(pixels, count, ops->swizzle);
+    if (ops->normal_z)
+        normal_z(pixels, count);
+    if (ops->convert == LUB3D_CONVERT_TO_LINEAR)
+        convert_rgb(pixels, count, srgb_to_linear8_lut);
+    else if (ops->convert == LUB3D_CONVERT_TO_SRGB)
+        convert_rgb(pixels, count, linear8_to_srgb_lut);
+    if (ops->premultiply) {
+        int srgb = ops->convert ? ops->convert == LUB3D_CONVERT_TO_SRGB : ops->srgb;
+        premultiply(pixels, count, srgb);
+    }
+}
+
+/* image.mip_count(w, h) */
+static int l_image_mip_count(lua_State *L)
+{
+    int w = (int)luaL_checkinteger(L, 1);
+    int h = (int)luaL_checkinteger(L, 2);
+    luaL_argcheck(L, w > 0, 1, "width must be positive");
+    luaL_argcheck(L, h > 0, 2, "height must be positive");
+    lua_pushinteger(L, lub3d_image_mip_count(w, h));
+    return 1;
+}
+
+/* ===== Pixel buffers ===== */
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+    int from_stb; /* data was allocated by stb_image */
+} ImageBuffer;
+
+static ImageBuffer *check_buffer(lua_State *L, int idx)
+{
+    return (ImageBuffer *)luaL_checkudata(L, idx, BUFFER_MT);
+}
+
+static void buffer_free(ImageBuffer *b)
+{
+    if (b->from_stb)
+        stbi_image_free(b->data);
+    else
+        free(b->data);
+    b->data = NULL;
+    b->size = b->capacity = 0;
+    b->from_stb = 0;
+}
+
+/* Make room for size bytes, keeping the allocation when it is big enough */
+static int buffer_reserve(ImageBuffer *b, size_t size)
+{
+    if (b->data && !b->from_stb && b->capacity >= size) {
+        b->size = size;
+        return 1;
+    }
+    buffer_free(b);
+    b->data = (uint8_t *)malloc(size > 0 ? size : 1);
+    if (!b->data)
+        return 0;
+    b->size = b->capacity = size;
+    return 1;
+}
+
+/* Byte span [offset, offset + size) of a buffer from optional arguments */
+static const uint8_t *buffer_span(lua_State *L, ImageBuffer *b, int idx, size_t *size)
+{
+    lua_Integer offset = luaL_optinteger(L, idx, 0);
+    luaL_argcheck(L, offset >= 0 && (size_t)offset <= b->size, idx, "offset out of range");
+    lua_Integer n = luaL_optinteger(L, idx + 1, (lua_Integer)(b->size - (size_t)offset));
+    luaL_argcheck(L, n >= 0 && (size_t)n <= b->size - (size_t)offset, idx + 1, "size out of range");
+    *size = (size_t)n;
+    return b->data + offset;
+}
+
+uint8_t *lub3d_image_check_buffer(lua_State *L, int idx, size_t size)
+{
+    ImageBuffer *b = check_buffer(L, idx);
+    if (!buffer_reserve(b, size))
+        luaL_error(L, "out of memory");
+    return b->data;
+}
+
+static void push_range(lua_State *L, const void *ptr, size_t size)
+{
+    lua_createtable(L, 0, 2);
+    lua_pushlightuserdata(L, (void *)ptr);
+    lua_setfield(L, -2, "ptr");
+    lua_pushinteger(L, (lua_Integer)size);
+    lua_setfield(L, -2, "size");
+}
+
+/* image.buffer() */
+static int l_image_buffer(lua_State *L)
+{
+    ImageBuffer *b = (ImageBuffer *)lua_newuserdatauv(L, sizeof(ImageBuffer), 0);
+    memset(b, 0, sizeof(*b));
+    luaL_setmetatable(L, BUFFER_MT);
+    return 1;
+}
+
+static int l_buffer_size(lua_State *L)
+{
+    lua_pushinteger(L, (lua_Integer)check_buffer(L, 1)->size);
+    return 1;
+}
+
+/* buffer:range(offset, size) -> { ptr, size } for gfx.Range */
+static int l_buffer_range(lua_State *L)
+{
+    ImageBuffer *b = check_buffer(L, 1);
+    size_t size;
+    const uint8_t *ptr = buffer_span(L, b, 2, &size);
+    push_range(L, ptr, size);
+    return 1;
+}
+
+/* buffer:read(offset, size) -> string copy */
+static int l_buffer_read(lua_State *L)
+{
+    ImageBuffer *b = check_buffer(L, 1);
+    size_t size;
+    const uint8_t *ptr = buffer_span(L, b, 2, &size);
+    lua_pushlstring(L, (const char *)ptr, size);
+    return 1;
+}
+
+static int l_buffer_release(lua_State *L)
+{
+    buffer_free(check_buffer(L, 1));
+    return 0;
+}
+
+/* image.info(data) */
+static int l_image_info(lua_State *L)
+{
+    size_t len;
+    const stbi_uc *data = (const stbi_uc *)luaL_checklstring(L, 1, &len);
+    int w, h, ch;
+    if (!stbi_info_from_memory(data, (int)len, &w, &h, &ch)) {
+        lua_pushnil(L);
+        lua_pushstring(L, stbi_failure_reason());
+        return 2;
+    }
+    lua_pushinteger(L, w);
+    lua_pushinteger(L, h);
+    lua_pushinteger(L, ch);
+    return 3;
+}
+
+/* image.decode(data, buffer, channels) */
+static int l_image_decode(lua_State *L)
+{
+    size_t len;
+    const stbi_uc *data = (const stbi_uc *)luaL_checklstring(L, 1, &len);
+    ImageBuffer *b = check_buffer(L, 2);
+    int channels = (int)luaL_optinteger(L, 3, 4);
+    luaL_argcheck(L, channels >= 1 && channels <= 4, 3, "channels must be 1 to 4");
+
+    int w, h, ch;
+    stbi_uc *pixels = stbi_load_from_memory(data, (int)len, &w, &h, &ch, channels);
+    if (!pixels) {
+        lua_pushnil(L);
+        lua_pushstring(L, stbi_failure_reason());
+        return 2;
+    }
+    buffer_free(b);
+    b->data = pixels;
+    b->size = b->capacity = (size_t)w * h * channels;
+    b->from_stb = 1;
+    lua_pushinteger(L, w);
+    lua_pushinteger(L, h);
+    lua_pushinteger(L, channels);
+    return 3;
+}
+
+static int l_buffer_gc(lua_State *L)
+{
+    buffer_free(check_buffer(L, 1));
+    return 0;
+}
+
+static const luaL_Reg buffer_methods[] = {
+    {"size", l_buffer_size},
+    {"range", l_buffer_range},
+    {"read", l_buffer_read},
+    {"release", l_buffer_release},
+    {NULL, NULL}
+};
+
+/* image.process(pixels, opts) */
+static int l_image_process(lua_State *L)
+{
+    lub3d_image_ops ops;
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lub3d_image_check_ops(L, 2, &ops);
+    if (lua_type(L, 1) == LUA_TUSERDATA) {
+        ImageBuffer *b = check_buffer(L, 1);
+        luaL_argcheck(L, b->size % 4 == 0, 1, "pixel data size mismatch (expected RGBA8)");
+        lub3d_image_process(b->data, b->size / 4, &ops);
+        lua_pushvalue(L, 1);
+        return 1;
+    }
+    size_t len;
+    const char *pixels = luaL_checklstring(L, 1, &len);
+    luaL_argcheck(L, len % 4 == 0, 1, "pixel data size mismatch (expected RGBA8)");
+    luaL_Buffer b;
+    uint8_t *out = (uint8_t *)luaL_buffinitsize(L, &b, len);
+    memcpy(out, pixels, len);
+    lub3d_image_process(out, len / 4, &ops);
+    luaL_pushresultsize(&b, len);
+    return 1;
+}
+
+/* image.gen_mips(pixels, w, h, opts) */
+static int l_image_gen_mips(lua_State *L)
+{
+    size_t len;
+    const uint8_t *pixels;
+    if (lua_type(L, 1) == LUA_TUSERDATA) {
+        ImageBuffer *b = check_buffer(L, 1);
+        pixels = b->data;
+        len = b->size;
+    } else {
+        pixels = (const uint8_t *)luaL_checklstring(L, 1, &len);
+    }
+    int w = (int)luaL_checkinteger(L, 2);
+    int h = (int)luaL_checkinteger(L, 3);
+    luaL_argcheck(L, w > 0, 2, "width must be positive");
+    luaL_argcheck(L, h > 0, 3, "height must be positive");
+    luaL_argcheck(L, len == (size_t)w * h * 4, 1, "pixel data size mismatch (expected w*h*4 RGBA8)");
+
+    int srgb = 0, kaiser = 0;
+    int levels = lub3d_image_mip_count(w, h);
+    ImageBuffer *into = NULL;
+    if (lua_istable(L, 4)) {
+        lua_getfield(L, 4, "srgb");
+        srgb = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 4, "filter");
+        const char *filter = luaL_optstring(L, -1, "box");
+        if (strcmp(filter, "kaiser") == 0)
+            kaiser = 1;
+        else if (strcmp(filter, "box") != 0)
+            return luaL_error(L, "unknown mip filter '%s' (expected box or kaiser)", filter);
+        lua_pop(L, 1);
+
+        lua_getfield(L, 4, "max_levels");
+        int max_levels = (int)luaL_optinteger(L, -1, levels);
+        if (max_levels >= 1 && max_levels < levels)
+            levels = max_levels;
+        lua_pop(L, 1);
+
+        lua_getfield(L, 4, "into");
+        if (!lua_isnil(L, -1))
+            into = (ImageBuffer *)luaL_checkudata(L, -1, BUFFER_MT);
+        lua_pop(L, 1); /* still referenced by opts */
+    }
+
+    if (into) {
+        luaL_argcheck(L, lua_type(L, 1) != LUA_TUSERDATA || lua_touserdata(L, 1) != into, 1,
+                      "pixels and opts.into must be different buffers");
+        if (!buffer_reserve(into, lub3d_image_mip_bytes(w, h, levels))
+            || !lub3d_image_gen_mips(pixels, w, h, levels, srgb, kaiser, into->data))
+            return luaL_error(L, "out of memory");
+        lua_createtable(L, levels, 0);
+        push_range(L, pixels, len);
+        lua_rawseti(L, -2, 1);
+        const uint8_t *p = into->data;
+        for (int i = 1; i < levels; i++) {
+            size_t size = (size_t)mip_dim(w, i) * mip_dim(h, i) * 4;
+            push_range(L, p, size);
+            lua_rawseti(L, -2, i + 1);
+            p += size;
+        }
+        return 1;
+    }
+
+    /* Scratch rows are sized for level 0 -> 1, the widest step */
+    float *scratch = (float *)lua_newuserdatauv(L, scratch_texels(w, kaiser) * 4 * sizeof(float), 0);
+
+    lua_createtable(L, levels, 0);
+    if (lua_type(L, 1) == LUA_TUSERDATA)
+        lua_pushlstring(L, (const char *)pixels, len);
+    else
+        lua_pushvalue(L, 1);
+    lua_rawseti(L, -2, 1);
+
+    /* Each level is read back from the previous one, anchored in the table */
+    const uint8_t *src = pixels;
+    int sw = w, sh = h;
+    for (int i = 1; i < levels; i++) {
+        int dw = sw > 1 ? sw / 2 : 1;
+        int dh = sh > 1 ? sh / 2 : 1;
+        size_t size = (size_t)dw * dh * 4;
+        luaL_Buffer b;
+        uint8_t *dst = (uint8_t *)luaL_buffinitsize(L, &b, size);
+        downsample(src, sw, sh, dst, dw, dh, srgb, kaiser, scratch);
+        luaL_pushresultsize(&b, size);
+        src = (const uint8_t *)lua_tostring(L, -1);
+        lua_rawseti(L, -2, i + 1);
+        sw = dw;
+        sh = dh;
+    }
+    return 1;
+}
+
+/* ===== KTX2 / DDS containers ===== */
+
+/* Khronos data format descriptor color models and channels (KTX2 DFD) */
+#define DF_MODEL_RGBSDA 1
+#define DF_MODEL_BC1A 128
+#define DF_MODEL_BC3 130
+#define DF_MODEL_BC4 131
+#define DF_MODEL_BC5 132
+#define DF_MODEL_BC7 135
+#define DF_SAMPLE_LINEAR 0x10
+#define DF_SAMPLE_SIGNED 0x40
+
+typedef struct {
+    uint8_t channel;
+    uint8_t offset; /* bits */
+    uint8_t bits;
+} DfdSample;
+
+struct lub3d_texture_format {
+    sg_pixel_format format;
+    const char *name;
+    uint32_t vk_format;
+    uint32_t dxgi_format;
+    uint8_t block_bytes;       /* bytes per 4x4 block, or per texel when not compressed */
+    uint8_t compressed;
+    uint8_t srgb;
+    uint8_t is_signed;
+    uint8_t df_model;
+    uint8_t num_samples;
+    DfdSample samples[4];
+};
+
+static const lub3d_texture_format texture_formats[] = {
+    { SG_PIXELFORMAT_RGBA8, "RGBA8", 37, 28, 4, 0, 0, 0, DF_MODEL_RGBSDA, 4,
+      { { 0, 0, 8 }, { 1, 8, 8 }, { 2, 16, 8 }, { 15, 24, 8 } } },
+    { SG_PIXELFORMAT_SRGB8A8, "SRGB8A8", 43, 29, 4, 0, 1, 0, DF_MODEL_RGBSDA, 4,
+      { { 0, 0, 8 }, { 1, 8, 8 }, { 2, 16, 8 }, { 15, 24, 8 } } },
+    { SG_PIXELFORMAT_BC1_RGBA, "BC1_RGBA", 133, 71, 8, 1, 0, 0, DF_MODEL_BC1A, 1, { { 1, 0, 64 } } },
+    { SG_PIXELFORMAT_BC3_RGBA, "BC3_RGBA", 137, 77, 16, 1, 0, 0, DF_MODEL_BC3, 2,
+      { { 15, 0, 64 }, { 0, 64, 64 } } },
+    { SG_PIXELFORMAT_BC3_SRGBA, "BC3_SRGBA", 138, 78, 16, 1, 1, 0, DF_MODEL_BC3, 2,
+      { { 15, 0, 64 }, { 0, 64, 64 } } },
+    { SG_PIXELFORMAT_BC4_R, "BC4_R", 139, 80, 8, 1, 0, 0, DF_MODEL_BC4, 1, { { 0, 0, 64 } } },
+    { SG_PIXELFORMAT_BC4_RSN, "BC4_RSN", 140, 81, 8, 1, 0, 1, DF_MODEL_BC4, 1, { { 0, 0, 64 } } },
+    { SG_PIXELFORMAT_BC5_RG, "BC5_RG", 141, 83, 16, 1, 0, 0, DF_MODEL_BC5, 2,
+      { { 0, 0, 64 }, { 1, 64, 64 } } },
+    { SG_PIXELFORMAT_BC5_RGSN, "BC5_RGSN", 142, 84, 16, 1, 0, 1, DF_MODEL_BC5, 2,
+      { { 0, 0, 64 }, { 1, 64, 64 } } },
+    { SG_PIXELFORMAT_BC7_RGBA, "BC7_RGBA", 145, 98, 16, 1, 0, 0, DF_MODEL_BC7, 1, { { 0, 0, 128 } } },
+    { SG_PIXELFORMAT_BC7_SRGBA, "BC7_SRGBA", 146, 99, 16, 1, 1, 0, DF_MODEL_BC7, 1, { { 0, 0, 128 } } },
+};
+#define NUM_TEXTURE_FORMATS (int)(sizeof(texture_formats) / sizeof(texture_formats[0]))
+
+static const lub3d_texture_format *format_by_sg(lua_Integer format)
+{
+    for (int i = 0; i < NUM_TEXTURE_FORMATS; i++)
+        if ((lua_Integer)texture_formats[i].format == format)
+            return &texture_formats[i];
+    return NULL;
+}
+
+static const lub3d_texture_format *format_by_vk(uint32_t vk_format)
+{
+    for (int i = 0; i < NUM_TEXTURE_FORMATS; i++)
+        if (texture_formats[i].vk_format == vk_format)
+            return &texture_formats[i];
+    return NULL;
+}
+
+static const lub3d_texture_format *format_by_dxgi(uint32_t dxgi_format)
+{
+    for (int i = 0; i < NUM_TEXTURE_FORMATS; i++)
+        if (texture_formats[i].dxgi_format == dxgi_format)
+            return &texture_formats[i];
+    return NULL;
+}
+
+/* Bytes of one image (one slice) of a mip level */
+static size_t level_bytes(const lub3d_texture_format *f, int w, int h)
+{
+    if (f->compressed)
+        return (size_t)((w + 3) / 4) * ((h + 3) / 4) * f->block_bytes;
+    return (size_t)w * h * f->block_bytes;
+}
+
+/* *out = a * b; 0 on overflow */
+static int size_mul(size_t a, size_t b, size_t *out)
+{
+    if (b && a > SIZE_MAX / b)
+        return 0;
+    *out = a * b;
+    return 1;
+}
+
+/* level_bytes for sizes read from a file header; 0 on overflow */
+static int level_bytes_checked(const lub3d_texture_format *f, int w, int h, size_t *out)
+{
+    size_t bw = f->compressed ? (size_t)(w + 3) / 4 : (size_t)w;
+    size_t bh = f->compressed ? (size_t)(h + 3) / 4 : (size_t)h;
+    size_t row;
+    return size_mul(bw, f->block_bytes, &row) && size_mul(row, bh, out);
+}
+
+size_t lub3d_image_level_bytes(sg_pixel_format format, int w, int h)
+{
+    const lub3d_texture_format *f = format_by_sg(format);
+    return f ? level_bytes(f, w, h) : 0;
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t rd64(const uint8_t *p)
+{
+    return (uint64_t)rd32(p) | (uint64_t)rd32(p + 4) << 32;
+}
+
+static void wr32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void wr64(uint8_t *p, uint64_t v)
+{
+    wr32(p, (uint32_t)v);
+    wr32(p + 4, (uint32_t)(v >> 32));
+}
+
+static const uint8_t ktx2_identifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+/* Shared size checks; returns an error message or NULL */
+static const char *check_info(lub3d_texture_info *info)
+{
+    if (!info->format)
+        return "unsupported pixel format";
+    if (info->width <= 0 || info->height <= 0
+        || info->width > TEXTURE_MAX_SIZE || info->height > TEXTURE_MAX_SIZE)
+        return "invalid image size";
+    if (info->levels < 1 || info->levels > SG_MAX_MIPMAPS
+        || info->levels > lub3d_image_mip_count(info->width, info->height))
+        return "invalid mip level count";
+    if (info->faces != 1 && info->faces != 6)
+        return "invalid face count";
+    if (info->faces == 6 && info->layers > 1)
+        return "cube map arrays are not supported";
+    for (int i = 0; i < info->levels; i++) {
+        if (!level_bytes_checked(info->format, mip_dim(info->width, i), mip_dim(info->height, i), &info->size[i]))
+            return "image too large";
+    }
+    return NULL;
+}
+
+/* KTX2: level index first, each level holds all layers/faces back to back
+ * (the same order sg_image_data expects) */
+static const char *parse_ktx2(const uint8_t *data, size_t len, lub3d_texture_info *info)
+{
+    if (len < 80)
+        return "truncated KTX2 header";
+    info->container = "ktx2";
+    info->format = format_by_vk(rd32(data + 12));
+    info->width = (int)rd32(data + 20);
+    info->height = (int)rd32(data + 24);
+    uint32_t depth = rd32(data + 28);
+    uint32_t layers = rd32(data + 32);
+    uint32_t faces = rd32(data + 36);
+    uint32_t levels = rd32(data + 40);
+    if (depth > 1)
+        return "3D textures are not supported";
+    if (rd32(data + 44) != 0)
+        return "supercompressed KTX2 files are not supported";
+    if (layers > 2048)
+        return "invalid KTX2 header";
+    info->layers = layers ? (int)layers : 1;
+    info->faces = (int)faces;
+    info->levels = levels ? (int)levels : 1;
+    const char *err = check_info(info);
+    if (err)
+        return err;
+
+    if (len < 80 + (size_t)info->levels * 24)
+        return "truncated KTX2 level index";
+    size_t slices = (size_t)info->layers * info->faces;
+    for (int i = 0; i < info->levels; i++) {
+        uint64_t offset = rd64(data + 80 + i * 24);
+        uint64_t size = rd64(data + 80 + i * 24 + 8);
+        size_t needed;
+        if (!size_mul(info->size[i], slices, &needed) || size < needed || offset > len || size > len - offset)
+            return "KTX2 level data out of range";
+        info->offset[i] = (size_t)offset;
+    }
+    info->slice_stride = 0;
+    return NULL;
+}
+
+#define FOURCC(a, b, c, d) ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
+#define DDPF_FOURCC 0x4
+#define DDPF_RGB 0x40
+#define DDSCAPS2_CUBEMAP 0x200
+#define DDSCAPS2_VOLUME 0x200000
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4
+
+/* DDS: each array slice / cube face stores its full mip chain in turn */
+static const char *parse_dds(const uint8_t *data, size_t len, lub3d_texture_info *info)
+{
+    if (len < 128 || rd32(data + 4) != 124)
+        return "truncated DDS header";
+    info->container = "dds";
+    info->height = (int)rd32(data + 12);
+    info->width = (int)rd32(data + 16);
+    uint32_t levels = rd32(data + 28);
+    uint32_t pf_flags = rd32(data + 80);
+    uint32_t fourcc = rd32(data + 84);
+    uint32_t caps2 = rd32(data + 112);
+    size_t data_offset = 128;
+    info->levels = levels ? (int)levels : 1;
+    info->layers = 1;
+    info->faces = (caps2 & DDSCAPS2_CUBEMAP) ? 6 : 1;
+    if (caps2 & DDSCAPS2_VOLUME)
+        return "3D textures are not supported";
+
+    uint32_t dxgi = 0;
+    if ((pf_flags & DDPF_FOURCC) && fourcc == FOURCC('D', 'X', '1', '0')) {
+        if (len < 148)
+            return "truncated DDS DX10 header";
+        dxgi = rd32(data + 128);
+        uint32_t array_size = rd32(data + 140);
+        if (array_size > 2048)
+            return "invalid DDS header";
+        info->layers = array_size ? (int)array_size : 1;
+        info->faces = (rd32(data + 136) & DDS_RESOURCE_MISC_TEXTURECUBE) ? 6 : 1;
+        data_offset = 148;
+    } else if (pf_flags & DDPF_FOURCC) {
+        switch (fourcc) {
+        case FOURCC('D', 'X', 'T', '1'): dxgi = 71; break;
+        case FOURCC('D', 'X', 'T', '5'): dxgi = 77; break;
+        case FOURCC('A', 'T', 'I', '1'):
+        case FOURCC('B', 'C', '4', 'U'): dxgi = 80; break;
+        case FOURCC('B', 'C', '4', 'S'): dxgi = 81; break;
+        case FOURCC('A', 'T', 'I', '2'):
+        case FOURCC('B', 'C', '5', 'U'): dxgi = 83; break;
+        case FOURCC('B', 'C', '5', 'S'): dxgi = 84; break;
+        default: break;
+        }
+    } else if ((pf_flags & DDPF_RGB) && rd32(data + 88) == 32 && rd32(data + 92) == 0xFF &&
+               rd32(data + 96) == 0xFF00 && rd32(data + 100) == 0xFF0000) {
+        dxgi = 28;
+    }
+    info->format = format_by_dxgi(dxgi);
+    const char *err = check_info(info);
+    if (err)
+        return err;
+
+    size_t offset = data_offset;
+    info->slice_stride = 0;
+    for (int i = 0; i < info->levels; i++) {
+        if (info->size[i] > SIZE_MAX - offset)
+            return "DDS data out of range";
+        info->offset[i] = offset;
+        offset += info->size[i];
+        info->slice_stride += info->size[i];
+    }
+    size_t slices = (size_t)info->layers * info->faces;
+    if (info->slice_stride > (len - data_offset) / slices)
+        return "DDS data out of range";
+    return NULL;
+}
+
+const char *lub3d_image_parse_texture(const uint8_t *data, size_t len, lub3d_texture_info *info)
+{
+    memset(info, 0, sizeof(lub3d_texture_info));
+    if (len >= 12 && memcmp(data, ktx2_identifier, 12) == 0)
+        return parse_ktx2(data, len, info);
+    if (len >= 4 && memcmp(data, "DDS ", 4) == 0)
+        return parse_dds(data, len, info);
+    return "not a KTX2 or DDS file";
+}
+
+static void push_info(lua_State *L, const lub3d_texture_info *info)
+{
+    lua_createtable(L, 0, 8);
+    lua_pushstring(L, info->container);
+    lua_setfield(L, -2, "container");
+    lua_pushinteger(L, (lua_Integer)info->format->format);
+    lua_setfield(L, -2, "format");
+    lua_pushstring(L, info->format->name);
+    lua_setfield(L, -2, "format_name");
+    lua_pushinteger(L, info->width);
+    lua_setfield(L, -2, "width");
+    lua_pushinteger(L, info->height);
+    lua_setfield(L, -2, "height");
+    lua_pushinteger(L, info->layers);
+    lua_setfield(L, -2, "layers");
+    lua_pushinteger(L, info->faces);
+    lua_setfield(L, -2, "faces");
+    lua_pushinteger(L, info->levels);
+    lua_setfield(L, -2, "levels");
+}
+
+/* image.parse_texture(data) */
+static int l_image_parse_texture(lua_State *L)
+{
+    size_t len;
+    const uint8_t *data = (const uint8_t *)luaL_checklstring(L, 1, &len);
+    lub3d_texture_info info;
+    const char *err = lub3d_image_parse_texture(data, len, &info);
+    if (err) {
+        lua_pushnil(L);
+        lua_pushstring(L, err);
+        return 2;
+    }
+    push_info(L, &info);
+    return 1;
+}
+
+int lub3d_image_texture_desc(const uint8_t *data, const lub3d_texture_info *info,
+                             sg_image_desc *desc, uint8_t **repacked)
+{
+    int slices = info->layers * info->faces;
+    if (info->faces == 6) {
+        desc->type = SG_IMAGETYPE_CUBE;
+    } else if (info->layers > 1) {
+        desc->type = SG_IMAGETYPE_ARRAY;
+    } else {
+        desc->type = SG_IMAGETYPE_2D;
+    }
+    desc->width = info->width;
+    desc->height = info->height;
+    desc->num_slices = slices;
+    desc->num_mipmaps = info->levels;
+    desc->pixel_format = info->format->format;
+
+    /* Levels point straight into the file data; only multi-slice DDS files
+     * need their slice-major layout regrouped by level */
+    *repacked = NULL;
+    if (info->slice_stride && slices > 1) {
+        uint8_t *dst = (uint8_t *)malloc(info->slice_stride * slices);
+        if (!dst)
+            return 0;
+        *repacked = dst;
+        for (int i = 0; i < info->levels; i++) {
+            desc->data.mip_levels[i].ptr = dst;
+            desc->data.mip_levels[i].size = info->size[i] * slices;
+            for (int s = 0; s < slices; s++) {
+                memcpy(dst, data + info->offset[i] + (size_t)s * info->slice_stride, info->size[i]);
+                dst += info->size[i];
+            }
+        }
+    } else {
+        for (int i = 0; i < info->levels; i++) {
+            desc->data.mip_levels[i].ptr = data + info->offset[i];
+            desc->data.mip_levels[i].size = info->size[i] * slices;
+        }
+    }
+    return 1;
+}
+
+/* image.make_image(data, label) */
+static int l_image_make_image(lua_State *L)
+{
+    size_t len;
+    const uint8_t *data = (const uint8_t *)luaL_checklstring(L, 1, &len);
+    const char *label = luaL_optstring(L, 2, NULL);
+    lub3d_texture_info info;
+    const char *err = lub3d_image_parse_texture(data, len, &info);
+    if (err) {
+        lua_pushnil(L);
+        lua_pushstring(L, err);
+        return 2;
+    }
+
+    sg_image_desc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.label = label;
+    uint8_t *repacked = NULL;
+    if (!lub3d_image_texture_desc(data, &info, &desc, &repacked))
+        return luaL_error(L, "out of memory");
+
+    sg_image img = sg_make_image(&desc);
+    free(repacked);
+    if (sg_query_image_state(img) != SG_RESOURCESTATE_VALID) {
+        sg_destroy_image(img);
+        lua_pushnil(L);
+        lua_pushfstring(L, "failed to create %s image", info.format->name);
+        return 2;
+    }
+
+    sg_image *ud = (sg_image *)lua_newuserdatauv(L, sizeof(sg_image), 0);
+    *ud = img;
+    luaL_setmetatable(L, SG_IMAGE_MT);
+    push_info(L, &info);
+    return 2;
+}
+
+uint8_t *lub3d_image_encode_ktx2(const uint8_t *const *levels, const size_t *sizes, int num_levels,
+                                 int w, int h, sg_pixel_format format, size_t *out_len)
+{
+    const lub3d_texture_format *f = format_by_sg(format);
+    if (!f || num_levels < 1 || num_levels > SG_MAX_MIPMAPS)
+        return NULL;
+
+    /* Header, level index, DFD, then level data smallest first, each
+     * aligned to the block size */
+    size_t dfd_offset = 80 + (size_t)num_levels * 24;
+    size_t dfd_size = 4 + 24 + (size_t)f->num_samples * 16;
+    size_t align = f->compressed ? f->block_bytes : 4;
+    size_t offsets[SG_MAX_MIPMAPS];
+    size_t end = dfd_offset + dfd_size;
+    for (int i = num_levels - 1; i >= 0; i--) {
+        end = (end + align - 1) / align * align;
+        offsets[i] = end;
+        end += sizes[i];
+    }
+
+    uint8_t *out = (uint8_t *)calloc(1, end);
+    if (!out)
+        return NULL;
+    memcpy(out, ktx2_identifier, 12);
+    wr32(out + 12, f->vk_format);
+    wr32(out + 16, 1); /* typeSize */
+    wr32(out + 20, (uint32_t)w);
+    wr32(out + 24, (uint32_t)h);
+    wr32(out + 36, 1); /* faceCount */
+    wr32(out + 40, (uint32_t)num_levels);
+    wr32(out + 48, (uint32_t)dfd_offset);
+    wr32(out + 52, (uint32_t)dfd_size);
+
+    uint8_t *dfd = out + dfd_offset;
+    wr32(dfd, (uint32_t)dfd_size);
+    wr32(dfd + 8, 2 | (uint32_t)(24 + f->num_samples * 16) << 16); /* version, block size */
+    dfd[12] = f->df_model;
+    dfd[13] = 1;              /* BT.709 primaries */
+    dfd[14] = f->srgb ? 2 : 1; /* transfer function */
+    dfd[16] = f->compressed ? 3 : 0;
+    dfd[17] = f->compressed ? 3 : 0;
+    dfd[20] = f->block_bytes;
+    for (int s = 0; s < f->num_samples; s++) {
+        const DfdSample *sample = &f->samples[s];
+        uint8_t *p = dfd + 28 + s * 16;
+        p[0] = sample->offset;
+        p[2] = (uint8_t)(sample->bits - 1);
+        p[3] = sample->channel;
+        if (f->is_signed)
+            p[3] |= DF_SAMPLE_SIGNED;
+        if (f->srgb && sample->channel == 15)
+            p[3] |= DF_SAMPLE_LINEAR;
+        if (f->is_signed) {
+            wr32(p + 8, 0x80000000u);
+            wr32(p + 12, 0x7FFFFFFFu);
+        } else {
+            wr32(p + 12, f->compressed ? 0xFFFFFFFFu : 0xFFu);
+        }
+    }
+
+    for (int i = 0; i < num_levels; i++) {
+        memcpy(out + offsets[i], levels[i], sizes[i]);
+        wr64(out + 80 + i * 24, offsets[i]);
+        wr64(out + 80 + i * 24 + 8, sizes[i]);
+        wr64(out + 80 + i * 24 + 16, sizes[i]);
+    }
+    *out_len = end;
+    return out;
+}
+
+/* image.encode_ktx2(levels, w, h, format) */
+static int l_image_encode_ktx2(lua_State *L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    int w = (int)luaL_checkinteger(L, 2);
+    int h = (int)luaL_checkinteger(L, 3);
+    sg_pixel_format format = (sg_pixel_format)luaL_checkinteger(L, 4);
+    const lub3d_texture_format *f = format_by_sg(format);
+    int levels = (int)lua_rawlen(L, 1);
+    luaL_argcheck(L, w > 0, 2, "width must be positive");
+    luaL_argcheck(L, h > 0, 3, "height must be positive");
+    luaL_argcheck(L, f != NULL, 4, "unsupported pixel format");
+    luaL_argcheck(L, levels >= 1 && levels <= SG_MAX_MIPMAPS, 1, "expected 1 to 16 levels");
+
+    const uint8_t *data[SG_MAX_MIPMAPS];
+    size_t sizes[SG_MAX_MIPMAPS];
+    for (int i = 0; i < levels; i++) {
+        size_t expected = level_bytes(f, mip_dim(w, i), mip_dim(h, i));
+        lua_rawgeti(L, 1, i + 1);
+        data[i] = (const uint8_t *)luaL_checklstring(L, -1, &sizes[i]);
+        lua_pop(L, 1); /* still referenced by the levels table */
+        if (sizes[i] != expected)
+            return luaL_error(L, "level %d: expected %d bytes, got %d", i + 1, (int)expected, (int)sizes[i]);
+    }
+
+    size_t len;
+    uint8_t *out = lub3d_image_encode_ktx2(data, sizes, levels, w, h, format, &len);
+    if (!out)
+        return luaL_error(L, "out of memory");
+    lua_pushlstring(L, (const char *)out, len);
+    free(out);
+    return 1;
+}
+
+static const luaL_Reg image_funcs[] = {
+    {"mip_count", l_image_mip_count},
+    {"gen_mips", l_image_gen_mips},
+    {"process", l_image_process},
+    {"buffer", l_image_buffer},
+    {"info", l_image_info},
+    {"decode", l_image_decode},
+    {"parse_texture", l_image_parse_texture},
+    {"make_image", l_image_make_image},
+    {"encode_ktx2", l_image_encode_ktx2},
+    {NULL, NULL}
+};
+
+int luaopen_lub3d_image(lua_State *L)
+{
+    static int tables_ready = 0;
+    if (!tables_ready) {
+        init_tables();
+        tables_ready = 1;
+    }
+    if (luaL_newmetatable(L, BUFFER_MT)) {
+        luaL_newlib(L, buffer_methods);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, l_buffer_gc);
+        lua_setfield(L, -2, "__gc");
+    }
+    lua_pop(L, 1);
+    luaL_newlib(L, image_funcs);
+    return 1;
+}
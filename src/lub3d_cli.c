@@ -5,6 +5,8 @@
  *   lub3d run [path]       Run a Lua project (default: current directory)
  *   lub3d doc [topic]      Show module/API documentation
  *   lub3d example [name]   List or run built-in examples
+ *   lub3d convert <image>  Encode images to KTX2 (mips, BCn)
+ *   lub3d cook <dir>       Precompile a project's Lua, shaders and textures
  *   lub3d                  Same as "lub3d run ."
  */
 #include "sokol_app.h"
@@ -222,6 +224,61 @@ static int cmd_doc(const char *topic)
     return result;
 }
 
+/* ===== cmd_convert / cmd_cook ===== */
+
+/* Run an offline tool script from pack data (lib/convert.lua, lib/cook.lua)
+ * with the arguments after the subcommand in the _lub3d_args global */
+static int run_tool(const char *script, int argc, char *argv[])
+{
+    L = luaL_newstate();
+    luaL_openlibs(L);
+
+#ifdef LUB3D_HAS_SHDC
+    shdc_init();
+#endif
+
+    lub3d_lua_register_all(L);
+    lub3d_pack_register_preload(L);
+
+    /* Set _lub3d_args global (arguments after the subcommand) */
+    lua_createtable(L, argc, 0);
+    for (int i = 0; i < argc; i++) {
+        lua_pushstring(L, argv[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setglobal(L, "_lub3d_args");
+
+    /* Run the script from pack */
+    unsigned int size;
+    const unsigned char *data = lub3d_pack_find(script, &size);
+    int result = 0;
+    if (!data) {
+        fprintf(stderr, "error: %s not found in pack data\n", script);
+        result = 1;
+    } else if (luaL_loadbuffer(L, (const char *)data, size, script) != LUA_OK ||
+               lua_pcall(L, 0, 0, 0) != LUA_OK) {
+        const char *err = lua_tostring(L, -1);
+        fprintf(stderr, "error: %s\n", err ? err : "(no message)");
+        result = 1;
+    }
+
+#ifdef LUB3D_HAS_SHDC
+    shdc_shutdown();
+#endif
+    lua_close(L);
+    return result;
+}
+
+static int cmd_convert(int argc, char *argv[])
+{
+    return run_tool("lib/convert.lua", argc, argv);
+}
+
+static int cmd_cook(int argc, char *argv[])
+{
+    return run_tool("lib/cook.lua", argc, argv);
+}
+
 /* ===== Usage ===== */
 
 static void print_usage(void)
@@ -232,6 +289,8 @@ static void print_usage(void)
     printf("  run [path]       Run a Lua project (default: current directory)\n");
     printf("  example [name]   List or run built-in examples\n");
     printf("  doc [topic]      Show module/API documentation\n");
+    printf("  convert <image>  Encode images to KTX2 (see 'lub3d convert --help')\n");
+    printf("  cook <dir>       Precompile a project's Lua, shaders and textures (see 'lub3d cook --help')\n");
     printf("  --help, -h       Show this help message\n");
     printf("\n");
     printf("Running without arguments is equivalent to 'lub3d run .'\n");
@@ -268,6 +327,14 @@ int main(int argc, char *argv[])
         return cmd_doc(argc > 2 ? argv[2] : NULL);
     }
 
+    if (strcmp(cmd, "convert") == 0) {
+        return cmd_convert(argc - 2, argv + 2);
+    }
+
+    if (strcmp(cmd, "cook") == 0) {
+        return cmd_cook(argc - 2, argv + 2);
+    }
+
     /* Unknown command */
     fprintf(stderr, "Unknown command: %s\n\n", cmd);
     print_usage();
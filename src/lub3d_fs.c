@@ -134,6 +134,18 @@ static int l_fs_write(lua_State *L)
     return 1;
 }
 
+int lub3d_fs_write_atomic(const char *path, const void *data, size_t len)
+{
+    (void)path; (void)data; (void)len;
+    return 0;
+}
+
+int lub3d_fs_mkdir(const char *path)
+{
+    (void)path;
+    return 0;
+}
+
 static int l_fs_mtime(lua_State *L)
 {
     const char *path = luaL_checkstring(L, 1);
@@ -170,6 +182,8 @@ static int l_fs_dir(lua_State *L)
 #include <windows.h>
 #else
 #include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
 #endif
 
 static int l_fs_read(lua_State *L)
@@ -225,6 +239,65 @@ static int l_fs_write(lua_State *L)
     return 1;
 }
 
+/* Write to a uniquely named temporary next to path, then rename it over
+ * path, so readers (and other processes) never see a partial file */
+int lub3d_fs_write_atomic(const char *path, const void *data, size_t len)
+{
+    char tmp[1024];
+#ifdef _WIN32
+    unsigned long pid = (unsigned long)GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    /* The stack address tells threads of one process apart */
+    if (snprintf(tmp, sizeof(tmp), "%s.%lu.%p.tmp", path, pid, (void *)tmp) >= (int)sizeof(tmp))
+        return 0;
+    FILE *f = fopen(tmp, "wb");
+    if (!f)
+        return 0;
+    size_t written = fwrite(data, 1, len, f);
+    if (fclose(f) != 0 || written != len) {
+        remove(tmp);
+        return 0;
+    }
+#ifdef _WIN32
+    if (!MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING)) {
+#else
+    if (rename(tmp, path) != 0) {
+#endif
+        remove(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+/* Create a directory and its missing parents */
+int lub3d_fs_mkdir(const char *path)
+{
+    char buf[1024];
+    size_t n = strlen(path);
+    if (n == 0 || n >= sizeof(buf))
+        return 0;
+    memcpy(buf, path, n + 1);
+    for (size_t i = 1; i <= n; i++) {
+        if (buf[i] != '/' && buf[i] != '\\' && buf[i] != '\0')
+            continue;
+        char c = buf[i];
+        buf[i] = '\0';
+        struct stat st;
+        if (stat(buf, &st) != 0) {
+#ifdef _WIN32
+            if (!CreateDirectoryA(buf, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+#else
+            if (mkdir(buf, 0755) != 0 && errno != EEXIST)
+#endif
+                return 0;
+        }
+        buf[i] = c;
+    }
+    return 1;
+}
+
 static int l_fs_mtime(lua_State *L)
 {
     const char *path = luaL_checkstring(L, 1);
@@ -297,6 +370,11 @@ static int l_fs_dir(lua_State *L)
     d->hFind = FindFirstFileA(pattern, &d->ffd);
     d->first = 1;
 
+    if (d->hFind == INVALID_HANDLE_VALUE) {
+        lua_pushnil(L);
+        return 1;
+    }
+
     if (luaL_newmetatable(L, "lub3d.fs.dir")) {
         lua_pushcfunction(L, dir_gc);
         lua_setfield(L, -2, "__gc");
@@ -362,9 +440,26 @@ static int l_fs_dir(lua_State *L)
 
 /* ===== Module registration ===== */
 
+static int l_fs_write_atomic(lua_State *L)
+{
+    const char *path = luaL_checkstring(L, 1);
+    size_t len;
+    const char *data = luaL_checklstring(L, 2, &len);
+    lua_pushboolean(L, lub3d_fs_write_atomic(path, data, len));
+    return 1;
+}
+
+static int l_fs_mkdir(lua_State *L)
+{
+    lua_pushboolean(L, lub3d_fs_mkdir(luaL_checkstring(L, 1)));
+    return 1;
+}
+
 static const luaL_Reg fs_funcs[] = {
     {"read", l_fs_read},
     {"write", l_fs_write},
+    {"write_atomic", l_fs_write_atomic},
+    {"mkdir", l_fs_mkdir},
     {"mtime", l_fs_mtime},
     {"exists", l_fs_exists},
     {"dir", l_fs_dir},
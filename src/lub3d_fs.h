@@ -4,6 +4,8 @@
  * Lua API: require("lub3d.fs")
  *   fs.read(path)        -- read entire file (string or nil)
  *   fs.write(path, data) -- write file (true/false)
+ *   fs.write_atomic(path, data) -- write via temp file + rename (true/false)
+ *   fs.mkdir(path)       -- create directory and parents (true/false)
  *   fs.mtime(path)       -- modification time (integer or nil)
  *   fs.exists(path)      -- existence check (boolean)
  *   fs.dir(path)         -- directory listing (iterator or nil)
@@ -23,6 +25,11 @@ int luaopen_lub3d_fs(lua_State *L);
 typedef const unsigned char *(*lub3d_fs_pack_find_fn)(const char *path, unsigned int *out_size);
 extern lub3d_fs_pack_find_fn lub3d_fs_pack_find;
 
+/* Atomic replace-on-write and recursive mkdir (also usable from worker
+ * threads). Return 1 on success; always 0 on Emscripten. */
+int lub3d_fs_write_atomic(const char *path, const void *data, size_t len);
+int lub3d_fs_mkdir(const char *path);
+
 #ifdef __EMSCRIPTEN__
 /* Fetch file via synchronous XHR. Caller must free() the returned buffer. */
 char *lub3d_fs_fetch_file(const char *url, size_t *out_len);
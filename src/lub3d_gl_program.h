@@ -0,0 +1,32 @@
+/*
+ * lub3d_gl_program.h - GL program binary hooks (see program_cache_lua.c)
+ *
+ * sokol_gfx.h has no way to create a shader from a program binary, so
+ * sokol_impl.c compiles its GL backend with glCompileShader, glGetShaderiv
+ * and glLinkProgram routed through the functions below. Outside of
+ * program_cache.make_shader they call straight through.
+ *
+ * Only where sokol_gfx.h takes the GL prototypes from the system headers
+ * (Linux, Android): those headers are included here first, so the renaming
+ * in sokol_impl.c only reaches sokol's calls. WebGL has no program binaries,
+ * and the Windows and macOS builds use D3D11 and Metal.
+ */
+#ifndef LUB3D_GL_PROGRAM_H
+#define LUB3D_GL_PROGRAM_H
+
+#if (defined(SOKOL_GLCORE) || defined(SOKOL_GLES3)) && defined(__linux__) && !defined(SOKOL_EXTERNAL_GL_LOADER)
+#define LUB3D_GL_PROGRAM_BINARY 1
+
+#if defined(SOKOL_GLCORE) && !defined(__ANDROID__)
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#else
+#include <GLES3/gl3.h>
+#endif
+
+void lub3d_gl_compile_shader(GLuint shader);
+void lub3d_gl_get_shaderiv(GLuint shader, GLenum pname, GLint *params);
+void lub3d_gl_link_program(GLuint program);
+#endif
+
+#endif /* LUB3D_GL_PROGRAM_H */
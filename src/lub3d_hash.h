@@ -0,0 +1,20 @@
+/*
+ * lub3d_hash.h - Fast non-cryptographic hashing for cache keys
+ *
+ * Lua API: require("lub3d.hash")
+ *   hash.xxh64(data, seed?) -> integer  -- XXH64, format with "%016x"
+ */
+#ifndef LUB3D_HASH_H
+#define LUB3D_HASH_H
+
+#include <lua.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Lua module opener */
+int luaopen_lub3d_hash(lua_State *L);
+
+/* XXH64 of len bytes (matches the reference implementation) */
+uint64_t lub3d_hash_xxh64(const void *data, size_t len, uint64_t seed);
+
+#endif /* LUB3D_HASH_H */
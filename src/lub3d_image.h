@@ -0,0 +1,102 @@
+/*
+ * lub3d_image.h - Native image helpers shared between modules
+ *
+ * Implemented in image_lua.c (mips, texel processing, KTX2/DDS containers,
+ * pixel buffers)
+ * and bc7enc_lua.cpp (BC1/BC4/BC5/BC7 blocks). Everything without a
+ * lua_State is reentrant once the modules have been opened, so it can be
+ * called from worker threads (see texloader_lua.c).
+ */
+#ifndef LUB3D_IMAGE_H
+#define LUB3D_IMAGE_H
+
+#include <lua.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sokol_gfx.h"
+
+/* Lua module opener */
+int luaopen_lub3d_image(lua_State *L);
+
+typedef struct lub3d_texture_format lub3d_texture_format;
+
+/* Parsed KTX2/DDS layout */
+typedef struct {
+    const char *container;         /* "ktx2" or "dds" */
+    const lub3d_texture_format *format;
+    int width, height;
+    int layers, faces, levels;
+    size_t offset[SG_MAX_MIPMAPS]; /* first slice of each level */
+    size_t size[SG_MAX_MIPMAPS];   /* one slice of each level */
+    size_t slice_stride;           /* DDS: slices are stored with all their mips */
+} lub3d_texture_info;
+
+/* Number of levels in a full mip chain down to 1x1 */
+int lub3d_image_mip_count(int w, int h);
+
+/* Bytes of RGBA8 levels 1 .. levels-1 (everything below level 0) */
+size_t lub3d_image_mip_bytes(int w, int h, int levels);
+
+/* Generate RGBA8 levels 1 .. levels-1 back to back into out.
+ * Returns 0 when out of memory. */
+int lub3d_image_gen_mips(const uint8_t *pixels, int w, int h, int levels,
+                         int srgb, int kaiser, uint8_t *out);
+
+/* Texel processing done once at load time, applied in field order */
+#define LUB3D_CONVERT_TO_LINEAR 1
+#define LUB3D_CONVERT_TO_SRGB 2
+
+typedef struct {
+    uint8_t swizzle[4]; /* source of r, g, b, a: 0-3 = r, g, b, a, 4 = 0, 5 = 255 */
+    int swizzled;       /* swizzle is not rgba */
+    int normal_z;       /* rebuild b as the z of a unit normal from r, g */
+    int convert;        /* LUB3D_CONVERT_TO_LINEAR, LUB3D_CONVERT_TO_SRGB or 0 */
+    int premultiply;    /* multiply rgb by a */
+    int srgb;           /* texels are sRGB without convert: premultiply in linear light */
+} lub3d_image_ops;
+
+/* Read ops from the fields of the table at idx (swizzle, normal_z, convert,
+ * premultiply, srgb; see image.process). Returns 1 when any processing is
+ * requested; raises a Lua error for invalid values. */
+int lub3d_image_check_ops(lua_State *L, int idx, lub3d_image_ops *ops);
+
+/* Apply ops to count RGBA8 texels in place */
+void lub3d_image_process(uint8_t *pixels, size_t count, const lub3d_image_ops *ops);
+
+/* Parse a KTX2 or DDS header. Returns NULL or an error message. */
+const char *lub3d_image_parse_texture(const uint8_t *data, size_t len, lub3d_texture_info *info);
+
+/* Fill type, size, format and mip ranges of desc from parsed file data.
+ * Multi-slice DDS data is regrouped into *repacked, which the caller frees
+ * after sg_make_image. Returns 0 when out of memory. */
+int lub3d_image_texture_desc(const uint8_t *data, const lub3d_texture_info *info,
+                             sg_image_desc *desc, uint8_t **repacked);
+
+/* Bytes of one level (whole blocks for compressed formats), 0 if unsupported */
+size_t lub3d_image_level_bytes(sg_pixel_format format, int w, int h);
+
+/* Write a single-layer KTX2 file from levels (largest first). Returns a
+ * malloc'd buffer the caller frees, or NULL for an unsupported format or
+ * when out of memory. */
+uint8_t *lub3d_image_encode_ktx2(const uint8_t *const *levels, const size_t *sizes, int num_levels,
+                                 int w, int h, sg_pixel_format format, size_t *out_len);
+
+/* Data of the lub3d.image.Buffer at idx, resized to size bytes (raises a
+ * Lua error for other values or when out of memory) */
+uint8_t *lub3d_image_check_buffer(lua_State *L, int idx, size_t size);
+
+#ifdef LUB3D_HAS_BC7ENC
+/* Encode RGBA8 pixels to BC1_RGBA, BC4_R (red), BC5_RG (red, green) or
+ * BC7_RGBA/BC7_SRGBA blocks (lub3d_image_level_bytes(format, w, h) bytes).
+ * quality is 1-6; threads <= 0 uses all cores. Returns 0 for other formats. */
+int lub3d_bc_encode(sg_pixel_format format, const uint8_t *pixels, int w, int h, int quality,
+                    int threads, uint8_t *out);
+
+/* Decode those formats to RGBA8 (missing channels 0, alpha 255). Returns 0
+ * for other formats or invalid BC7 blocks. */
+int lub3d_bc_decode(sg_pixel_format format, const uint8_t *blocks, int w, int h, int threads,
+                    uint8_t *out);
+#endif
+
+#endif /* LUB3D_IMAGE_H */
@@ -21,6 +21,13 @@ extern int luaopen_miniaudio(lua_State *L);
 extern int luaopen_lub3d_fs(lua_State *L);
 extern int luaopen_mane3d_encoding(lua_State *L);
 extern int luaopen_lib_glm(lua_State *L);
+extern int luaopen_lub3d_sprite(lua_State *L);
+extern int luaopen_lub3d_particles(lua_State *L);
+extern int luaopen_lub3d_image(lua_State *L);
+extern int luaopen_lub3d_texloader(lua_State *L);
+extern int luaopen_lub3d_hash(lua_State *L);
+extern int luaopen_lub3d_pipeline_cache(lua_State *L);
+extern int luaopen_lub3d_program_cache(lua_State *L);
 
 #ifdef LUB3D_HAS_SHDC
 extern int luaopen_shdc(lua_State *L);
@@ -115,6 +122,20 @@ void lub3d_lua_register_all(lua_State *L)
     lua_pop(L, 1);
     luaL_requiref(L, "lib.glm", luaopen_lib_glm, 0);
     lua_pop(L, 1);
+    luaL_requiref(L, "lub3d.sprite", luaopen_lub3d_sprite, 0);
+    lua_pop(L, 1);
+    luaL_requiref(L, "lub3d.particles", luaopen_lub3d_particles, 0);
+    lua_pop(L, 1);
+    luaL_requiref(L, "lub3d.image", luaopen_lub3d_image, 0);
+    lua_pop(L, 1);
+    luaL_requiref(L, "lub3d.texloader", luaopen_lub3d_texloader, 0);
+    lua_pop(L, 1);
+    luaL_requiref(L, "lub3d.hash", luaopen_lub3d_hash, 0);
+    lua_pop(L, 1);
+    luaL_requiref(L, "lub3d.pipeline_cache", luaopen_lub3d_pipeline_cache, 0);
+    lua_pop(L, 1);
+    luaL_requiref(L, "lub3d.program_cache", luaopen_lub3d_program_cache, 0);
+    lua_pop(L, 1);
 
     /* Export write_floats for audio stream_cb */
     lua_pushcfunction(L, l_write_floats);
@@ -0,0 +1,401 @@
+/*
+ * particles_lua.c - Native particle pool for lib/particles.lua
+ *
+ * Particles are stored structure-of-arrays and kept densely packed: a new
+ * particle is appended at index count and a dead one is replaced by the
+ * last live particle, so allocation and release are O(1) and the live range
+ * [0, count) can be integrated and uploaded without gaps.
+ *
+ * Integration runs four particles at a time with SSE2 where available and
+ * falls back to scalar loops (e.g. on Emscripten).
+ *
+ * Lua API: require("lub3d.particles")
+ *   particles.new_pool(capacity, seed?) -> Pool
+ *   pool:emit(count, emitter) -> emitted
+ *   pool:update(dt)              -- integrate and retire expired particles
+ *   pool:append(buffer) -> byte_offset, count
+ *                               -- sg_append_buffer instance data (INSTANCE_BYTES each)
+ *   pool:count() / pool:capacity()
+ *   pool:clear()
+ *
+ * Emitter fields (all optional):
+ *   pos {x,y,z}, pos_range {x,y,z}   -- spawn box center and half extents
+ *   yaw, yaw_range                   -- horizontal direction (radians)
+ *   pitch, pitch_range               -- elevation (radians)
+ *   speed, speed_range
+ *   acc {x,y,z}, acc_range {x,y,z}   -- constant acceleration
+ *   life, life_range                 -- seconds
+ *   size, size_range
+ *   color {r,g,b,a}
+ * Every *_range is a symmetric random offset: value + rand(-1..1) * range.
+ */
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sokol_gfx.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARTICLES_SSE2 1
+#endif
+
+#define PARTICLE_POOL_MT "lub3d.particles.Pool"
+#define SG_BUFFER_MT "sokol.gfx.Buffer"
+#define PARTICLE_MIN_LIFE 1e-4f /* keeps the fade in append finite */
+
+/* Per-instance record (matches the lib/particles.lua pipeline layout) */
+typedef struct {
+    float x, y, z, size; /* FLOAT4 */
+    uint8_t color[4];    /* UBYTE4N, faded by remaining life */
+} ParticleInstance;
+
+enum {
+    F_PX, F_PY, F_PZ,
+    F_VX, F_VY, F_VZ,
+    F_AX, F_AY, F_AZ,
+    F_AGE, F_LIFE, F_SIZE,
+    F_COUNT
+};
+
+typedef struct {
+    float *block;            /* F_COUNT arrays of stride floats */
+    float *f[F_COUNT];
+    uint8_t (*color)[4];
+    ParticleInstance *instances;
+    int stride;              /* capacity rounded up to a multiple of 4 */
+    int capacity;
+    int count;
+    uint64_t rng;
+} ParticlePool;
+
+typedef struct {
+    float pos[3], pos_range[3];
+    float yaw, yaw_range;
+    float pitch, pitch_range;
+    float speed, speed_range;
+    float acc[3], acc_range[3];
+    float life, life_range;
+    float size, size_range;
+    float color[4];
+} Emitter;
+
+static ParticlePool *check_pool(lua_State *L, int idx)
+{
+    ParticlePool *p = (ParticlePool *)luaL_checkudata(L, idx, PARTICLE_POOL_MT);
+    if (!p->block)
+        luaL_error(L, "lub3d.particles.Pool has been destroyed");
+    return p;
+}
+
+/* xorshift64*: uniform float in [-1, 1) */
+static float rand_signed(ParticlePool *p)
+{
+    p->rng ^= p->rng >> 12;
+    p->rng ^= p->rng << 25;
+    p->rng ^= p->rng >> 27;
+    uint32_t bits = (uint32_t)((p->rng * 0x2545F4914F6CDD1DULL) >> 40); /* 24 bits */
+    return (float)bits * (2.0f / 16777216.0f) - 1.0f;
+}
+
+static float opt_number(lua_State *L, int idx, const char *key, float def)
+{
+    float v = def;
+    if (lua_getfield(L, idx, key) != LUA_TNIL)
+        v = (float)lua_tonumber(L, -1);
+    lua_pop(L, 1);
+    return v;
+}
+
+/* Read emitter.<key> as a vector: accepts {x=, y=, z=, w=} (glm vectors)
+ * or an array {1, 2, 3, 4} */
+static void opt_vec(lua_State *L, int idx, const char *key, float *out, int n)
+{
+    static const char *const names[4] = { "x", "y", "z", "w" };
+    int t = lua_getfield(L, idx, key);
+    if (t == LUA_TTABLE || t == LUA_TUSERDATA) {
+        int vi = lua_gettop(L);
+        for (int i = 0; i < n; i++) {
+            if (t == LUA_TTABLE && lua_rawgeti(L, vi, i + 1) != LUA_TNIL) {
+                out[i] = (float)lua_tonumber(L, -1);
+            } else {
+                if (t == LUA_TTABLE)
+                    lua_pop(L, 1);
+                if (lua_getfield(L, vi, names[i]) != LUA_TNIL)
+                    out[i] = (float)lua_tonumber(L, -1);
+            }
+            lua_pop(L, 1);
+        }
+    }
+    lua_pop(L, 1);
+}
+
+static void read_emitter(lua_State *L, int idx, Emitter *e)
+{
+    memset(e, 0, sizeof(Emitter));
+    e->life = 1.0f;
+    e->size = 1.0f;
+    e->color[0] = e->color[1] = e->color[2] = e->color[3] = 1.0f;
+    if (!lua_istable(L, idx))
+        return;
+    opt_vec(L, idx, "pos", e->pos, 3);
+    opt_vec(L, idx, "pos_range", e->pos_range, 3);
+    e->yaw = opt_number(L, idx, "yaw", 0.0f);
+    e->yaw_range = opt_number(L, idx, "yaw_range", 0.0f);
+    e->pitch = opt_number(L, idx, "pitch", 0.0f);
+    e->pitch_range = opt_number(L, idx, "pitch_range", 0.0f);
+    e->speed = opt_number(L, idx, "speed", 0.0f);
+    e->speed_range = opt_number(L, idx, "speed_range", 0.0f);
+    opt_vec(L, idx, "acc", e->acc, 3);
+    opt_vec(L, idx, "acc_range", e->acc_range, 3);
+    e->life = opt_number(L, idx, "life", 1.0f);
+    e->life_range = opt_number(L, idx, "life_range", 0.0f);
+    e->size = opt_number(L, idx, "size", 1.0f);
+    e->size_range = opt_number(L, idx, "size_range", 0.0f);
+    opt_vec(L, idx, "color", e->color, 4);
+}
+
+static uint8_t to_unorm8(float v)
+{
+    if (v <= 0.0f) return 0;
+    if (v >= 1.0f) return 255;
+    return (uint8_t)(v * 255.0f + 0.5f);
+}
+
+static void free_pool(ParticlePool *p)
+{
+    free(p->block);
+    free(p->color);
+    free(p->instances);
+    memset(p, 0, sizeof(ParticlePool));
+}
+
+/* particles.new_pool(capacity, seed) */
+static int l_particles_new_pool(lua_State *L)
+{
+    int capacity = (int)luaL_checkinteger(L, 1);
+    lua_Integer seed = luaL_optinteger(L, 2, 0x2545F491);
+    luaL_argcheck(L, capacity > 0, 1, "capacity must be positive");
+
+    ParticlePool *p = (ParticlePool *)lua_newuserdatauv(L, sizeof(ParticlePool), 0);
+    memset(p, 0, sizeof(ParticlePool));
+    luaL_setmetatable(L, PARTICLE_POOL_MT);
+
+    p->stride = (capacity + 3) & ~3;
+    p->block = (float *)malloc((size_t)p->stride * F_COUNT * sizeof(float));
+    p->color = (uint8_t (*)[4])malloc((size_t)capacity * 4);
+    p->instances = (ParticleInstance *)malloc((size_t)capacity * sizeof(ParticleInstance));
+    if (!p->block || !p->color || !p->instances) {
+        free_pool(p);
+        return luaL_error(L, "out of memory");
+    }
+    for (int i = 0; i < F_COUNT; i++)
+        p->f[i] = p->block + (size_t)i * p->stride;
+    p->capacity = capacity;
+    p->rng = seed ? (uint64_t)seed : 1;
+    return 1;
+}
+
+/* pool:emit(count, emitter) -> emitted (clamped to free capacity) */
+static int l_particles_emit(lua_State *L)
+{
+    ParticlePool *p = check_pool(L, 1);
+    lua_Integer want = luaL_checkinteger(L, 2);
+    Emitter e;
+    read_emitter(L, 3, &e);
+
+    int n = p->capacity - p->count;
+    if (want < n)
+        n = want > 0 ? (int)want : 0;
+
+    uint8_t color[4];
+    for (int c = 0; c < 4; c++)
+        color[c] = to_unorm8(e.color[c]);
+
+    float **f = p->f;
+    for (int k = 0; k < n; k++) {
+        int i = p->count++;
+        float yaw = e.yaw + rand_signed(p) * e.yaw_range;
+        float pitch = e.pitch + rand_signed(p) * e.pitch_range;
+        float speed = e.speed + rand_signed(p) * e.speed_range;
+        float horiz = cosf(pitch) * speed;
+
+        f[F_PX][i] = e.pos[0] + rand_signed(p) * e.pos_range[0];
+        f[F_PY][i] = e.pos[1] + rand_signed(p) * e.pos_range[1];
+        f[F_PZ][i] = e.pos[2] + rand_signed(p) * e.pos_range[2];
+        f[F_VX][i] = cosf(yaw) * horiz;
+        f[F_VY][i] = sinf(pitch) * speed;
+        f[F_VZ][i] = sinf(yaw) * horiz;
+        f[F_AX][i] = e.acc[0] + rand_signed(p) * e.acc_range[0];
+        f[F_AY][i] = e.acc[1] + rand_signed(p) * e.acc_range[1];
+        f[F_AZ][i] = e.acc[2] + rand_signed(p) * e.acc_range[2];
+        f[F_AGE][i] = 0.0f;
+        float life = e.life + rand_signed(p) * e.life_range;
+        f[F_LIFE][i] = life > PARTICLE_MIN_LIFE ? life : PARTICLE_MIN_LIFE;
+        f[F_SIZE][i] = e.size + rand_signed(p) * e.size_range;
+        memcpy(p->color[i], color, 4);
+    }
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+/* v += a * dt over [0, n) */
+static void madd(float *v, const float *a, float dt, int n)
+{
+    int i = 0;
+#ifdef PARTICLES_SSE2
+    __m128 vdt = _mm_set1_ps(dt);
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(v + i);
+        __m128 y = _mm_loadu_ps(a + i);
+        _mm_storeu_ps(v + i, _mm_add_ps(x, _mm_mul_ps(y, vdt)));
+    }
+#endif
+    for (; i < n; i++)
+        v[i] += a[i] * dt;
+}
+
+static void add_scalar(float *v, float s, int n)
+{
+    int i = 0;
+#ifdef PARTICLES_SSE2
+    __m128 vs = _mm_set1_ps(s);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(v + i, _mm_add_ps(_mm_loadu_ps(v + i), vs));
+#endif
+    for (; i < n; i++)
+        v[i] += s;
+}
+
+/* Move particle src into slot dst */
+static void move_particle(ParticlePool *p, int dst, int src)
+{
+    for (int k = 0; k < F_COUNT; k++)
+        p->f[k][dst] = p->f[k][src];
+    memcpy(p->color[dst], p->color[src], 4);
+}
+
+/* pool:update(dt)
+ * Semi-implicit Euler (velocity first), then retire particles whose age
+ * reached their life by swapping in the last live particle. */
+static int l_particles_update(lua_State *L)
+{
+    ParticlePool *p = check_pool(L, 1);
+    float dt = (float)luaL_checknumber(L, 2);
+    int n = p->count;
+    float **f = p->f;
+
+    madd(f[F_VX], f[F_AX], dt, n);
+    madd(f[F_VY], f[F_AY], dt, n);
+    madd(f[F_VZ], f[F_AZ], dt, n);
+    madd(f[F_PX], f[F_VX], dt, n);
+    madd(f[F_PY], f[F_VY], dt, n);
+    madd(f[F_PZ], f[F_VZ], dt, n);
+    add_scalar(f[F_AGE], dt, n);
+
+    const float *age = f[F_AGE];
+    const float *life = f[F_LIFE];
+    int i = 0;
+    while (i < n) {
+        if (age[i] >= life[i]) {
+            n--;
+            if (i != n)
+                move_particle(p, i, n);
+        } else {
+            i++;
+        }
+    }
+    p->count = n;
+    return 0;
+}
+
+/* pool:append(buffer) -> byte_offset, count
+ * Writes one instance per live particle (color faded by remaining life)
+ * and appends them with sg_append_buffer. */
+static int l_particles_append(lua_State *L)
+{
+    ParticlePool *p = check_pool(L, 1);
+    sg_buffer buf = *(sg_buffer *)luaL_checkudata(L, 2, SG_BUFFER_MT);
+    int n = p->count;
+    if (n == 0) {
+        lua_pushinteger(L, 0);
+        lua_pushinteger(L, 0);
+        return 2;
+    }
+
+    float **f = p->f;
+    for (int i = 0; i < n; i++) {
+        ParticleInstance *inst = &p->instances[i];
+        float fade = 1.0f - f[F_AGE][i] / f[F_LIFE][i];
+        if (fade < 0.0f) fade = 0.0f;
+        inst->x = f[F_PX][i];
+        inst->y = f[F_PY][i];
+        inst->z = f[F_PZ][i];
+        inst->size = f[F_SIZE][i];
+        for (int c = 0; c < 4; c++)
+            inst->color[c] = (uint8_t)((float)p->color[i][c] * fade + 0.5f);
+    }
+    sg_range range = { p->instances, (size_t)n * sizeof(ParticleInstance) };
+    lua_pushinteger(L, sg_append_buffer(buf, &range));
+    lua_pushinteger(L, n);
+    return 2;
+}
+
+static int l_particles_count(lua_State *L)
+{
+    lua_pushinteger(L, check_pool(L, 1)->count);
+    return 1;
+}
+
+static int l_particles_capacity(lua_State *L)
+{
+    lua_pushinteger(L, check_pool(L, 1)->capacity);
+    return 1;
+}
+
+static int l_particles_clear(lua_State *L)
+{
+    check_pool(L, 1)->count = 0;
+    return 0;
+}
+
+static int l_particles_pool_gc(lua_State *L)
+{
+    ParticlePool *p = (ParticlePool *)luaL_checkudata(L, 1, PARTICLE_POOL_MT);
+    free_pool(p);
+    return 0;
+}
+
+static const luaL_Reg particles_pool_methods[] = {
+    {"emit", l_particles_emit},
+    {"update", l_particles_update},
+    {"append", l_particles_append},
+    {"count", l_particles_count},
+    {"capacity", l_particles_capacity},
+    {"clear", l_particles_clear},
+    {"destroy", l_particles_pool_gc},
+    {NULL, NULL}
+};
+
+static const luaL_Reg particles_funcs[] = {
+    {"new_pool", l_particles_new_pool},
+    {NULL, NULL}
+};
+
+int luaopen_lub3d_particles(lua_State *L)
+{
+    luaL_newmetatable(L, PARTICLE_POOL_MT);
+    lua_pushcfunction(L, l_particles_pool_gc);
+    lua_setfield(L, -2, "__gc");
+    luaL_newlib(L, particles_pool_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    luaL_newlib(L, particles_funcs);
+    lua_pushinteger(L, (lua_Integer)sizeof(ParticleInstance));
+    lua_setfield(L, -2, "INSTANCE_BYTES");
+    return 1;
+}
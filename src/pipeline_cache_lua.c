@@ -0,0 +1,187 @@
+/*
+ * pipeline_cache_lua.c - Shared, ref-counted sokol pipelines
+ *
+ * Pipelines are keyed by the XXH64 of their sg_pipeline_desc (shader handle,
+ * vertex layout, depth/stencil, blend, rasterizer state; the label is left
+ * out) and compared in full on a key match, so equal descriptors share one
+ * sg_pipeline. Each get() takes a reference and each release() drops one;
+ * the pipeline is destroyed with its last reference.
+ *
+ * The cache lives in C, so it survives hot reloads of the Lua modules that
+ * use it: a reloaded module asking for the same pipeline gets the existing
+ * one instead of creating a duplicate.
+ *
+ * refresh(shader) rebuilds the cached pipelines of a shader that was
+ * re-initialized in place (shader hot reload, see lib/shader.lua): each
+ * keeps its handle, so every holder draws with the new shader.
+ *
+ * Lua API: require("lub3d.pipeline_cache")
+ *   pipeline_cache.get(desc) -> sokol.gfx.Pipeline   -- desc: gfx.PipelineDesc
+ *   pipeline_cache.release(pipeline)   -- pipelines not from get() are destroyed
+ *   pipeline_cache.refresh(shader) -> count  -- rebuild pipelines using shader
+ *   pipeline_cache.stats() -> { hits, misses, pipelines, refs }
+ *   pipeline_cache.reset()             -- forget every entry (after gfx.shutdown)
+ */
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sokol_gfx.h"
+#include "lub3d_hash.h"
+
+#define SG_PIPELINE_MT "sokol.gfx.Pipeline"
+#define SG_SHADER_MT "sokol.gfx.Shader"
+#define SG_PIPELINE_DESC_MT "sokol.gfx.PipelineDesc"
+
+typedef struct {
+    uint64_t key;
+    sg_pipeline_desc desc; /* label cleared */
+    sg_pipeline pip;
+    int refs;
+} PipelineEntry;
+
+static PipelineEntry *entries;
+static int entry_count;
+static int entry_cap;
+static lua_Integer hits;
+static lua_Integer misses;
+
+static int find_pipeline(sg_pipeline pip)
+{
+    for (int i = 0; i < entry_count; i++) {
+        if (entries[i].pip.id == pip.id)
+            return i;
+    }
+    return -1;
+}
+
+static void push_pipeline(lua_State *L, sg_pipeline pip)
+{
+    sg_pipeline *ud = (sg_pipeline *)lua_newuserdatauv(L, sizeof(sg_pipeline), 0);
+    *ud = pip;
+    luaL_setmetatable(L, SG_PIPELINE_MT);
+}
+
+/* pipeline_cache.get(desc) */
+static int l_pipeline_cache_get(lua_State *L)
+{
+    const sg_pipeline_desc *desc = (const sg_pipeline_desc *)luaL_checkudata(L, 1, SG_PIPELINE_DESC_MT);
+    /* PipelineDesc userdata are zero-filled before their fields are set,
+     * so padding bytes hash consistently */
+    sg_pipeline_desc key_desc = *desc;
+    key_desc.label = NULL;
+    uint64_t key = lub3d_hash_xxh64(&key_desc, sizeof(key_desc), 0);
+
+    for (int i = 0; i < entry_count; i++) {
+        PipelineEntry *e = &entries[i];
+        if (e->key == key && memcmp(&e->desc, &key_desc, sizeof(key_desc)) == 0) {
+            e->refs++;
+            hits++;
+            push_pipeline(L, e->pip);
+            return 1;
+        }
+    }
+
+    misses++;
+    sg_pipeline pip = sg_make_pipeline(desc);
+    /* Failed pipelines are handed out uncached; release() destroys them */
+    if (sg_query_pipeline_state(pip) == SG_RESOURCESTATE_VALID) {
+        if (entry_count == entry_cap) {
+            int cap = entry_cap ? entry_cap * 2 : 32;
+            PipelineEntry *grown = (PipelineEntry *)realloc(entries, (size_t)cap * sizeof(PipelineEntry));
+            if (!grown) {
+                sg_destroy_pipeline(pip);
+                return luaL_error(L, "pipeline cache: out of memory");
+            }
+            entries = grown;
+            entry_cap = cap;
+        }
+        PipelineEntry *e = &entries[entry_count++];
+        e->key = key;
+        e->desc = key_desc;
+        e->pip = pip;
+        e->refs = 1;
+    }
+    push_pipeline(L, pip);
+    return 1;
+}
+
+/* pipeline_cache.release(pipeline) */
+static int l_pipeline_cache_release(lua_State *L)
+{
+    sg_pipeline pip = *(sg_pipeline *)luaL_checkudata(L, 1, SG_PIPELINE_MT);
+    int i = find_pipeline(pip);
+    if (i < 0) {
+        sg_destroy_pipeline(pip);
+        return 0;
+    }
+    if (--entries[i].refs > 0)
+        return 0;
+    sg_destroy_pipeline(pip);
+    entries[i] = entries[--entry_count];
+    return 0;
+}
+
+/* pipeline_cache.refresh(shader) */
+static int l_pipeline_cache_refresh(lua_State *L)
+{
+    sg_shader shd = *(sg_shader *)luaL_checkudata(L, 1, SG_SHADER_MT);
+    int count = 0;
+    for (int i = 0; i < entry_count; i++) {
+        PipelineEntry *e = &entries[i];
+        if (e->desc.shader.id == shd.id) {
+            sg_uninit_pipeline(e->pip);
+            sg_init_pipeline(e->pip, &e->desc);
+            count++;
+        }
+    }
+    lua_pushinteger(L, count);
+    return 1;
+}
+
+/* pipeline_cache.stats() */
+static int l_pipeline_cache_stats(lua_State *L)
+{
+    lua_Integer refs = 0;
+    for (int i = 0; i < entry_count; i++)
+        refs += entries[i].refs;
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, hits);
+    lua_setfield(L, -2, "hits");
+    lua_pushinteger(L, misses);
+    lua_setfield(L, -2, "misses");
+    lua_pushinteger(L, entry_count);
+    lua_setfield(L, -2, "pipelines");
+    lua_pushinteger(L, refs);
+    lua_setfield(L, -2, "refs");
+    return 1;
+}
+
+/* pipeline_cache.reset() */
+static int l_pipeline_cache_reset(lua_State *L)
+{
+    (void)L;
+    free(entries);
+    entries = NULL;
+    entry_count = 0;
+    entry_cap = 0;
+    hits = 0;
+    misses = 0;
+    return 0;
+}
+
+static const luaL_Reg pipeline_cache_funcs[] = {
+    {"get", l_pipeline_cache_get},
+    {"release", l_pipeline_cache_release},
+    {"refresh", l_pipeline_cache_refresh},
+    {"stats", l_pipeline_cache_stats},
+    {"reset", l_pipeline_cache_reset},
+    {NULL, NULL}
+};
+
+int luaopen_lub3d_pipeline_cache(lua_State *L)
+{
+    luaL_newlib(L, pipeline_cache_funcs);
+    return 1;
+}
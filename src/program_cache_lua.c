@@ -0,0 +1,236 @@
+/*
+ * program_cache_lua.c - GL program binaries for warm starts
+ *
+ * On the GL backends sg_make_shader hands GLSL to the driver, which compiles
+ * and links it on every run. make_shader(desc, binary) creates the shader
+ * from a program binary saved by an earlier run instead (glProgramBinary):
+ * while it runs, the hooks below defer sokol's glCompileShader calls and turn
+ * its glLinkProgram into a glProgramBinary load. A binary the driver refuses
+ * (driver update, other GPU) falls back to compiling and linking the
+ * deferred sources, so the result is the same shader either way.
+ *
+ * Shaders built from source come back with their program binary
+ * (glGetProgramBinary) for the caller to store. The binary is prefixed with
+ * its 4-byte format; lib/shader.lua keys the files by source and driver().
+ *
+ * Lua API: require("lub3d.program_cache")
+ *   program_cache.supported() -> boolean  -- GL backend with binary formats
+ *   program_cache.driver() -> string?     -- "vendor|renderer|version"
+ *   program_cache.make_shader(desc, binary?) -> shader, loaded, binary?
+ *       -- loaded: created from binary; binary: to store, when built from source
+ *   program_cache.stats() -> { loaded, compiled, rejected }
+ */
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lub3d_gl_program.h"
+#include "sokol_gfx.h"
+
+#define SG_SHADER_MT "sokol.gfx.Shader"
+#define SG_SHADER_DESC_MT "sokol.gfx.ShaderDesc"
+
+static lua_Integer loaded_count;
+static lua_Integer compiled_count;
+static lua_Integer rejected_count;
+
+#ifdef LUB3D_GL_PROGRAM_BINARY
+
+/* State of the sg_make_shader call in progress in make_shader */
+static struct {
+    int armed;             /* hooks active */
+    const char *binary;    /* program binary to try, NULL to build from source */
+    GLsizei binary_len;
+    GLenum format;
+    int deferred;          /* glCompileShader calls skipped for the binary */
+    int loaded;            /* the binary was accepted */
+} hook;
+
+void lub3d_gl_compile_shader(GLuint shader)
+{
+    if (hook.armed && hook.binary) {
+        hook.deferred = 1;
+        return;
+    }
+    glCompileShader(shader);
+}
+
+void lub3d_gl_get_shaderiv(GLuint shader, GLenum pname, GLint *params)
+{
+    /* Deferred stages report success; link time settles it */
+    if (hook.deferred && pname == GL_COMPILE_STATUS) {
+        *params = GL_TRUE;
+        return;
+    }
+    glGetShaderiv(shader, pname, params);
+}
+
+void lub3d_gl_link_program(GLuint program)
+{
+    if (hook.armed && hook.binary) {
+        glProgramBinary(program, hook.format, hook.binary, hook.binary_len);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked) {
+            hook.loaded = 1;
+            return;
+        }
+        /* Refused: compile the attached stages and link them after all */
+        rejected_count++;
+        GLuint shaders[2];
+        GLsizei count = 0;
+        glGetAttachedShaders(program, 2, &count, shaders);
+        for (GLsizei i = 0; i < count; i++)
+            glCompileShader(shaders[i]);
+        hook.deferred = 0;
+    }
+    if (hook.armed)
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+}
+
+static int binaries_supported(void)
+{
+    if (!sg_isvalid())
+        return 0;
+    sg_backend backend = sg_query_backend();
+    if (backend != SG_BACKEND_GLCORE && backend != SG_BACKEND_GLES3)
+        return 0;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+/* Push the format-prefixed program binary of shd, or nil */
+static void push_binary(lua_State *L, sg_shader shd)
+{
+    GLuint program = (GLuint)sg_gl_query_shader_info(shd).prog;
+    GLint len = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &len);
+    if (len <= 0) {
+        lua_pushnil(L);
+        return;
+    }
+    luaL_Buffer b;
+    char *p = luaL_buffinitsize(L, &b, sizeof(uint32_t) + (size_t)len);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, len, &written, &format, p + sizeof(uint32_t));
+    if (written <= 0) {
+        luaL_pushresultsize(&b, 0);
+        lua_pop(L, 1);
+        lua_pushnil(L);
+        return;
+    }
+    uint32_t format32 = (uint32_t)format;
+    memcpy(p, &format32, sizeof(format32));
+    luaL_pushresultsize(&b, sizeof(uint32_t) + (size_t)written);
+}
+
+#else
+
+static int binaries_supported(void)
+{
+    return 0;
+}
+
+#endif /* LUB3D_GL_PROGRAM_BINARY */
+
+static void push_shader(lua_State *L, sg_shader shd)
+{
+    sg_shader *ud = (sg_shader *)lua_newuserdatauv(L, sizeof(sg_shader), 0);
+    *ud = shd;
+    luaL_setmetatable(L, SG_SHADER_MT);
+}
+
+/* program_cache.supported() */
+static int l_program_cache_supported(lua_State *L)
+{
+    lua_pushboolean(L, binaries_supported());
+    return 1;
+}
+
+/* program_cache.driver() */
+static int l_program_cache_driver(lua_State *L)
+{
+#ifdef LUB3D_GL_PROGRAM_BINARY
+    if (binaries_supported()) {
+        const char *vendor = (const char *)glGetString(GL_VENDOR);
+        const char *renderer = (const char *)glGetString(GL_RENDERER);
+        const char *version = (const char *)glGetString(GL_VERSION);
+        lua_pushfstring(L, "%s|%s|%s", vendor ? vendor : "", renderer ? renderer : "", version ? version : "");
+        return 1;
+    }
+#endif
+    lua_pushnil(L);
+    return 1;
+}
+
+/* program_cache.make_shader(desc, binary?) */
+static int l_program_cache_make_shader(lua_State *L)
+{
+    const sg_shader_desc *desc = (const sg_shader_desc *)luaL_checkudata(L, 1, SG_SHADER_DESC_MT);
+    size_t len = 0;
+    const char *binary = luaL_optlstring(L, 2, NULL, &len);
+#ifdef LUB3D_GL_PROGRAM_BINARY
+    memset(&hook, 0, sizeof(hook));
+    hook.armed = binaries_supported();
+    if (hook.armed && binary && len > sizeof(uint32_t)) {
+        uint32_t format;
+        memcpy(&format, binary, sizeof(format));
+        hook.format = (GLenum)format;
+        hook.binary = binary + sizeof(uint32_t);
+        hook.binary_len = (GLsizei)(len - sizeof(uint32_t));
+    }
+    sg_shader shd = sg_make_shader(desc);
+    int armed = hook.armed;
+    int loaded = hook.loaded;
+    memset(&hook, 0, sizeof(hook));
+
+    push_shader(L, shd);
+    lua_pushboolean(L, loaded);
+    if (loaded) {
+        loaded_count++;
+        lua_pushnil(L);
+    } else if (armed && sg_query_shader_state(shd) == SG_RESOURCESTATE_VALID) {
+        compiled_count++;
+        push_binary(L, shd);
+    } else {
+        lua_pushnil(L);
+    }
+#else
+    (void)binary;
+    push_shader(L, sg_make_shader(desc));
+    lua_pushboolean(L, 0);
+    lua_pushnil(L);
+#endif
+    return 3;
+}
+
+/* program_cache.stats() */
+static int l_program_cache_stats(lua_State *L)
+{
+    lua_createtable(L, 0, 3);
+    lua_pushinteger(L, loaded_count);
+    lua_setfield(L, -2, "loaded");
+    lua_pushinteger(L, compiled_count);
+    lua_setfield(L, -2, "compiled");
+    lua_pushinteger(L, rejected_count);
+    lua_setfield(L, -2, "rejected");
+    return 1;
+}
+
+static const luaL_Reg program_cache_funcs[] = {
+    {"supported", l_program_cache_supported},
+    {"driver", l_program_cache_driver},
+    {"make_shader", l_program_cache_make_shader},
+    {"stats", l_program_cache_stats},
+    {NULL, NULL}
+};
+
+int luaopen_lub3d_program_cache(lua_State *L)
+{
+    luaL_newlib(L, program_cache_funcs);
+    return 1;
+}
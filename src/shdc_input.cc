@@ -0,0 +1,101 @@
+// sokol-shdc's input.cc, built with its file loader redirected to memory
+//
+// Input::load_and_parse only takes a path, and reads the top-level file and
+// every @include with fopen/fseek/ftell/fread/fclose. This translation unit
+// compiles input.cc in place of the upstream one with those calls routed
+// through the functions below: the path registered with
+// shdc_input_set_memory is served from a buffer, anything else goes to stdio.
+// The registration is thread local, so concurrent compiles never share it.
+#include "shdc_input.h"
+
+// Everything input.cc includes must be seen before the stdio names are
+// redefined, so their declarations stay untouched
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "input.h"
+#include "util.h"
+#include "fmt/format.h"
+#include "pystring.h"
+
+namespace {
+
+struct MemorySource {
+    const char* path;
+    const char* data;
+    long len;
+};
+
+// A stream over a MemorySource, handed to input.cc as a FILE*
+struct MemoryStream {
+    const char* data;
+    long len;
+    long pos;
+};
+
+thread_local MemorySource memory_source = {};
+thread_local MemoryStream* memory_stream = nullptr;
+
+MemoryStream* as_memory(FILE* f) {
+    return (memory_stream && f == reinterpret_cast<FILE*>(memory_stream)) ? memory_stream : nullptr;
+}
+
+FILE* input_fopen(const char* path, const char* mode) {
+    if (memory_source.path && !memory_stream && strcmp(path, memory_source.path) == 0) {
+        memory_stream = new MemoryStream{memory_source.data, memory_source.len, 0};
+        return reinterpret_cast<FILE*>(memory_stream);
+    }
+    return fopen(path, mode);
+}
+
+int input_fseek(FILE* f, long offset, int origin) {
+    MemoryStream* m = as_memory(f);
+    if (!m) return fseek(f, offset, origin);
+    long base = origin == SEEK_SET ? 0 : origin == SEEK_CUR ? m->pos : m->len;
+    if (base + offset < 0 || base + offset > m->len) return -1;
+    m->pos = base + offset;
+    return 0;
+}
+
+long input_ftell(FILE* f) {
+    MemoryStream* m = as_memory(f);
+    return m ? m->pos : ftell(f);
+}
+
+size_t input_fread(void* dst, size_t size, size_t count, FILE* f) {
+    MemoryStream* m = as_memory(f);
+    if (!m) return fread(dst, size, count, f);
+    if (size == 0) return 0;
+    size_t n = std::min(count, static_cast<size_t>(m->len - m->pos) / size);
+    memcpy(dst, m->data + m->pos, n * size);
+    m->pos += static_cast<long>(n * size);
+    return n;
+}
+
+int input_fclose(FILE* f) {
+    MemoryStream* m = as_memory(f);
+    if (!m) return fclose(f);
+    delete m;
+    memory_stream = nullptr;
+    return 0;
+}
+
+} // namespace
+
+void shdc_input_set_memory(const char* path, const char* data, size_t len) {
+    memory_source = {path, data, static_cast<long>(len)};
+}
+
+void shdc_input_clear_memory(void) {
+    memory_source = {};
+}
+
+#define fopen input_fopen
+#define fseek input_fseek
+#define ftell input_ftell
+#define fread input_fread
+#define fclose input_fclose
+#include "input.cc"
@@ -0,0 +1,15 @@
+// In-memory sources for sokol-shdc's Input::load_and_parse
+#ifndef SHDC_INPUT_H
+#define SHDC_INPUT_H
+
+#include <cstddef>
+
+// Serve path from memory: while set, Input::load_and_parse on the calling
+// thread reads data instead of opening the file. Other paths (@include) still
+// come from the file system. data must stay valid until cleared.
+void shdc_input_set_memory(const char* path, const char* data, size_t len);
+
+// Stop serving the path set by shdc_input_set_memory
+void shdc_input_clear_memory(void);
+
+#endif // SHDC_INPUT_H
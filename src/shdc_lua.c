@@ -1,6 +1,8 @@
 // Lua bindings for sokol-shdc wrapper
 #include <lua.h>
 #include <lauxlib.h>
+#include <string.h>
+#include "sokol_gfx.h"
 #include "shdc_wrapper.h"
 
 // shdc.init()
@@ -15,7 +17,87 @@ static int l_shdc_shutdown(lua_State* L) {
     return 0;
 }
 
-// shdc.compile(source, program_name, slang)
+// Set the stage sources and bytecode of result as fields of the table on top
+static void set_stages(lua_State* L, const shdc_compile_result_t* result) {
+    if (result->vs_source && result->vs_source_len > 0) {
+        lua_pushlstring(L, result->vs_source, result->vs_source_len);
+        lua_setfield(L, -2, "vs_source");
+    }
+
+    if (result->fs_source && result->fs_source_len > 0) {
+        lua_pushlstring(L, result->fs_source, result->fs_source_len);
+        lua_setfield(L, -2, "fs_source");
+    }
+
+    if (result->vs_bytecode && result->vs_bytecode_len > 0) {
+        lua_pushlstring(L, result->vs_bytecode, result->vs_bytecode_len);
+        lua_setfield(L, -2, "vs_bytecode");
+    }
+
+    if (result->fs_bytecode && result->fs_bytecode_len > 0) {
+        lua_pushlstring(L, result->fs_bytecode, result->fs_bytecode_len);
+        lua_setfield(L, -2, "fs_bytecode");
+    }
+
+    if (result->reflection) {
+        lua_pushlstring(L, (const char*)result->reflection, sizeof(shdc_reflection_t));
+        lua_setfield(L, -2, "reflection");
+    }
+}
+
+// shdc.version() -> string identifying the compiler build (for cache keys)
+static int l_shdc_version(lua_State* L) {
+    lua_pushstring(L, shdc_version());
+    return 1;
+}
+
+#define MAX_SLANGS 16
+#define MAX_DEFINES 32
+#define JOB_MT "shdc.Job"
+
+// Read the string list at idx into out (at most max); the strings stay
+// referenced by the table. A nil argument is an empty list. Returns the count.
+static int check_strings(lua_State* L, int idx, const char** out, int max) {
+    if (lua_isnoneornil(L, idx)) {
+        return 0;
+    }
+    luaL_checktype(L, idx, LUA_TTABLE);
+    int count = (int)luaL_len(L, idx);
+    luaL_argcheck(L, count <= max, idx, "too many entries");
+    for (int i = 0; i < count; i++) {
+        if (lua_rawgeti(L, idx, i + 1) != LUA_TSTRING) {
+            luaL_argerror(L, idx, "entries must be strings");
+        }
+        out[i] = lua_tostring(L, -1);
+        lua_pop(L, 1);
+    }
+    return count;
+}
+
+// Read the output options table at idx ({ optimize?, minify? }) as
+// SHDC_* flags. A nil argument is no options.
+static int check_flags(lua_State* L, int idx) {
+    if (lua_isnoneornil(L, idx)) {
+        return 0;
+    }
+    luaL_checktype(L, idx, LUA_TTABLE);
+    int flags = 0;
+    lua_getfield(L, idx, "optimize");
+    if (lua_toboolean(L, -1)) {
+        flags |= SHDC_OPTIMIZE;
+    }
+    lua_getfield(L, idx, "minify");
+    if (lua_toboolean(L, -1)) {
+        flags |= SHDC_MINIFY;
+    }
+    lua_pop(L, 2);
+    return flags;
+}
+
+// shdc.compile(source, program_name, slang, defines?, options?)
+// defines: { "NAME" or "NAME VALUE", ... } as after #define.
+// options: { optimize = spirv-opt performance passes, minify = strip
+// indentation and empty lines from the sources }
 // Returns table with:
 //   success: boolean
 //   error: string or nil
@@ -23,12 +105,17 @@ static int l_shdc_shutdown(lua_State* L) {
 //   fs_source: string
 //   vs_bytecode: string (binary) or nil
 //   fs_bytecode: string (binary) or nil
+//   reflection: string (binary, for shdc.shader_desc / shdc.reflect)
+//   compile_ms: number (on success)
 static int l_shdc_compile(lua_State* L) {
     const char* source = luaL_checkstring(L, 1);
     const char* program_name = luaL_checkstring(L, 2);
     const char* slang = luaL_checkstring(L, 3);
+    const char* defines[MAX_DEFINES];
+    int define_count = check_strings(L, 4, defines, MAX_DEFINES);
+    int flags = check_flags(L, 5);
 
-    shdc_compile_result_t result = shdc_compile(source, program_name, slang);
+    shdc_compile_result_t result = shdc_compile(source, program_name, slang, defines, define_count, flags);
 
     lua_newtable(L);
 
@@ -40,27 +127,501 @@ static int l_shdc_compile(lua_State* L) {
         lua_setfield(L, -2, "error");
     }
 
-    if (result.vs_source && result.vs_source_len > 0) {
-        lua_pushlstring(L, result.vs_source, result.vs_source_len);
-        lua_setfield(L, -2, "vs_source");
+    set_stages(L, &result);
+
+    if (result.success) {
+        lua_pushnumber(L, result.compile_ms);
+        lua_setfield(L, -2, "compile_ms");
     }
 
-    if (result.fs_source && result.fs_source_len > 0) {
-        lua_pushlstring(L, result.fs_source, result.fs_source_len);
-        lua_setfield(L, -2, "fs_source");
+    shdc_free_result(&result);
+
+    return 1;
+}
+
+// Push the compile_all table for result and free it
+static void push_all_result(lua_State* L, shdc_compile_all_result_t* result) {
+    lua_newtable(L);
+
+    lua_pushboolean(L, result->success);
+    lua_setfield(L, -2, "success");
+
+    if (result->error_msg && result->error_msg[0]) {
+        lua_pushstring(L, result->error_msg);
+        lua_setfield(L, -2, "error");
     }
 
-    if (result.vs_bytecode && result.vs_bytecode_len > 0) {
-        lua_pushlstring(L, result.vs_bytecode, result.vs_bytecode_len);
-        lua_setfield(L, -2, "vs_bytecode");
+    if (result->success) {
+        lua_pushnumber(L, result->compile_ms);
+        lua_setfield(L, -2, "compile_ms");
+
+        lua_newtable(L);
+        for (int i = 0; i < result->program_count; i++) {
+            const shdc_program_result_t* entry = &result->programs[i];
+            if (lua_getfield(L, -1, entry->program) != LUA_TTABLE) {
+                lua_pop(L, 1);
+                lua_newtable(L);
+                lua_pushvalue(L, -1);
+                lua_setfield(L, -3, entry->program);
+            }
+            lua_newtable(L);
+            set_stages(L, &entry->stages);
+            lua_setfield(L, -2, entry->slang);
+            lua_pop(L, 1);
+        }
+        lua_setfield(L, -2, "programs");
     }
 
-    if (result.fs_bytecode && result.fs_bytecode_len > 0) {
-        lua_pushlstring(L, result.fs_bytecode, result.fs_bytecode_len);
-        lua_setfield(L, -2, "fs_bytecode");
+    shdc_free_all_result(result);
+}
+
+// shdc.compile_all(source, slangs, defines?, options?)
+// Compiles every @program of source for every language in slangs, parsing
+// the source once. defines, options: as for shdc.compile. Returns table with:
+//   success: boolean
+//   error: string or nil
+//   compile_ms: number (on success)
+//   programs: { [program] = { [slang] = { vs_source, fs_source, vs_bytecode?, fs_bytecode?, reflection } } }
+static int l_shdc_compile_all(lua_State* L) {
+    const char* source = luaL_checkstring(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    const char* slangs[MAX_SLANGS];
+    int slang_count = check_strings(L, 2, slangs, MAX_SLANGS);
+    const char* defines[MAX_DEFINES];
+    int define_count = check_strings(L, 3, defines, MAX_DEFINES);
+    int flags = check_flags(L, 4);
+
+    shdc_compile_all_result_t result = shdc_compile_all(source, slangs, slang_count, defines, define_count, flags);
+    push_all_result(L, &result);
+    return 1;
+}
+
+typedef struct {
+    shdc_job_t* job;
+} ShdcJob;
+
+// shdc.compile_async(source, slangs, defines?, options?)
+// Queues shdc.compile_all(source, slangs, defines, options) on the background
+// compile threads and returns a Job right away. Poll job:done(), then job:result().
+static int l_shdc_compile_async(lua_State* L) {
+    const char* source = luaL_checkstring(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    const char* slangs[MAX_SLANGS];
+    int slang_count = check_strings(L, 2, slangs, MAX_SLANGS);
+    const char* defines[MAX_DEFINES];
+    int define_count = check_strings(L, 3, defines, MAX_DEFINES);
+    int flags = check_flags(L, 4);
+
+    ShdcJob* ud = (ShdcJob*)lua_newuserdatauv(L, sizeof(ShdcJob), 1);
+    ud->job = NULL;
+    luaL_setmetatable(L, JOB_MT);
+    ud->job = shdc_compile_async(source, slangs, slang_count, defines, define_count, flags);
+    return 1;
+}
+
+// job:done() -> boolean
+static int l_job_done(lua_State* L) {
+    ShdcJob* ud = (ShdcJob*)luaL_checkudata(L, 1, JOB_MT);
+    lua_pushboolean(L, !ud->job || shdc_job_done(ud->job));
+    return 1;
+}
+
+// shdc.set_threads(count?) - background compile threads; nil or 0 for one
+// per core (offline cooking), default a few
+static int l_shdc_set_threads(lua_State* L) {
+    shdc_set_threads((int)luaL_optinteger(L, 1, 0));
+    return 0;
+}
+
+// job:result() -> compile_all table, or nil while the job is running.
+// The table is kept, so later calls return the same one.
+static int l_job_result(lua_State* L) {
+    ShdcJob* ud = (ShdcJob*)luaL_checkudata(L, 1, JOB_MT);
+    if (lua_getiuservalue(L, 1, 1) == LUA_TTABLE) {
+        return 1;
+    }
+    if (!ud->job || !shdc_job_done(ud->job)) {
+        lua_pushnil(L);
+        return 1;
     }
+    shdc_compile_all_result_t result = shdc_job_take(ud->job);
+    shdc_job_release(ud->job);
+    ud->job = NULL;
+    push_all_result(L, &result);
+    lua_pushvalue(L, -1);
+    lua_setiuservalue(L, 1, 1);
+    return 1;
+}
 
-    shdc_free_result(&result);
+// job:wait() -> compile_all table, blocking until the job has finished
+static int l_job_wait(lua_State* L) {
+    ShdcJob* ud = (ShdcJob*)luaL_checkudata(L, 1, JOB_MT);
+    if (ud->job) {
+        shdc_job_wait(ud->job);
+    }
+    return l_job_result(L);
+}
+
+// job:cancel() / __gc: drop the job, finishing or discarding it in the background
+static int l_job_cancel(lua_State* L) {
+    ShdcJob* ud = (ShdcJob*)luaL_checkudata(L, 1, JOB_MT);
+    shdc_job_release(ud->job);
+    ud->job = NULL;
+    return 0;
+}
+
+static const luaL_Reg job_methods[] = {
+    {"done", l_job_done},
+    {"result", l_job_result},
+    {"wait", l_job_wait},
+    {"cancel", l_job_cancel},
+    {NULL, NULL}
+};
+
+#define TERMINATE(name) ((name)[sizeof(name) - 1] = '\0')
+
+static int valid_stage(int32_t stage) {
+    return stage >= SHDC_STAGE_NONE && stage <= SHDC_STAGE_FRAGMENT;
+}
+
+// Copy a reflection blob out of data and check everything that is used as
+// an index or count; names are cut to their fixed size. Blobs come back from
+// cache files, so a corrupt one must not read out of bounds. Returns an
+// error message or NULL.
+static const char* read_reflection(const char* data, size_t len, shdc_reflection_t* refl) {
+    if (len != sizeof(shdc_reflection_t)) {
+        return "not a shader reflection";
+    }
+    memcpy(refl, data, sizeof(*refl));
+    if (refl->version != SHDC_REFLECTION_VERSION) {
+        return "shader reflection version mismatch";
+    }
+    for (int i = 0; i < SHDC_MAX_UNIFORM_BLOCKS; i++) {
+        shdc_uniform_block_t* ub = &refl->uniform_blocks[i];
+        if (!valid_stage(ub->stage) || ub->size < 0
+            || ub->member_count < 0 || ub->member_count > SHDC_MAX_UNIFORM_MEMBERS) {
+            return "corrupt shader reflection";
+        }
+        TERMINATE(ub->name);
+        TERMINATE(ub->inst_name);
+        for (int m = 0; m < SHDC_MAX_UNIFORM_MEMBERS; m++) {
+            TERMINATE(ub->members[m].name);
+        }
+    }
+    for (int i = 0; i < SHDC_MAX_TEXTURES; i++) {
+        if (!valid_stage(refl->textures[i].stage)) {
+            return "corrupt shader reflection";
+        }
+        TERMINATE(refl->textures[i].name);
+    }
+    for (int i = 0; i < SHDC_MAX_SAMPLERS; i++) {
+        if (!valid_stage(refl->samplers[i].stage)) {
+            return "corrupt shader reflection";
+        }
+        TERMINATE(refl->samplers[i].name);
+    }
+    for (int i = 0; i < SHDC_MAX_TEXTURE_SAMPLERS; i++) {
+        shdc_texture_sampler_t* pair = &refl->texture_samplers[i];
+        if (!valid_stage(pair->stage)
+            || (pair->stage != SHDC_STAGE_NONE
+                && (pair->texture_slot < 0 || pair->texture_slot >= SHDC_MAX_TEXTURES
+                    || pair->sampler_slot < 0 || pair->sampler_slot >= SHDC_MAX_SAMPLERS))) {
+            return "corrupt shader reflection";
+        }
+        TERMINATE(pair->glsl_name);
+    }
+    for (int i = 0; i < SHDC_MAX_ATTRS; i++) {
+        TERMINATE(refl->attrs[i].name);
+        TERMINATE(refl->attrs[i].sem_name);
+    }
+    return NULL;
+}
+
+// Reflection blob at idx, copied out of the string and checked
+static void check_reflection(lua_State* L, int idx, shdc_reflection_t* refl) {
+    size_t len;
+    const char* data = luaL_checklstring(L, idx, &len);
+    const char* err = read_reflection(data, len, refl);
+    if (err) {
+        luaL_argerror(L, idx, err);
+    }
+}
+
+// shdc.valid_reflection(reflection) -> boolean, error?
+// Whether a reflection blob (e.g. read from the shader cache) is usable
+static int l_shdc_valid_reflection(lua_State* L) {
+    size_t len;
+    const char* data = luaL_checklstring(L, 1, &len);
+    shdc_reflection_t refl;
+    const char* err = read_reflection(data, len, &refl);
+    lua_pushboolean(L, err == NULL);
+    if (err) {
+        lua_pushstring(L, err);
+        return 2;
+    }
+    return 1;
+}
+
+static int shader_stage(int32_t stage) {
+    return stage == SHDC_STAGE_VERTEX ? SG_SHADERSTAGE_VERTEX : SG_SHADERSTAGE_FRAGMENT;
+}
+
+static int uniform_type(int32_t type) {
+    switch (type) {
+        case SHDC_TYPE_FLOAT: return SG_UNIFORMTYPE_FLOAT;
+        case SHDC_TYPE_FLOAT2: return SG_UNIFORMTYPE_FLOAT2;
+        case SHDC_TYPE_FLOAT3: return SG_UNIFORMTYPE_FLOAT3;
+        case SHDC_TYPE_FLOAT4: return SG_UNIFORMTYPE_FLOAT4;
+        case SHDC_TYPE_INT: return SG_UNIFORMTYPE_INT;
+        case SHDC_TYPE_INT2: return SG_UNIFORMTYPE_INT2;
+        case SHDC_TYPE_INT3: return SG_UNIFORMTYPE_INT3;
+        case SHDC_TYPE_INT4: return SG_UNIFORMTYPE_INT4;
+        case SHDC_TYPE_MAT4: return SG_UNIFORMTYPE_MAT4;
+        default: return SG_UNIFORMTYPE_INVALID;
+    }
+}
+
+static int image_type(int32_t type) {
+    switch (type) {
+        case SHDC_IMAGE_CUBE: return SG_IMAGETYPE_CUBE;
+        case SHDC_IMAGE_3D: return SG_IMAGETYPE_3D;
+        case SHDC_IMAGE_ARRAY: return SG_IMAGETYPE_ARRAY;
+        default: return SG_IMAGETYPE_2D;
+    }
+}
+
+static int sample_type(int32_t type) {
+    switch (type) {
+        case SHDC_SAMPLE_DEPTH: return SG_IMAGESAMPLETYPE_DEPTH;
+        case SHDC_SAMPLE_SINT: return SG_IMAGESAMPLETYPE_SINT;
+        case SHDC_SAMPLE_UINT: return SG_IMAGESAMPLETYPE_UINT;
+        case SHDC_SAMPLE_UNFILTERABLE_FLOAT: return SG_IMAGESAMPLETYPE_UNFILTERABLE_FLOAT;
+        default: return SG_IMAGESAMPLETYPE_FLOAT;
+    }
+}
+
+static int sampler_type(int32_t type) {
+    switch (type) {
+        case SHDC_SAMPLER_NONFILTERING: return SG_SAMPLERTYPE_NONFILTERING;
+        case SHDC_SAMPLER_COMPARISON: return SG_SAMPLERTYPE_COMPARISON;
+        default: return SG_SAMPLERTYPE_FILTERING;
+    }
+}
+
+static void set_int(lua_State* L, const char* key, lua_Integer value) {
+    lua_pushinteger(L, value);
+    lua_setfield(L, -2, key);
+}
+
+static void set_str(lua_State* L, const char* key, const char* value) {
+    lua_pushstring(L, value);
+    lua_setfield(L, -2, key);
+}
+
+// GLSL uniforms of a block: one vec4/ivec4 array when shdc flattened it,
+// else one entry per member
+static void push_glsl_uniforms(lua_State* L, const shdc_uniform_block_t* ub) {
+    lua_newtable(L);
+    if (ub->flattened) {
+        int is_int = ub->member_count > 0 && ub->members[0].type >= SHDC_TYPE_INT && ub->members[0].type <= SHDC_TYPE_INT4;
+        lua_newtable(L);
+        set_int(L, "type", is_int ? SG_UNIFORMTYPE_INT4 : SG_UNIFORMTYPE_FLOAT4);
+        set_int(L, "array_count", (ub->size + 15) / 16);
+        set_str(L, "glsl_name", ub->name);
+        lua_rawseti(L, -2, 1);
+        return;
+    }
+    for (int i = 0; i < ub->member_count; i++) {
+        const shdc_uniform_member_t* m = &ub->members[i];
+        lua_newtable(L);
+        set_int(L, "type", uniform_type(m->type));
+        if (m->array_count > 0) {
+            set_int(L, "array_count", m->array_count);
+        }
+        lua_pushfstring(L, "%s.%s", ub->inst_name, m->name);
+        lua_setfield(L, -2, "glsl_name");
+        lua_rawseti(L, -2, i + 1);
+    }
+}
+
+// Count of slots up to the highest used one; unused slots below it become
+// empty tables, which sokol reads as unused
+static int used_slots(const int32_t* stage, size_t stride, int max) {
+    int count = 0;
+    for (int i = 0; i < max; i++) {
+        if (*(const int32_t*)((const char*)stage + i * stride) != SHDC_STAGE_NONE) {
+            count = i + 1;
+        }
+    }
+    return count;
+}
+
+// shdc.shader_desc(reflection) -> table for gfx.ShaderDesc without
+// vertex_func/fragment_func: uniform_blocks, views, samplers,
+// texture_sampler_pairs and attrs, for every backend
+static int l_shdc_shader_desc(lua_State* L) {
+    shdc_reflection_t refl;
+    check_reflection(L, 1, &refl);
+
+    lua_newtable(L);
+
+    int n = used_slots(&refl.uniform_blocks[0].stage, sizeof(refl.uniform_blocks[0]), SHDC_MAX_UNIFORM_BLOCKS);
+    lua_createtable(L, n, 0);
+    for (int i = 0; i < n; i++) {
+        const shdc_uniform_block_t* ub = &refl.uniform_blocks[i];
+        lua_newtable(L);
+        if (ub->stage != SHDC_STAGE_NONE) {
+            set_int(L, "stage", shader_stage(ub->stage));
+            set_int(L, "size", ub->size);
+            set_int(L, "layout", SG_UNIFORMLAYOUT_STD140);
+            set_int(L, "hlsl_register_b_n", ub->hlsl_register_b_n);
+            set_int(L, "msl_buffer_n", ub->msl_buffer_n);
+            set_int(L, "wgsl_group0_binding_n", ub->wgsl_group0_binding_n);
+            push_glsl_uniforms(L, ub);
+            lua_setfield(L, -2, "glsl_uniforms");
+        }
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "uniform_blocks");
+
+    n = used_slots(&refl.textures[0].stage, sizeof(refl.textures[0]), SHDC_MAX_TEXTURES);
+    lua_createtable(L, n, 0);
+    for (int i = 0; i < n; i++) {
+        const shdc_texture_t* tex = &refl.textures[i];
+        lua_newtable(L);
+        if (tex->stage != SHDC_STAGE_NONE) {
+            lua_newtable(L);
+            set_int(L, "stage", shader_stage(tex->stage));
+            set_int(L, "image_type", image_type(tex->image_type));
+            set_int(L, "sample_type", sample_type(tex->sample_type));
+            lua_pushboolean(L, tex->multisampled);
+            lua_setfield(L, -2, "multisampled");
+            set_int(L, "hlsl_register_t_n", tex->hlsl_register_t_n);
+            set_int(L, "msl_texture_n", tex->msl_texture_n);
+            set_int(L, "wgsl_group1_binding_n", tex->wgsl_group1_binding_n);
+            lua_setfield(L, -2, "texture");
+        }
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "views");
+
+    n = used_slots(&refl.samplers[0].stage, sizeof(refl.samplers[0]), SHDC_MAX_SAMPLERS);
+    lua_createtable(L, n, 0);
+    for (int i = 0; i < n; i++) {
+        const shdc_sampler_t* smp = &refl.samplers[i];
+        lua_newtable(L);
+        if (smp->stage != SHDC_STAGE_NONE) {
+            set_int(L, "stage", shader_stage(smp->stage));
+            set_int(L, "sampler_type", sampler_type(smp->sampler_type));
+            set_int(L, "hlsl_register_s_n", smp->hlsl_register_s_n);
+            set_int(L, "msl_sampler_n", smp->msl_sampler_n);
+            set_int(L, "wgsl_group1_binding_n", smp->wgsl_group1_binding_n);
+        }
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "samplers");
+
+    n = used_slots(&refl.texture_samplers[0].stage, sizeof(refl.texture_samplers[0]), SHDC_MAX_TEXTURE_SAMPLERS);
+    lua_createtable(L, n, 0);
+    for (int i = 0; i < n; i++) {
+        const shdc_texture_sampler_t* pair = &refl.texture_samplers[i];
+        lua_newtable(L);
+        if (pair->stage != SHDC_STAGE_NONE) {
+            set_int(L, "stage", shader_stage(pair->stage));
+            set_int(L, "view_slot", pair->texture_slot);
+            set_int(L, "sampler_slot", pair->sampler_slot);
+            set_str(L, "glsl_name", pair->glsl_name);
+        }
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "texture_sampler_pairs");
+
+    n = used_slots(&refl.attrs[0].used, sizeof(refl.attrs[0]), SHDC_MAX_ATTRS);
+    lua_createtable(L, n, 0);
+    for (int i = 0; i < n; i++) {
+        const shdc_attr_t* attr = &refl.attrs[i];
+        lua_newtable(L);
+        if (attr->used) {
+            set_str(L, "glsl_name", attr->name);
+            set_str(L, "hlsl_sem_name", attr->sem_name);
+            set_int(L, "hlsl_sem_index", attr->sem_index);
+        }
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "attrs");
+
+    return 1;
+}
+
+static const char* const STAGE_NAMES[] = {"none", "vertex", "fragment"};
+static const char* const TYPE_NAMES[] = {
+    "invalid", "float", "float2", "float3", "float4", "int", "int2", "int3", "int4", "mat4",
+};
+
+// shdc.reflect(reflection) -> readable reflection, keyed by bind slot + 1:
+//   uniform_blocks = { [slot] = { stage, name, size, members = { { name, type, offset, array_count } } } }
+//   textures = { [slot] = { stage, name } }
+//   samplers = { [slot] = { stage, name } }
+//   attrs = { [location] = { name, sem_name, sem_index } }
+static int l_shdc_reflect(lua_State* L) {
+    shdc_reflection_t refl;
+    check_reflection(L, 1, &refl);
+
+    lua_newtable(L);
+
+    lua_newtable(L);
+    for (int i = 0; i < SHDC_MAX_UNIFORM_BLOCKS; i++) {
+        const shdc_uniform_block_t* ub = &refl.uniform_blocks[i];
+        if (ub->stage == SHDC_STAGE_NONE) continue;
+        lua_newtable(L);
+        set_str(L, "stage", STAGE_NAMES[ub->stage]);
+        set_str(L, "name", ub->name);
+        set_int(L, "size", ub->size);
+        lua_createtable(L, ub->member_count, 0);
+        for (int m = 0; m < ub->member_count; m++) {
+            const shdc_uniform_member_t* member = &ub->members[m];
+            lua_newtable(L);
+            set_str(L, "name", member->name);
+            set_str(L, "type", TYPE_NAMES[member->type <= SHDC_TYPE_MAT4 ? member->type : 0]);
+            set_int(L, "offset", member->offset);
+            set_int(L, "array_count", member->array_count);
+            lua_rawseti(L, -2, m + 1);
+        }
+        lua_setfield(L, -2, "members");
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "uniform_blocks");
+
+    lua_newtable(L);
+    for (int i = 0; i < SHDC_MAX_TEXTURES; i++) {
+        if (refl.textures[i].stage == SHDC_STAGE_NONE) continue;
+        lua_newtable(L);
+        set_str(L, "stage", STAGE_NAMES[refl.textures[i].stage]);
+        set_str(L, "name", refl.textures[i].name);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "textures");
+
+    lua_newtable(L);
+    for (int i = 0; i < SHDC_MAX_SAMPLERS; i++) {
+        if (refl.samplers[i].stage == SHDC_STAGE_NONE) continue;
+        lua_newtable(L);
+        set_str(L, "stage", STAGE_NAMES[refl.samplers[i].stage]);
+        set_str(L, "name", refl.samplers[i].name);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "samplers");
+
+    lua_newtable(L);
+    for (int i = 0; i < SHDC_MAX_ATTRS; i++) {
+        if (!refl.attrs[i].used) continue;
+        lua_newtable(L);
+        set_str(L, "name", refl.attrs[i].name);
+        set_str(L, "sem_name", refl.attrs[i].sem_name);
+        set_int(L, "sem_index", refl.attrs[i].sem_index);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "attrs");
 
     return 1;
 }
@@ -68,11 +629,25 @@ static int l_shdc_compile(lua_State* L) {
 static const luaL_Reg shdc_funcs[] = {
     {"init", l_shdc_init},
     {"shutdown", l_shdc_shutdown},
+    {"version", l_shdc_version},
     {"compile", l_shdc_compile},
+    {"compile_all", l_shdc_compile_all},
+    {"compile_async", l_shdc_compile_async},
+    {"set_threads", l_shdc_set_threads},
+    {"shader_desc", l_shdc_shader_desc},
+    {"reflect", l_shdc_reflect},
+    {"valid_reflection", l_shdc_valid_reflection},
     {NULL, NULL}
 };
 
 int luaopen_shdc(lua_State* L) {
+    luaL_newmetatable(L, JOB_MT);
+    lua_pushcfunction(L, l_job_cancel);
+    lua_setfield(L, -2, "__gc");
+    luaL_newlib(L, job_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
     luaL_newlib(L, shdc_funcs);
     return 1;
 }
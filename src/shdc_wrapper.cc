@@ -1,19 +1,154 @@
 // C wrapper for sokol-shdc library
 #include "shdc_wrapper.h"
+#include "shdc_input.h"
 #include "shdc/spirv.h"
 #include "shdc/input.h"
 #include "shdc/spirvcross.h"
 #include "shdc/bytecode.h"
 #include "shdc/reflection.h"
 #include "shdc/types/slang.h"
+#include "spirv-tools/optimizer.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <cstring>
 #include <cstdlib>
-#include <fstream>
 #include <string>
+#include <vector>
 
 using namespace shdc;
 
+// Set by CMake from the deps/sokol-tools checkout
+#ifndef SHDC_TOOLS_REV
+#define SHDC_TOOLS_REV "unknown"
+#endif
+
+// Background compile jobs (shdc_compile_async). glslang, SPIRV-Cross and
+// tint keep no global state once Spirv::initialize_spirv_tools has run, and
+// in-memory sources are registered per thread (shdc_input.h), so workers
+// run shdc_compile_all concurrently. Without thread support (Emscripten
+// builds without pthreads) jobs compile synchronously when queued.
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define SHDC_THREADS 0
+#else
+#define SHDC_THREADS 1
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+struct shdc_job {
+    enum State { QUEUED, RUNNING, DONE };
+    std::string source;
+    std::vector<std::string> slangs;
+    std::vector<std::string> defines;
+    int flags = 0;
+    State state = QUEUED;
+    bool released = false;  // owner let go while running: the worker frees it
+    bool taken = false;
+    shdc_compile_all_result_t result = {};
+};
+
+static shdc_compile_all_result_t run_job(const shdc_job* job) {
+    std::vector<const char*> slangs;
+    for (const std::string& slang : job->slangs) {
+        slangs.push_back(slang.c_str());
+    }
+    std::vector<const char*> defines;
+    for (const std::string& define : job->defines) {
+        defines.push_back(define.c_str());
+    }
+    return shdc_compile_all(job->source.c_str(), slangs.data(), static_cast<int>(slangs.size()), defines.data(),
+                            static_cast<int>(defines.size()), job->flags);
+}
+
+#if SHDC_THREADS
+namespace {
+
+const int MAX_WORKERS = 4;
+
+struct Pool {
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;  // a job finished (shdc_job_wait)
+    std::deque<shdc_job*> queue;
+    std::vector<std::thread> workers;
+    int threads = 0;  // shdc_set_threads, 0 for the default
+    bool quit = false;
+};
+
+Pool pool;
+
+void worker_main() {
+    for (;;) {
+        shdc_job* job;
+        {
+            std::unique_lock<std::mutex> lk(pool.lock);
+            pool.wake.wait(lk, [] { return pool.quit || !pool.queue.empty(); });
+            if (pool.quit) {
+                return;
+            }
+            job = pool.queue.front();
+            pool.queue.pop_front();
+            job->state = shdc_job::RUNNING;
+        }
+
+        shdc_compile_all_result_t result = run_job(job);
+
+        std::lock_guard<std::mutex> lk(pool.lock);
+        if (job->released) {
+            shdc_free_all_result(&result);
+            delete job;
+        } else {
+            job->result = result;
+            job->state = shdc_job::DONE;
+            pool.done.notify_all();
+        }
+    }
+}
+
+// Start the workers on first use, or more after shdc_set_threads raised the
+// count (caller holds pool.lock). By default a few, leaving the other cores
+// to the game.
+void start_workers() {
+    int count = pool.threads;
+    if (count <= 0) {
+        count = std::clamp(static_cast<int>(std::thread::hardware_concurrency()) - 1, 1, MAX_WORKERS);
+    }
+    pool.quit = false;
+    while (static_cast<int>(pool.workers.size()) < count) {
+        pool.workers.emplace_back(worker_main);
+    }
+}
+
+// Join the workers; queued jobs finish with an error
+void stop_workers() {
+    {
+        std::lock_guard<std::mutex> lk(pool.lock);
+        pool.quit = true;
+        for (shdc_job* job : pool.queue) {
+            if (job->released) {
+                delete job;
+            } else {
+                job->result.error_msg = strdup("Shader compiler shut down");
+                job->state = shdc_job::DONE;
+            }
+        }
+        pool.queue.clear();
+    }
+    pool.wake.notify_all();
+    pool.done.notify_all();
+    for (std::thread& t : pool.workers) {
+        t.join();
+    }
+    pool.workers.clear();
+}
+
+} // namespace
+#endif
+
 extern "C" {
 
 void shdc_init(void) {
@@ -21,9 +156,19 @@ void shdc_init(void) {
 }
 
 void shdc_shutdown(void) {
+#if SHDC_THREADS
+    stop_workers();
+#endif
     Spirv::finalize_spirv_tools();
 }
 
+#define SHDC_STR2(x) #x
+#define SHDC_STR(x) SHDC_STR2(x)
+
+const char* shdc_version(void) {
+    return "sokol-tools " SHDC_TOOLS_REV " reflection " SHDC_STR(SHDC_REFLECTION_VERSION);
+}
+
 static Slang::Enum parse_slang(const char* slang_str) {
     if (strcmp(slang_str, "glsl410") == 0) return Slang::GLSL410;
     if (strcmp(slang_str, "glsl430") == 0) return Slang::GLSL430;
@@ -64,74 +209,259 @@ static shdc_compile_result_t make_error(const std::string& msg) {
     return result;
 }
 
-shdc_compile_result_t shdc_compile(const char* source, const char* program_name, const char* slang_str) {
-    shdc_compile_result_t result = {};
+static double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
-    // Parse slang
-    Slang::Enum slang = parse_slang(slang_str);
-    if (slang == Slang::Num) {
-        return make_error("Invalid shader language: " + std::string(slang_str));
-    }
+// Parse straight from memory: the path only names the source in error
+// messages, @include paths resolve against the working directory
+static Input parse_source(const char* source, const std::string& name) {
+    std::string input_path = "<" + name + ">";
+    shdc_input_set_memory(input_path.c_str(), source, strlen(source));
+    Input inp = Input::load_and_parse(input_path, "");
+    shdc_input_clear_memory();
+    return inp;
+}
 
-    // Write source to temp file (Input::load_and_parse requires file path)
-    std::string tmp_path;
-#ifdef _WIN32
-    char* tmp_env = getenv("TEMP");
-    if (!tmp_env) tmp_env = getenv("TMP");
-    tmp_path = tmp_env ? tmp_env : ".";
-    tmp_path += "\\shdc_temp_";
-#else
-    tmp_path = "/tmp/shdc_temp_";
-#endif
-    tmp_path += std::to_string(reinterpret_cast<uintptr_t>(source));
-    tmp_path += ".glsl";
+// SPIR-V environment matching the version in a module's header
+static spv_target_env target_env(const std::vector<uint32_t>& words) {
+    switch (words.size() > 1 ? (words[1] >> 8) & 0xFF : 0) {
+        case 1: return SPV_ENV_UNIVERSAL_1_1;
+        case 2: return SPV_ENV_UNIVERSAL_1_2;
+        case 3: return SPV_ENV_UNIVERSAL_1_3;
+        case 4: return SPV_ENV_UNIVERSAL_1_4;
+        case 5: return SPV_ENV_UNIVERSAL_1_5;
+        case 6: return SPV_ENV_UNIVERSAL_1_6;
+        default: return SPV_ENV_UNIVERSAL_1_0;
+    }
+}
 
-    {
-        std::ofstream f(tmp_path);
-        if (!f) {
-            return make_error("Failed to create temp file");
+// Run spirv-opt's performance recipe over every snippet's SPIR-V. A module
+// the optimizer rejects is cross-compiled as it is.
+static void optimize_spirv(Spirv& spirv) {
+    for (SpirvBlob& blob : spirv.blobs) {
+        spvtools::Optimizer optimizer(target_env(blob.bytecode));
+        optimizer.RegisterPerformancePasses();
+        std::vector<uint32_t> optimized;
+        if (optimizer.Run(blob.bytecode.data(), blob.bytecode.size(), &optimized)) {
+            blob.bytecode.swap(optimized);
         }
-        f << source;
     }
+}
 
-    // Load and parse
-    Input inp = Input::load_and_parse(tmp_path, "");
-    std::remove(tmp_path.c_str());
+// Drop indentation, trailing blanks and empty lines. Line breaks stay:
+// preprocessor directives end at them.
+static std::string minify_source(const std::string& src) {
+    std::string out;
+    out.reserve(src.size());
+    size_t pos = 0;
+    while (pos < src.size()) {
+        size_t end = src.find('\n', pos);
+        if (end == std::string::npos) {
+            end = src.size();
+        }
+        size_t first = src.find_first_not_of(" \t\r", pos);
+        if (first != std::string::npos && first < end) {
+            size_t last = src.find_last_not_of(" \t\r", end - 1);
+            out.append(src, first, last - first + 1);
+            out += '\n';
+        }
+        pos = end + 1;
+    }
+    return out;
+}
 
-    if (inp.out_error.valid()) {
-        return make_error(inp.out_error.msg);
+// Compile every snippet of the input to SPIR-V with defines and cross-compile
+// it for slang (plus HLSL bytecode). Returns an error message, empty on success.
+static std::string translate(const Input& inp, Slang::Enum slang, const std::vector<std::string>& defines,
+                             int flags, Spirvcross& spirvcross, Bytecode& bytecode) {
+    Spirv spirv = Spirv::compile_glsl_and_extract_bindings(inp, slang, defines);
+    for (const ErrMsg& err : spirv.errors) {
+        if (err.type == ErrMsg::ERROR) {
+            return err.msg;
+        }
+    }
+    if (flags & SHDC_OPTIMIZE) {
+        optimize_spirv(spirv);
     }
 
-    // Find program
-    auto prog_it = inp.programs.find(program_name);
-    if (prog_it == inp.programs.end()) {
-        return make_error("Program not found: " + std::string(program_name));
+    spirvcross = Spirvcross::translate(inp, spirv, slang);
+    if (spirvcross.error.valid()) {
+        return spirvcross.error.msg;
     }
-    const Program& prog = prog_it->second;
 
-    // Compile to SPIRV
-    std::vector<std::string> defines;
-    Spirv spirv = Spirv::compile_glsl_and_extract_bindings(inp, slang, defines);
-    if (!spirv.errors.empty()) {
-        for (const ErrMsg& err : spirv.errors) {
+    if (Slang::is_hlsl(slang)) {
+        Args args;
+        args.byte_code = true;
+        args.slang = Slang::bit(slang);
+
+        bytecode = Bytecode::compile(args, inp, spirvcross, slang);
+        for (const ErrMsg& err : bytecode.errors) {
             if (err.type == ErrMsg::ERROR) {
-                return make_error(err.msg);
+                return err.msg;
             }
         }
     }
+    return std::string();
+}
 
-    // Cross-compile
-    Spirvcross spirvcross = Spirvcross::translate(inp, spirv, slang);
-    if (spirvcross.error.valid()) {
-        return make_error(spirvcross.error.msg);
+static void copy_name(char* dst, const std::string& src) {
+    snprintf(dst, SHDC_MAX_NAME, "%s", src.c_str());
+}
+
+static int32_t member_type(Type::Enum type) {
+    switch (type) {
+        case Type::Float: return SHDC_TYPE_FLOAT;
+        case Type::Float2: return SHDC_TYPE_FLOAT2;
+        case Type::Float3: return SHDC_TYPE_FLOAT3;
+        case Type::Float4: return SHDC_TYPE_FLOAT4;
+        case Type::Int: return SHDC_TYPE_INT;
+        case Type::Int2: return SHDC_TYPE_INT2;
+        case Type::Int3: return SHDC_TYPE_INT3;
+        case Type::Int4: return SHDC_TYPE_INT4;
+        case Type::Mat4x4: return SHDC_TYPE_MAT4;
+        default: return SHDC_TYPE_INVALID;
     }
+}
 
+static int32_t image_type(ImageType::Enum type) {
+    switch (type) {
+        case ImageType::_2D: return SHDC_IMAGE_2D;
+        case ImageType::CUBE: return SHDC_IMAGE_CUBE;
+        case ImageType::_3D: return SHDC_IMAGE_3D;
+        case ImageType::ARRAY: return SHDC_IMAGE_ARRAY;
+        default: return SHDC_IMAGE_INVALID;
+    }
+}
+
+static int32_t sample_type(ImageSampleType::Enum type) {
+    switch (type) {
+        case ImageSampleType::FLOAT: return SHDC_SAMPLE_FLOAT;
+        case ImageSampleType::DEPTH: return SHDC_SAMPLE_DEPTH;
+        case ImageSampleType::SINT: return SHDC_SAMPLE_SINT;
+        case ImageSampleType::UINT: return SHDC_SAMPLE_UINT;
+        case ImageSampleType::UNFILTERABLE_FLOAT: return SHDC_SAMPLE_UNFILTERABLE_FLOAT;
+        default: return SHDC_SAMPLE_INVALID;
+    }
+}
+
+static int32_t sampler_type(SamplerType::Enum type) {
+    switch (type) {
+        case SamplerType::FILTERING: return SHDC_SAMPLER_FILTERING;
+        case SamplerType::NONFILTERING: return SHDC_SAMPLER_NONFILTERING;
+        case SamplerType::COMPARISON: return SHDC_SAMPLER_COMPARISON;
+        default: return SHDC_SAMPLER_INVALID;
+    }
+}
+
+// Add one stage's bindings to out, at the sokol slots shdc assigned.
+// Returns an error message, empty on success.
+static std::string reflect_stage(const StageReflection& refl, int32_t stage, shdc_reflection_t& out) {
+    const Bindings& bindings = refl.bindings;
+    for (const UniformBlock& ub : bindings.uniform_blocks) {
+        if (ub.sokol_slot < 0 || ub.sokol_slot >= SHDC_MAX_UNIFORM_BLOCKS) {
+            return "Uniform block slot out of range: " + ub.struct_info.name;
+        }
+        shdc_uniform_block_t& dst = out.uniform_blocks[ub.sokol_slot];
+        dst.stage = stage;
+        dst.size = ub.struct_info.size;
+        dst.flattened = ub.flattened ? 1 : 0;
+        dst.hlsl_register_b_n = ub.hlsl_register_b_n;
+        dst.msl_buffer_n = ub.msl_buffer_n;
+        dst.wgsl_group0_binding_n = ub.wgsl_group0_binding_n;
+        copy_name(dst.name, ub.struct_info.name);
+        copy_name(dst.inst_name, ub.inst_name);
+        for (const Type& item : ub.struct_info.struct_items) {
+            if (dst.member_count == SHDC_MAX_UNIFORM_MEMBERS) {
+                return "Too many uniform block members: " + ub.struct_info.name;
+            }
+            shdc_uniform_member_t& member = dst.members[dst.member_count++];
+            copy_name(member.name, item.name);
+            member.type = member_type(item.type);
+            member.array_count = item.is_array ? item.array_count : 0;
+            member.offset = item.offset;
+        }
+    }
+    for (const Texture& tex : bindings.textures) {
+        if (tex.sokol_slot < 0 || tex.sokol_slot >= SHDC_MAX_TEXTURES) {
+            return "Texture slot out of range: " + tex.name;
+        }
+        shdc_texture_t& dst = out.textures[tex.sokol_slot];
+        dst.stage = stage;
+        dst.image_type = image_type(tex.type);
+        dst.sample_type = sample_type(tex.sample_type);
+        dst.multisampled = tex.multisampled ? 1 : 0;
+        dst.hlsl_register_t_n = tex.hlsl_register_t_n;
+        dst.msl_texture_n = tex.msl_texture_n;
+        dst.wgsl_group1_binding_n = tex.wgsl_group1_binding_n;
+        copy_name(dst.name, tex.name);
+    }
+    for (const Sampler& smp : bindings.samplers) {
+        if (smp.sokol_slot < 0 || smp.sokol_slot >= SHDC_MAX_SAMPLERS) {
+            return "Sampler slot out of range: " + smp.name;
+        }
+        shdc_sampler_t& dst = out.samplers[smp.sokol_slot];
+        dst.stage = stage;
+        dst.sampler_type = sampler_type(smp.type);
+        dst.hlsl_register_s_n = smp.hlsl_register_s_n;
+        dst.msl_sampler_n = smp.msl_sampler_n;
+        dst.wgsl_group1_binding_n = smp.wgsl_group1_binding_n;
+        copy_name(dst.name, smp.name);
+    }
+    for (const TextureSampler& pair : bindings.texture_samplers) {
+        if (pair.sokol_slot < 0 || pair.sokol_slot >= SHDC_MAX_TEXTURE_SAMPLERS) {
+            return "Texture-sampler slot out of range: " + pair.name;
+        }
+        shdc_texture_sampler_t& dst = out.texture_samplers[pair.sokol_slot];
+        dst.stage = stage;
+        dst.texture_slot = -1;
+        dst.sampler_slot = -1;
+        for (const Texture& tex : bindings.textures) {
+            if (tex.name == pair.texture_name) dst.texture_slot = tex.sokol_slot;
+        }
+        for (const Sampler& smp : bindings.samplers) {
+            if (smp.name == pair.sampler_name) dst.sampler_slot = smp.sokol_slot;
+        }
+        if (dst.texture_slot < 0 || dst.sampler_slot < 0) {
+            return "Texture-sampler pair without texture or sampler: " + pair.name;
+        }
+        copy_name(dst.glsl_name, pair.name);
+    }
+    return std::string();
+}
+
+// Program reflection: vertex inputs plus the bindings of both stages
+static std::string reflect_program(const StageReflection& vs, const StageReflection& fs, shdc_reflection_t& out) {
+    out.version = SHDC_REFLECTION_VERSION;
+    for (const StageAttr& attr : vs.inputs) {
+        if (attr.slot < 0) continue;
+        if (attr.slot >= SHDC_MAX_ATTRS) {
+            return "Vertex attribute location out of range: " + attr.name;
+        }
+        shdc_attr_t& dst = out.attrs[attr.slot];
+        dst.used = 1;
+        dst.sem_index = attr.sem_index;
+        copy_name(dst.name, attr.name);
+        copy_name(dst.sem_name, attr.sem_name);
+    }
+    std::string error = reflect_stage(vs, SHDC_STAGE_VERTEX, out);
+    if (error.empty()) {
+        error = reflect_stage(fs, SHDC_STAGE_FRAGMENT, out);
+    }
+    return error;
+}
+
+// Copy one program's stages out of a translated input into out.
+// Returns an error message, empty on success (out is freed by the caller).
+static std::string extract_program(const Input& inp, const Program& prog, const Spirvcross& spirvcross,
+                                   const Bytecode& bytecode, Slang::Enum slang, int flags,
+                                   shdc_compile_result_t& out) {
     // Find VS and FS snippets
     int vs_idx = inp.snippet_map.count(prog.vs_name) ? inp.snippet_map.at(prog.vs_name) : -1;
     int fs_idx = inp.snippet_map.count(prog.fs_name) ? inp.snippet_map.at(prog.fs_name) : -1;
 
     if (vs_idx < 0 || fs_idx < 0) {
-        return make_error("VS or FS snippet not found");
+        return "VS or FS snippet not found";
     }
 
     // Get sources
@@ -139,51 +469,148 @@ shdc_compile_result_t shdc_compile(const char* source, const char* program_name,
     const SpirvcrossSource* fs_src = spirvcross.find_source_by_snippet_index(fs_idx);
 
     if (!vs_src || !vs_src->valid) {
-        return make_error("VS compilation failed");
+        return "VS compilation failed";
     }
     if (!fs_src || !fs_src->valid) {
-        return make_error("FS compilation failed");
+        return "FS compilation failed";
     }
 
-    // Allocate result strings
-    result.vs_source = dup_str(vs_src->source_code);
-    result.vs_source_len = static_cast<int>(vs_src->source_code.size());
-    result.fs_source = dup_str(fs_src->source_code);
-    result.fs_source_len = static_cast<int>(fs_src->source_code.size());
-
-    // For HLSL, we need to compile to bytecode
-    if (Slang::is_hlsl(slang)) {
-        // Build args for bytecode compilation
-        Args args;
-        args.byte_code = true;
-        args.slang = Slang::bit(slang);
+    out.reflection = static_cast<shdc_reflection_t*>(calloc(1, sizeof(shdc_reflection_t)));
+    if (!out.reflection) {
+        return "Out of memory";
+    }
+    std::string error = reflect_program(vs_src->stage_refl, fs_src->stage_refl, *out.reflection);
+    if (!error.empty()) {
+        return error;
+    }
 
-        Bytecode bytecode = Bytecode::compile(args, inp, spirvcross, slang);
-        if (!bytecode.errors.empty()) {
-            for (const ErrMsg& err : bytecode.errors) {
-                if (err.type == ErrMsg::ERROR) {
-                    // Free already allocated
-                    free((void*)result.vs_source);
-                    free((void*)result.fs_source);
-                    return make_error(err.msg);
-                }
-            }
-        }
+    // HLSL sources only feed the bytecode compiler, which already ran
+    bool minify = (flags & SHDC_MINIFY) && !Slang::is_hlsl(slang);
+    const std::string vs_code = minify ? minify_source(vs_src->source_code) : vs_src->source_code;
+    const std::string fs_code = minify ? minify_source(fs_src->source_code) : fs_src->source_code;
+    out.vs_source = dup_str(vs_code);
+    out.vs_source_len = static_cast<int>(vs_code.size());
+    out.fs_source = dup_str(fs_code);
+    out.fs_source_len = static_cast<int>(fs_code.size());
 
-        // Get bytecode
+    // Bytecode only exists for HLSL
+    if (Slang::is_hlsl(slang)) {
         const BytecodeBlob* vs_blob = bytecode.find_blob_by_snippet_index(vs_idx);
         const BytecodeBlob* fs_blob = bytecode.find_blob_by_snippet_index(fs_idx);
 
         if (vs_blob && vs_blob->valid) {
-            result.vs_bytecode = dup_bin(vs_blob->data.data(), vs_blob->data.size());
-            result.vs_bytecode_len = static_cast<int>(vs_blob->data.size());
+            out.vs_bytecode = dup_bin(vs_blob->data.data(), vs_blob->data.size());
+            out.vs_bytecode_len = static_cast<int>(vs_blob->data.size());
         }
         if (fs_blob && fs_blob->valid) {
-            result.fs_bytecode = dup_bin(fs_blob->data.data(), fs_blob->data.size());
-            result.fs_bytecode_len = static_cast<int>(fs_blob->data.size());
+            out.fs_bytecode = dup_bin(fs_blob->data.data(), fs_blob->data.size());
+            out.fs_bytecode_len = static_cast<int>(fs_blob->data.size());
         }
     }
 
+    out.success = 1;
+    return std::string();
+}
+
+shdc_compile_result_t shdc_compile(const char* source, const char* program_name, const char* slang_str,
+                                   const char* const* defines, int define_count, int flags) {
+    shdc_compile_result_t result = {};
+
+    // Parse slang
+    Slang::Enum slang = parse_slang(slang_str);
+    if (slang == Slang::Num) {
+        return make_error("Invalid shader language: " + std::string(slang_str));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    Input inp = parse_source(source, program_name);
+    if (inp.out_error.valid()) {
+        return make_error(inp.out_error.msg);
+    }
+
+    // Find program
+    auto prog_it = inp.programs.find(program_name);
+    if (prog_it == inp.programs.end()) {
+        return make_error("Program not found: " + std::string(program_name));
+    }
+
+    Spirvcross spirvcross;
+    Bytecode bytecode;
+    std::vector<std::string> define_list(defines, defines + std::max(define_count, 0));
+    std::string error = translate(inp, slang, define_list, flags, spirvcross, bytecode);
+    if (error.empty()) {
+        error = extract_program(inp, prog_it->second, spirvcross, bytecode, slang, flags, result);
+    }
+    if (!error.empty()) {
+        shdc_free_result(&result);
+        return make_error(error);
+    }
+
+    result.compile_ms = ms_since(start);
+    return result;
+}
+
+static shdc_compile_all_result_t make_all_error(const std::string& msg) {
+    shdc_compile_all_result_t result = {};
+    result.error_msg = dup_str(msg);
+    return result;
+}
+
+shdc_compile_all_result_t shdc_compile_all(const char* source, const char* const* slangs, int slang_count,
+                                           const char* const* defines, int define_count, int flags) {
+    if (slang_count <= 0) {
+        return make_all_error("No shader language given");
+    }
+    std::vector<std::string> define_list(defines, defines + std::max(define_count, 0));
+    std::vector<Slang::Enum> slang_enums;
+    for (int i = 0; i < slang_count; i++) {
+        Slang::Enum slang = parse_slang(slangs[i]);
+        if (slang == Slang::Num) {
+            return make_all_error("Invalid shader language: " + std::string(slangs[i]));
+        }
+        slang_enums.push_back(slang);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    Input inp = parse_source(source, "source");
+    if (inp.out_error.valid()) {
+        return make_all_error(inp.out_error.msg);
+    }
+    if (inp.programs.empty()) {
+        return make_all_error("No @program in source");
+    }
+
+    shdc_compile_all_result_t result = {};
+    result.programs = static_cast<shdc_program_result_t*>(
+        calloc(inp.programs.size() * slang_enums.size(), sizeof(shdc_program_result_t)));
+    if (!result.programs) {
+        return make_all_error("Out of memory");
+    }
+
+    // The input is parsed once; SPIR-V and cross-compilation run once per
+    // language and serve every program
+    for (int i = 0; i < slang_count; i++) {
+        Spirvcross spirvcross;
+        Bytecode bytecode;
+        std::string error = translate(inp, slang_enums[i], define_list, flags, spirvcross, bytecode);
+        for (auto it = inp.programs.begin(); error.empty() && it != inp.programs.end(); ++it) {
+            shdc_program_result_t& entry = result.programs[result.program_count++];
+            entry.program = dup_str(it->first);
+            entry.slang = dup_str(slangs[i]);
+            error = extract_program(inp, it->second, spirvcross, bytecode, slang_enums[i], flags, entry.stages);
+            if (!error.empty()) {
+                error = it->first + ": " + error;
+            }
+        }
+        if (!error.empty()) {
+            shdc_free_all_result(&result);
+            return make_all_error(std::string(slangs[i]) + ": " + error);
+        }
+    }
+
+    result.compile_ms = ms_since(start);
     result.success = 1;
     return result;
 }
@@ -195,7 +622,105 @@ void shdc_free_result(shdc_compile_result_t* result) {
     free((void*)result->fs_source);
     free((void*)result->vs_bytecode);
     free((void*)result->fs_bytecode);
+    free(result->reflection);
     *result = {};
 }
 
+void shdc_free_all_result(shdc_compile_all_result_t* result) {
+    if (!result) return;
+    for (int i = 0; i < result->program_count; i++) {
+        free((void*)result->programs[i].program);
+        free((void*)result->programs[i].slang);
+        shdc_free_result(&result->programs[i].stages);
+    }
+    free(result->programs);
+    free((void*)result->error_msg);
+    *result = {};
+}
+
+shdc_job_t* shdc_compile_async(const char* source, const char* const* slangs, int slang_count,
+                               const char* const* defines, int define_count, int flags) {
+    shdc_job* job = new shdc_job;
+    job->source = source;
+    for (int i = 0; i < slang_count; i++) {
+        job->slangs.push_back(slangs[i]);
+    }
+    for (int i = 0; i < define_count; i++) {
+        job->defines.push_back(defines[i]);
+    }
+    job->flags = flags;
+#if SHDC_THREADS
+    {
+        std::lock_guard<std::mutex> lk(pool.lock);
+        start_workers();
+        pool.queue.push_back(job);
+    }
+    pool.wake.notify_one();
+#else
+    job->result = run_job(job);
+    job->state = shdc_job::DONE;
+#endif
+    return job;
+}
+
+void shdc_set_threads(int count) {
+#if SHDC_THREADS
+    if (count <= 0) {
+        count = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    }
+    std::lock_guard<std::mutex> lk(pool.lock);
+    pool.threads = count;
+    if (!pool.workers.empty()) {
+        start_workers();
+    }
+#else
+    (void)count;
+#endif
+}
+
+void shdc_job_wait(shdc_job_t* job) {
+#if SHDC_THREADS
+    std::unique_lock<std::mutex> lk(pool.lock);
+    pool.done.wait(lk, [job] { return job->state == shdc_job::DONE; });
+#else
+    (void)job;
+#endif
+}
+
+int shdc_job_done(shdc_job_t* job) {
+#if SHDC_THREADS
+    std::lock_guard<std::mutex> lk(pool.lock);
+#endif
+    return job->state == shdc_job::DONE;
+}
+
+shdc_compile_all_result_t shdc_job_take(shdc_job_t* job) {
+#if SHDC_THREADS
+    std::lock_guard<std::mutex> lk(pool.lock);
+#endif
+    shdc_compile_all_result_t result = {};
+    if (job->state == shdc_job::DONE && !job->taken) {
+        result = job->result;
+        job->result = {};
+        job->taken = true;
+    }
+    return result;
+}
+
+void shdc_job_release(shdc_job_t* job) {
+    if (!job) return;
+#if SHDC_THREADS
+    std::lock_guard<std::mutex> lk(pool.lock);
+    if (job->state == shdc_job::RUNNING) {
+        job->released = true;
+        return;
+    }
+    if (job->state == shdc_job::QUEUED) {
+        pool.queue.erase(std::find(pool.queue.begin(), pool.queue.end(), job));
+    }
+#endif
+    shdc_free_all_result(&job->result);
+    delete job;
+}
+
 } // extern "C"
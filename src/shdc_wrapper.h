@@ -1,6 +1,8 @@
 #ifndef SHDC_WRAPPER_H
 #define SHDC_WRAPPER_H
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -11,6 +13,114 @@ void shdc_init(void);
 // Shutdown sokol-shdc (call once at cleanup)
 void shdc_shutdown(void);
 
+// Compiler identity for cache keys: the sokol-tools revision the library was
+// built from (glslang, SPIRV-Cross and tint are vendored in it) and the
+// reflection layout version. Changes whenever compiled output may change.
+const char* shdc_version(void);
+
+// Reflection limits (match sokol_gfx bind slot limits)
+#define SHDC_MAX_NAME 64
+#define SHDC_MAX_UNIFORM_BLOCKS 8
+#define SHDC_MAX_UNIFORM_MEMBERS 16
+#define SHDC_MAX_TEXTURES 32
+#define SHDC_MAX_SAMPLERS 16
+#define SHDC_MAX_TEXTURE_SAMPLERS 32
+#define SHDC_MAX_ATTRS 16
+
+// Bump when shdc_reflection_t changes layout
+#define SHDC_REFLECTION_VERSION 1
+
+// Stage of a binding; 0 marks an unused slot
+enum { SHDC_STAGE_NONE, SHDC_STAGE_VERTEX, SHDC_STAGE_FRAGMENT };
+
+// Uniform block member types
+enum {
+    SHDC_TYPE_INVALID,
+    SHDC_TYPE_FLOAT, SHDC_TYPE_FLOAT2, SHDC_TYPE_FLOAT3, SHDC_TYPE_FLOAT4,
+    SHDC_TYPE_INT, SHDC_TYPE_INT2, SHDC_TYPE_INT3, SHDC_TYPE_INT4,
+    SHDC_TYPE_MAT4,
+};
+
+enum { SHDC_IMAGE_INVALID, SHDC_IMAGE_2D, SHDC_IMAGE_CUBE, SHDC_IMAGE_3D, SHDC_IMAGE_ARRAY };
+enum { SHDC_SAMPLE_INVALID, SHDC_SAMPLE_FLOAT, SHDC_SAMPLE_DEPTH, SHDC_SAMPLE_SINT, SHDC_SAMPLE_UINT, SHDC_SAMPLE_UNFILTERABLE_FLOAT };
+enum { SHDC_SAMPLER_INVALID, SHDC_SAMPLER_FILTERING, SHDC_SAMPLER_NONFILTERING, SHDC_SAMPLER_COMPARISON };
+
+typedef struct {
+    char name[SHDC_MAX_NAME];
+    int32_t type;          // SHDC_TYPE_*
+    int32_t array_count;   // 0 when not an array
+    int32_t offset;        // byte offset in the block (std140)
+} shdc_uniform_member_t;
+
+typedef struct {
+    int32_t stage;
+    int32_t size;          // bytes
+    int32_t flattened;     // GLSL: declared as one vec4/ivec4 array named after the block
+    int32_t hlsl_register_b_n;
+    int32_t msl_buffer_n;
+    int32_t wgsl_group0_binding_n;
+    int32_t member_count;
+    char name[SHDC_MAX_NAME];       // block type name
+    char inst_name[SHDC_MAX_NAME];  // instance name
+    shdc_uniform_member_t members[SHDC_MAX_UNIFORM_MEMBERS];
+} shdc_uniform_block_t;
+
+typedef struct {
+    int32_t stage;
+    int32_t image_type;    // SHDC_IMAGE_*
+    int32_t sample_type;   // SHDC_SAMPLE_*
+    int32_t multisampled;
+    int32_t hlsl_register_t_n;
+    int32_t msl_texture_n;
+    int32_t wgsl_group1_binding_n;
+    char name[SHDC_MAX_NAME];
+} shdc_texture_t;
+
+typedef struct {
+    int32_t stage;
+    int32_t sampler_type;  // SHDC_SAMPLER_*
+    int32_t hlsl_register_s_n;
+    int32_t msl_sampler_n;
+    int32_t wgsl_group1_binding_n;
+    char name[SHDC_MAX_NAME];
+} shdc_sampler_t;
+
+typedef struct {
+    int32_t stage;
+    int32_t texture_slot;
+    int32_t sampler_slot;
+    char glsl_name[SHDC_MAX_NAME];
+} shdc_texture_sampler_t;
+
+typedef struct {
+    int32_t used;
+    int32_t sem_index;
+    char name[SHDC_MAX_NAME];
+    char sem_name[SHDC_MAX_NAME];
+} shdc_attr_t;
+
+// Bindings of one program, every array indexed by sokol bind slot (vertex
+// attributes by location). Plain int32/char data, so the struct is stored
+// byte for byte in the shader cache and reads back on any platform.
+typedef struct {
+    int32_t version;       // SHDC_REFLECTION_VERSION
+    shdc_uniform_block_t uniform_blocks[SHDC_MAX_UNIFORM_BLOCKS];
+    shdc_texture_t textures[SHDC_MAX_TEXTURES];
+    shdc_sampler_t samplers[SHDC_MAX_SAMPLERS];
+    shdc_texture_sampler_t texture_samplers[SHDC_MAX_TEXTURE_SAMPLERS];
+    shdc_attr_t attrs[SHDC_MAX_ATTRS];
+} shdc_reflection_t;
+
+// Output options (flags of shdc_compile, shdc_compile_all, shdc_compile_async)
+enum {
+    // Run spirv-opt's performance passes (inlining, constant propagation,
+    // dead code and dead branch elimination...) before cross-compiling
+    SHDC_OPTIMIZE = 1 << 0,
+    // Strip indentation and empty lines from the generated GLSL, MSL and
+    // WGSL sources. Names are kept: sokol binds GL uniforms by name.
+    SHDC_MINIFY = 1 << 1,
+};
+
 // Compile result structure
 typedef struct {
     int success;
@@ -23,18 +133,78 @@ typedef struct {
     int vs_bytecode_len;
     const char* fs_bytecode;
     int fs_bytecode_len;
+    double compile_ms;  // parse + SPIR-V + cross-compile (+ bytecode) time
+    shdc_reflection_t* reflection;
 } shdc_compile_result_t;
 
 // Compile shader
 // source: GLSL source with @vs/@fs/@program tags
 // program_name: name of @program to compile
 // slang: target language ("hlsl5", "metal_macos", "glsl430", "glsl300es", "wgsl")
+// defines: preprocessor defines for every snippet, each "NAME" or
+// "NAME VALUE" as after #define (may be NULL when define_count is 0)
+// flags: SHDC_OPTIMIZE | SHDC_MINIFY, or 0
 // Returns compile result. Call shdc_free_result when done.
-shdc_compile_result_t shdc_compile(const char* source, const char* program_name, const char* slang);
+shdc_compile_result_t shdc_compile(const char* source, const char* program_name, const char* slang,
+                                   const char* const* defines, int define_count, int flags);
 
 // Free compile result resources
 void shdc_free_result(shdc_compile_result_t* result);
 
+// One program compiled for one language
+typedef struct {
+    const char* program;
+    const char* slang;
+    shdc_compile_result_t stages;  // compile_ms is not set per program
+} shdc_program_result_t;
+
+typedef struct {
+    int success;
+    const char* error_msg;
+    shdc_program_result_t* programs;  // program_count entries, by language then program name
+    int program_count;
+    double compile_ms;
+} shdc_compile_all_result_t;
+
+// Compile every @program in source for every language in slangs.
+// The source is parsed once, and SPIR-V compilation and cross-compilation
+// run once per language for all programs together.
+// defines, flags: as for shdc_compile
+// Returns compile result. Call shdc_free_all_result when done.
+shdc_compile_all_result_t shdc_compile_all(const char* source, const char* const* slangs, int slang_count,
+                                           const char* const* defines, int define_count, int flags);
+
+// Free compile_all result resources
+void shdc_free_all_result(shdc_compile_all_result_t* result);
+
+// Background compile job
+typedef struct shdc_job shdc_job_t;
+
+// Queue shdc_compile_all(source, slangs, defines, flags) on the worker pool
+// (started on first use, joined by shdc_shutdown). Never blocks on
+// compilation. Call shdc_job_release when done with the job.
+shdc_job_t* shdc_compile_async(const char* source, const char* const* slangs, int slang_count,
+                               const char* const* defines, int define_count, int flags);
+
+// Number of pool threads (default: cores - 1, at most 4, leaving the rest to
+// the game); count <= 0 uses every core. Takes effect for running pools too,
+// which only grow.
+void shdc_set_threads(int count);
+
+// Nonzero once the job has finished
+int shdc_job_done(shdc_job_t* job);
+
+// Block until the job has finished
+void shdc_job_wait(shdc_job_t* job);
+
+// Move the result out of a finished job; zeroed if the job is still
+// running or the result was already taken. Call shdc_free_all_result on it.
+shdc_compile_all_result_t shdc_job_take(shdc_job_t* job);
+
+// Free the job. A queued job is cancelled; a running one is freed by its
+// worker when it finishes.
+void shdc_job_release(shdc_job_t* job);
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,7 +21,20 @@ static void _lub3d_assert_fail(const char* expr, const char* file, int line) {
 #endif
 #define SOKOL_IMPL
 #include "sokol_log.h"
+/* GL program binaries: sokol's shader compile and link calls go through the
+ * hooks in program_cache_lua.c */
+#include "lub3d_gl_program.h"
+#ifdef LUB3D_GL_PROGRAM_BINARY
+#define glCompileShader lub3d_gl_compile_shader
+#define glGetShaderiv lub3d_gl_get_shaderiv
+#define glLinkProgram lub3d_gl_link_program
+#endif
 #include "sokol_gfx.h"
+#ifdef LUB3D_GL_PROGRAM_BINARY
+#undef glCompileShader
+#undef glGetShaderiv
+#undef glLinkProgram
+#endif
 #ifndef SOKOL_DUMMY_BACKEND
 /* sokol_app requires a real windowing backend - skip for headless testing */
 /* SOKOL_NO_ENTRY: Use sapp_run() instead of sokol_main() - Lua controls entry point */
@@ -0,0 +1,538 @@
+/*
+ * sprite_lua.c - Native sprite batch core for lib/sprite.lua
+ *
+ * Quads are transformed in C and written into a persistent CPU buffer
+ * owned by the batch userdata, then uploaded to a sokol buffer in one
+ * call. sprite.draw no longer builds Lua tables or packs strings.
+ *
+ * Two vertex layouts are supported:
+ *   vertex    - 4 vertices x (float2 pos, float2 uv, float4 color) = 128 bytes/quad,
+ *               drawn with a shared UINT32 index buffer
+ *   instanced - 1 instance x (float3 pivot+rotation, float4 local rect,
+ *               ushort4n uv rect, ubyte4n color) = 40 bytes/quad,
+ *               expanded from a static unit quad in the vertex shader
+ *
+ * Lua API: require("lub3d.sprite")
+ *   sprite.new_batch(max_quads, tex_w, tex_h, instanced?) -> Batch
+ *   sprite.quad_indices(max_quads) -> string (UINT32 index data)
+ *   batch:draw(sx, sy, sw, sh, dx, dy, opts?, texture?) -> boolean (false if full)
+ *   batch:update(buffer)   -- sg_update_buffer, returns quad count
+ *   batch:append(buffer)   -- sg_append_buffer, returns byte offset
+ *   batch:clear()
+ *   batch:count() / batch:capacity() / batch:quad_bytes()
+ *   batch:set_texture_size(w, h)          -- size of texture slot 0
+ *   batch:set_texture(slot, w, h)         -- register/resize a texture slot
+ *   batch:sort() -> run_count             -- group queued quads into draw runs
+ *   batch:run(i) -> layer, texture, blend, first, count
+ *
+ * Every quad carries a sort key built from (layer, texture slot, blend).
+ * sort() stably reorders the queued quads by key, so sprites keep their
+ * submission order within a run, and records one run per distinct key.
+ */
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "sokol_gfx.h"
+
+#define SPRITE_BATCH_MT "lub3d.sprite.Batch"
+#define SG_BUFFER_MT "sokol.gfx.Buffer"
+
+#define VERTS_PER_QUAD 4
+#define INDICES_PER_QUAD 6
+#define FLOATS_PER_VERT 8 /* x, y, u, v, r, g, b, a */
+#define FLOATS_PER_QUAD (VERTS_PER_QUAD * FLOATS_PER_VERT)
+#define VERTEX_QUAD_BYTES (FLOATS_PER_QUAD * sizeof(float))
+
+/* Per-instance record (matches the instanced pipeline layout) */
+typedef struct {
+    float pivot_x, pivot_y, rotate; /* FLOAT3 */
+    float x0, y0, x1, y1;           /* FLOAT4: local corners relative to pivot */
+    uint16_t uv[4];                 /* USHORT4N: u0, v0, u1, v1 */
+    uint8_t color[4];               /* UBYTE4N: r, g, b, a */
+} SpriteInstance;
+
+/* Sort key: layer (biased to 0..255) | texture slot (16 bits) | blend (8 bits) */
+#define KEY_LAYER_SHIFT 24
+#define KEY_TEXTURE_SHIFT 8
+#define MAX_TEXTURES 0x10000
+
+typedef struct {
+    float inv_w;
+    float inv_h;
+} SpriteTexture;
+
+typedef struct {
+    uint32_t key;
+    int first;
+    int count;
+} SpriteRun;
+
+typedef struct {
+    unsigned char *data;
+    unsigned char *scratch; /* sort destination, allocated on first mixed sort */
+    uint32_t *keys;
+    uint64_t *order;
+    SpriteRun *runs;
+    SpriteTexture *textures;
+    size_t quad_bytes;
+    int instanced;
+    int max_quads;
+    int quad_count;
+    int mixed; /* queued quads have more than one distinct key */
+    int run_count;
+    int texture_count;
+} SpriteBatch;
+
+static SpriteBatch *check_batch(lua_State *L, int idx)
+{
+    SpriteBatch *b = (SpriteBatch *)luaL_checkudata(L, idx, SPRITE_BATCH_MT);
+    if (!b->data)
+        luaL_error(L, "lub3d.sprite.Batch has been destroyed");
+    return b;
+}
+
+static sg_buffer check_buffer(lua_State *L, int idx)
+{
+    return *(sg_buffer *)luaL_checkudata(L, idx, SG_BUFFER_MT);
+}
+
+/* Read opts.<key> as a number, leaving def if absent */
+static float opt_field(lua_State *L, int idx, const char *key, float def)
+{
+    float v = def;
+    if (lua_getfield(L, idx, key) != LUA_TNIL)
+        v = (float)lua_tonumber(L, -1);
+    lua_pop(L, 1);
+    return v;
+}
+
+static float opt_index(lua_State *L, int idx, int i, float def)
+{
+    float v = def;
+    if (lua_rawgeti(L, idx, i) != LUA_TNIL)
+        v = (float)lua_tonumber(L, -1);
+    lua_pop(L, 1);
+    return v;
+}
+
+static uint16_t to_unorm16(float v)
+{
+    if (v <= 0.0f) return 0;
+    if (v >= 1.0f) return 65535;
+    return (uint16_t)(v * 65535.0f + 0.5f);
+}
+
+static uint8_t to_unorm8(float v)
+{
+    if (v <= 0.0f) return 0;
+    if (v >= 1.0f) return 255;
+    return (uint8_t)(v * 255.0f + 0.5f);
+}
+
+static void set_texture(SpriteBatch *b, int slot, lua_Number tex_w, lua_Number tex_h)
+{
+    b->textures[slot].inv_w = (float)(1.0 / tex_w);
+    b->textures[slot].inv_h = (float)(1.0 / tex_h);
+}
+
+static void free_batch(SpriteBatch *b)
+{
+    free(b->data);
+    free(b->scratch);
+    free(b->keys);
+    free(b->order);
+    free(b->runs);
+    free(b->textures);
+    memset(b, 0, sizeof(SpriteBatch));
+}
+
+/* sprite.new_batch(max_quads, tex_w, tex_h, instanced) */
+static int l_sprite_new_batch(lua_State *L)
+{
+    int max_quads = (int)luaL_checkinteger(L, 1);
+    lua_Number tex_w = luaL_checknumber(L, 2);
+    lua_Number tex_h = luaL_checknumber(L, 3);
+    luaL_argcheck(L, max_quads > 0, 1, "max_quads must be positive");
+    luaL_argcheck(L, tex_w > 0 && tex_h > 0, 2, "texture size must be positive");
+    int instanced = lua_toboolean(L, 4);
+
+    SpriteBatch *b = (SpriteBatch *)lua_newuserdatauv(L, sizeof(SpriteBatch), 0);
+    memset(b, 0, sizeof(SpriteBatch));
+    luaL_setmetatable(L, SPRITE_BATCH_MT);
+
+    b->instanced = instanced;
+    b->quad_bytes = instanced ? sizeof(SpriteInstance) : VERTEX_QUAD_BYTES;
+    b->data = (unsigned char *)malloc((size_t)max_quads * b->quad_bytes);
+    b->keys = (uint32_t *)malloc((size_t)max_quads * sizeof(uint32_t));
+    b->textures = (SpriteTexture *)malloc(sizeof(SpriteTexture));
+    if (!b->data || !b->keys || !b->textures) {
+        free_batch(b);
+        return luaL_error(L, "out of memory");
+    }
+    b->max_quads = max_quads;
+    b->texture_count = 1;
+    set_texture(b, 0, tex_w, tex_h);
+    return 1;
+}
+
+/* batch:draw(sx, sy, sw, sh, dx, dy, opts, texture) -> true, or false if the batch is full
+ * opts: { rotate, scale_x, scale_y, origin_x, origin_y, color = {r, g, b, a},
+ *         layer, blend, texture }
+ * The texture argument, when given, overrides opts.texture (slot, default 0). */
+static int l_sprite_draw(lua_State *L)
+{
+    SpriteBatch *b = check_batch(L, 1);
+    if (b->quad_count >= b->max_quads) {
+        lua_pushboolean(L, 0);
+        return 1;
+    }
+
+    float sx = (float)luaL_checknumber(L, 2);
+    float sy = (float)luaL_checknumber(L, 3);
+    float sw = (float)luaL_checknumber(L, 4);
+    float sh = (float)luaL_checknumber(L, 5);
+    float dx = (float)luaL_checknumber(L, 6);
+    float dy = (float)luaL_checknumber(L, 7);
+
+    float r = 1.0f, g = 1.0f, bl = 1.0f, a = 1.0f;
+    float rotate = 0.0f;
+    float scale_x = 1.0f, scale_y = 1.0f;
+    float origin_x = 0.0f, origin_y = 0.0f;
+    lua_Integer layer = 0, blend = 0, tex = 0;
+
+    if (lua_istable(L, 8)) {
+        if (lua_getfield(L, 8, "color") == LUA_TTABLE) {
+            int ci = lua_gettop(L);
+            r = opt_index(L, ci, 1, 1.0f);
+            g = opt_index(L, ci, 2, 1.0f);
+            bl = opt_index(L, ci, 3, 1.0f);
+            a = opt_index(L, ci, 4, 1.0f);
+        }
+        lua_pop(L, 1);
+        rotate = opt_field(L, 8, "rotate", 0.0f);
+        scale_x = opt_field(L, 8, "scale_x", 1.0f);
+        scale_y = opt_field(L, 8, "scale_y", 1.0f);
+        origin_x = opt_field(L, 8, "origin_x", 0.0f);
+        origin_y = opt_field(L, 8, "origin_y", 0.0f);
+        layer = (lua_Integer)opt_field(L, 8, "layer", 0.0f);
+        blend = (lua_Integer)opt_field(L, 8, "blend", 0.0f);
+        tex = (lua_Integer)opt_field(L, 8, "texture", 0.0f);
+    }
+    if (!lua_isnoneornil(L, 9))
+        tex = luaL_checkinteger(L, 9);
+    luaL_argcheck(L, tex >= 0 && tex < b->texture_count, 9, "texture slot not registered");
+    luaL_argcheck(L, layer >= -128 && layer <= 127, 8, "layer must be in -128..127");
+    luaL_argcheck(L, blend >= 0 && blend <= 255, 8, "blend must be in 0..255");
+
+    uint32_t key = ((uint32_t)(layer + 128) << KEY_LAYER_SHIFT) |
+                   ((uint32_t)tex << KEY_TEXTURE_SHIFT) | (uint32_t)blend;
+    if (b->quad_count > 0 && key != b->keys[0])
+        b->mixed = 1;
+    b->keys[b->quad_count] = key;
+    const SpriteTexture *t = &b->textures[tex];
+
+    /* UV coordinates */
+    float u0 = sx * t->inv_w;
+    float v0 = sy * t->inv_h;
+    float u1 = (sx + sw) * t->inv_w;
+    float v1 = (sy + sh) * t->inv_h;
+
+    /* Local quad corners relative to origin */
+    float x0 = -origin_x * scale_x;
+    float y0 = -origin_y * scale_y;
+    float x1 = (sw - origin_x) * scale_x;
+    float y1 = (sh - origin_y) * scale_y;
+
+    float ox = dx + origin_x;
+    float oy = dy + origin_y;
+
+    if (b->instanced) {
+        SpriteInstance *inst = (SpriteInstance *)(b->data + (size_t)b->quad_count * sizeof(SpriteInstance));
+        inst->pivot_x = ox;
+        inst->pivot_y = oy;
+        inst->rotate = rotate;
+        inst->x0 = x0;
+        inst->y0 = y0;
+        inst->x1 = x1;
+        inst->y1 = y1;
+        inst->uv[0] = to_unorm16(u0);
+        inst->uv[1] = to_unorm16(v0);
+        inst->uv[2] = to_unorm16(u1);
+        inst->uv[3] = to_unorm16(v1);
+        inst->color[0] = to_unorm8(r);
+        inst->color[1] = to_unorm8(g);
+        inst->color[2] = to_unorm8(bl);
+        inst->color[3] = to_unorm8(a);
+        b->quad_count++;
+        lua_pushboolean(L, 1);
+        return 1;
+    }
+
+    /* Rotate and translate to destination (top-left, top-right, bottom-right, bottom-left) */
+    float px[4], py[4];
+    if (rotate == 0.0f) {
+        px[0] = ox + x0; py[0] = oy + y0;
+        px[1] = ox + x1; py[1] = oy + y0;
+        px[2] = ox + x1; py[2] = oy + y1;
+        px[3] = ox + x0; py[3] = oy + y1;
+    } else {
+        float c = cosf(rotate);
+        float s = sinf(rotate);
+        px[0] = ox + x0 * c - y0 * s; py[0] = oy + x0 * s + y0 * c;
+        px[1] = ox + x1 * c - y0 * s; py[1] = oy + x1 * s + y0 * c;
+        px[2] = ox + x1 * c - y1 * s; py[2] = oy + x1 * s + y1 * c;
+        px[3] = ox + x0 * c - y1 * s; py[3] = oy + x0 * s + y1 * c;
+    }
+    const float us[4] = { u0, u1, u1, u0 };
+    const float vs[4] = { v0, v0, v1, v1 };
+
+    float *v = (float *)(b->data + (size_t)b->quad_count * VERTEX_QUAD_BYTES);
+    for (int i = 0; i < VERTS_PER_QUAD; i++) {
+        v[0] = px[i];
+        v[1] = py[i];
+        v[2] = us[i];
+        v[3] = vs[i];
+        v[4] = r;
+        v[5] = g;
+        v[6] = bl;
+        v[7] = a;
+        v += FLOATS_PER_VERT;
+    }
+    b->quad_count++;
+
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/* batch:update(buffer) -> quad_count
+ * Replaces the buffer contents with the queued quads (one update per frame). */
+static int l_sprite_update(lua_State *L)
+{
+    SpriteBatch *b = check_batch(L, 1);
+    sg_buffer buf = check_buffer(L, 2);
+    if (b->quad_count > 0) {
+        sg_range range = { b->data, (size_t)b->quad_count * b->quad_bytes };
+        sg_update_buffer(buf, &range);
+    }
+    lua_pushinteger(L, b->quad_count);
+    return 1;
+}
+
+/* batch:append(buffer) -> byte_offset
+ * Appends the queued quads; use the offset as vertex_buffer_offsets[1]. */
+static int l_sprite_append(lua_State *L)
+{
+    SpriteBatch *b = check_batch(L, 1);
+    sg_buffer buf = check_buffer(L, 2);
+    sg_range range = { b->data, (size_t)b->quad_count * b->quad_bytes };
+    lua_pushinteger(L, sg_append_buffer(buf, &range));
+    return 1;
+}
+
+static int l_sprite_clear(lua_State *L)
+{
+    SpriteBatch *b = check_batch(L, 1);
+    b->quad_count = 0;
+    b->mixed = 0;
+    b->run_count = 0;
+    return 0;
+}
+
+static int l_sprite_count(lua_State *L)
+{
+    lua_pushinteger(L, check_batch(L, 1)->quad_count);
+    return 1;
+}
+
+static int l_sprite_capacity(lua_State *L)
+{
+    lua_pushinteger(L, check_batch(L, 1)->max_quads);
+    return 1;
+}
+
+/* batch:quad_bytes() -> bytes uploaded per queued quad */
+static int l_sprite_quad_bytes(lua_State *L)
+{
+    lua_pushinteger(L, (lua_Integer)check_batch(L, 1)->quad_bytes);
+    return 1;
+}
+
+static int l_sprite_set_texture_size(lua_State *L)
+{
+    SpriteBatch *b = check_batch(L, 1);
+    lua_Number tex_w = luaL_checknumber(L, 2);
+    lua_Number tex_h = luaL_checknumber(L, 3);
+    luaL_argcheck(L, tex_w > 0 && tex_h > 0, 2, "texture size must be positive");
+    set_texture(b, 0, tex_w, tex_h);
+    return 0;
+}
+
+/* batch:set_texture(slot, w, h)
+ * Slots must be registered in order; re-registering a slot updates its size. */
+static int l_sprite_set_texture(lua_State *L)
+{
+    SpriteBatch *b = check_batch(L, 1);
+    lua_Integer slot = luaL_checkinteger(L, 2);
+    lua_Number tex_w = luaL_checknumber(L, 3);
+    lua_Number tex_h = luaL_checknumber(L, 4);
+    luaL_argcheck(L, slot >= 0 && slot <= b->texture_count && slot < MAX_TEXTURES, 2,
+                  "texture slots must be registered in order");
+    luaL_argcheck(L, tex_w > 0 && tex_h > 0, 3, "texture size must be positive");
+    if (slot == b->texture_count) {
+        SpriteTexture *grown = (SpriteTexture *)realloc(b->textures, (size_t)(slot + 1) * sizeof(SpriteTexture));
+        if (!grown)
+            return luaL_error(L, "out of memory");
+        b->textures = grown;
+        b->texture_count++;
+    }
+    set_texture(b, (int)slot, tex_w, tex_h);
+    return 0;
+}
+
+static int compare_order(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* batch:sort() -> run_count
+ * Stable sort by key (the low 32 bits of each order entry are the submission
+ * index), then collapse equal keys into runs. Skips the sort when every
+ * queued quad shares one key. */
+static int l_sprite_sort(lua_State *L)
+{
+    SpriteBatch *b = check_batch(L, 1);
+    int n = b->quad_count;
+    if (!b->runs) {
+        b->runs = (SpriteRun *)malloc((size_t)b->max_quads * sizeof(SpriteRun));
+        if (!b->runs)
+            return luaL_error(L, "out of memory");
+    }
+
+    if (b->mixed) {
+        if (!b->order) {
+            b->order = (uint64_t *)malloc((size_t)b->max_quads * sizeof(uint64_t));
+            b->scratch = (unsigned char *)malloc((size_t)b->max_quads * b->quad_bytes);
+            if (!b->order || !b->scratch)
+                return luaL_error(L, "out of memory");
+        }
+        for (int i = 0; i < n; i++)
+            b->order[i] = ((uint64_t)b->keys[i] << 32) | (uint32_t)i;
+        qsort(b->order, (size_t)n, sizeof(uint64_t), compare_order);
+        for (int i = 0; i < n; i++) {
+            uint32_t src = (uint32_t)b->order[i];
+            memcpy(b->scratch + (size_t)i * b->quad_bytes, b->data + (size_t)src * b->quad_bytes, b->quad_bytes);
+            b->keys[i] = (uint32_t)(b->order[i] >> 32);
+        }
+        unsigned char *tmp = b->data;
+        b->data = b->scratch;
+        b->scratch = tmp;
+        b->mixed = 0;
+    }
+
+    b->run_count = 0;
+    for (int i = 0; i < n; i++) {
+        if (b->run_count > 0 && b->runs[b->run_count - 1].key == b->keys[i]) {
+            b->runs[b->run_count - 1].count++;
+        } else {
+            SpriteRun *run = &b->runs[b->run_count++];
+            run->key = b->keys[i];
+            run->first = i;
+            run->count = 1;
+        }
+    }
+    lua_pushinteger(L, b->run_count);
+    return 1;
+}
+
+/* batch:run(i) -> layer, texture, blend, first, count  (i is 1-based, first is 0-based) */
+static int l_sprite_run(lua_State *L)
+{
+    SpriteBatch *b = check_batch(L, 1);
+    lua_Integer i = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, i >= 1 && i <= b->run_count, 2, "run index out of range");
+    const SpriteRun *run = &b->runs[i - 1];
+    lua_pushinteger(L, (lua_Integer)(run->key >> KEY_LAYER_SHIFT) - 128);
+    lua_pushinteger(L, (lua_Integer)((run->key >> KEY_TEXTURE_SHIFT) & 0xFFFF));
+    lua_pushinteger(L, (lua_Integer)(run->key & 0xFF));
+    lua_pushinteger(L, run->first);
+    lua_pushinteger(L, run->count);
+    return 5;
+}
+
+static int l_sprite_batch_gc(lua_State *L)
+{
+    SpriteBatch *b = (SpriteBatch *)luaL_checkudata(L, 1, SPRITE_BATCH_MT);
+    free_batch(b);
+    return 0;
+}
+
+/* sprite.quad_indices(max_quads) -> string
+ * UINT32 index data for max_quads quads (0,1,2, 0,2,3 per quad) */
+static int l_sprite_quad_indices(lua_State *L)
+{
+    int max_quads = (int)luaL_checkinteger(L, 1);
+    luaL_argcheck(L, max_quads > 0, 1, "max_quads must be positive");
+
+    size_t size = (size_t)max_quads * INDICES_PER_QUAD * sizeof(uint32_t);
+    luaL_Buffer buf;
+    uint32_t *idx = (uint32_t *)luaL_buffinitsize(L, &buf, size);
+    for (int i = 0; i < max_quads; i++) {
+        uint32_t base = (uint32_t)i * VERTS_PER_QUAD;
+        idx[0] = base + 0;
+        idx[1] = base + 1;
+        idx[2] = base + 2;
+        idx[3] = base + 0;
+        idx[4] = base + 2;
+        idx[5] = base + 3;
+        idx += INDICES_PER_QUAD;
+    }
+    luaL_pushresultsize(&buf, size);
+    return 1;
+}
+
+static const luaL_Reg sprite_batch_methods[] = {
+    {"draw", l_sprite_draw},
+    {"update", l_sprite_update},
+    {"append", l_sprite_append},
+    {"clear", l_sprite_clear},
+    {"count", l_sprite_count},
+    {"capacity", l_sprite_capacity},
+    {"quad_bytes", l_sprite_quad_bytes},
+    {"set_texture_size", l_sprite_set_texture_size},
+    {"set_texture", l_sprite_set_texture},
+    {"sort", l_sprite_sort},
+    {"run", l_sprite_run},
+    {"destroy", l_sprite_batch_gc},
+    {NULL, NULL}
+};
+
+static const luaL_Reg sprite_funcs[] = {
+    {"new_batch", l_sprite_new_batch},
+    {"quad_indices", l_sprite_quad_indices},
+    {NULL, NULL}
+};
+
+int luaopen_lub3d_sprite(lua_State *L)
+{
+    luaL_newmetatable(L, SPRITE_BATCH_MT);
+    lua_pushcfunction(L, l_sprite_batch_gc);
+    lua_setfield(L, -2, "__gc");
+    luaL_newlib(L, sprite_batch_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    luaL_newlib(L, sprite_funcs);
+    lua_pushinteger(L, FLOATS_PER_VERT);
+    lua_setfield(L, -2, "FLOATS_PER_VERT");
+    lua_pushinteger(L, (lua_Integer)VERTEX_QUAD_BYTES);
+    lua_setfield(L, -2, "VERTEX_QUAD_BYTES");
+    lua_pushinteger(L, (lua_Integer)sizeof(SpriteInstance));
+    lua_setfield(L, -2, "INSTANCE_BYTES");
+    return 1;
+}
@@ -1,3 +1,8 @@
 /* stb_image implementation — include once */
 #define STB_IMAGE_IMPLEMENTATION
+/* SSE2 IDCT/color conversion is detected by stb itself on x86; the NEON
+ * path (ARM64, Apple silicon) has to be requested */
+#if defined(__ARM_NEON) && !defined(STBI_NEON)
+#define STBI_NEON
+#endif
 #include "stb_image.h"
@@ -0,0 +1,897 @@
+/*
+ * texloader_lua.c - Background texture loading for lib/texture_manager.lua
+ *
+ * Requests are queued and handled by a small pool of worker threads: read
+ * the file (pack data first, like fs.read), parse KTX2/DDS or decode with
+ * stb_image, generate mips and optionally encode BCn. Finished jobs wait in
+ * a ready queue until the main thread uploads them in update(), which stops
+ * once the per-call byte budget is used up (at least one job always goes
+ * through), so a burst of requests is spread over several frames instead of
+ * stalling one.
+ *
+ * BCn requests with cache_dir share lib.texture_cache with texture.load_bc7:
+ * the worker hashes the source bytes with cache_params into the same key,
+ * uses <cache_dir>/<key>.ktx2 when present and otherwise writes it
+ * atomically. The result reports the key (and the size of a new entry) so
+ * the main thread can update the cache index.
+ *
+ * max_size requests a reduced version for texture streaming: the largest
+ * levels are dropped until the image fits, so KTX2/DDS files and cache
+ * entries upload only their smaller mips, and full_width/full_height report
+ * the size of the source.
+ *
+ * Decoded images can be processed before their mips are built (premultiply,
+ * swizzle, normal_z, convert; see image.process), so the work is done once
+ * on a worker instead of per frame in shaders.
+ *
+ * upload = false only decodes (and encodes into the cache): the result
+ * reports the sizes and cache key without creating an image, so tools such
+ * as lub3d cook can fill the texture cache without a graphics context.
+ *
+ * Workers time the decode of each source image (stb_image, mips and BCn
+ * encoding) and report it as decode_ms, for util.profile_report.
+ *
+ * Without thread support (Emscripten builds without pthreads), jobs are
+ * decoded synchronously in update() under the same budget.
+ *
+ * Lua API: require("lub3d.texloader")
+ *   texloader.new(opts?) -> Loader
+ *     opts: threads (cores - 1, at most 4), budget (bytes per update, 8 MiB)
+ *   loader:request(path, opts?) -> id
+ *     opts: srgb (false), mips (true), mip_filter ("box"),
+ *           format ("bc1", "bc4", "bc5" or "bc7"; default RGBA8),
+ *           bc7 (same as format = "bc7"),
+ *           cache_dir, cache_params (BCn cache, see above),
+ *           max_size (largest side to upload, 0 = full size),
+ *           upload (true; false to skip creating the image),
+ *           premultiply, swizzle, normal_z, convert (see image.process)
+ *   loader:update(budget?) -> results
+ *     { id, image, width, height, full_width, full_height, levels, bytes,
+ *       decode_ms?, cache_key?, cache_bytes? }
+ *     per uploaded texture
+ *     { id, error } per failed request
+ *   loader:wait()                -- block until every request is decoded
+ *   loader:stats() -> { requested, queued, ready, uploaded, failed,
+ *                       bytes, frame_bytes, cache_hits, cache_misses }
+ *   loader:destroy()             -- stop workers, drop pending requests
+ * Images are raw sokol.gfx.Image handles; wrap them with gpu.wrap_image.
+ */
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sokol_gfx.h"
+#include "stb_image.h"
+#include "lub3d_fs.h"
+#include "lub3d_hash.h"
+#include "lub3d_image.h"
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define TEXLOADER_THREADS 0
+#elif defined(_WIN32)
+#define TEXLOADER_THREADS 1
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+typedef CRITICAL_SECTION tl_mutex;
+typedef CONDITION_VARIABLE tl_cond;
+typedef HANDLE tl_thread;
+#define tl_mutex_init(m) InitializeCriticalSection(m)
+#define tl_mutex_destroy(m) DeleteCriticalSection(m)
+#define tl_lock(m) EnterCriticalSection(m)
+#define tl_unlock(m) LeaveCriticalSection(m)
+#define tl_cond_init(c) InitializeConditionVariable(c)
+#define tl_cond_destroy(c) ((void)(c))
+#define tl_cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define tl_cond_signal(c) WakeConditionVariable(c)
+#define tl_cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+#define TEXLOADER_THREADS 1
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_mutex_t tl_mutex;
+typedef pthread_cond_t tl_cond;
+typedef pthread_t tl_thread;
+#define tl_mutex_init(m) pthread_mutex_init(m, NULL)
+#define tl_mutex_destroy(m) pthread_mutex_destroy(m)
+#define tl_lock(m) pthread_mutex_lock(m)
+#define tl_unlock(m) pthread_mutex_unlock(m)
+#define tl_cond_init(c) pthread_cond_init(c, NULL)
+#define tl_cond_destroy(c) pthread_cond_destroy(c)
+#define tl_cond_wait(c, m) pthread_cond_wait(c, m)
+#define tl_cond_signal(c) pthread_cond_signal(c)
+#define tl_cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+#define TEXLOADER_MT "lub3d.texloader.Loader"
+#define SG_IMAGE_MT "sokol.gfx.Image"
+
+#define MAX_THREADS 16
+#define DEFAULT_BUDGET (8 * 1024 * 1024)
+
+typedef struct TexJob {
+    struct TexJob *next;
+    int id;
+    char *path;
+    int srgb, mips, kaiser;
+    int upload;           /* create an image in update(), 0 to only decode */
+    lub3d_image_ops ops;  /* texel processing before mips */
+    int process;          /* ops request any processing */
+    sg_pixel_format bc_format; /* block format to encode to, 0 for RGBA8 */
+    int max_size;         /* drop levels larger than this, 0 for none */
+    int full_width, full_height;
+    char *cache_dir;      /* lib.texture_cache directory, NULL for no cache */
+    char *cache_params;   /* texture_cache.params() of the request */
+    char cache_key[17];   /* hex key once computed */
+    size_t cache_bytes;   /* size of a newly written cache entry */
+    double decode_ms;     /* stb decode + mips + BC7, 0 when nothing was decoded */
+
+    /* Worker output: desc ranges point into the buffers below */
+    sg_image_desc desc;
+    size_t bytes;
+    const uint8_t *file;  /* KTX2/DDS data, not owned when it lives in the pack */
+    int file_owned;
+    uint8_t *repacked;
+    stbi_uc *pixels;
+    uint8_t *levels;      /* mips below level 0, or every BCn level */
+    char error[256];
+} TexJob;
+
+typedef struct {
+    TexJob *head, *tail;
+} JobQueue;
+
+typedef struct {
+    JobQueue queued;  /* waiting for a worker */
+    JobQueue ready;   /* decoded, waiting for upload */
+    int decoding;     /* jobs currently held by workers */
+    int cache_hits, cache_misses;
+#if TEXLOADER_THREADS
+    tl_mutex lock;
+    tl_cond wake;     /* new job or quit */
+    tl_cond idle;     /* a job finished decoding */
+    tl_thread threads[MAX_THREADS];
+    int quit;
+#endif
+    int num_threads;
+    int destroyed;
+
+    /* Main thread only */
+    int next_id;
+    size_t budget;
+    int requested, uploaded, failed;
+    size_t bytes, frame_bytes;
+} TexLoader;
+
+static void queue_push(JobQueue *q, TexJob *job)
+{
+    job->next = NULL;
+    if (q->tail)
+        q->tail->next = job;
+    else
+        q->head = job;
+    q->tail = job;
+}
+
+static TexJob *queue_pop(JobQueue *q)
+{
+    TexJob *job = q->head;
+    if (job) {
+        q->head = job->next;
+        if (!q->head)
+            q->tail = NULL;
+    }
+    return job;
+}
+
+static void free_job(TexJob *job)
+{
+    if (job->file_owned)
+        free((void *)job->file);
+    free(job->repacked);
+    if (job->pixels)
+        stbi_image_free(job->pixels);
+    free(job->levels);
+    free(job->cache_dir);
+    free(job->cache_params);
+    free(job->path);
+    free(job);
+}
+
+/* ===== Worker side (no Lua state) ===== */
+
+/* Read a whole file, from the pack when present. *owned is 0 for pack data. */
+static const uint8_t *read_file(const char *path, size_t *len, int *owned)
+{
+    *owned = 0;
+    if (lub3d_fs_pack_find) {
+        unsigned int pack_size;
+        const unsigned char *pack_data = lub3d_fs_pack_find(path, &pack_size);
+        if (pack_data) {
+            *len = pack_size;
+            return pack_data;
+        }
+    }
+#ifdef __EMSCRIPTEN__
+    char *data = lub3d_fs_fetch_file(path, len);
+    if (data && *len == 0) {
+        free(data);
+        data = NULL;
+    }
+#else
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = size > 0 ? (char *)malloc((size_t)size) : NULL;
+    if (data && fread(data, 1, (size_t)size, f) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *len = (size_t)size;
+#endif
+    if (data)
+        *owned = 1;
+    return (const uint8_t *)data;
+}
+
+static int is_container(const char *path)
+{
+    const char *dot = strrchr(path, '.');
+    if (!dot || strpbrk(dot, "/\\"))
+        return 0;
+    char ext[8] = {0};
+    for (int i = 0; i < 7 && dot[i + 1]; i++)
+        ext[i] = (char)(dot[i + 1] | 0x20);
+    return strcmp(ext, "ktx2") == 0 || strcmp(ext, "dds") == 0;
+}
+
+/* Number of leading levels to drop so the image fits job->max_size */
+static int skip_levels(const TexJob *job, int w, int h, int levels)
+{
+    int skip = 0;
+    if (job->max_size > 0) {
+        while (skip < levels - 1 && ((w >> skip) > job->max_size || (h >> skip) > job->max_size))
+            skip++;
+    }
+    return skip;
+}
+
+/* Drop the first skip levels from job->desc */
+static void apply_skip(TexJob *job, int skip)
+{
+    sg_image_desc *desc = &job->desc;
+    if (skip <= 0)
+        return;
+    desc->width = desc->width >> skip > 0 ? desc->width >> skip : 1;
+    desc->height = desc->height >> skip > 0 ? desc->height >> skip : 1;
+    desc->num_mipmaps -= skip;
+    for (int i = 0; i < desc->num_mipmaps; i++)
+        desc->data.mip_levels[i] = desc->data.mip_levels[i + skip];
+    for (int i = desc->num_mipmaps; i < SG_MAX_MIPMAPS; i++)
+        memset(&desc->data.mip_levels[i], 0, sizeof(desc->data.mip_levels[i]));
+}
+
+/* Point the job's desc at a parsed KTX2/DDS file in job->file */
+static int use_container(TexJob *job, size_t len)
+{
+    lub3d_texture_info info;
+    const char *err = lub3d_image_parse_texture(job->file, len, &info);
+    if (err) {
+        snprintf(job->error, sizeof(job->error), "%s: %s", job->path, err);
+        return 0;
+    }
+    if (!lub3d_image_texture_desc(job->file, &info, &job->desc, &job->repacked)) {
+        snprintf(job->error, sizeof(job->error), "%s: out of memory", job->path);
+        return 0;
+    }
+    job->full_width = info.width;
+    job->full_height = info.height;
+    apply_skip(job, skip_levels(job, info.width, info.height, info.levels));
+    for (int i = 0; i < job->desc.num_mipmaps; i++)
+        job->bytes += job->desc.data.mip_levels[i].size;
+    return 1;
+}
+
+#ifdef LUB3D_HAS_BC7ENC
+/* Use the cache entry at path when it matches the request. The key
+ * already covers the source and the settings; the check guards against
+ * damaged or foreign files. */
+static int try_cache(TexJob *job, const char *path)
+{
+    size_t len;
+    job->file = read_file(path, &len, &job->file_owned);
+    if (!job->file)
+        return 0;
+    if (use_container(job, len) && job->desc.pixel_format == job->bc_format
+        && job->desc.num_mipmaps == (job->mips ? lub3d_image_mip_count(job->desc.width, job->desc.height) : 1))
+        return 1;
+
+    if (job->file_owned)
+        free((void *)job->file);
+    job->file = NULL;
+    job->file_owned = 0;
+    free(job->repacked);
+    job->repacked = NULL;
+    memset(&job->desc, 0, sizeof(job->desc));
+    job->desc.label = job->path;
+    job->bytes = 0;
+    job->error[0] = '\0';
+    return 0;
+}
+#endif
+
+/* Monotonic clock for decode timings */
+static double now_ms(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart * 1000.0 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1.0e6;
+#endif
+}
+
+/* Decode one request into job->desc. Returns 0 with job->error set on failure.
+ * *cache_hit is set when a BCn cache entry was used, *cache_miss when it was
+ * (re)built. */
+static int process_job(TexJob *job, int *cache_hit, int *cache_miss)
+{
+    job->desc.label = job->path;
+    *cache_hit = *cache_miss = 0;
+#ifndef LUB3D_HAS_BC7ENC
+    job->bc_format = _SG_PIXELFORMAT_DEFAULT;
+#endif
+
+    size_t len;
+    int owned;
+    const uint8_t *data = read_file(job->path, &len, &owned);
+    if (!data) {
+        snprintf(job->error, sizeof(job->error), "Failed to read: %s", job->path);
+        return 0;
+    }
+    if (is_container(job->path)) {
+        job->file = data;
+        job->file_owned = owned;
+        return use_container(job, len);
+    }
+
+    /* Same key as texture_cache.key(data, params) */
+    char cache[1024] = "";
+    if (job->bc_format && job->cache_dir) {
+        uint64_t h = lub3d_hash_xxh64(job->cache_params, strlen(job->cache_params),
+                                      lub3d_hash_xxh64(data, len, 0));
+        snprintf(job->cache_key, sizeof(job->cache_key), "%016llx", (unsigned long long)h);
+        snprintf(cache, sizeof(cache), "%s/%s.ktx2", job->cache_dir, job->cache_key);
+#ifdef LUB3D_HAS_BC7ENC
+        if (try_cache(job, cache)) {
+            if (owned)
+                free((void *)data);
+            *cache_hit = 1;
+            return 1;
+        }
+#endif
+        *cache_miss = 1;
+    }
+
+    double start = now_ms();
+    int w, h, ch;
+    job->pixels = stbi_load_from_memory(data, (int)len, &w, &h, &ch, 4);
+    if (owned)
+        free((void *)data);
+    if (!job->pixels) {
+        snprintf(job->error, sizeof(job->error), "Failed to load: %s (stb error: %s)",
+                 job->path, stbi_failure_reason());
+        return 0;
+    }
+
+    if (job->process)
+        lub3d_image_process(job->pixels, (size_t)w * h, &job->ops);
+
+    int levels = job->mips ? lub3d_image_mip_count(w, h) : 1;
+    int skip = skip_levels(job, w, h, levels);
+    job->full_width = w;
+    job->full_height = h;
+    const uint8_t *level[SG_MAX_MIPMAPS];
+    size_t size[SG_MAX_MIPMAPS];
+    level[0] = job->pixels;
+    size[0] = (size_t)w * h * 4;
+    if (levels > 1) {
+        job->levels = (uint8_t *)malloc(lub3d_image_mip_bytes(w, h, levels));
+        if (!job->levels
+            || !lub3d_image_gen_mips(job->pixels, w, h, levels, job->srgb, job->kaiser, job->levels)) {
+            snprintf(job->error, sizeof(job->error), "%s: out of memory", job->path);
+            return 0;
+        }
+        uint8_t *p = job->levels;
+        for (int i = 1; i < levels; i++) {
+            int lw = w >> i > 0 ? w >> i : 1, lh = h >> i > 0 ? h >> i : 1;
+            level[i] = p;
+            size[i] = (size_t)lw * lh * 4;
+            p += size[i];
+        }
+    }
+
+    sg_pixel_format format = job->srgb ? SG_PIXELFORMAT_SRGB8A8 : SG_PIXELFORMAT_RGBA8;
+#ifdef LUB3D_HAS_BC7ENC
+    if (job->bc_format) {
+        /* Every level is encoded single-threaded: the pool is the parallelism.
+         * Skipped levels are only encoded for the cache entry. */
+        format = job->bc_format;
+        int first = cache[0] ? 0 : skip;
+        size_t total = 0;
+        for (int i = first; i < levels; i++)
+            total += lub3d_image_level_bytes(format, w >> i > 0 ? w >> i : 1, h >> i > 0 ? h >> i : 1);
+        uint8_t *blocks = (uint8_t *)malloc(total);
+        if (!blocks) {
+            snprintf(job->error, sizeof(job->error), "%s: out of memory", job->path);
+            return 0;
+        }
+        uint8_t *p = blocks;
+        for (int i = first; i < levels; i++) {
+            int lw = w >> i > 0 ? w >> i : 1, lh = h >> i > 0 ? h >> i : 1;
+            lub3d_bc_encode(format, level[i], lw, lh, 5, 1, p);
+            level[i] = p;
+            size[i] = lub3d_image_level_bytes(format, lw, lh);
+            p += size[i];
+        }
+        stbi_image_free(job->pixels);
+        job->pixels = NULL;
+        free(job->levels);
+        job->levels = blocks;
+
+        if (cache[0]) {
+            size_t ktx_len;
+            uint8_t *ktx = lub3d_image_encode_ktx2(level, size, levels, w, h, format, &ktx_len);
+            if (ktx && lub3d_fs_write_atomic(cache, ktx, ktx_len))
+                job->cache_bytes = ktx_len;
+            free(ktx);
+        }
+    }
+#endif
+
+    job->desc.width = w;
+    job->desc.height = h;
+    job->desc.num_mipmaps = levels;
+    job->desc.pixel_format = format;
+    for (int i = 0; i < levels; i++) {
+        job->desc.data.mip_levels[i].ptr = level[i];
+        job->desc.data.mip_levels[i].size = size[i];
+    }
+    apply_skip(job, skip);
+    for (int i = 0; i < job->desc.num_mipmaps; i++)
+        job->bytes += job->desc.data.mip_levels[i].size;
+    job->decode_ms = now_ms() - start;
+    return 1;
+}
+
+#if TEXLOADER_THREADS
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg)
+#else
+static void *worker_main(void *arg)
+#endif
+{
+    TexLoader *tl = (TexLoader *)arg;
+    tl_lock(&tl->lock);
+    for (;;) {
+        while (!tl->quit && !tl->queued.head)
+            tl_cond_wait(&tl->wake, &tl->lock);
+        if (tl->quit)
+            break;
+        TexJob *job = queue_pop(&tl->queued);
+        tl->decoding++;
+        tl_unlock(&tl->lock);
+
+        int hit, miss;
+        process_job(job, &hit, &miss);
+
+        tl_lock(&tl->lock);
+        tl->decoding--;
+        tl->cache_hits += hit;
+        tl->cache_misses += miss;
+        queue_push(&tl->ready, job);
+        tl_cond_broadcast(&tl->idle);
+    }
+    tl_unlock(&tl->lock);
+    return 0;
+}
+#endif
+
+static int default_threads(void)
+{
+#if !TEXLOADER_THREADS
+    return 0;
+#else
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int cores = (int)si.dwNumberOfProcessors;
+#else
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    int n = cores - 1;
+    if (n < 1) n = 1;
+    if (n > 4) n = 4;
+    return n;
+#endif
+}
+
+static void loader_destroy(TexLoader *tl)
+{
+    if (tl->destroyed)
+        return;
+    tl->destroyed = 1;
+#if TEXLOADER_THREADS
+    tl_lock(&tl->lock);
+    tl->quit = 1;
+    tl_cond_broadcast(&tl->wake);
+    tl_unlock(&tl->lock);
+    for (int i = 0; i < tl->num_threads; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(tl->threads[i], INFINITE);
+        CloseHandle(tl->threads[i]);
+#else
+        pthread_join(tl->threads[i], NULL);
+#endif
+    }
+    tl_cond_destroy(&tl->wake);
+    tl_cond_destroy(&tl->idle);
+    tl_mutex_destroy(&tl->lock);
+#endif
+    TexJob *job;
+    while ((job = queue_pop(&tl->queued)))
+        free_job(job);
+    while ((job = queue_pop(&tl->ready)))
+        free_job(job);
+}
+
+/* ===== Lua API ===== */
+
+static TexLoader *check_loader(lua_State *L)
+{
+    TexLoader *tl = (TexLoader *)luaL_checkudata(L, 1, TEXLOADER_MT);
+    if (tl->destroyed)
+        luaL_error(L, "texture loader has been destroyed");
+    return tl;
+}
+
+/* texloader.new(opts?) */
+static int l_texloader_new(lua_State *L)
+{
+    int threads = default_threads();
+    lua_Integer budget = DEFAULT_BUDGET;
+    if (lua_istable(L, 1)) {
+        lua_getfield(L, 1, "threads");
+        threads = (int)luaL_optinteger(L, -1, threads);
+        lua_pop(L, 1);
+        lua_getfield(L, 1, "budget");
+        budget = luaL_optinteger(L, -1, budget);
+        lua_pop(L, 1);
+    }
+    if (threads < 0) threads = 0;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+#if !TEXLOADER_THREADS
+    threads = 0;
+#endif
+
+    TexLoader *tl = (TexLoader *)lua_newuserdatauv(L, sizeof(TexLoader), 0);
+    memset(tl, 0, sizeof(*tl));
+    tl->budget = budget > 0 ? (size_t)budget : 0;
+    tl->next_id = 1;
+    luaL_setmetatable(L, TEXLOADER_MT);
+
+#if TEXLOADER_THREADS
+    tl_mutex_init(&tl->lock);
+    tl_cond_init(&tl->wake);
+    tl_cond_init(&tl->idle);
+    for (int i = 0; i < threads; i++) {
+#ifdef _WIN32
+        tl->threads[i] = CreateThread(NULL, 0, worker_main, tl, 0, NULL);
+        if (!tl->threads[i])
+            break;
+#else
+        if (pthread_create(&tl->threads[i], NULL, worker_main, tl) != 0)
+            break;
+#endif
+        tl->num_threads++;
+    }
+#endif
+    return 1;
+}
+
+/* Block format for a format name, 0 when unknown or without an sRGB variant */
+static sg_pixel_format block_format(const char *name, int srgb)
+{
+    if (strcmp(name, "bc7") == 0)
+        return srgb ? SG_PIXELFORMAT_BC7_SRGBA : SG_PIXELFORMAT_BC7_RGBA;
+    if (srgb)
+        return _SG_PIXELFORMAT_DEFAULT;
+    if (strcmp(name, "bc1") == 0)
+        return SG_PIXELFORMAT_BC1_RGBA;
+    if (strcmp(name, "bc4") == 0)
+        return SG_PIXELFORMAT_BC4_R;
+    if (strcmp(name, "bc5") == 0)
+        return SG_PIXELFORMAT_BC5_RG;
+    return _SG_PIXELFORMAT_DEFAULT;
+}
+
+static char *dup_string(const char *s)
+{
+    size_t n = strlen(s) + 1;
+    char *out = (char *)malloc(n);
+    if (out)
+        memcpy(out, s, n);
+    return out;
+}
+
+/* loader:request(path, opts?) */
+static int l_texloader_request(lua_State *L)
+{
+    TexLoader *tl = check_loader(L);
+    size_t path_len;
+    const char *path = luaL_checklstring(L, 2, &path_len);
+    lub3d_image_ops ops; /* checked first: errors must not leak the job */
+    int process = lub3d_image_check_ops(L, 3, &ops);
+    int max_size = 0;
+    if (lua_istable(L, 3)) {
+        lua_getfield(L, 3, "max_size");
+        max_size = (int)luaL_optinteger(L, -1, 0);
+        lua_pop(L, 1);
+    }
+
+    TexJob *job = (TexJob *)calloc(1, sizeof(TexJob));
+    if (!job || !(job->path = (char *)malloc(path_len + 1))) {
+        free(job);
+        return luaL_error(L, "out of memory");
+    }
+    memcpy(job->path, path, path_len + 1);
+    job->mips = 1;
+    job->upload = 1;
+    job->ops = ops;
+    job->process = process;
+    job->max_size = max_size;
+    if (lua_istable(L, 3)) {
+        lua_getfield(L, 3, "srgb");
+        job->srgb = lua_toboolean(L, -1);
+        lua_getfield(L, 3, "mips");
+        job->mips = lua_isnil(L, -1) || lua_toboolean(L, -1);
+        lua_getfield(L, 3, "bc7");
+        lua_getfield(L, 3, "format");
+        const char *format = lua_toboolean(L, -2) ? "bc7" : lua_tostring(L, -1);
+        if (format && !(job->bc_format = block_format(format, job->srgb))) {
+            free_job(job);
+            return luaL_error(L, "unsupported texture format '%s'%s", format, job->srgb ? " for srgb" : "");
+        }
+        lua_pop(L, 1);
+        lua_getfield(L, 3, "mip_filter");
+        const char *filter = lua_tostring(L, -1);
+        job->kaiser = filter && strcmp(filter, "kaiser") == 0;
+        lua_getfield(L, 3, "upload");
+        job->upload = lua_isnil(L, -1) || lua_toboolean(L, -1);
+        lua_pop(L, 1);
+        lua_getfield(L, 3, "cache_dir");
+        lua_getfield(L, 3, "cache_params");
+        const char *cache_dir = lua_tostring(L, -2);
+        const char *cache_params = lua_tostring(L, -1);
+        if (cache_dir && cache_params) {
+            job->cache_dir = dup_string(cache_dir);
+            job->cache_params = dup_string(cache_params);
+            if (!job->cache_dir || !job->cache_params) {
+                free_job(job);
+                return luaL_error(L, "out of memory");
+            }
+        }
+        lua_pop(L, 6);
+    }
+    job->id = tl->next_id++;
+    tl->requested++;
+
+#if TEXLOADER_THREADS
+    tl_lock(&tl->lock);
+    queue_push(&tl->queued, job);
+    tl_cond_signal(&tl->wake);
+    tl_unlock(&tl->lock);
+#else
+    queue_push(&tl->queued, job);
+#endif
+    lua_pushinteger(L, job->id);
+    return 1;
+}
+
+/* Next decoded job, decoding it here when there are no workers */
+static TexJob *next_ready(TexLoader *tl)
+{
+#if TEXLOADER_THREADS
+    if (tl->num_threads > 0) {
+        tl_lock(&tl->lock);
+        TexJob *job = queue_pop(&tl->ready);
+        tl_unlock(&tl->lock);
+        return job;
+    }
+#endif
+    TexJob *job = queue_pop(&tl->queued);
+    if (job) {
+        int hit, miss;
+        process_job(job, &hit, &miss);
+        tl->cache_hits += hit;
+        tl->cache_misses += miss;
+    }
+    return job;
+}
+
+/* loader:update(budget?) */
+static int l_texloader_update(lua_State *L)
+{
+    TexLoader *tl = check_loader(L);
+    lua_Integer budget = luaL_optinteger(L, 2, (lua_Integer)tl->budget);
+    size_t spent = 0;
+    int n = 0;
+
+    lua_newtable(L);
+    while (n == 0 || budget <= 0 || spent < (size_t)budget) {
+        TexJob *job = next_ready(tl);
+        if (!job)
+            break;
+        lua_createtable(L, 0, 8);
+        lua_pushinteger(L, job->id);
+        lua_setfield(L, -2, "id");
+
+        sg_image img = {SG_INVALID_ID};
+        if (!job->error[0] && job->upload) {
+            img = sg_make_image(&job->desc);
+            if (sg_query_image_state(img) != SG_RESOURCESTATE_VALID) {
+                sg_destroy_image(img);
+                img.id = SG_INVALID_ID;
+                snprintf(job->error, sizeof(job->error), "%s: failed to create image", job->path);
+            }
+        }
+        if (!job->error[0]) {
+            if (img.id != SG_INVALID_ID) {
+                sg_image *ud = (sg_image *)lua_newuserdatauv(L, sizeof(sg_image), 0);
+                *ud = img;
+                luaL_setmetatable(L, SG_IMAGE_MT);
+                lua_setfield(L, -2, "image");
+                spent += job->bytes;
+                tl->uploaded++;
+            }
+            lua_pushinteger(L, job->desc.width);
+            lua_setfield(L, -2, "width");
+            lua_pushinteger(L, job->desc.height);
+            lua_setfield(L, -2, "height");
+            lua_pushinteger(L, job->full_width);
+            lua_setfield(L, -2, "full_width");
+            lua_pushinteger(L, job->full_height);
+            lua_setfield(L, -2, "full_height");
+            lua_pushinteger(L, job->desc.num_mipmaps);
+            lua_setfield(L, -2, "levels");
+            lua_pushinteger(L, (lua_Integer)job->bytes);
+            lua_setfield(L, -2, "bytes");
+            if (job->decode_ms > 0) {
+                lua_pushnumber(L, job->decode_ms);
+                lua_setfield(L, -2, "decode_ms");
+            }
+        } else {
+            lua_pushstring(L, job->error);
+            lua_setfield(L, -2, "error");
+            tl->failed++;
+        }
+        if (job->cache_key[0]) {
+            lua_pushstring(L, job->cache_key);
+            lua_setfield(L, -2, "cache_key");
+            if (job->cache_bytes) {
+                lua_pushinteger(L, (lua_Integer)job->cache_bytes);
+                lua_setfield(L, -2, "cache_bytes");
+            }
+        }
+        lua_rawseti(L, -2, ++n);
+        free_job(job);
+    }
+    tl->bytes += spent;
+    tl->frame_bytes = spent;
+    return 1;
+}
+
+/* loader:wait() */
+static int l_texloader_wait(lua_State *L)
+{
+    TexLoader *tl = check_loader(L);
+#if TEXLOADER_THREADS
+    if (tl->num_threads > 0) {
+        tl_lock(&tl->lock);
+        while (tl->queued.head || tl->decoding > 0)
+            tl_cond_wait(&tl->idle, &tl->lock);
+        tl_unlock(&tl->lock);
+    }
+#endif
+    (void)tl;
+    return 0;
+}
+
+/* loader:stats() */
+static int l_texloader_stats(lua_State *L)
+{
+    TexLoader *tl = check_loader(L);
+    int queued = 0, ready = 0, cache_hits, cache_misses;
+#if TEXLOADER_THREADS
+    tl_lock(&tl->lock);
+#endif
+    for (TexJob *job = tl->queued.head; job; job = job->next)
+        queued++;
+    for (TexJob *job = tl->ready.head; job; job = job->next)
+        ready++;
+#if TEXLOADER_THREADS
+    queued += tl->decoding;
+#endif
+    cache_hits = tl->cache_hits;
+    cache_misses = tl->cache_misses;
+#if TEXLOADER_THREADS
+    tl_unlock(&tl->lock);
+#endif
+
+    lua_createtable(L, 0, 9);
+    lua_pushinteger(L, tl->requested);
+    lua_setfield(L, -2, "requested");
+    lua_pushinteger(L, queued);
+    lua_setfield(L, -2, "queued");
+    lua_pushinteger(L, ready);
+    lua_setfield(L, -2, "ready");
+    lua_pushinteger(L, tl->uploaded);
+    lua_setfield(L, -2, "uploaded");
+    lua_pushinteger(L, tl->failed);
+    lua_setfield(L, -2, "failed");
+    lua_pushinteger(L, (lua_Integer)tl->bytes);
+    lua_setfield(L, -2, "bytes");
+    lua_pushinteger(L, (lua_Integer)tl->frame_bytes);
+    lua_setfield(L, -2, "frame_bytes");
+    lua_pushinteger(L, cache_hits);
+    lua_setfield(L, -2, "cache_hits");
+    lua_pushinteger(L, cache_misses);
+    lua_setfield(L, -2, "cache_misses");
+    return 1;
+}
+
+/* loader:destroy() / __gc */
+static int l_texloader_destroy(lua_State *L)
+{
+    TexLoader *tl = (TexLoader *)luaL_checkudata(L, 1, TEXLOADER_MT);
+    loader_destroy(tl);
+    return 0;
+}
+
+static const luaL_Reg texloader_methods[] = {
+    {"request", l_texloader_request},
+    {"update", l_texloader_update},
+    {"wait", l_texloader_wait},
+    {"stats", l_texloader_stats},
+    {"destroy", l_texloader_destroy},
+    {NULL, NULL}
+};
+
+static const luaL_Reg texloader_funcs[] = {
+    {"new", l_texloader_new},
+    {NULL, NULL}
+};
+
+int luaopen_lub3d_texloader(lua_State *L)
+{
+    luaL_newmetatable(L, TEXLOADER_MT);
+    lua_pushcfunction(L, l_texloader_destroy);
+    lua_setfield(L, -2, "__gc");
+    luaL_newlib(L, texloader_methods);
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    luaL_newlib(L, texloader_funcs);
+    return 1;
+}
@@ -17,6 +17,20 @@ function fs.read(path) end
 ---@return boolean success
 function fs.write(path, data) end
 
+---Write data to a temporary file next to path, then rename it over path.
+---Readers and concurrent writers never see a partially written file.
+---Native: fopen + rename (Win32: MoveFileEx), WASM: always returns false.
+---@param path string file path
+---@param data string binary data to write
+---@return boolean success
+function fs.write_atomic(path, data) end
+
+---Create a directory, including missing parent directories.
+---Native: mkdir (Win32: CreateDirectory), WASM: always returns false.
+---@param path string directory path
+---@return boolean success true if the directory exists afterwards
+function fs.mkdir(path) end
+
 ---Get file modification time as Unix timestamp.
 ---Native: stat, WASM: HEAD Last-Modified header.
 ---@param path string file path
@@ -0,0 +1,13 @@
+---@meta
+-- LuaCATS type definitions for lub3d.hash (content hashing)
+
+---@class lub3d.hash
+local hash = {}
+
+---XXH64 of data. Format with string.format("%016x", h) for file names.
+---@param data string
+---@param seed? integer (default 0)
+---@return integer
+function hash.xxh64(data, seed) end
+
+return hash
@@ -0,0 +1,119 @@
+---@meta
+-- LuaCATS type definitions for lub3d.image (native image processing)
+
+---@class lub3d.image
+local image = {}
+
+---Number of levels in a full mip chain down to 1x1.
+---@param w integer
+---@param h integer
+---@return integer
+function image.mip_count(w, h) end
+
+---@alias lub3d.image.MipFilter "box"|"kaiser"
+
+---Generate a mip chain from RGBA8 pixels.
+---levels[1] is pixels itself; level i is max(1, w >> (i-1)) x max(1, h >> (i-1)).
+---With srgb, filtering happens in linear space. With into, levels 2.. are
+---written into that buffer and ranges are returned instead of strings.
+---@param pixels string|lub3d.image.Buffer RGBA8 pixel data (w * h * 4 bytes)
+---@param w integer
+---@param h integer
+---@param opts? { srgb?: boolean, filter?: lub3d.image.MipFilter, max_levels?: integer, into?: lub3d.image.Buffer }
+---@return string[]|lub3d.image.Range[] levels
+function image.gen_mips(pixels, w, h, opts) end
+
+---@class lub3d.image.ProcessOpts
+---@field swizzle? string output channels from "rgba01", e.g. "bgra" or "ag01"
+---@field normal_z? boolean rebuild b as the z of a unit normal from r and g
+---@field convert? "linear"|"srgb" convert rgb from sRGB to linear or back
+---@field premultiply? boolean multiply rgb by alpha (in linear light for sRGB texels)
+---@field srgb? boolean texels are sRGB (when convert is not set)
+
+---Process RGBA8 texels once at load time; applied in the order swizzle,
+---normal_z, convert, premultiply. Strings are copied, buffers processed in place.
+---@generic T: string|lub3d.image.Buffer
+---@param pixels T RGBA8 pixel data
+---@param opts lub3d.image.ProcessOpts
+---@return T pixels
+function image.process(pixels, opts) end
+
+---@class lub3d.image.Range
+---@field ptr lightuserdata
+---@field size integer
+
+---Reusable pixel storage that is passed to gfx.Range without a Lua string copy.
+---@class lub3d.image.Buffer
+local Buffer = {}
+
+---@return integer bytes
+function Buffer:size() end
+
+---Range for gfx.Range, valid until the buffer is decoded into again or released.
+---@param offset? integer default 0
+---@param size? integer default the rest of the buffer
+---@return lub3d.image.Range
+function Buffer:range(offset, size) end
+
+---Copy bytes into a string.
+---@param offset? integer default 0
+---@param size? integer default the rest of the buffer
+---@return string
+function Buffer:read(offset, size) end
+
+---Free the memory now instead of at garbage collection.
+function Buffer:release() end
+
+---Create an empty buffer.
+---@return lub3d.image.Buffer
+function image.buffer() end
+
+---Read the size of a PNG/JPG/... from its header without decoding it.
+---@param data string file contents
+---@return integer? w
+---@return integer|string h or error message
+---@return integer? channels in the file
+function image.info(data) end
+
+---Decode a PNG/JPG/... with stb_image into buffer (replacing its contents).
+---@param data string file contents
+---@param buffer lub3d.image.Buffer
+---@param channels? integer 1 to 4 (default 4, RGBA8)
+---@return integer? w
+---@return integer|string h or error message
+---@return integer? channels
+function image.decode(data, buffer, channels) end
+
+---@class lub3d.image.TextureInfo
+---@field container "ktx2"|"dds"
+---@field format sokol.gfx.PixelFormat
+---@field format_name string e.g. "BC7_SRGBA"
+---@field width integer
+---@field height integer
+---@field layers integer array layers (1 if not an array)
+---@field faces integer 6 for cube maps, otherwise 1
+---@field levels integer mip levels
+
+---Parse a KTX2 or DDS header (BC1/BC3/BC4/BC5/BC7 or RGBA8).
+---@param data string file contents
+---@return lub3d.image.TextureInfo? info
+---@return string? err
+function image.parse_texture(data) end
+
+---Create an immutable image from KTX2 or DDS file contents.
+---Mip levels are uploaded straight from data (requires gfx.setup).
+---@param data string file contents
+---@param label? string debug label
+---@return sokol.gfx.Image? image raw handle (caller destroys it, see gpu.wrap_image)
+---@return lub3d.image.TextureInfo|string info or error message
+function image.make_image(data, label) end
+
+---Write a 2D texture with a mip chain as a KTX2 file.
+---@param levels string[] level data, largest first
+---@param w integer
+---@param h integer
+---@param pixel_format sokol.gfx.PixelFormat one of the formats parse_texture supports
+---@return string data
+function image.encode_ktx2(levels, w, h, pixel_format) end
+
+return image
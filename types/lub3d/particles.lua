@@ -0,0 +1,45 @@
+---@meta
+-- LuaCATS type definitions for lub3d.particles (native particle pool)
+
+---@class lub3d.particles
+---@field INSTANCE_BYTES integer bytes per streamed instance (float4 pos/size, ubyte4n color)
+local particles = {}
+
+---@class lub3d.particles.Pool
+local Pool = {}
+
+---Create a structure-of-arrays particle pool.
+---@param capacity integer
+---@param seed? integer random seed
+---@return lub3d.particles.Pool
+function particles.new_pool(capacity, seed) end
+
+---Spawn up to count particles from an emitter config (see particles.Emitter).
+---@param count integer
+---@param emitter table
+---@return integer emitted
+function Pool:emit(count, emitter) end
+
+---Integrate velocity/position and retire particles whose age reached their life.
+---@param dt number seconds
+function Pool:update(dt) end
+
+---Append one instance per live particle to buffer (sg_append_buffer).
+---@param buffer sokol.gfx.Buffer
+---@return integer offset byte offset for vertex_buffer_offsets
+---@return integer count instances written
+function Pool:append(buffer) end
+
+---@return integer count live particles
+function Pool:count() end
+
+---@return integer capacity
+function Pool:capacity() end
+
+---Remove all particles.
+function Pool:clear() end
+
+---Free the pool (also done by __gc).
+function Pool:destroy() end
+
+return particles
@@ -0,0 +1,36 @@
+---@meta
+-- LuaCATS type definitions for lub3d.pipeline_cache (shared pipelines)
+
+---@class lub3d.pipeline_cache
+local pipeline_cache = {}
+
+---@class lub3d.pipeline_cache.Stats
+---@field hits integer get() calls served by an existing pipeline
+---@field misses integer get() calls that created a pipeline
+---@field pipelines integer pipelines currently cached
+---@field refs integer references held on them
+
+---Pipeline for desc, shared with every equal descriptor (the label is ignored).
+---Takes a reference; give it back with release().
+---@param desc sokol.gfx.PipelineDesc
+---@return sokol.gfx.Pipeline
+function pipeline_cache.get(desc) end
+
+---Drop a reference; the pipeline is destroyed with its last one.
+---Pipelines not created by get() are destroyed right away.
+---@param pipeline sokol.gfx.Pipeline
+function pipeline_cache.release(pipeline) end
+
+---Rebuild, keeping their handles, the cached pipelines using a shader that
+---was re-initialized in place (shader hot reload).
+---@param shader sokol.gfx.Shader
+---@return integer count pipelines rebuilt
+function pipeline_cache.refresh(shader) end
+
+---@return lub3d.pipeline_cache.Stats
+function pipeline_cache.stats() end
+
+---Forget every cached pipeline without destroying them (after gfx.shutdown)
+function pipeline_cache.reset() end
+
+return pipeline_cache
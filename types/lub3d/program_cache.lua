@@ -0,0 +1,35 @@
+---@meta
+-- LuaCATS type definitions for lub3d.program_cache (GL program binaries)
+
+---@class lub3d.program_cache
+local program_cache = {}
+
+---@class lub3d.program_cache.Stats
+---@field loaded integer shaders created from a program binary
+---@field compiled integer shaders built from source with their binary read back
+---@field rejected integer binaries the driver refused (rebuilt from source)
+
+---Whether program binaries can be used: a GL backend whose driver offers
+---at least one binary format (needs gfx.setup).
+---@return boolean
+function program_cache.supported() end
+
+---The driver's "vendor|renderer|version", for binary cache keys; nil when
+---not supported.
+---@return string?
+function program_cache.driver() end
+
+---gfx.make_shader, from a program binary when one is given and the driver
+---accepts it; otherwise from source. Built from source on a supported
+---driver, the shader comes back with its program binary to store.
+---@param desc sokol.gfx.ShaderDesc
+---@param binary? string binary returned by an earlier call
+---@return sokol.gfx.Shader shader
+---@return boolean loaded created from binary
+---@return string? binary program binary to store, when built from source
+function program_cache.make_shader(desc, binary) end
+
+---@return lub3d.program_cache.Stats
+function program_cache.stats() end
+
+return program_cache
@@ -0,0 +1,89 @@
+---@meta
+-- LuaCATS type definitions for lub3d.sprite (native sprite batch core)
+
+---@class lub3d.sprite
+---@field FLOATS_PER_VERT integer floats per vertex (x, y, u, v, r, g, b, a)
+---@field VERTEX_QUAD_BYTES integer bytes per quad in vertex mode (4 vertices)
+---@field INSTANCE_BYTES integer bytes per quad in instanced mode (1 instance)
+local sprite = {}
+
+---@class lub3d.sprite.Batch
+local Batch = {}
+
+---Create a batch with a persistent CPU buffer of max_quads quads.
+---Instanced batches write one per-instance record per quad instead of 4 vertices.
+---@param max_quads integer
+---@param tex_w number atlas width in pixels (for UV normalization)
+---@param tex_h number atlas height in pixels
+---@param instanced? boolean
+---@return lub3d.sprite.Batch
+function sprite.new_batch(max_quads, tex_w, tex_h, instanced) end
+
+---UINT32 index data for max_quads quads (0,1,2, 0,2,3 per quad).
+---@param max_quads integer
+---@return string
+function sprite.quad_indices(max_quads) end
+
+---Transform and queue one quad.
+---Returns false without queuing when the batch is full.
+---@param sx number source X in atlas (pixels)
+---@param sy number source Y in atlas (pixels)
+---@param sw number source width (pixels)
+---@param sh number source height (pixels)
+---@param dx number destination X (pixels)
+---@param dy number destination Y (pixels)
+---@param opts? table { rotate, scale_x, scale_y, origin_x, origin_y, color, layer, blend, texture }
+---@param texture? integer texture slot, overrides opts.texture
+---@return boolean queued
+function Batch:draw(sx, sy, sw, sh, dx, dy, opts, texture) end
+
+---Replace buffer contents with the queued quads (sg_update_buffer).
+---@param buffer sokol.gfx.Buffer
+---@return integer quad_count
+function Batch:update(buffer) end
+
+---Append the queued quads to buffer (sg_append_buffer).
+---@param buffer sokol.gfx.Buffer
+---@return integer offset byte offset for vertex_buffer_offsets
+function Batch:append(buffer) end
+
+---Discard queued quads.
+function Batch:clear() end
+
+---@return integer quad_count quads queued
+function Batch:count() end
+
+---@return integer max_quads
+function Batch:capacity() end
+
+---@return integer bytes bytes uploaded per queued quad
+function Batch:quad_bytes() end
+
+---Set the size of texture slot 0.
+---@param tex_w number
+---@param tex_h number
+function Batch:set_texture_size(tex_w, tex_h) end
+
+---Register (slot == number of slots) or resize a texture slot.
+---@param slot integer
+---@param tex_w number
+---@param tex_h number
+function Batch:set_texture(slot, tex_w, tex_h) end
+
+---Stably sort queued quads by (layer, texture, blend) and build draw runs.
+---@return integer run_count
+function Batch:sort() end
+
+---Describe a run built by sort().
+---@param i integer 1-based run index
+---@return integer layer
+---@return integer texture slot
+---@return integer blend
+---@return integer first 0-based first quad
+---@return integer count
+function Batch:run(i) end
+
+---Free the vertex buffer (also done by __gc).
+function Batch:destroy() end
+
+return sprite
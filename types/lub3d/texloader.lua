@@ -0,0 +1,67 @@
+---@meta
+-- LuaCATS type definitions for lub3d.texloader (background texture loading)
+
+---@class lub3d.texloader
+local texloader = {}
+
+---@class lub3d.texloader.Loader
+local Loader = {}
+
+---@class lub3d.texloader.Result
+---@field id integer request id
+---@field image? sokol.gfx.Image raw handle (wrap with gpu.wrap_image), nil with upload = false
+---@field width? integer uploaded size (reduced by max_size)
+---@field height? integer
+---@field full_width? integer size of the source image
+---@field full_height? integer
+---@field levels? integer mip levels
+---@field bytes? integer uploaded bytes
+---@field decode_ms? number worker time spent decoding, generating mips and encoding
+---@field error? string set instead of image when the request failed
+---@field cache_key? string texture cache key of a BCn request with cache_dir
+---@field cache_bytes? integer size of the cache entry written for this request
+
+---@class lub3d.texloader.Stats
+---@field requested integer
+---@field queued integer waiting for or being decoded by a worker
+---@field ready integer decoded, waiting for upload
+---@field uploaded integer
+---@field failed integer
+---@field bytes integer total uploaded bytes
+---@field frame_bytes integer bytes uploaded by the last update
+---@field cache_hits integer BCn requests served from the texture cache
+---@field cache_misses integer BCn requests that were encoded
+
+---Create a loader with its worker threads.
+---@param opts? { threads?: integer, budget?: integer }
+---@return lub3d.texloader.Loader
+function texloader.new(opts) end
+
+---Queue a texture (PNG/JPG/... decoded with stb_image, or KTX2/DDS).
+---format picks a block format to encode to ("bc1", "bc4", "bc5" or "bc7";
+---bc7 = true is the same as format = "bc7"). cache_dir and cache_params
+---(texture_cache.params) enable the texture cache for encoded textures.
+---max_size drops the largest mip levels until both sides fit (for streaming).
+---upload = false only decodes and encodes (e.g. to fill the texture cache).
+---premultiply, swizzle, normal_z and convert process the texels on the worker
+---before the mips are built (see image.process).
+---@param path string
+---@param opts? { srgb?: boolean, mips?: boolean, mip_filter?: "box"|"kaiser", bc7?: boolean, format?: "bc1"|"bc4"|"bc5"|"bc7", cache_dir?: string, cache_params?: string, max_size?: integer, upload?: boolean, premultiply?: boolean, swizzle?: string, normal_z?: boolean, convert?: "linear"|"srgb" }
+---@return integer id
+function Loader:request(path, opts) end
+
+---Upload decoded textures until budget bytes have been uploaded (at least one).
+---@param budget? integer bytes, defaults to the loader budget (<= 0: no limit)
+---@return lub3d.texloader.Result[]
+function Loader:update(budget) end
+
+---Block until every queued request has been decoded.
+function Loader:wait() end
+
+---@return lub3d.texloader.Stats
+function Loader:stats() end
+
+---Stop the workers and drop pending requests (also done by __gc).
+function Loader:destroy() end
+
+return texloader
@@ -10,6 +10,11 @@ function shdc.init() end
 ---Shutdown the shader compiler
 function shdc.shutdown() end
 
+---Compiler build identity (sokol-tools revision and reflection version),
+---part of the shader cache key
+---@return string
+function shdc.version() end
+
 ---@class shdc.CompileResult
 ---@field success boolean
 ---@field error? string
@@ -17,12 +22,123 @@ function shdc.shutdown() end
 ---@field fs_source? string
 ---@field vs_bytecode? string
 ---@field fs_bytecode? string
+---@field reflection? string Binary reflection, for shdc.shader_desc and shdc.reflect
+---@field compile_ms? number Time spent compiling, in milliseconds (on success)
+
+---@class shdc.OutputOptions
+---@field optimize? boolean Run spirv-opt's performance passes before cross-compiling
+---@field minify? boolean Strip indentation and empty lines from GLSL, MSL and WGSL sources
 
 ---Compile a shader from source
 ---@param source string Shader source code
 ---@param module_name string Module name for the shader
 ---@param target_lang string Target language (hlsl5, metal_macos, wgsl, glsl430, glsl300es)
+---@param defines? string[] Preprocessor defines, each "NAME" or "NAME VALUE" as after #define
+---@param options? shdc.OutputOptions
 ---@return shdc.CompileResult
-function shdc.compile(source, module_name, target_lang) end
+function shdc.compile(source, module_name, target_lang, defines, options) end
+
+---@class shdc.Stages
+---@field vs_source? string
+---@field fs_source? string
+---@field vs_bytecode? string
+---@field fs_bytecode? string
+---@field reflection? string
+
+---@class shdc.CompileAllResult
+---@field success boolean
+---@field error? string
+---@field compile_ms? number Time spent compiling, in milliseconds (on success)
+---@field programs? table<string, table<string, shdc.Stages>> Stages by program name, then target language
+
+---Compile every @program of a source for several languages at once.
+---The source is parsed once and each language is translated once for all
+---programs, instead of once per compile call.
+---@param source string Shader source code
+---@param target_langs string[] Target languages (hlsl5, metal_macos, wgsl, glsl430, glsl300es)
+---@param defines? string[] Preprocessor defines, each "NAME" or "NAME VALUE" as after #define
+---@param options? shdc.OutputOptions
+---@return shdc.CompileAllResult
+function shdc.compile_all(source, target_langs, defines, options) end
+
+---@class shdc.Job
+local Job = {}
+
+---Whether the compile has finished
+---@return boolean
+function Job:done() end
+
+---The compile_all result once done, nil while still compiling
+---@return shdc.CompileAllResult?
+function Job:result() end
+
+---Block until the compile has finished and return its result
+---@return shdc.CompileAllResult
+function Job:wait() end
+
+---Drop the job; a running compile finishes in the background and is discarded
+function Job:cancel() end
+
+---Queue shdc.compile_all on the background compile threads and return at once.
+---Poll job:done() or job:result() each frame; shdc.shutdown joins the threads.
+---@param source string Shader source code
+---@param target_langs string[] Target languages (hlsl5, metal_macos, wgsl, glsl430, glsl300es)
+---@param defines? string[] Preprocessor defines, each "NAME" or "NAME VALUE" as after #define
+---@param options? shdc.OutputOptions
+---@return shdc.Job
+function shdc.compile_async(source, target_langs, defines, options) end
+
+---Number of background compile threads. The default is a few, leaving the
+---other cores to the game; nil or 0 uses every core (offline cooking).
+---@param count? integer
+function shdc.set_threads(count) end
+
+---@class shdc.UniformMember
+---@field name string
+---@field type string float, float2, float3, float4, int, int2, int3, int4, mat4 or invalid
+---@field offset integer Byte offset in the block (std140)
+---@field array_count integer 0 when not an array
+
+---@class shdc.UniformBlock
+---@field stage "vertex"|"fragment"
+---@field name string
+---@field size integer
+---@field members shdc.UniformMember[]
+
+---@class shdc.Binding
+---@field stage "vertex"|"fragment"
+---@field name string
+
+---@class shdc.Attr
+---@field name string
+---@field sem_name string
+---@field sem_index integer
+
+---@class shdc.Reflection
+---@field uniform_blocks table<integer, shdc.UniformBlock> By bind slot + 1
+---@field textures table<integer, shdc.Binding> By view slot + 1
+---@field samplers table<integer, shdc.Binding> By sampler slot + 1
+---@field attrs table<integer, shdc.Attr> By attribute location + 1
+
+---Build the binding part of a shader descriptor from a compile result's
+---reflection: uniform_blocks (with GLSL uniforms), views, samplers,
+---texture_sampler_pairs and attrs, valid for every backend. Add
+---vertex_func/fragment_func and pass it to gfx.ShaderDesc.
+---@param reflection string CompileResult.reflection
+---@return table
+function shdc.shader_desc(reflection) end
+
+---Decode a compile result's reflection into plain tables
+---@param reflection string CompileResult.reflection
+---@return shdc.Reflection
+function shdc.reflect(reflection) end
+
+---Whether a reflection blob (e.g. read back from the shader cache) is intact:
+---right size and version, slots, stages and counts in range. shader_desc and
+---reflect raise an error on one that is not.
+---@param reflection string
+---@return boolean ok
+---@return string? err
+function shdc.valid_reflection(reflection) end
 
 return shdc